@@ -8,7 +8,7 @@ from PyQt6.QtGui import *
 from .TableView import ListView, TableView, StyledItemDelegate, RowValueRole
 from .libroke import RokeException, default_config_dir, \
     build, rebuild, build_cancel, rename_index, \
-    find, index_info, \
+    find, index_info, Session, \
     ROKE_CASE_SENSITIVE, ROKE_CASE_INSENSITIVE, \
     ROKE_DEFAULT, ROKE_GLOB, ROKE_REGEX
 import json
@@ -115,6 +115,75 @@ class BuildThread(QThread):
         except RokeException as e:
             print(e)
 
+class SearchThread(QThread):
+    """
+    run the queries of a session off the UI thread
+
+    only the latest query is wanted: a new one cancels the query which is
+    running, and queries which were replaced before they started are
+    skipped. results are reported with the number of their query, so
+    results which arrive late can be ignored.
+    """
+
+    results = pyqtSignal(int, object)
+
+    def __init__(self, session):
+        super(SearchThread, self).__init__()
+        self.session = session
+        self.mutex = QMutex()
+        self.cond = QWaitCondition()
+        self.pending = None
+        self.running = False
+        self.quit = False
+        self.generation = 0
+
+    def search(self, text, flags, limit):
+        self.mutex.lock()
+        self.generation += 1
+        self.pending = (self.generation, text, flags, limit)
+        if self.running:
+            self.session.cancel()
+        self.cond.wakeOne()
+        self.mutex.unlock()
+        return self.generation
+
+    def stop(self):
+        self.mutex.lock()
+        self.quit = True
+        if self.running:
+            self.session.cancel()
+        self.cond.wakeOne()
+        self.mutex.unlock()
+        self.wait()
+
+    def run(self):
+        while True:
+            self.mutex.lock()
+            while self.pending is None and not self.quit:
+                self.cond.wait(self.mutex)
+            if self.quit:
+                self.mutex.unlock()
+                break
+            generation, text, flags, limit = self.pending
+            self.pending = None
+            self.running = True
+            self.mutex.unlock()
+
+            try:
+                data = [os.path.split(p) for p in
+                    self.session.find([text], flags, limit)]
+            except RokeException as e:
+                print(e)
+                data = None
+
+            self.mutex.lock()
+            self.running = False
+            # a cancelled query writes nothing, and is not reported
+            current = (generation == self.generation)
+            self.mutex.unlock()
+            if current and data is not None:
+                self.results.emit(generation, data)
+
 class RebuildAllThread(QThread):
 
     statusText = pyqtSignal(str)
@@ -527,6 +596,15 @@ class MainWindow(QMainWindow):
 
         self.config_dir = default_config_dir()
         self.config = RokeConfig.getConfig(self.config_dir)
+        # keeps the indexes open, and refines the last results when the
+        # text is extended
+        self.session = Session(self.config_dir)
+        # queries run off the UI thread, and each keystroke cancels the
+        # query of the one before it
+        self.search_thread = SearchThread(self.session)
+        self.search_thread.results.connect(self.onSearchResults)
+        self.search_thread.start()
+        self.search_generation = 0
 
         self.btn_mode = QComboBox(self)
         self.btn_mode.addItem("Default", ROKE_DEFAULT)
@@ -537,6 +615,7 @@ class MainWindow(QMainWindow):
 
         self.edit = QLineEdit(self)
         self.edit.returnPressed.connect(self.onReturnPressed)
+        self.edit.textChanged.connect(self.onTextChanged)
         self.edit.setToolTip("Enter a search term")
 
         self.btn_search = QPushButton("Search", self)
@@ -672,10 +751,20 @@ class MainWindow(QMainWindow):
 
         text = self.edit.text()
 
-        gen_results = find(self.config_dir, [text],
+        self.search_generation = self.search_thread.search(text,
             self.config.getSearchFlags(),
             self.config.getSearchLimit())
-        data = [os.path.split(p) for p in gen_results]
+
+    def onTextChanged(self, text):
+
+        if text:
+            self.onReturnPressed()
+
+    def onSearchResults(self, generation, data):
+
+        if generation != self.search_generation:
+            return
+
         self.table.setNewData(data)
 
         self.table.resizeColumnToContents(0)
@@ -727,6 +816,8 @@ class MainWindow(QMainWindow):
     def closeEvent(self, event):
         sys.stdout.write("Closing Application\n")
 
+        self.search_thread.stop()
+
         self.config.save()
 
 def handle_exception(exc_type, exc_value, exc_traceback):
@@ -160,10 +160,52 @@ ROKE_GLOB = 2
 ROKE_REGEX = 4
 ROKE_MATCH_MASK = (ROKE_GLOB|ROKE_REGEX)
 
+ROKE_TYPE_FILE = 1
+ROKE_TYPE_DIR = 2
+ROKE_TYPE_LINK = 4
+
+ROKE_FORMAT_LINES = 0
+ROKE_FORMAT_NUL = 1
+ROKE_FORMAT_RECORDS = 2
+
+class RokeLocateOptions(ctypes.Structure):
+    _fields_ = [
+        ("match_flags", ctypes.c_int),
+        ("limit", ctypes.c_int),
+        ("filters", c_uint32),
+        ("newer", ctypes.c_int64),
+        ("older", ctypes.c_int64),
+        ("size_min", c_uint64),
+        ("size_max", c_uint64),
+        ("types", c_uint32),
+        ("under", c_char_p),
+        ("threads", ctypes.c_int),
+        ("format", ctypes.c_int),
+    ]
+
+class RokeResult(ctypes.Structure):
+    _fields_ = [
+        ("path", c_char_p),
+        ("pathlen", c_uint32),
+        ("id", c_uint32),
+        ("index", c_uint32),
+        ("type", c_uint32),
+        ("size", c_uint64),
+    ]
+
 cdef('roke_default_config_dir', c_uint64, c_char_p, c_uint64)
 cdef('roke_build_index_fd', c_int, c_int, c_char_p, c_char_p, c_char_p, c_char_pp)
 cdef('roke_locate_fd', c_int, c_int, c_char_p, c_char_pp, c_uint64, c_int, c_int)
 cdef('roke_build_cancel', c_int)
+cdef('roke_locate_options_init', None, c_void_p)
+cdef('roke_search_open', c_int, c_void_p, c_char_p, c_char_pp, c_size_t, c_void_p)
+cdef('roke_search_next', c_int, c_void_p, c_void_p, c_size_t, c_char_p, c_size_t)
+cdef('roke_search_cancel', None, c_void_p)
+cdef('roke_search_close', None, c_void_p)
+cdef('roke_session_open', c_int, c_void_p, c_char_p)
+cdef('roke_session_locate_fd', c_int, c_void_p, c_int, c_char_pp, c_size_t, c_void_p)
+cdef('roke_session_cancel', None, c_void_p)
+cdef('roke_session_close', None, c_void_p)
 cdef('roke_index_dirinfo', c_int, c_char_p, c_char_p, c_char_p, c_size_t)
 cdef('roke_index_info', c_int, c_char_p, c_char_p, c_uint32_p, c_uint32_p, c_uint64_p)
 
@@ -260,6 +302,110 @@ def find(config_dir, patterns, flags=ROKE_CASE_SENSITIVE, limit=1000):
     if result['error'] is not None:
         raise RokeException("Locate Failed: %s" % result['error'])
 
+def search(config_dir, patterns, flags=ROKE_CASE_SENSITIVE, limit=1000, batch=256):
+    """
+    yield (path, type, size) for every result, without a thread or a pipe
+
+    results are found as they are asked for, so closing the generator
+    stops the search.
+    """
+
+    if isinstance(patterns, str):
+        patterns = [patterns, ]
+
+    patterns = [x.encode("utf-8") for x in patterns]
+    data = (c_char_p *(len(patterns)))(*patterns)
+
+    opts = RokeLocateOptions()
+    roke_locate_options_init(ctypes.byref(opts))
+    opts.match_flags = flags
+    opts.limit = limit
+
+    handle = c_void_p()
+    if roke_search_open(ctypes.byref(handle), config_dir.encode("utf-8"),
+            data, len(patterns), ctypes.byref(opts)) != 0:
+        raise RokeException("Error executing query: %s" % patterns)
+
+    results = (RokeResult * batch)()
+    bufsize = 4096 * 16
+    buf = ctypes.create_string_buffer(bufsize)
+
+    try:
+        while True:
+            count = roke_search_next(handle, results, batch, buf, bufsize)
+            if count < 0:
+                raise RokeException("Error executing query: %s" % patterns)
+            if count == 0:
+                break
+            for r in results[:count]:
+                yield (r.path.decode("utf-8", "ignore"), r.type, r.size)
+    finally:
+        roke_search_close(handle)
+
+class Session(object):
+    """
+    run a series of queries, such as the text typed into a search box
+
+    a query which extends the one before it, conf after con, only tests
+    the previous matches. cancel() may be called from another thread to
+    drop a query which is no longer wanted.
+    """
+
+    def __init__(self, config_dir):
+        self.handle = c_void_p()
+        if roke_session_open(ctypes.byref(self.handle), config_dir.encode("utf-8")) != 0:
+            raise RokeException("Error opening session: %s" % config_dir)
+
+    def _find_impl(self, result, fd, patterns, flags, limit):
+
+        try:
+            data = (c_char_p *(len(patterns)))(*patterns)
+            opts = RokeLocateOptions()
+            roke_locate_options_init(ctypes.byref(opts))
+            opts.match_flags = flags
+            opts.limit = limit
+
+            result['error'] = roke_session_locate_fd(self.handle, fd, data,
+                len(patterns), ctypes.byref(opts))
+        except Exception as e:
+            # prevents a hang, waiting for fd to close
+            os.close(fd)
+            result['error'] = "%s" % e
+
+    def find(self, patterns, flags=ROKE_CASE_SENSITIVE, limit=1000):
+
+        if isinstance(patterns, str):
+            patterns = [patterns, ]
+        patterns = [x.encode("utf-8") for x in patterns]
+
+        rd, wd = os.pipe()
+        result = {'error': None}
+        rb = os.fdopen(rd, "rb")
+        t = threading.Thread(target=self._find_impl,
+            args=(result, wd, patterns, flags, limit))
+
+        try:
+            t.start()
+            for line in rb:
+                yield line.decode("utf-8", "ignore")[:-1]
+        finally:
+            rb.close()
+            t.join()
+
+        if result['error']:
+            raise RokeException("Error executing query: %s" % patterns)
+
+    def cancel(self):
+        roke_session_cancel(self.handle)
+
+    def close(self):
+        if self.handle:
+            roke_session_close(self.handle)
+            self.handle = c_void_p()
+
+    def __del__(self):
+        self.close()
+
 def _build_impl(result, fd, config_dir, name, root):
 
     try:
@@ -9,6 +9,9 @@ argparse_spec_t spec[] = {
     {0, 0, "root", "directory to scan"},
 
     {0, 0, 0, "Optional Arguments:"},
+    {0, 'm', 0, "store the size, mtime and type of every entry (slower)"},
+    {0, 'z', 0, "compress the names to reduce the size of the index"},
+    {0, 'n', 0, "store normalized names, so that roke -n is as fast as plain matching"},
     {"config", 0, 0, "path to the configuration directory."},
 
     {0, 0, 0, "Other:"},
@@ -36,13 +39,29 @@ int main(int argc, char** argv)
 
     makedirs((uint8_t*)config_dir);
 
-    _abspath((uint8_t*)argparse->argv[2], strlen(argparse->argv[2]),
-             (uint8_t*)root, sizeof(root));
+    size_t len = _abspath((uint8_t*)argparse->argv[2], strlen(argparse->argv[2]),
+                          (uint8_t*)root, sizeof(root));
+    if (len == 0 || len >= sizeof(root)) {
+        fprintf(stderr, "invalid path: %s\n", argparse->argv[2]);
+        err = 1;
+        goto exit;
+    }
 
     name = (char*) argparse->argv[1];
 
+    int build_flags = 0;
+    if (argparser_get_flag(argparse, 'm')) {
+        build_flags |= ROKE_BUILD_METADATA;
+    }
+    if (argparser_get_flag(argparse, 'z')) {
+        build_flags |= ROKE_BUILD_COMPRESS;
+    }
+    if (argparser_get_flag(argparse, 'n')) {
+        build_flags |= ROKE_BUILD_NORMALIZE;
+    }
+
     fprintf(stdout, "Building Index: %s %s\n", name, root);
-    roke_build_index(config_dir, name, root, blacklist);
+    roke_build_index_ex(config_dir, name, root, blacklist, build_flags);
 
 exit:
     argparser_delete(&argparse);
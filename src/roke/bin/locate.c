@@ -1,20 +1,57 @@
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+// F_SETPIPE_SZ
+#define _GNU_SOURCE
+#endif
 
 #include "roke/libroke_internal.h"
 
+#if defined(__linux__)
+#include <fcntl.h>
+#endif
+
+
 argparse_spec_t spec[] = {
     {0, 0, 0, "quickly find files by name"},
     {0, 0, 0, "Regular Expression Help:\n"
-        "todo\n"},
+        "  POSIX extended syntax, matched anywhere in the name unless anchored\n"
+        "  .  [abc] [^a-z] [[:alpha:]]  \\d \\w \\s (\\D \\W \\S negated)  \\. for a literal .\n"
+        "  ( ) |  * + ? {n} {n,} {n,m}  ^ $\n"},
+    {0, 0, 0, "Query Help:\n"
+        "  terms: name:PAT path:PAT name~REGEX path~REGEX size>N size<N size=N\n"
+        "         newer:T older:T type:fdl, or a bare name pattern\n"
+        "  combine terms with AND, OR, NOT and ( ). AND is implied between terms\n"},
     {0, 0, 0, "Positional Arguments:"},
     {0, 0, "pattern", "file name pattern."},
-    {0, ARGPARSE_OPT, "pattern2", "file path pattern."},
+    {0, ARGPARSE_OPTMANY, "patterns", "file path patterns, or more name patterns with --any or --all."},
 
     {0, 0, 0, "Optional Arguments:"},
     {0, 'i', 0, "case insensitive matching"},
     {0, 'I', 0, "case sensitive matching"},
-    {0, 'g', 0, "use shell-like glob matching (ignores -i switch)"},
+    {0, 'n', 0, "ignore case and Unicode normalization, e.g. composed and decomposed accents"},
+    {0, 'g', 0, "use shell-like glob matching, the whole name must match"},
     {0, 'r', 0, "use regular expression matching (ignores -i switch)"},
+    {0, 'f', 0, "fuzzy matching, the pattern is a subsequence of the path. best matches first"},
+    {"any", 0, 0, "every pattern matches names, find names containing any of them"},
+    {"all", 0, 0, "every pattern matches names, find names containing all of them"},
+    {0, 'q', 0, "the patterns form a query, e.g. 'name:*.log AND path:/var/ AND NOT name:*.gz AND size>10M'"},
+    {"limit", 'l', "N", "show at most N results, e.g. -l20"},
+    {"rank", 0, 0, "best results first: exact name matches, then shallower paths, then recently modified"},
     {"config", 0, 0, "path to the configuration directory."},
+    {"under", 0, 0, "only find entries below this directory."},
+    {"threads", 0, 0, "number of threads used to scan an index (default: one per cpu)"},
+    {"no-server", 0, 0, "search the indexes directly, even if roke-server is running"},
+    {"count", 'c', 0, "print the number of matches instead of the matches"},
+    {"per-index", 0, 0, "with --count, print the number of matches in every index"},
+    {"exists", 0, 0, "print nothing, exit with status 0 if anything matches and 1 otherwise"},
+    {"null", '0', 0, "end each result with a null byte instead of a newline, for xargs -0"},
+    {"records", 0, 0, "write each result as its length, a 32 bit integer in host byte order, followed by the path"},
+    {"existing", 'e', 0, "only show results which still exist on disk, checked as they are written"},
+
+    {0, 0, 0, "Filters (require an index built with roke-build -m):"},
+    {"newer", 0, 0, "modified within a duration (30m, 12h, 2d, 1w) or since a date (YYYY-MM-DD)"},
+    {"older", 0, 0, "modified before a duration ago or a date"},
+    {"size", 0, 0, "size in bytes or with a unit k, M, G, T. +N for larger, -N for smaller"},
+    {"type", 0, 0, "f (file), d (directory), l (symbolic link), or a combination"},
 
     {0, 0, 0, "Other:"},
     {0, 'v', 0, "verbose"},
@@ -25,6 +62,7 @@ int main(int argc, char** argv)
 {
     int err = 0;
     char config_dir[ROKE_PATH_MAX];
+    char under[ROKE_PATH_MAX];
 
     argparser_t *argparse = newArgParse(argc, (const char**) argv, spec);
 
@@ -35,20 +73,186 @@ int main(int argc, char** argv)
         goto exit;
     }
 
-    int flags = 0;
+    roke_locate_options_t opts;
+    roke_locate_options_init(&opts);
+
     if (argparser_get_flag(argparse, 'i')) {
-        flags |= ROKE_CASE_INSENSITIVE;
+        opts.match_flags |= ROKE_CASE_INSENSITIVE;
+    }
+
+    if (argparser_get_flag(argparse, 'n')) {
+        opts.match_flags |= ROKE_NORMALIZE;
     }
 
     if (argparser_get_flag(argparse, 'g')) {
-        flags |= ROKE_GLOB;
+        opts.match_flags |= ROKE_GLOB;
     }
 
     if (argparser_get_flag(argparse, 'r')) {
-        flags |= ROKE_REGEX;
+        opts.match_flags |= ROKE_REGEX;
+    }
+
+    if (argparser_get_flag(argparse, 'f')) {
+        opts.match_flags |= ROKE_FUZZY;
+    }
+
+    if (argparser_has_kwarg(argparse, "rank")) {
+        opts.match_flags |= ROKE_RANK;
     }
 
-    err = roke_locate(config_dir, argparse->argv + 1, argparse->argc - 1, flags, 0);
+    if (argparser_get_flag(argparse, 'q')) {
+        opts.match_flags |= ROKE_QUERY;
+    } else if (argparser_has_kwarg(argparse, "all")) {
+        opts.match_flags |= ROKE_MATCH_ALL;
+    } else if (argparser_has_kwarg(argparse, "any")) {
+        opts.match_flags |= ROKE_MATCH_ANY;
+    }
+
+    const char* value = NULL;
+    int64_t now = (int64_t) time(NULL);
+
+    argparser_default_kwarg(argparse, "newer", &value);
+    if (value != NULL) {
+        if (roke_parse_time_filter(value, now, &opts.newer)!=0) {
+            fprintf(stderr, "invalid time: %s\n", value);
+            err = 1;
+            goto exit;
+        }
+        opts.filters |= ROKE_FILTER_NEWER;
+        value = NULL;
+    }
+
+    argparser_default_kwarg(argparse, "older", &value);
+    if (value != NULL) {
+        if (roke_parse_time_filter(value, now, &opts.older)!=0) {
+            fprintf(stderr, "invalid time: %s\n", value);
+            err = 1;
+            goto exit;
+        }
+        opts.filters |= ROKE_FILTER_OLDER;
+        value = NULL;
+    }
+
+    argparser_default_kwarg(argparse, "size", &value);
+    if (value != NULL) {
+        if (roke_parse_size_filter(value, &opts)!=0) {
+            fprintf(stderr, "invalid size: %s\n", value);
+            err = 1;
+            goto exit;
+        }
+        value = NULL;
+    }
+
+    argparser_default_kwarg(argparse, "type", &value);
+    if (value != NULL) {
+        if (roke_parse_type_filter(value, &opts)!=0) {
+            fprintf(stderr, "invalid type: %s\n", value);
+            err = 1;
+            goto exit;
+        }
+        value = NULL;
+    }
+
+    argparser_default_kwarg(argparse, "under", &value);
+    if (value != NULL) {
+        size_t len = _abspath((const uint8_t*) value, strlen(value),
+                              (uint8_t*) under, sizeof(under));
+        // a path which does not fit is not searched as a shorter prefix
+        if (len == 0 || len >= sizeof(under)) {
+            fprintf(stderr, "invalid path: %s\n", value);
+            err = 1;
+            goto exit;
+        }
+        opts.under = under;
+        value = NULL;
+    }
+
+    int32_t limit = 0;
+    argparser_default_kwarg_i(argparse, "limit", &limit);
+    opts.limit = (limit > 0) ? limit : 0;
+
+    int32_t threads = 0;
+    argparser_default_kwarg_i(argparse, "threads", &threads);
+    opts.threads = (threads > 0) ? threads : 0;
+
+    if (argparser_has_kwarg(argparse, "records")) {
+        opts.format = ROKE_FORMAT_RECORDS;
+    } else if (argparser_has_kwarg(argparse, "null")) {
+        opts.format = ROKE_FORMAT_NUL;
+    }
+
+    if (argparser_has_kwarg(argparse, "existing")) {
+        if (argparser_has_kwarg(argparse, "count") || argparser_has_kwarg(argparse, "exists")) {
+            fprintf(stderr, "--existing can not be used with --count or --exists\n");
+            err = 1;
+            goto exit;
+        }
+        opts.filters |= ROKE_FILTER_EXISTS;
+    }
+
+    if (argparser_has_kwarg(argparse, "exists")) {
+        // stop at the first match
+        opts.limit = 1;
+        int64_t n = roke_count(config_dir, argparse->argv + 1, argparse->argc - 1,
+            &opts, NULL, NULL);
+        err = (n > 0) ? 0 : (n == 0) ? 1 : 2;
+        goto exit;
+    }
+
+    if (argparser_has_kwarg(argparse, "count")) {
+        roke_index_count_t* counts = NULL;
+        size_t capacity = (argparser_has_kwarg(argparse, "per-index")) ? 64 : 0;
+        size_t ncounts = 0;
+        int64_t n = -1;
+        while (1) {
+            if (capacity > 0) {
+                counts = calloc(capacity, sizeof(roke_index_count_t));
+                if (counts == NULL) {
+                    break;
+                }
+            }
+            ncounts = capacity;
+            n = roke_count(config_dir, argparse->argv + 1, argparse->argc - 1,
+                &opts, counts, &ncounts);
+            if (n < 0 || ncounts <= capacity || capacity == 0) {
+                break;
+            }
+            // count again with room for every index
+            free(counts);
+            capacity = ncounts;
+        }
+        if (n < 0) {
+            err = 1;
+        } else {
+            size_t i;
+            for (i=0; counts != NULL && i<ncounts; i++) {
+                printf("%" PRIu64 " %s\n", counts[i].count, counts[i].name);
+            }
+            printf("%" PRId64 "%s\n", n, (counts != NULL) ? " total" : "");
+        }
+        free(counts);
+        goto exit;
+    }
+
+#if defined(__linux__)
+    struct stat st;
+    if (fstat(roke_fileno(stdout), &st)==0 && S_ISFIFO(st.st_mode)) {
+        // a full output buffer fits in the pipe, instead of being written
+        // and read back 64k at a time. fails harmlessly above pipe-max-size
+        fcntl(roke_fileno(stdout), F_SETPIPE_SZ, ROKE_OUTPUT_CAPACITY);
+    }
+#endif
+
+    // roke-server has the indexes mapped already
+    err = -1;
+    if (!argparser_has_kwarg(argparse, "no-server")) {
+        fflush(stdout);
+        err = roke_locate_remote_fd(roke_fileno(stdout), config_dir,
+            argparse->argv + 1, argparse->argc - 1, &opts);
+    }
+    if (err < 0) {
+        err = roke_locate_ex(config_dir, argparse->argv + 1, argparse->argc - 1, &opts);
+    }
 
   exit:
     argparser_delete(&argparse);
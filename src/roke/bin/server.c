@@ -0,0 +1,48 @@
+
+#include "roke/libroke_internal.h"
+
+#include <signal.h>
+
+argparse_spec_t spec[] = {
+    {0, 0, 0, "answer roke queries with the indexes kept in memory.\n"
+        "roke uses the server of its config directory when one is running,\n"
+        "and indexes rebuilt by roke-build are used by the next query."},
+
+    {0, 0, 0, "Optional Arguments:"},
+    {"config", 0, 0, "path to the configuration directory."},
+
+    {0, 0, 0, "Other:"},
+    {0, 'v', 0, "verbose"},
+    {0, 0, 0, 0},
+};
+
+static void
+_stop(int sig)
+{
+    (void) sig;
+    roke_server_stop();
+}
+
+int main(int argc, char** argv)
+{
+    int err = 0;
+    char config_dir[ROKE_PATH_MAX];
+
+    argparser_t *argparse = newArgParse(argc, (const char**) argv, spec);
+
+    char* pconfig = NULL;
+    argparser_default_kwarg(argparse, "config", (const char**) &pconfig);
+    if (roke_get_config_dir(config_dir, sizeof(config_dir), pconfig)==0) {
+        err = 1;
+        goto exit;
+    }
+
+    signal(SIGINT, _stop);
+    signal(SIGTERM, _stop);
+
+    err = roke_server_run(config_dir);
+
+  exit:
+    argparser_delete(&argparse);
+    return err;
+}
@@ -0,0 +1,247 @@
+#include "roke/common/aho_corasick.h"
+
+/**
+ * @brief compile a set of literal patterns
+ * @param patterns the patterns, which need not be null terminated
+ * @param lens     the length of each pattern
+ * @return non-zero on failure
+ */
+int
+roke_ac_init(
+    roke_ac_t* ac,
+    const uint8_t** patterns,
+    const size_t* lens,
+    uint32_t npatterns)
+{
+    uint32_t* fail = NULL;
+    uint32_t* queue = NULL;
+    uint32_t* own_head = NULL;
+    uint32_t* own_next = NULL;
+    uint32_t* cnt = NULL;
+    uint64_t maxstates = 1;
+    uint32_t i, c;
+
+    memset(ac, 0, sizeof(roke_ac_t));
+    ac->npatterns = npatterns;
+
+    // every byte used by a pattern gets its own column. the remaining
+    // bytes share column zero, which always leads back to the root
+    ac->nclasses = 1;
+    for (i=0; i<npatterns; i++) {
+        size_t k;
+        for (k=0; k<lens[i]; k++) {
+            uint8_t b = patterns[i][k];
+            if (ac->classes[b] == 0) {
+                ac->classes[b] = (uint16_t) ac->nclasses++;
+            }
+        }
+        maxstates += lens[i];
+    }
+    if (maxstates >= ROKE_AC_ACCEPT) {
+        goto error;
+    }
+
+    uint32_t nc = ac->nclasses;
+    ac->delta = calloc(maxstates * nc, sizeof(uint32_t));
+    own_head = malloc(maxstates * sizeof(uint32_t));
+    own_next = malloc((npatterns + 1) * sizeof(uint32_t));
+    if (ac->delta == NULL || own_head == NULL || own_next == NULL) {
+        goto error;
+    }
+    memset(own_head, 0xFF, maxstates * sizeof(uint32_t));
+
+    // build the trie. zero is never a child, so it marks a missing edge
+    ac->nstates = 1;
+    for (i=0; i<npatterns; i++) {
+        uint32_t s = 0;
+        size_t k;
+        for (k=0; k<lens[i]; k++) {
+            uint32_t* t = &ac->delta[(size_t) s * nc + ac->classes[patterns[i][k]]];
+            if (*t == 0) {
+                *t = ac->nstates++;
+            }
+            s = *t;
+        }
+        own_next[i] = own_head[s];
+        own_head[s] = i;
+        ac->nempty += (lens[i] == 0);
+    }
+
+    fail = calloc(ac->nstates, sizeof(uint32_t));
+    queue = malloc(ac->nstates * sizeof(uint32_t));
+    cnt = calloc(ac->nstates, sizeof(uint32_t));
+    ac->out_begin = calloc(ac->nstates + 1, sizeof(uint32_t));
+    if (fail == NULL || queue == NULL || cnt == NULL || ac->out_begin == NULL) {
+        goto error;
+    }
+
+    // resolve the failure links breadth first, so that the row of the
+    // failure state is complete before it is copied. the rows of states
+    // which have not been visited still contain only trie edges.
+    uint32_t head = 0, tail = 0;
+    queue[tail++] = 0;
+    while (head < tail) {
+        uint32_t s = queue[head++];
+        uint32_t* row = &ac->delta[(size_t) s * nc];
+        const uint32_t* frow = &ac->delta[(size_t) fail[s] * nc];
+        for (c=0; c<nc; c++) {
+            if (row[c] != 0) {
+                fail[row[c]] = (s == 0) ? 0 : frow[c];
+                queue[tail++] = row[c];
+            } else {
+                row[c] = (s == 0) ? 0 : frow[c];
+            }
+        }
+    }
+
+    // a state outputs its own patterns and those of its failure state,
+    // which is always visited first
+    uint64_t nout = 0;
+    for (i=0; i<tail; i++) {
+        uint32_t s = queue[i];
+        uint32_t p;
+        for (p=own_head[s]; p!=UINT32_MAX; p=own_next[p]) {
+            cnt[s]++;
+        }
+        if (s != 0) {
+            cnt[s] += cnt[fail[s]];
+        }
+        nout += cnt[s];
+    }
+    if (nout >= UINT32_MAX) {
+        goto error;
+    }
+    for (i=0; i<ac->nstates; i++) {
+        ac->out_begin[i + 1] = ac->out_begin[i] + cnt[i];
+    }
+    ac->out = malloc((nout + 1) * sizeof(uint32_t));
+    if (ac->out == NULL) {
+        goto error;
+    }
+    for (i=0; i<tail; i++) {
+        uint32_t s = queue[i];
+        uint32_t n = ac->out_begin[s];
+        uint32_t p;
+        for (p=own_head[s]; p!=UINT32_MAX; p=own_next[p]) {
+            ac->out[n++] = p;
+        }
+        if (s != 0) {
+            memcpy(ac->out + n, ac->out + ac->out_begin[fail[s]],
+                cnt[fail[s]] * sizeof(uint32_t));
+        }
+    }
+
+    // flag transitions into accepting states, so that a scan only looks
+    // at the outputs when a pattern has ended
+    for (i=0; i<ac->nstates * nc; i++) {
+        if (cnt[ac->delta[i]] > 0) {
+            ac->delta[i] |= ROKE_AC_ACCEPT;
+        }
+    }
+
+    free(fail);
+    free(queue);
+    free(cnt);
+    free(own_head);
+    free(own_next);
+    return 0;
+
+  error:
+    free(fail);
+    free(queue);
+    free(cnt);
+    free(own_head);
+    free(own_next);
+    roke_ac_free(ac);
+    return 1;
+}
+
+void
+roke_ac_free(roke_ac_t* ac)
+{
+    free(ac->delta);
+    ac->delta = NULL;
+    free(ac->out_begin);
+    ac->out_begin = NULL;
+    free(ac->out);
+    ac->out = NULL;
+    ac->nstates = 0;
+}
+
+/**
+ * @brief test if any pattern occurs in a string
+ * @return non-zero if at least one pattern was found
+ */
+int
+roke_ac_match_any(
+    const roke_ac_t* ac,
+    const uint8_t* str,
+    size_t len)
+{
+    const uint32_t* delta = ac->delta;
+    const uint16_t* classes = ac->classes;
+    uint32_t nc = ac->nclasses;
+    uint32_t s = 0;
+    size_t i;
+
+    if (ac->nempty > 0) {
+        return 1;
+    }
+
+    for (i=0; i<len; i++) {
+        uint32_t d = delta[(size_t) s * nc + classes[str[i]]];
+        if (d & ROKE_AC_ACCEPT) {
+            return 1;
+        }
+        s = d;
+    }
+    return 0;
+}
+
+/**
+ * @brief find which patterns occur in a string
+ * @param seen (npatterns + 63) / 64 words, bit i is set if pattern i
+ *             was found
+ * @return the number of distinct patterns found. the scan stops once
+ *         every pattern has been found
+ */
+uint32_t
+roke_ac_match_all(
+    const roke_ac_t* ac,
+    const uint8_t* str,
+    size_t len,
+    uint64_t* seen)
+{
+    const uint32_t* delta = ac->delta;
+    const uint16_t* classes = ac->classes;
+    uint32_t nc = ac->nclasses;
+    uint32_t found = 0;
+    uint32_t s = 0;
+    uint32_t k;
+    size_t i;
+
+    memset(seen, 0, sizeof(uint64_t) * ((ac->npatterns + 63) / 64));
+
+    // empty patterns are outputs of the root
+    for (k=ac->out_begin[0]; k<ac->out_begin[1]; k++) {
+        uint32_t p = ac->out[k];
+        seen[p >> 6] |= ((uint64_t) 1) << (p & 63);
+        found++;
+    }
+
+    for (i=0; i<len && found<ac->npatterns; i++) {
+        uint32_t d = delta[(size_t) s * nc + classes[str[i]]];
+        s = d & ~ROKE_AC_ACCEPT;
+        if (d & ROKE_AC_ACCEPT) {
+            for (k=ac->out_begin[s]; k<ac->out_begin[s + 1]; k++) {
+                uint32_t p = ac->out[k];
+                uint64_t bit = ((uint64_t) 1) << (p & 63);
+                if (!(seen[p >> 6] & bit)) {
+                    seen[p >> 6] |= bit;
+                    found++;
+                }
+            }
+        }
+    }
+    return found;
+}
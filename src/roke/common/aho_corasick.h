@@ -0,0 +1,45 @@
+#ifndef ROKE_COMMON_AHO_CORASICK_H
+#define ROKE_COMMON_AHO_CORASICK_H
+
+/**
+ *
+ * @file roke/common/aho_corasick.h
+ * @brief match many literal patterns in a single pass
+ *
+ * The patterns are compiled into a trie whose failure links are resolved
+ * ahead of time, giving a complete DFA: every byte of the string is one
+ * table lookup, independent of the number of patterns.
+ *
+ * Bytes which do not occur in any pattern all behave the same way, so
+ * bytes are first mapped to a class and the table has one column per
+ * class rather than 256.
+ */
+
+#include "roke/common/compat.h"
+
+// set on a transition into a state where at least one pattern ends
+#define ROKE_AC_ACCEPT 0x80000000u
+
+/**
+ * @brief a compiled set of literal patterns
+ */
+typedef struct roke_ac {
+    uint16_t classes[256];  // byte to column of the transition table
+    uint32_t nclasses;
+    uint32_t nstates;
+    uint32_t* delta;        // nstates * nclasses transitions
+    uint32_t* out_begin;    // nstates + 1 offsets into out
+    uint32_t* out;          // the patterns ending at each state
+    uint32_t npatterns;
+    uint32_t nempty;        // the number of empty patterns, which always match
+} roke_ac_t;
+
+ROKE_INTERNAL_API int roke_ac_init(roke_ac_t* ac,
+    const uint8_t** patterns, const size_t* lens, uint32_t npatterns);
+ROKE_INTERNAL_API void roke_ac_free(roke_ac_t* ac);
+ROKE_INTERNAL_API int roke_ac_match_any(const roke_ac_t* ac,
+    const uint8_t* str, size_t len);
+ROKE_INTERNAL_API uint32_t roke_ac_match_all(const roke_ac_t* ac,
+    const uint8_t* str, size_t len, uint64_t* seen);
+
+#endif
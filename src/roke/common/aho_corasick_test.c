@@ -0,0 +1,156 @@
+#include "roke/common/argparse.h"
+#include "roke/common/unittest.h"
+#include "roke/common/aho_corasick.h"
+
+argparse_spec_t spec[] = {
+    {0, 0, 0, "Test the Aho-Corasick multi-pattern matcher"},
+    {0, 'v', 0, "verbose"},
+    {"pattern", 'p', 0, "run tests that match the given glob-like pattern."},
+    {0, 0, 0, 0},
+};
+
+// test if pat occurs in str, one position at a time
+static int
+naive_find(const uint8_t* pat, size_t patlen, const uint8_t* str, size_t len)
+{
+    size_t i;
+    if (patlen > len) {
+        return 0;
+    }
+    for (i=0; i + patlen <= len; i++) {
+        if (memcmp(str + i, pat, patlen) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int
+init_strings(roke_ac_t* ac, const char** patterns, uint32_t n)
+{
+    size_t lens[16];
+    uint32_t i;
+    for (i=0; i<n; i++) {
+        lens[i] = strlen(patterns[i]);
+    }
+    return roke_ac_init(ac, (const uint8_t**) patterns, lens, n);
+}
+
+#define match_any(s) roke_ac_match_any(&ac, (uint8_t*) s, strlen(s))
+#define match_all(s) roke_ac_match_all(&ac, (uint8_t*) s, strlen(s), seen)
+
+int
+test_ac_basic(void) {
+    int err = 0;
+    roke_ac_t ac;
+    uint64_t seen[1];
+    const char* patterns[] = {"he", "she", "his", "hers"};
+
+    tassert_zero(init_strings(&ac, patterns, 4));
+
+    tassert_true(match_any("ushers"));
+    tassert_true(match_any("this"));
+    tassert_false(match_any("hxsxr"));
+    tassert_false(match_any(""));
+
+    // "ushers" contains she, he and hers but not his
+    tassert_equal(match_all("ushers"), 3);
+    tassert_equal(seen[0], 0xB);
+    tassert_equal(match_all("his hers she"), 4);
+    tassert_equal(match_all("xyz"), 0);
+
+    roke_ac_free(&ac);
+
+    // a pattern which is a suffix of another is found through the
+    // failure links
+    const char* nested[] = {"abcd", "bc", "c"};
+    tassert_zero(init_strings(&ac, nested, 3));
+    tassert_equal(match_all("xabcx"), 2);
+    tassert_equal(seen[0], 0x6);
+    roke_ac_free(&ac);
+
+    // empty patterns match every string, duplicates are counted once each
+    const char* empty[] = {"", "ab", "ab"};
+    tassert_zero(init_strings(&ac, empty, 3));
+    tassert_true(match_any(""));
+    tassert_equal(match_all(""), 1);
+    tassert_equal(match_all("xaby"), 3);
+    roke_ac_free(&ac);
+
+    // no patterns never match
+    tassert_zero(init_strings(&ac, patterns, 0));
+    tassert_false(match_any("abc"));
+    roke_ac_free(&ac);
+
+  end:
+    return err;
+}
+
+/**
+ * compare with a naive search on random strings drawn from a small
+ * alphabet, so that patterns overlap and share prefixes
+ */
+int
+test_ac_fuzz(void) {
+    int err = 0;
+    uint8_t str[200];
+    uint8_t pats[16][12];
+    const uint8_t* pointers[16];
+    size_t lens[16];
+    uint64_t seen[1];
+    uint32_t iter, i;
+
+    srand(7);
+
+    for (iter=0; iter<5000; iter++) {
+        uint32_t nalpha = 1 + rand() % 4;
+        uint32_t npatterns = 1 + rand() % 16;
+        size_t len = (size_t) (rand() % 100);
+        size_t k;
+
+        for (k=0; k<len; k++) {
+            str[k] = (uint8_t) ('a' + rand() % nalpha);
+        }
+        for (i=0; i<npatterns; i++) {
+            lens[i] = 1 + (size_t) (rand() % 6);
+            for (k=0; k<lens[i]; k++) {
+                pats[i][k] = (uint8_t) ('a' + rand() % (nalpha + 1));
+            }
+            pointers[i] = pats[i];
+        }
+
+        roke_ac_t ac;
+        tassert_zero(roke_ac_init(&ac, pointers, lens, npatterns));
+
+        uint32_t expected = 0;
+        uint64_t expected_seen = 0;
+        for (i=0; i<npatterns; i++) {
+            if (naive_find(pats[i], lens[i], str, len)) {
+                expected++;
+                expected_seen |= ((uint64_t) 1) << i;
+            }
+        }
+
+        int any = roke_ac_match_any(&ac, str, len);
+        uint32_t found = roke_ac_match_all(&ac, str, len, seen);
+        roke_ac_free(&ac);
+
+        tassert_equal(any, expected > 0);
+        tassert_equal(found, expected);
+        tassert_equal(seen[0], expected_seen);
+    }
+
+  end:
+    return err;
+}
+
+int
+main(int argc, const char *argv[]) {
+
+    begin_test(argc, argv, spec);
+
+    run_test(test_ac_basic);
+    run_test(test_ac_fuzz);
+
+    end_test();
+}
@@ -0,0 +1,138 @@
+#include "roke/common/bloom.h"
+
+static inline uint32_t
+_bloom_fold(uint8_t c)
+{
+    return (c >= 'A' && c <= 'Z') ? (uint32_t)(c | 0x20) : (uint32_t) c;
+}
+
+static inline uint32_t
+_bloom_trigram(const uint8_t* s)
+{
+    return _bloom_fold(s[0]) | (_bloom_fold(s[1]) << 8) | (_bloom_fold(s[2]) << 16);
+}
+
+// two independent multiplicative hashes of the 24 bit trigram
+static inline uint32_t
+_bloom_hash1(uint32_t t)
+{
+    return (t * 0x9E3779B1u) ^ (t >> 11);
+}
+
+static inline uint32_t
+_bloom_hash2(uint32_t t)
+{
+    uint32_t h = t * 0x85EBCA6Bu;
+    return (h >> 13) ^ (h << 7);
+}
+
+/**
+ * @brief the number of bytes to use for a filter of an index
+ * @param nitems the number of names in the index
+ *
+ * The size grows with the index, rounded to a power of two and clamped
+ * so that reading the filter from disk stays cheap.
+ */
+size_t
+roke_bloom_size_for(uint32_t nitems)
+{
+    size_t n = ROKE_BLOOM_MIN_SIZE;
+    while (n < nitems && n < ROKE_BLOOM_MAX_SIZE) {
+        n <<= 1;
+    }
+    return n;
+}
+
+int
+roke_bloom_init(roke_bloom_t* bloom, size_t nbytes)
+{
+    bloom->bits = calloc(nbytes, 1);
+    if (bloom->bits == NULL) {
+        return 1;
+    }
+    bloom->nbytes = (uint32_t) nbytes;
+    bloom->mask = (uint32_t) (nbytes * 8 - 1);
+    bloom->owned = 1;
+    return 0;
+}
+
+/**
+ * @brief use an existing buffer as a filter
+ * @return non-zero if the buffer size is not a power of two
+ */
+int
+roke_bloom_wrap(roke_bloom_t* bloom, uint8_t* bits, size_t nbytes)
+{
+    bloom->bits = NULL;
+    bloom->nbytes = 0;
+    bloom->mask = 0;
+    bloom->owned = 0;
+    if (nbytes == 0 || (nbytes & (nbytes - 1)) != 0) {
+        return 1;
+    }
+    bloom->bits = bits;
+    bloom->nbytes = (uint32_t) nbytes;
+    bloom->mask = (uint32_t) (nbytes * 8 - 1);
+    return 0;
+}
+
+void
+roke_bloom_free(roke_bloom_t* bloom)
+{
+    if (bloom->owned && bloom->bits != NULL) {
+        free(bloom->bits);
+    }
+    bloom->bits = NULL;
+    bloom->nbytes = 0;
+    bloom->mask = 0;
+    bloom->owned = 0;
+}
+
+void
+roke_bloom_add_trigrams(roke_bloom_t* bloom, const uint8_t* str, size_t len)
+{
+    size_t i;
+    for (i = 0; i + 3 <= len; i++) {
+        uint32_t t = _bloom_trigram(str + i);
+        uint32_t a = _bloom_hash1(t) & bloom->mask;
+        uint32_t b = _bloom_hash2(t) & bloom->mask;
+        bloom->bits[a >> 3] |= (uint8_t) (1 << (a & 7));
+        bloom->bits[b >> 3] |= (uint8_t) (1 << (b & 7));
+    }
+}
+
+/**
+ * @brief test if a string may be a substring of a name in the filter
+ * @param ascii_only only test trigrams made of ASCII characters. set for
+ *                   case insensitive patterns, whose non-ASCII characters
+ *                   were folded using unicode rules. the filters of
+ *                   names with non-ASCII characters also hold the
+ *                   trigrams of the folded names.
+ * @return zero if the string is definitely not contained in any name,
+ *         non-zero if it may be contained.
+ */
+int
+roke_bloom_test_trigrams(
+    const roke_bloom_t* bloom,
+    const uint8_t* str,
+    size_t len,
+    int ascii_only)
+{
+    size_t i;
+    if (bloom->bits == NULL) {
+        return 1;
+    }
+    for (i = 0; i + 3 <= len; i++) {
+        if (ascii_only && ((str[i] | str[i+1] | str[i+2]) & 0x80)) {
+            continue;
+        }
+        uint32_t t = _bloom_trigram(str + i);
+        uint32_t a = _bloom_hash1(t) & bloom->mask;
+        uint32_t b = _bloom_hash2(t) & bloom->mask;
+        if ((bloom->bits[a >> 3] & (1 << (a & 7))) == 0 ||
+            (bloom->bits[b >> 3] & (1 << (b & 7))) == 0) {
+            return 0;
+        }
+    }
+    return 1;
+}
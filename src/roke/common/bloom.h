@@ -0,0 +1,46 @@
+#ifndef ROKE_COMMON_BLOOM_H
+#define ROKE_COMMON_BLOOM_H
+
+/**
+ *
+ * @file roke/common/bloom.h
+ * @brief Bloom filter over name trigrams
+ *
+ * Each index stores a small bloom filter containing every trigram of every
+ * name in the index. A literal pattern can only match a name in the index
+ * if all of the trigrams of the pattern are present in the filter, which
+ * allows locate to skip an index without mapping it.
+ *
+ * Trigrams are hashed after folding ASCII upper case characters to lower
+ * case. Bytes with the high bit set are hashed as-is.
+ */
+
+#include "roke/common/compat.h"
+
+#define ROKE_BLOOM_MIN_SIZE 1024
+#define ROKE_BLOOM_MAX_SIZE (64 * 1024)
+
+/**
+ * @brief a bloom filter with a power of two number of bits
+ *
+ * when owned is zero the bits point into memory owned by someone else,
+ * for example a buffer read from an index file.
+ */
+typedef struct roke_bloom {
+    uint8_t* bits;
+    uint32_t nbytes;
+    uint32_t mask;
+    int owned;
+} roke_bloom_t;
+
+ROKE_INTERNAL_API size_t roke_bloom_size_for(uint32_t nitems);
+ROKE_INTERNAL_API int roke_bloom_init(roke_bloom_t* bloom, size_t nbytes);
+ROKE_INTERNAL_API int roke_bloom_wrap(roke_bloom_t* bloom,
+    uint8_t* bits, size_t nbytes);
+ROKE_INTERNAL_API void roke_bloom_free(roke_bloom_t* bloom);
+ROKE_INTERNAL_API void roke_bloom_add_trigrams(roke_bloom_t* bloom,
+    const uint8_t* str, size_t len);
+ROKE_INTERNAL_API int roke_bloom_test_trigrams(const roke_bloom_t* bloom,
+    const uint8_t* str, size_t len, int ascii_only);
+
+#endif
@@ -0,0 +1,109 @@
+#include "roke/common/argparse.h"
+#include "roke/common/unittest.h"
+#include "roke/common/bloom.h"
+
+argparse_spec_t spec[] = {
+    {0, 0, 0, "Test the trigram bloom filter"},
+    {0, 'v', 0, "verbose"},
+    {"pattern", 'p', 0, "run tests that match the given glob-like pattern."},
+    {0, 0, 0, 0},
+};
+
+#define _add(s) roke_bloom_add_trigrams(&bloom, (uint8_t*) s, strlen(s))
+#define _test(s) roke_bloom_test_trigrams(&bloom, (uint8_t*) s, strlen(s), 0)
+#define _test_ascii(s) roke_bloom_test_trigrams(&bloom, (uint8_t*) s, strlen(s), 1)
+
+int
+test_bloom_size(void) {
+    int err = 0;
+
+    tassert_equal(roke_bloom_size_for(0), ROKE_BLOOM_MIN_SIZE);
+    tassert_equal(roke_bloom_size_for(1500), 2048);
+    tassert_equal(roke_bloom_size_for(1u << 30), ROKE_BLOOM_MAX_SIZE);
+
+  end:
+    return err;
+}
+
+int
+test_bloom_contains(void) {
+    int err = 0;
+
+    roke_bloom_t bloom;
+    tassert_zero(roke_bloom_init(&bloom, 1024));
+
+    _add("libroke.c");
+    _add("Makefile");
+
+    tassert_true(_test("libroke.c"));
+    tassert_true(_test("roke"));
+    tassert_true(_test("make"));
+    tassert_true(_test("MAKEFILE"));
+    // patterns shorter than a trigram always may match
+    tassert_true(_test("zz"));
+    tassert_true(_test(""));
+
+    tassert_false(_test("zzz"));
+    tassert_false(_test("libroke.h"));
+
+    roke_bloom_free(&bloom);
+
+  end:
+    return err;
+}
+
+int
+test_bloom_unicode(void) {
+    int err = 0;
+
+    roke_bloom_t bloom;
+    tassert_zero(roke_bloom_init(&bloom, 1024));
+
+    // upper case cyrillic name
+    _add("\xd0\x97\xd0\x94\xd0\xa0\xd0\x90\xd0\x92");
+
+    tassert_true(_test("\xd0\x97\xd0\x94\xd0\xa0"));
+    // the lower case pattern is only tested on ascii trigrams
+    tassert_true(_test_ascii("\xd0\xb7\xd0\xb4\xd1\x80"));
+
+    roke_bloom_free(&bloom);
+
+  end:
+    return err;
+}
+
+int
+test_bloom_wrap(void) {
+    int err = 0;
+
+    uint8_t buffer[2048];
+    roke_bloom_t bloom;
+
+    memset(buffer, 0, sizeof(buffer));
+    tassert_nonzero(roke_bloom_wrap(&bloom, buffer, 1000));
+    tassert_zero(roke_bloom_wrap(&bloom, buffer, sizeof(buffer)));
+
+    _add("config");
+    tassert_true(_test("fig"));
+    roke_bloom_free(&bloom);
+
+    // the buffer is not owned by the filter
+    tassert_zero(roke_bloom_wrap(&bloom, buffer, sizeof(buffer)));
+    tassert_true(_test("fig"));
+
+  end:
+    return err;
+}
+
+int
+main(int argc, const char *argv[]) {
+
+    begin_test(argc, argv, spec);
+
+    run_test(test_bloom_size);
+    run_test(test_bloom_contains);
+    run_test(test_bloom_unicode);
+    run_test(test_bloom_wrap);
+
+    end_test();
+}
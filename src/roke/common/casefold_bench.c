@@ -0,0 +1,224 @@
+#include "roke/common/argparse.h"
+#include "roke/common/strutil.h"
+#include "roke/common/substr.h"
+#include "roke/common/cpu.h"
+#include "roke/libroke_internal.h"
+#include "utf8/utf8proc.h"
+
+argparse_spec_t spec[] = {
+    {0, 0, 0, "case-insensitive matching micro benchmark"},
+
+    {0, 0, 0, "Optional Arguments:"},
+    {"count", 'n', 0, "number of file names (default 1000000)"},
+    {"rounds", 'r', 0, "number of times to repeat each benchmark (default 5)"},
+    {"ascii", 'a', 0, "percent of names which are pure ASCII (default 90)"},
+    {0, 0, 0, 0},
+};
+
+// words drawn on to build names, grouped by script
+static const char* ascii_words[] = {
+    "Makefile", "README", "index", "main", "Test", "config", "libroke",
+    "build", "IMG", "Photo", "report", "Draft", "backup", "utils",
+    "CMakeLists", "Screenshot", "node_modules", "src", "Invoice", "notes",
+};
+static const char* other_words[] = {
+    "caf\xc3\xa9", "R\xc3\xa9sum\xc3\xa9", "\xc3\x9c" "bersicht", "stra\xc3\x9f" "e",
+    "\xd0\x94\xd0\xbe\xd0\xba\xd1\x83\xd0\xbc\xd0\xb5\xd0\xbd\xd1\x82",
+    "\xce\x91\xce\xbb\xcf\x86\xce\xb1",
+    "\xce\xa6\xcf\x89\xcf\x84\xce\xbf",
+    "\xe6\x96\x87\xe4\xbb\xb6", "\xe5\x86\x99\xe7\x9c\x9f",
+    "\xf0\x9f\x93\x81", "Se\xc3\xb1or", "\xc3\x85ngstr\xc3\xb6m",
+};
+static const char* separators[] = { "_", "-", " ", ".", "" };
+static const char* extensions[] = {
+    ".c", ".h", ".txt", ".JPG", ".png", ".pdf", ".tar.gz", ".md", "",
+};
+
+#define NELEM(a) (sizeof(a) / sizeof((a)[0]))
+
+static double
+elapsed_since(clock_t t_start)
+{
+    return ((double)(clock() - t_start)) / CLOCKS_PER_SEC;
+}
+
+static void
+report(const char* name, double seconds, uint64_t nitems)
+{
+    fprintf(stdout, "%-28s %8.3f ms %8.2f Mnames/s\n", name, seconds * 1000.0,
+        (seconds > 0) ? nitems / seconds / 1e6 : 0.0);
+}
+
+/**
+ * @brief fill buf with count null terminated names
+ *
+ * a name is two to four words joined by separators, followed by an
+ * extension. names which are not ASCII have one word from another script.
+ */
+static size_t
+make_names(uint8_t* buf, uint32_t* offsets, uint32_t count, int ascii)
+{
+    size_t n = 0;
+    uint32_t i, k;
+
+    for (i=0; i<count; i++) {
+        uint32_t nwords = 2 + (uint32_t) (rand() % 3);
+        uint32_t other = (rand() % 100 < ascii) ? nwords : (uint32_t) (rand() % nwords);
+        offsets[i] = (uint32_t) n;
+        for (k=0; k<nwords; k++) {
+            const char* w = (k == other) ?
+                other_words[rand() % NELEM(other_words)] :
+                ascii_words[rand() % NELEM(ascii_words)];
+            if (k > 0) {
+                const char* s = separators[rand() % NELEM(separators)];
+                memcpy(buf + n, s, strlen(s));
+                n += strlen(s);
+            }
+            memcpy(buf + n, w, strlen(w));
+            n += strlen(w);
+        }
+        const char* e = extensions[rand() % NELEM(extensions)];
+        memcpy(buf + n, e, strlen(e) + 1);
+        n += strlen(e) + 1;
+    }
+    return n;
+}
+
+/**
+ * @brief lowercase through utf8proc one code point at a time, the way
+ *        tolowercase did before it had an ASCII fast path
+ */
+static size_t
+legacy_tolowercase(uint8_t* dst, size_t dstlen, const uint8_t* str)
+{
+    utf8proc_ssize_t inplen = strlen((char*) str);
+    utf8proc_int32_t codepoint;
+    const utf8proc_uint8_t* inptmp = str;
+    utf8proc_uint8_t* tmpout = dst;
+    utf8proc_ssize_t count;
+    utf8proc_ssize_t total = 0;
+
+    dstlen -= 1;
+    while (inplen > 0) {
+        count = utf8proc_iterate(inptmp, inplen, &codepoint);
+        if (count <= 0 || codepoint == -1) {
+            if ((dstlen - total) < 1) {
+                total = 0;
+                break;
+            }
+            *tmpout++ = *inptmp++;
+            inplen -= 1;
+            total += 1;
+            continue;
+        }
+        inplen -= count;
+        inptmp += count;
+        codepoint = utf8proc_tolower(codepoint);
+        if ((dstlen - total) < 4) {
+            total = 0;
+            break;
+        }
+        count = utf8proc_encode_char(codepoint, tmpout);
+        tmpout += count;
+        total += count;
+    }
+    dst[total] = '\0';
+    return (size_t) total;
+}
+
+int main(int argc, char** argv)
+{
+    int32_t count = 1000000;
+    int32_t rounds = 5;
+    int32_t ascii = 90;
+    int32_t r, i;
+    clock_t t_start;
+    uint32_t matches = 0;
+    uint8_t lower[4096];
+    const char* patterns[] = {"readme", "photo", "caf\xc3\xa9", "tar.gz"};
+    uint32_t p;
+
+    argparser_t *argparse = newArgParse(argc, (const char**) argv, spec);
+    argparser_default_kwarg_i(argparse, "count", &count);
+    argparser_default_kwarg_i(argparse, "rounds", &rounds);
+    argparser_default_kwarg_i(argparse, "ascii", &ascii);
+
+    uint8_t* names = malloc((size_t) count * 128);
+    uint32_t* offsets = malloc(sizeof(uint32_t) * count);
+    uint32_t* lens = malloc(sizeof(uint32_t) * count);
+
+    srand(11);
+    make_names(names, offsets, count, ascii);
+    for (i=0; i<count; i++) {
+        lens[i] = (uint32_t) strlen((char*) names + offsets[i]);
+    }
+
+    fprintf(stdout, "cpu features: 0x%02x\n", roke_cpu_features());
+
+    t_start = clock();
+    for (r=0; r<rounds; r++) {
+        for (i=0; i<count; i++) {
+            legacy_tolowercase(lower, sizeof(lower), names + offsets[i]);
+        }
+    }
+    report("fold (utf8proc)", elapsed_since(t_start) / rounds, count);
+
+    t_start = clock();
+    for (r=0; r<rounds; r++) {
+        for (i=0; i<count; i++) {
+            tolowercase(lower, sizeof(lower), names + offsets[i]);
+        }
+    }
+    report("fold (ascii fast path)", elapsed_since(t_start) / rounds, count);
+
+    for (p=0; p<NELEM(patterns); p++) {
+        const uint8_t* pat = (const uint8_t*) patterns[p];
+        size_t patlen = strlen(patterns[p]);
+        roke_substr_t sub;
+        string_matcher_t matcher;
+
+        fprintf(stdout, "pattern: %s\n", patterns[p]);
+        roke_substr_init(&sub, pat, patlen);
+        string_matcher_init(&matcher, pat, patlen, ROKE_CASE_INSENSITIVE);
+
+        t_start = clock();
+        for (r=0; r<rounds; r++) {
+            for (i=0; i<count; i++) {
+                size_t n = legacy_tolowercase(lower, sizeof(lower), names + offsets[i]);
+                matches += roke_substr_find(&sub, lower, n) != NULL;
+            }
+        }
+        report("  utf8proc + find", elapsed_since(t_start) / rounds, count);
+
+        t_start = clock();
+        for (r=0; r<rounds; r++) {
+            for (i=0; i<count; i++) {
+                matches += string_matcher_match(&matcher, names + offsets[i], lens[i]) == 0;
+            }
+        }
+        report("  matcher (simd)", elapsed_since(t_start) / rounds, count);
+
+        uint32_t features = roke_cpu_set_features_for_test(0);
+        string_matcher_free(&matcher);
+        string_matcher_init(&matcher, pat, patlen, ROKE_CASE_INSENSITIVE);
+        t_start = clock();
+        for (r=0; r<rounds; r++) {
+            for (i=0; i<count; i++) {
+                matches += string_matcher_match(&matcher, names + offsets[i], lens[i]) == 0;
+            }
+        }
+        report("  matcher (scalar)", elapsed_since(t_start) / rounds, count);
+        roke_cpu_set_features_for_test(features);
+
+        string_matcher_free(&matcher);
+        roke_substr_free(&sub);
+    }
+
+    fprintf(stdout, "matches: %u\n", matches);
+
+    free(names);
+    free(offsets);
+    free(lens);
+    argparser_delete(&argparse);
+    return 0;
+}
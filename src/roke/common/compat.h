@@ -72,9 +72,15 @@
     #include <dirent.h>
     #define stat_utf8 stat
     #define stat64_utf8 stat
+    #define lstat64_utf8 lstat
     #define stat64_t stat
 #endif
 
+#ifdef _WIN32
+    // symbolic links are not reported on windows
+    #define lstat64_utf8 stat64_utf8
+#endif
+
 
 #ifndef _WIN32
     #include <sys/wait.h>
@@ -94,6 +100,10 @@
 #include <errno.h>
 #include <sys/stat.h>
 
+#ifndef S_IFLNK
+#define S_IFLNK 0120000
+#endif
+
 #include <limits.h>
 #include <stddef.h>
 
@@ -116,6 +126,7 @@
     #define roke_getcwd(dst, dstlen) _getcwd(dst, dstlen)
     #define roke_fileno(x) _fileno(x)
     #define roke_fdopen(_fd,mode) _fdopen(_fd,mode)
+    #define roke_close(_fd) _close(_fd)
 
     #include <io.h>
     #define roke_isatty(_fn) _isatty(_fn)
@@ -125,6 +136,7 @@
     #define roke_getcwd(dst, dstlen) getcwd(dst, dstlen)
     #define roke_fileno(x) fileno(x)
     #define roke_fdopen(_fd,mode) fdopen(_fd,mode)
+    #define roke_close(_fd) close(_fd)
     #define roke_isatty(_fn) isatty(_fn)
 #endif
 
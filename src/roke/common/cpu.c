@@ -0,0 +1,70 @@
+#include "roke/common/cpu.h"
+
+// -1 until the features have been detected
+static int64_t _roke_cpu_features = -1;
+
+static uint32_t
+_roke_cpu_detect(void)
+{
+    uint32_t features = 0;
+
+#if defined(ROKE_ARCH_X86) && (defined(__GNUC__) || defined(__clang__))
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse2"))     features |= ROKE_CPU_SSE2;
+    if (__builtin_cpu_supports("ssse3"))    features |= ROKE_CPU_SSSE3;
+    if (__builtin_cpu_supports("sse4.1"))   features |= ROKE_CPU_SSE41;
+    if (__builtin_cpu_supports("avx2"))     features |= ROKE_CPU_AVX2;
+    if (__builtin_cpu_supports("avx512bw")) features |= ROKE_CPU_AVX512BW;
+#elif defined(ROKE_ARCH_X86) && defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    int nids = info[0];
+    __cpuid(info, 1);
+    if (info[3] & (1 << 26)) features |= ROKE_CPU_SSE2;
+    if (info[2] & (1 << 9))  features |= ROKE_CPU_SSSE3;
+    if (info[2] & (1 << 19)) features |= ROKE_CPU_SSE41;
+    // the os must save the ymm and zmm registers
+    int osxsave = (info[2] & (1 << 27)) != 0;
+    uint64_t xcr0 = osxsave ? _xgetbv(0) : 0;
+    if (nids >= 7) {
+        __cpuidex(info, 7, 0);
+        if ((info[1] & (1 << 5)) && (xcr0 & 0x6) == 0x6)
+            features |= ROKE_CPU_AVX2;
+        if ((info[1] & (1 << 30)) && (xcr0 & 0xE6) == 0xE6)
+            features |= ROKE_CPU_AVX512BW;
+    }
+#elif defined(ROKE_ARCH_ARM64)
+    // advanced simd is mandatory on aarch64
+    features |= ROKE_CPU_NEON;
+#endif
+
+    return features;
+}
+
+/**
+ * @brief return the set of SIMD instruction sets supported by this cpu
+ *
+ * the result is a combination of the ROKE_CPU_* bits
+ */
+uint32_t
+roke_cpu_features(void)
+{
+    if (_roke_cpu_features < 0) {
+        _roke_cpu_features = _roke_cpu_detect();
+    }
+    return (uint32_t) _roke_cpu_features;
+}
+
+/**
+ * @brief restrict the instruction sets used by SIMD kernels
+ * @return the previous feature set
+ *
+ * used by unit tests to compare SIMD kernels with the scalar implementation.
+ */
+uint32_t
+roke_cpu_set_features_for_test(uint32_t features)
+{
+    uint32_t t = roke_cpu_features();
+    _roke_cpu_features = features;
+    return t;
+}
@@ -0,0 +1,59 @@
+#ifndef ROKE_COMMON_CPU_H
+#define ROKE_COMMON_CPU_H
+
+/**
+ *
+ * @file roke/common/cpu.h
+ * @brief runtime cpu feature detection
+ *
+ * SIMD kernels are compiled for a specific instruction set using the
+ * ROKE_TARGET attribute and selected at runtime by testing the bits
+ * returned by roke_cpu_features.
+ */
+
+#include "roke/common/compat.h"
+
+#define ROKE_CPU_SSE2      0x01
+#define ROKE_CPU_SSSE3     0x02
+#define ROKE_CPU_SSE41     0x04
+#define ROKE_CPU_AVX2      0x08
+#define ROKE_CPU_AVX512BW  0x10
+#define ROKE_CPU_NEON      0x20
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+    #define ROKE_ARCH_X86 1
+#elif defined(__aarch64__) || defined(_M_ARM64)
+    #define ROKE_ARCH_ARM64 1
+#endif
+
+// compile a single function for an instruction set not enabled
+// for the rest of the translation unit. MSVC does not require this.
+#if defined(ROKE_ARCH_X86) && (defined(__GNUC__) || defined(__clang__))
+    #define ROKE_TARGET(x) __attribute__((target(x)))
+#else
+    #define ROKE_TARGET(x)
+#endif
+
+#if defined(_MSC_VER)
+    #include <intrin.h>
+#endif
+
+/**
+ * @brief the index of the lowest set bit, x must not be zero
+ */
+static inline uint32_t
+roke_ctz64(uint64_t x)
+{
+#if defined(_MSC_VER)
+    unsigned long r;
+    _BitScanForward64(&r, x);
+    return (uint32_t) r;
+#else
+    return (uint32_t) __builtin_ctzll(x);
+#endif
+}
+
+ROKE_INTERNAL_API uint32_t roke_cpu_features(void);
+ROKE_INTERNAL_API uint32_t roke_cpu_set_features_for_test(uint32_t features);
+
+#endif
@@ -0,0 +1,307 @@
+#include "roke/common/exists.h"
+#include "roke/common/pathutil.h"
+
+// the number of paths taken by a thread at a time
+#define ROKE_EXISTS_STEP 16
+
+static uint64_t
+_roke_exists_hash(const char* s, size_t len)
+{
+    uint64_t h = 14695981039346656037ULL;
+    size_t i;
+    for (i=0; i<len; i++) {
+        h = (h ^ (uint8_t) s[i]) * 1099511628211ULL;
+    }
+    return h;
+}
+
+/**
+ * @brief the slot of a directory in the set, or the empty slot for it
+ *
+ * called with dirs_lock held
+ */
+static char**
+_roke_exists_slot(char** table, uint32_t capacity, const char* dir, size_t len)
+{
+    uint32_t i = (uint32_t) _roke_exists_hash(dir, len) & (capacity - 1);
+    while (table[i] != NULL) {
+        if (memcmp(table[i], dir, len)==0 && table[i][len] == '\0') {
+            break;
+        }
+        i = (i + 1) & (capacity - 1);
+    }
+    return &table[i];
+}
+
+/**
+ * @brief remember a directory
+ *
+ * a directory which can not be remembered is checked again, which is
+ * slower but not wrong.
+ */
+static void
+_roke_exists_add(roke_exists_t* e, roke_exists_set_t* set, const char* dir, size_t len)
+{
+    uint32_t i;
+
+    roke_mutex_lock(&e->dirs_lock);
+    if (2 * (set->count + 1) > set->capacity) {
+        uint32_t capacity = (set->capacity) ? 2 * set->capacity : 64;
+        char** table = calloc(capacity, sizeof(char*));
+        if (table == NULL) {
+            goto end;
+        }
+        for (i=0; i<set->capacity; i++) {
+            if (set->items[i] != NULL) {
+                *_roke_exists_slot(table, capacity, set->items[i], strlen(set->items[i])) = set->items[i];
+            }
+        }
+        free(set->items);
+        set->items = table;
+        set->capacity = capacity;
+    }
+    char** slot = _roke_exists_slot(set->items, set->capacity, dir, len);
+    if (*slot == NULL) {
+        *slot = malloc(len + 1);
+        if (*slot != NULL) {
+            memcpy(*slot, dir, len);
+            (*slot)[len] = '\0';
+            set->count++;
+        }
+    }
+  end:
+    roke_mutex_unlock(&e->dirs_lock);
+}
+
+/**
+ * @brief non-zero if a directory has been remembered
+ */
+static int
+_roke_exists_known(roke_exists_t* e, roke_exists_set_t* set, const char* dir, size_t len)
+{
+    int known;
+
+    roke_mutex_lock(&e->dirs_lock);
+    known = set->count > 0 && *_roke_exists_slot(set->items, set->capacity, dir, len) != NULL;
+    roke_mutex_unlock(&e->dirs_lock);
+    return known;
+}
+
+/**
+ * @brief non-zero if a directory above a path is known to be missing
+ */
+static int
+_roke_exists_below_missing(roke_exists_t* e, const char* path, size_t len)
+{
+    size_t i;
+    int missing = 0;
+
+    roke_mutex_lock(&e->dirs_lock);
+    for (i=1; i<len && e->missing.count > 0 && !missing; i++) {
+        if (path[i] == SEP) {
+            missing = *_roke_exists_slot(e->missing.items, e->missing.capacity, path, i) != NULL;
+        }
+    }
+    roke_mutex_unlock(&e->dirs_lock);
+    return missing;
+}
+
+/**
+ * @brief zero if a path no longer exists
+ *
+ * a path which can not be checked, for example because a directory can
+ * not be read, is taken to exist.
+ */
+static uint8_t
+_roke_exists_one(roke_exists_t* e, const uint8_t* path, uint32_t len)
+{
+    char buf[ROKE_PATH_MAX];
+    struct stat64_t st;
+
+    if (len == 0 || len >= sizeof(buf)) {
+        return 1;
+    }
+    memcpy(buf, path, len);
+    // directories end with a separator
+    int is_dir = 0;
+    while (len > 1 && buf[len - 1] == SEP) {
+        is_dir = 1;
+        len--;
+    }
+    buf[len] = '\0';
+
+    if (_roke_exists_below_missing(e, buf, len)) {
+        return 0;
+    }
+    if (lstat64_utf8(buf, &st)==0 || (errno != ENOENT && errno != ENOTDIR)) {
+        return 1;
+    }
+
+    // remember the directories which went with it, up to one which exists.
+    // the directories found to exist are remembered too, so that the other
+    // missing files of a directory only cost their own lookup
+    if (is_dir) {
+        _roke_exists_add(e, &e->missing, buf, len);
+    }
+    size_t end = len;
+    while (1) {
+        while (end > 0 && buf[end - 1] != SEP) {
+            end--;
+        }
+        if (end <= 1) {
+            break;
+        }
+        buf[--end] = '\0';
+        if (_roke_exists_known(e, &e->present, buf, end)) {
+            break;
+        }
+        if (lstat64_utf8(buf, &st)==0 || (errno != ENOENT && errno != ENOTDIR)) {
+            _roke_exists_add(e, &e->present, buf, end);
+            break;
+        }
+        _roke_exists_add(e, &e->missing, buf, end);
+    }
+    return 0;
+}
+
+/**
+ * @brief check paths until the list is exhausted
+ *
+ * called with lock held, which is released while paths are checked
+ */
+static void
+_roke_exists_run(roke_exists_t* e)
+{
+    while (e->next < e->n) {
+        uint32_t begin = e->next;
+        uint32_t end = (e->n - begin > ROKE_EXISTS_STEP) ? begin + ROKE_EXISTS_STEP : e->n;
+        uint32_t i;
+        e->next = end;
+        roke_mutex_unlock(&e->lock);
+
+        for (i=begin; i<end; i++) {
+            e->found[i] = _roke_exists_one(e, e->paths[i], e->lens[i]);
+        }
+
+        roke_mutex_lock(&e->lock);
+        e->done += end - begin;
+        if (e->done == e->n) {
+            roke_cond_broadcast(&e->cond);
+        }
+    }
+}
+
+static void
+_roke_exists_worker(void* arg)
+{
+    roke_exists_t* e = (roke_exists_t*) arg;
+
+    roke_mutex_lock(&e->lock);
+    while (!e->quit) {
+        if (e->next < e->n) {
+            _roke_exists_run(e);
+        } else {
+            roke_cond_wait(&e->cond, &e->lock);
+        }
+    }
+    roke_mutex_unlock(&e->lock);
+}
+
+/**
+ * @brief start the threads which check paths
+ * @param nthreads the number of paths checked at once, including the
+ *                 thread calling roke_exists_check
+ * @return non-zero on failure
+ */
+int
+roke_exists_init(roke_exists_t* e, uint32_t nthreads)
+{
+    uint32_t t;
+
+    memset(e, 0, sizeof(roke_exists_t));
+    roke_mutex_init(&e->lock);
+    roke_mutex_init(&e->dirs_lock);
+    roke_cond_init(&e->cond);
+
+    if (nthreads > 1) {
+        e->threads = calloc(nthreads - 1, sizeof(roke_thread_t));
+        if (e->threads == NULL) {
+            roke_exists_free(e);
+            return 1;
+        }
+    }
+    // a thread which can not be started is tolerated, the caller and the
+    // threads which did start check every path
+    for (t=0; t+1<nthreads; t++) {
+        if (roke_thread_create(&e->threads[e->nthreads], _roke_exists_worker, e)==0) {
+            e->nthreads++;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief check a list of paths
+ * @param paths the paths, which need not be null terminated
+ * @param lens  the length of every path
+ * @param found set to zero for every path which no longer exists, and
+ *              to one otherwise
+ */
+void
+roke_exists_check(
+    roke_exists_t* e,
+    const uint8_t* const* paths,
+    const uint32_t* lens,
+    uint32_t n,
+    uint8_t* found)
+{
+    roke_mutex_lock(&e->lock);
+    e->paths = paths;
+    e->lens = lens;
+    e->found = found;
+    e->n = n;
+    e->next = 0;
+    e->done = 0;
+    roke_cond_broadcast(&e->cond);
+
+    _roke_exists_run(e);
+    while (e->done < e->n) {
+        roke_cond_wait(&e->cond, &e->lock);
+    }
+    e->n = 0;
+    e->next = 0;
+    roke_mutex_unlock(&e->lock);
+}
+
+static void
+_roke_exists_set_free(roke_exists_set_t* set)
+{
+    uint32_t i;
+    for (i=0; i<set->capacity; i++) {
+        free(set->items[i]);
+    }
+    free(set->items);
+}
+
+void
+roke_exists_free(roke_exists_t* e)
+{
+    uint32_t i;
+
+    roke_mutex_lock(&e->lock);
+    e->quit = 1;
+    roke_cond_broadcast(&e->cond);
+    roke_mutex_unlock(&e->lock);
+    for (i=0; i<e->nthreads; i++) {
+        roke_thread_join(&e->threads[i]);
+    }
+    free(e->threads);
+
+    _roke_exists_set_free(&e->missing);
+    _roke_exists_set_free(&e->present);
+
+    roke_cond_destroy(&e->cond);
+    roke_mutex_destroy(&e->dirs_lock);
+    roke_mutex_destroy(&e->lock);
+    memset(e, 0, sizeof(roke_exists_t));
+}
@@ -0,0 +1,62 @@
+#ifndef ROKE_COMMON_EXISTS_H
+#define ROKE_COMMON_EXISTS_H
+
+/**
+ *
+ * @file roke/common/exists.h
+ * @brief check that paths still exist, using a pool of threads
+ *
+ * A list of paths is checked by several threads at once, each taking the
+ * next few paths of the list, so that slow stat calls on a cold cache or
+ * a network file system overlap. The answers are written in the order of
+ * the list.
+ *
+ * Directories which are found to be missing are remembered, and a path
+ * below a missing directory is missing without a stat. A path which is
+ * missing leads to a check of its parent directories, until one which
+ * exists, so that the other children of a deleted directory cost no
+ * lookup. The directory found to exist is remembered as well, so that
+ * the other missing files of a directory cost one lookup each.
+ */
+
+#include "roke/common/compat.h"
+#include "roke/common/thread.h"
+
+// stat waits on the disk rather than the cpu, so more threads than cpus
+// are worth using
+#define ROKE_EXISTS_THREADS 16
+
+// directories, an open addressed set of strings
+typedef struct roke_exists_set {
+    char** items;
+    uint32_t count;
+    uint32_t capacity;
+} roke_exists_set_t;
+
+typedef struct roke_exists {
+    roke_mutex_t lock;
+    roke_cond_t cond;       // work was posted, or the last path was checked
+    roke_thread_t* threads;
+    uint32_t nthreads;
+    int quit;
+
+    // the list being checked
+    const uint8_t* const* paths;
+    const uint32_t* lens;
+    uint8_t* found;
+    uint32_t n;
+    uint32_t next;          // the first path not taken by a thread
+    uint32_t done;          // the number of paths checked
+
+    roke_mutex_t dirs_lock;
+    roke_exists_set_t missing;  // directories found missing
+    roke_exists_set_t present;  // parents of missing paths found to exist
+} roke_exists_t;
+
+ROKE_INTERNAL_API int roke_exists_init(roke_exists_t* e, uint32_t nthreads);
+ROKE_INTERNAL_API void roke_exists_check(roke_exists_t* e,
+    const uint8_t* const* paths, const uint32_t* lens, uint32_t n,
+    uint8_t* found);
+ROKE_INTERNAL_API void roke_exists_free(roke_exists_t* e);
+
+#endif
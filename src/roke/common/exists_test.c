@@ -0,0 +1,132 @@
+#include "roke/common/argparse.h"
+#include "roke/common/unittest.h"
+#include "roke/common/exists.h"
+#include "roke/common/pathutil.h"
+
+argparse_spec_t spec[] = {
+    {0, 0, 0, "Test checking that paths exist"},
+    {0, 'v', 0, "verbose"},
+    {"pattern", 'p', 0, "run tests that match the given glob-like pattern."},
+    {0, 0, 0, 0},
+};
+
+#ifndef _WIN32
+static int
+touch(const char* path)
+{
+    FILE* fp = fopen(path, "w");
+    if (fp == NULL) {
+        return 1;
+    }
+    fclose(fp);
+    return 0;
+}
+
+static int
+check(roke_exists_t* e, char paths[][256], uint32_t n, uint8_t* found)
+{
+    const uint8_t* ptrs[16];
+    uint32_t lens[16];
+    uint32_t i;
+    for (i=0; i<n; i++) {
+        ptrs[i] = (const uint8_t*) paths[i];
+        lens[i] = (uint32_t) strlen(paths[i]);
+    }
+    roke_exists_check(e, ptrs, lens, n, found);
+    return 0;
+}
+
+int
+test_exists(void) {
+    int err = 0;
+    char root[] = "/tmp/roke_exists_XXXXXX";
+    char paths[8][256];
+    uint8_t found[8];
+    roke_exists_t e;
+    int nthreads;
+
+    tassert_nonnull(mkdtemp(root));
+    snprintf(paths[0], 256, "%s/keep", root);
+    snprintf(paths[1], 256, "%s/gone", root);
+    snprintf(paths[2], 256, "%s/dir/", root);
+    snprintf(paths[3], 256, "%s/dir/sub/a", root);
+    snprintf(paths[4], 256, "%s/dir/sub/b", root);
+    snprintf(paths[5], 256, "%s/dir/c", root);
+    snprintf(paths[6], 256, "%s/never/was/here", root);
+    snprintf(paths[7], 256, "%s/", root);
+
+    for (nthreads=1; nthreads<=4; nthreads+=3) {
+        char path[256];
+        tassert_zero(touch(paths[0]));
+        snprintf(path, sizeof(path), "%s/dir", root);
+        tassert_zero(mkdir(path, 0700));
+        snprintf(path, sizeof(path), "%s/dir/sub", root);
+        tassert_zero(mkdir(path, 0700));
+        tassert_zero(touch(paths[3]));
+        tassert_zero(touch(paths[4]));
+        tassert_zero(touch(paths[5]));
+
+        tassert_zero(roke_exists_init(&e, (uint32_t) nthreads));
+        check(&e, paths, 8, found);
+        tassert_equal(found[0], 1);
+        tassert_equal(found[1], 0);
+        tassert_equal(found[2], 1);
+        tassert_equal(found[3], 1);
+        tassert_equal(found[4], 1);
+        tassert_equal(found[5], 1);
+        tassert_equal(found[6], 0);
+        tassert_equal(found[7], 1);
+
+        // a deleted directory takes its children with it
+        unlink(paths[3]);
+        unlink(paths[4]);
+        unlink(paths[5]);
+        snprintf(path, sizeof(path), "%s/dir/sub", root);
+        rmdir(path);
+        snprintf(path, sizeof(path), "%s/dir", root);
+        rmdir(path);
+        check(&e, paths, 8, found);
+        tassert_equal(found[0], 1);
+        tassert_equal(found[2], 0);
+        tassert_equal(found[3], 0);
+        tassert_equal(found[4], 0);
+        tassert_equal(found[5], 0);
+        tassert_equal(found[7], 1);
+        // dir, never and never/was are remembered. dir/sub is below dir,
+        // unless another thread checked it first. the root is the only
+        // parent found to exist, and is looked up once
+        if (nthreads == 1) {
+            tassert_equal(e.missing.count, 3);
+            tassert_equal(e.present.count, 1);
+        }
+
+        // children of a remembered directory are not checked again, even
+        // if they have come back
+        tassert_zero(mkdir(path, 0700));
+        tassert_zero(touch(paths[5]));
+        check(&e, paths, 8, found);
+        tassert_equal(found[5], 0);
+        roke_exists_free(&e);
+
+        unlink(paths[5]);
+        rmdir(path);
+    }
+
+  end:
+    unlink(paths[0]);
+    rmdir(root);
+    return err;
+}
+#endif
+
+int
+main(int argc, const char *argv[]) {
+
+    begin_test(argc, argv, spec);
+
+#ifndef _WIN32
+    run_test(test_exists);
+#endif
+
+    end_test();
+}
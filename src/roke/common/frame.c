@@ -0,0 +1,369 @@
+#include "roke/common/frame.h"
+
+#ifdef ROKE_HAVE_ZSTD
+#include <zstd.h>
+// favor decompression speed, the index is rebuilt in the background
+#define ROKE_ZSTD_LEVEL 3
+#endif
+
+#define ROKE_FRAME_HEADER_SIZE 16
+
+/**
+ * @brief test if this build can read and write a codec
+ */
+int
+roke_codec_available(uint32_t codec)
+{
+    switch (codec) {
+        case ROKE_CODEC_STORED:
+            return 1;
+#ifdef ROKE_HAVE_ZSTD
+        case ROKE_CODEC_ZSTD:
+            return 1;
+#endif
+        default:
+            return 0;
+    }
+}
+
+/**
+ * @brief the maximum compressed size of srclen bytes
+ */
+size_t
+roke_codec_bound(uint32_t codec, size_t srclen)
+{
+#ifdef ROKE_HAVE_ZSTD
+    if (codec == ROKE_CODEC_ZSTD) {
+        return ZSTD_compressBound(srclen);
+    }
+#endif
+    return srclen;
+}
+
+/**
+ * @brief compress a buffer
+ * @return the compressed size, or zero on failure
+ */
+size_t
+roke_codec_compress(
+    uint32_t codec,
+    uint8_t* dst,
+    size_t dstcap,
+    const uint8_t* src,
+    size_t srclen)
+{
+    switch (codec) {
+        case ROKE_CODEC_STORED:
+            if (srclen > dstcap) {
+                return 0;
+            }
+            memcpy(dst, src, srclen);
+            return srclen;
+#ifdef ROKE_HAVE_ZSTD
+        case ROKE_CODEC_ZSTD: {
+            size_t n = ZSTD_compress(dst, dstcap, src, srclen, ROKE_ZSTD_LEVEL);
+            return ZSTD_isError(n) ? 0 : n;
+        }
+#endif
+        default:
+            return 0;
+    }
+}
+
+/**
+ * @brief decompress a buffer of a known uncompressed size
+ * @return non-zero on failure
+ */
+int
+roke_codec_decompress(
+    uint32_t codec,
+    uint8_t* dst,
+    size_t dstlen,
+    const uint8_t* src,
+    size_t srclen)
+{
+    switch (codec) {
+        case ROKE_CODEC_STORED:
+            if (srclen != dstlen) {
+                return 1;
+            }
+            memcpy(dst, src, srclen);
+            return 0;
+#ifdef ROKE_HAVE_ZSTD
+        case ROKE_CODEC_ZSTD: {
+            size_t n = ZSTD_decompress(dst, dstlen, src, srclen);
+            return (ZSTD_isError(n) || n != dstlen) ? 1 : 0;
+        }
+#endif
+        default:
+            return 1;
+    }
+}
+
+// grow a buffer to hold at least size bytes
+static int
+_frame_reserve(uint8_t** buf, size_t* capacity, size_t size)
+{
+    if (size <= *capacity) {
+        return 0;
+    }
+    size_t n = (*capacity) ? *capacity : 4096;
+    while (n < size) {
+        n *= 2;
+    }
+    uint8_t* tmp = realloc(*buf, n);
+    if (tmp == NULL) {
+        return 1;
+    }
+    *buf = tmp;
+    *capacity = n;
+    return 0;
+}
+
+/**
+ * @brief initialize a writer
+ * @param codec         ROKE_CODEC_STORED or ROKE_CODEC_ZSTD
+ * @param frame_entries the number of entries in every frame
+ * @return non-zero if the codec is not available
+ */
+int
+roke_frame_writer_init(
+    roke_frame_writer_t* writer,
+    uint32_t codec,
+    uint32_t frame_entries)
+{
+    memset(writer, 0, sizeof(roke_frame_writer_t));
+    if (!roke_codec_available(codec) || frame_entries == 0) {
+        return 1;
+    }
+    writer->codec = codec;
+    writer->frame_entries = frame_entries;
+    return 0;
+}
+
+// compress the current frame and append it to the data buffer
+static int
+_frame_writer_flush(roke_frame_writer_t* writer)
+{
+    if (writer->nframes == writer->frames_capacity) {
+        uint32_t n = writer->frames_capacity ? writer->frames_capacity * 2 : 64;
+        roke_frame_t* tmp = realloc(writer->frames, sizeof(roke_frame_t) * n);
+        if (tmp == NULL) {
+            return 1;
+        }
+        writer->frames = tmp;
+        writer->frames_capacity = n;
+    }
+
+    size_t bound = roke_codec_bound(writer->codec, writer->frame_size);
+    if (_frame_reserve(&writer->data, &writer->data_capacity,
+            writer->data_size + bound)) {
+        return 1;
+    }
+
+    size_t csize = 0;
+    if (writer->frame_size > 0) {
+        csize = roke_codec_compress(writer->codec,
+            writer->data + writer->data_size, bound,
+            writer->frame, writer->frame_size);
+        if (csize == 0) {
+            return 1;
+        }
+    }
+
+    roke_frame_t* frame = &writer->frames[writer->nframes++];
+    frame->offset = writer->data_size;
+    frame->csize = (uint32_t) csize;
+    frame->usize = (uint32_t) writer->frame_size;
+
+    writer->data_size += csize;
+    writer->frame_size = 0;
+    writer->nentries = 0;
+    return 0;
+}
+
+/**
+ * @brief add the data of the next entry
+ * @param offset set to the offset of the data within its frame
+ * @return non-zero on failure
+ */
+int
+roke_frame_writer_add(
+    roke_frame_writer_t* writer,
+    const uint8_t* data,
+    size_t len,
+    uint32_t* offset)
+{
+    if (writer->nentries == writer->frame_entries) {
+        if (_frame_writer_flush(writer)) {
+            return 1;
+        }
+    }
+    if (_frame_reserve(&writer->frame, &writer->frame_capacity,
+            writer->frame_size + len)) {
+        return 1;
+    }
+    memcpy(writer->frame + writer->frame_size, data, len);
+    *offset = (uint32_t) writer->frame_size;
+    writer->frame_size += len;
+    writer->nentries++;
+    return 0;
+}
+
+/**
+ * @brief flush the last frame and build the section
+ *
+ * the section is stored in writer->out, writer->out_size bytes
+ */
+int
+roke_frame_writer_finish(roke_frame_writer_t* writer)
+{
+    uint32_t i;
+
+    if (writer->nentries > 0 && _frame_writer_flush(writer)) {
+        return 1;
+    }
+
+    size_t table_size = ROKE_FRAME_HEADER_SIZE + sizeof(roke_frame_t) * writer->nframes;
+    writer->out_size = table_size + writer->data_size;
+    writer->out = malloc(writer->out_size ? writer->out_size : 1);
+    if (writer->out == NULL) {
+        return 1;
+    }
+
+    uint32_t header[4] = {writer->codec, writer->nframes, writer->frame_entries, 0};
+    memcpy(writer->out, header, sizeof(header));
+
+    // make the frame offsets relative to the start of the section
+    for (i=0; i<writer->nframes; i++) {
+        writer->frames[i].offset += table_size;
+    }
+    memcpy(writer->out + ROKE_FRAME_HEADER_SIZE, writer->frames,
+        sizeof(roke_frame_t) * writer->nframes);
+    if (writer->data_size > 0) {
+        memcpy(writer->out + table_size, writer->data, writer->data_size);
+    }
+    return 0;
+}
+
+void
+roke_frame_writer_free(roke_frame_writer_t* writer)
+{
+    free(writer->frame);
+    free(writer->frames);
+    free(writer->data);
+    free(writer->out);
+    memset(writer, 0, sizeof(roke_frame_writer_t));
+}
+
+/**
+ * @brief initialize a reader of a framed section
+ * @param data   the start of the section
+ * @param size   the size of the section
+ * @param ncache the number of decompressed frames to keep in memory
+ * @return non-zero if the section is corrupt or uses an unknown codec
+ */
+int
+roke_frame_reader_init(
+    roke_frame_reader_t* reader,
+    const uint8_t* data,
+    uint64_t size,
+    uint32_t ncache)
+{
+    uint32_t header[4];
+    uint32_t i;
+
+    memset(reader, 0, sizeof(roke_frame_reader_t));
+
+    if (size < ROKE_FRAME_HEADER_SIZE) {
+        return 1;
+    }
+    memcpy(header, data, sizeof(header));
+    if (!roke_codec_available(header[0]) || header[2] == 0 ||
+        ROKE_FRAME_HEADER_SIZE + sizeof(roke_frame_t) * (uint64_t) header[1] > size) {
+        return 1;
+    }
+
+    reader->data = data;
+    reader->size = size;
+    reader->codec = header[0];
+    reader->nframes = header[1];
+    reader->frame_entries = header[2];
+    reader->frames = (const roke_frame_t*) (data + ROKE_FRAME_HEADER_SIZE);
+
+    for (i=0; i<reader->nframes; i++) {
+        if (reader->frames[i].offset + reader->frames[i].csize > size) {
+            return 1;
+        }
+    }
+
+    reader->ncache = (ncache > 0) ? ncache : 1;
+    reader->cache_id = malloc(sizeof(uint32_t) * reader->ncache);
+    reader->cache_buf = calloc(reader->ncache, sizeof(uint8_t*));
+    reader->cache_capacity = calloc(reader->ncache, sizeof(size_t));
+    if (!reader->cache_id || !reader->cache_buf || !reader->cache_capacity) {
+        roke_frame_reader_free(reader);
+        return 1;
+    }
+    for (i=0; i<reader->ncache; i++) {
+        reader->cache_id[i] = UINT32_MAX;
+    }
+    return 0;
+}
+
+/**
+ * @brief get the decompressed content of a frame
+ * @param usize set to the uncompressed size of the frame
+ * @return NULL if the frame does not exist or is corrupt
+ *
+ * the pointer remains valid until another frame is loaded into the same
+ * cache slot, that is until frame + k * ncache is requested.
+ */
+const uint8_t*
+roke_frame_reader_get(
+    roke_frame_reader_t* reader,
+    uint32_t frame,
+    uint32_t* usize)
+{
+    if (frame >= reader->nframes) {
+        return NULL;
+    }
+
+    const roke_frame_t* f = &reader->frames[frame];
+    uint32_t slot = frame % reader->ncache;
+    *usize = f->usize;
+
+    if (reader->cache_id[slot] == frame) {
+        return reader->cache_buf[slot];
+    }
+
+    if (_frame_reserve(&reader->cache_buf[slot],
+            &reader->cache_capacity[slot], f->usize + 1)) {
+        return NULL;
+    }
+
+    reader->cache_id[slot] = UINT32_MAX;
+    if (roke_codec_decompress(reader->codec, reader->cache_buf[slot],
+            f->usize, reader->data + f->offset, f->csize)) {
+        return NULL;
+    }
+    // names are null terminated, guard against a corrupt final name
+    reader->cache_buf[slot][f->usize] = '\0';
+    reader->cache_id[slot] = frame;
+    return reader->cache_buf[slot];
+}
+
+void
+roke_frame_reader_free(roke_frame_reader_t* reader)
+{
+    uint32_t i;
+    if (reader->cache_buf != NULL) {
+        for (i=0; i<reader->ncache; i++) {
+            free(reader->cache_buf[i]);
+        }
+    }
+    free(reader->cache_id);
+    free(reader->cache_buf);
+    free(reader->cache_capacity);
+    memset(reader, 0, sizeof(roke_frame_reader_t));
+}
@@ -0,0 +1,107 @@
+#ifndef ROKE_COMMON_FRAME_H
+#define ROKE_COMMON_FRAME_H
+
+/**
+ *
+ * @file roke/common/frame.h
+ * @brief seekable compressed frames
+ *
+ * A framed section stores a byte stream as a sequence of independently
+ * compressed frames, so that any frame can be decompressed without
+ * reading the frames before it:
+ *
+ *   [uint32 codec][uint32 nframes][uint32 frame_entries][uint32 reserved]
+ *   [roke_frame_t * nframes]
+ *   [frame data]
+ *
+ * every frame holds the data of frame_entries consecutive index entries,
+ * so the frame containing entry i is i / frame_entries.
+ *
+ * The reader decompresses frames on demand into a small direct mapped
+ * cache. A cache of a single frame is a reusable buffer, which is enough
+ * for a sequential scan.
+ */
+
+#include "roke/common/compat.h"
+
+// frames are stored without compression
+#define ROKE_CODEC_STORED 0
+// frames are compressed with zstd, requires ROKE_HAVE_ZSTD
+#define ROKE_CODEC_ZSTD   1
+
+// the default number of entries in a frame
+#define ROKE_FRAME_ENTRIES 1024
+
+/**
+ * @brief an entry in the frame table
+ *
+ * the offset is relative to the start of the framed section
+ */
+typedef struct roke_frame {
+    uint64_t offset;
+    uint32_t csize;
+    uint32_t usize;
+} roke_frame_t;
+
+/**
+ * @brief builds a framed section in memory
+ */
+typedef struct roke_frame_writer {
+    uint32_t codec;
+    uint32_t frame_entries;
+    uint32_t nentries;      // entries added to the current frame
+
+    uint8_t* frame;         // the uncompressed current frame
+    size_t frame_size;
+    size_t frame_capacity;
+
+    roke_frame_t* frames;
+    uint32_t nframes;
+    uint32_t frames_capacity;
+
+    uint8_t* data;          // compressed frames
+    size_t data_size;
+    size_t data_capacity;
+
+    uint8_t* out;           // the section, valid after finish
+    size_t out_size;
+} roke_frame_writer_t;
+
+/**
+ * @brief decompresses frames of a mapped framed section
+ */
+typedef struct roke_frame_reader {
+    const uint8_t* data;
+    uint64_t size;
+    uint32_t codec;
+    uint32_t nframes;
+    uint32_t frame_entries;
+    const roke_frame_t* frames;
+
+    uint32_t ncache;
+    uint32_t* cache_id;     // the frame held by each slot
+    uint8_t** cache_buf;
+    size_t* cache_capacity;
+} roke_frame_reader_t;
+
+ROKE_INTERNAL_API int roke_codec_available(uint32_t codec);
+ROKE_INTERNAL_API size_t roke_codec_bound(uint32_t codec, size_t srclen);
+ROKE_INTERNAL_API size_t roke_codec_compress(uint32_t codec,
+    uint8_t* dst, size_t dstcap, const uint8_t* src, size_t srclen);
+ROKE_INTERNAL_API int roke_codec_decompress(uint32_t codec,
+    uint8_t* dst, size_t dstlen, const uint8_t* src, size_t srclen);
+
+ROKE_INTERNAL_API int roke_frame_writer_init(roke_frame_writer_t* writer,
+    uint32_t codec, uint32_t frame_entries);
+ROKE_INTERNAL_API int roke_frame_writer_add(roke_frame_writer_t* writer,
+    const uint8_t* data, size_t len, uint32_t* offset);
+ROKE_INTERNAL_API int roke_frame_writer_finish(roke_frame_writer_t* writer);
+ROKE_INTERNAL_API void roke_frame_writer_free(roke_frame_writer_t* writer);
+
+ROKE_INTERNAL_API int roke_frame_reader_init(roke_frame_reader_t* reader,
+    const uint8_t* data, uint64_t size, uint32_t ncache);
+ROKE_INTERNAL_API const uint8_t* roke_frame_reader_get(
+    roke_frame_reader_t* reader, uint32_t frame, uint32_t* usize);
+ROKE_INTERNAL_API void roke_frame_reader_free(roke_frame_reader_t* reader);
+
+#endif
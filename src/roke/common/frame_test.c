@@ -0,0 +1,126 @@
+#include "roke/common/argparse.h"
+#include "roke/common/unittest.h"
+#include "roke/common/frame.h"
+
+argparse_spec_t spec[] = {
+    {0, 0, 0, "Test seekable compressed frames"},
+    {0, 'v', 0, "verbose"},
+    {"pattern", 'p', 0, "run tests that match the given glob-like pattern."},
+    {0, 0, 0, 0},
+};
+
+// build a framed section containing count names "name-<i>"
+static int
+build_section(roke_frame_writer_t* writer, uint32_t codec,
+    uint32_t frame_entries, uint32_t count, uint32_t* offsets)
+{
+    char name[32];
+    uint32_t i;
+
+    if (roke_frame_writer_init(writer, codec, frame_entries)) {
+        return 1;
+    }
+    for (i=0; i<count; i++) {
+        int n = snprintf(name, sizeof(name), "name-%u", i);
+        if (roke_frame_writer_add(writer, (uint8_t*) name, n + 1, &offsets[i])) {
+            return 1;
+        }
+    }
+    return roke_frame_writer_finish(writer);
+}
+
+static int
+check_codec(uint32_t codec)
+{
+    int err = 0;
+    roke_frame_writer_t writer;
+    roke_frame_reader_t reader;
+    uint32_t offsets[1000];
+    uint32_t count = 1000;
+    uint32_t i, usize;
+    char name[32];
+
+    memset(&reader, 0, sizeof(reader));
+
+    tassert_zero(build_section(&writer, codec, 64, count, offsets));
+    tassert_zero(roke_frame_reader_init(&reader, writer.out, writer.out_size, 1));
+    tassert_equal(reader.nframes, (count + 63) / 64);
+    tassert_equal(reader.frame_entries, 64);
+
+    // sequential access using a single buffer
+    for (i=0; i<count; i++) {
+        const uint8_t* frame = roke_frame_reader_get(&reader, i / 64, &usize);
+        tassert_nonnull(frame);
+        tassert_lessthan(offsets[i], usize);
+        snprintf(name, sizeof(name), "name-%u", i);
+        tassert_str_equal((char*) frame + offsets[i], name);
+    }
+    roke_frame_reader_free(&reader);
+
+    // random access through a cache
+    tassert_zero(roke_frame_reader_init(&reader, writer.out, writer.out_size, 4));
+    for (i=0; i<count; i++) {
+        uint32_t k = (i * 7919) % count;
+        const uint8_t* frame = roke_frame_reader_get(&reader, k / 64, &usize);
+        tassert_nonnull(frame);
+        snprintf(name, sizeof(name), "name-%u", k);
+        tassert_str_equal((char*) frame + offsets[k], name);
+    }
+    tassert_null(roke_frame_reader_get(&reader, reader.nframes, &usize));
+
+  end:
+    roke_frame_reader_free(&reader);
+    roke_frame_writer_free(&writer);
+    return err;
+}
+
+int
+test_frame_stored(void) {
+    return check_codec(ROKE_CODEC_STORED);
+}
+
+int
+test_frame_zstd(void) {
+    if (!roke_codec_available(ROKE_CODEC_ZSTD)) {
+        return 0;
+    }
+    return check_codec(ROKE_CODEC_ZSTD);
+}
+
+int
+test_frame_corrupt(void) {
+    int err = 0;
+    roke_frame_writer_t writer;
+    roke_frame_reader_t reader;
+    uint32_t offsets[100];
+
+    tassert_zero(build_section(&writer, ROKE_CODEC_STORED, 16, 100, offsets));
+
+    // truncated sections are rejected
+    tassert_nonzero(roke_frame_reader_init(&reader, writer.out, 8, 1));
+    tassert_nonzero(roke_frame_reader_init(&reader, writer.out, writer.out_size - 1, 1));
+
+    // unknown codecs are rejected
+    uint32_t codec = 99;
+    memcpy(writer.out, &codec, sizeof(codec));
+    tassert_nonzero(roke_frame_reader_init(&reader, writer.out, writer.out_size, 1));
+
+    roke_frame_writer_t other;
+    tassert_nonzero(roke_frame_writer_init(&other, 99, 16));
+
+  end:
+    roke_frame_writer_free(&writer);
+    return err;
+}
+
+int
+main(int argc, const char *argv[]) {
+
+    begin_test(argc, argv, spec);
+
+    run_test(test_frame_stored);
+    run_test(test_frame_zstd);
+    run_test(test_frame_corrupt);
+
+    end_test();
+}
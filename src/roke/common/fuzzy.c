@@ -0,0 +1,226 @@
+#include "roke/common/fuzzy.h"
+
+#define FUZZY_SCORE_MATCH 16
+#define FUZZY_SCORE_PARENT 8        // a byte matched in a parent directory
+#define FUZZY_GAP_START 3
+#define FUZZY_GAP_EXTEND 1
+#define FUZZY_BONUS_BOUNDARY 8      // after a separator, or at the start
+#define FUZZY_BONUS_CAMEL 7         // lower to upper case, or into digits
+#define FUZZY_BONUS_CONSECUTIVE 4
+#define FUZZY_FIRST_MULTIPLIER 2    // the first byte of the pattern
+
+#define FUZZY_ONES 0x0101010101010101ULL
+#define FUZZY_HIGH 0x8080808080808080ULL
+
+/**
+ * @brief find the first of two bytes in str[p, len)
+ * @return the offset of the byte, or len
+ *
+ * a word of eight bytes is tested at once, and only a word which holds
+ * one of the bytes is searched a byte at a time.
+ */
+static inline size_t
+_fuzzy_find(const uint8_t* str, size_t p, size_t len, uint8_t a, uint8_t b)
+{
+    uint64_t va = FUZZY_ONES * a;
+    uint64_t vb = FUZZY_ONES * b;
+
+    for (; p + 8 <= len; p += 8) {
+        uint64_t w;
+        memcpy(&w, str + p, 8);
+        uint64_t x = w ^ va;
+        uint64_t y = w ^ vb;
+        if ((((x - FUZZY_ONES) & ~x) | ((y - FUZZY_ONES) & ~y)) & FUZZY_HIGH) {
+            break;
+        }
+    }
+    for (; p < len; p++) {
+        if (str[p] == a || str[p] == b) {
+            return p;
+        }
+    }
+    return len;
+}
+
+static inline int
+_fuzzy_is_upper(uint8_t c)
+{
+    return c >= 'A' && c <= 'Z';
+}
+
+static inline int
+_fuzzy_is_lower(uint8_t c)
+{
+    return c >= 'a' && c <= 'z';
+}
+
+static inline int
+_fuzzy_is_digit(uint8_t c)
+{
+    return c >= '0' && c <= '9';
+}
+
+/**
+ * @brief the bonus for matching name[q], by what comes before it
+ */
+static inline int32_t
+_fuzzy_bonus(const uint8_t* name, size_t q)
+{
+    if (q == 0) {
+        return FUZZY_BONUS_BOUNDARY;
+    }
+    uint8_t prev = name[q - 1];
+    uint8_t c = name[q];
+    if (prev == '/' || prev == '\\' || prev == '_' || prev == '-' ||
+        prev == '.' || prev == ' ') {
+        return FUZZY_BONUS_BOUNDARY;
+    }
+    if ((_fuzzy_is_lower(prev) && _fuzzy_is_upper(c)) ||
+        (!_fuzzy_is_digit(prev) && _fuzzy_is_digit(c))) {
+        return FUZZY_BONUS_CAMEL;
+    }
+    return 0;
+}
+
+/**
+ * @brief compile a pattern
+ * @return non-zero if the pattern is empty or longer than ROKE_FUZZY_MAX
+ */
+int
+roke_fuzzy_init(
+    roke_fuzzy_t* fz,
+    const uint8_t* pattern,
+    size_t patlen)
+{
+    size_t i;
+    int icase = 1;
+
+    memset(fz, 0, sizeof(roke_fuzzy_t));
+    if (patlen == 0 || patlen > ROKE_FUZZY_MAX) {
+        return 1;
+    }
+    for (i=0; i<patlen; i++) {
+        if (_fuzzy_is_upper(pattern[i])) {
+            icase = 0;
+        }
+    }
+
+    for (i=0; i<256; i++) {
+        fz->fold[i] = (uint8_t) ((icase && _fuzzy_is_upper((uint8_t) i)) ? i + 32 : i);
+    }
+    for (i=0; i<patlen; i++) {
+        uint8_t c = pattern[i];
+        fz->pat[i] = c;
+        fz->alt[i] = (uint8_t) ((icase && _fuzzy_is_lower(c)) ? c - 32 : c);
+    }
+    fz->patlen = (uint32_t) patlen;
+    return 0;
+}
+
+/**
+ * @brief continue matching the pattern through str
+ * @param matched the number of pattern bytes matched before str
+ * @return the number of pattern bytes matched after str
+ */
+uint32_t
+roke_fuzzy_prefix(
+    const roke_fuzzy_t* fz,
+    uint32_t matched,
+    const uint8_t* str,
+    size_t len)
+{
+    size_t p = 0;
+    while (matched < fz->patlen) {
+        p = _fuzzy_find(str, p, len, fz->pat[matched], fz->alt[matched]);
+        if (p >= len) {
+            break;
+        }
+        p++;
+        matched++;
+    }
+    return matched;
+}
+
+/**
+ * @brief match a whole string
+ * @return 0 on match, non-zero otherwise
+ */
+int
+roke_fuzzy_match(
+    const roke_fuzzy_t* fz,
+    const uint8_t* str,
+    size_t len)
+{
+    return roke_fuzzy_prefix(fz, 0, str, len) != fz->patlen;
+}
+
+/**
+ * @brief score the last component of a path
+ * @param matched the number of pattern bytes matched by the parent
+ *                directories, see roke_fuzzy_prefix
+ * @param name    the last component
+ * @return 0 if the path matches, non-zero otherwise
+ *
+ * as much of the end of the pattern as possible is matched in the name,
+ * from the last match backward, and the matches are then moved forward
+ * as far as they go without passing it, so the matches are as close
+ * together as the greedy search allows.
+ */
+int
+roke_fuzzy_score(
+    const roke_fuzzy_t* fz,
+    uint32_t matched,
+    const uint8_t* name,
+    size_t len,
+    int32_t* score)
+{
+    uint32_t m = fz->patlen;
+    uint32_t j = m, t;
+    size_t p = len, begin = 0;
+
+    while (j > 0 && p > 0) {
+        p--;
+        if (fz->fold[name[p]] == fz->pat[j - 1]) {
+            j--;
+            begin = p;
+        }
+    }
+    // the rest of the pattern must be matched by the parent directories
+    if (j > matched) {
+        return 1;
+    }
+
+    int32_t s = (int32_t) j * FUZZY_SCORE_PARENT;
+    int32_t run_bonus = 0;
+    size_t prev = 0;
+
+    p = begin;
+    for (t=j; t<m; t++, p++) {
+        while (fz->fold[name[p]] != fz->pat[t]) {
+            p++;
+        }
+        int32_t bonus = _fuzzy_bonus(name, p);
+        if (t > j && p == prev + 1) {
+            // a run of matches keeps the bonus of its first byte
+            if (run_bonus < FUZZY_BONUS_CONSECUTIVE) {
+                run_bonus = FUZZY_BONUS_CONSECUTIVE;
+            }
+            if (bonus < run_bonus) {
+                bonus = run_bonus;
+            }
+        } else {
+            if (t > j) {
+                s -= FUZZY_GAP_START + (int32_t) (p - prev - 2) * FUZZY_GAP_EXTEND;
+            }
+            run_bonus = bonus;
+        }
+        if (t == 0) {
+            bonus *= FUZZY_FIRST_MULTIPLIER;
+        }
+        s += FUZZY_SCORE_MATCH + bonus;
+        prev = p;
+    }
+
+    *score = s;
+    return 0;
+}
@@ -0,0 +1,47 @@
+#ifndef ROKE_COMMON_FUZZY_H
+#define ROKE_COMMON_FUZZY_H
+
+/**
+ *
+ * @file roke/common/fuzzy.h
+ * @brief fuzzy subsequence matching and scoring of paths
+ *
+ * A pattern matches a path if its bytes appear in the path in order, not
+ * necessarily next to each other, so "rklbc" matches "roke/libroke.c".
+ * Matching is smart case: ASCII letters match either case unless the
+ * pattern contains an upper case letter.
+ *
+ * A path is matched a component at a time. The state after a component
+ * is the number of pattern bytes matched so far, taking each byte as
+ * early as possible, so the state of a directory is computed once and
+ * shared by everything below it. The next byte needed is searched for
+ * eight bytes at a time.
+ *
+ * Paths which match are scored on their last component. Bytes which
+ * match at the start of a word or continue a run of matches score more,
+ * gaps between matches cost, and bytes which could only be matched in a
+ * parent directory score half as much as bytes in the name.
+ */
+
+#include "roke/common/compat.h"
+
+// the longest pattern, so that a state fits in a byte
+#define ROKE_FUZZY_MAX 64
+
+typedef struct roke_fuzzy {
+    uint8_t pat[ROKE_FUZZY_MAX];    // the pattern, lower case unless it is case sensitive
+    uint8_t alt[ROKE_FUZZY_MAX];    // the byte of the other case, or the same byte
+    uint32_t patlen;
+    uint8_t fold[256];              // maps a byte of a path to the case of the pattern
+} roke_fuzzy_t;
+
+ROKE_INTERNAL_API int roke_fuzzy_init(roke_fuzzy_t* fz,
+    const uint8_t* pattern, size_t patlen);
+ROKE_INTERNAL_API uint32_t roke_fuzzy_prefix(const roke_fuzzy_t* fz,
+    uint32_t matched, const uint8_t* str, size_t len);
+ROKE_INTERNAL_API int roke_fuzzy_match(const roke_fuzzy_t* fz,
+    const uint8_t* str, size_t len);
+ROKE_INTERNAL_API int roke_fuzzy_score(const roke_fuzzy_t* fz,
+    uint32_t matched, const uint8_t* name, size_t len, int32_t* score);
+
+#endif
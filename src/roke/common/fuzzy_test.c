@@ -0,0 +1,163 @@
+#include "roke/common/argparse.h"
+#include "roke/common/unittest.h"
+#include "roke/common/fuzzy.h"
+
+argparse_spec_t spec[] = {
+    {0, 0, 0, "Test fuzzy matching"},
+    {0, 'v', 0, "verbose"},
+    {"pattern", 'p', 0, "run tests that match the given glob-like pattern."},
+    {0, 0, 0, 0},
+};
+
+static int
+fuzzy_match(const char* pattern, const char* str)
+{
+    roke_fuzzy_t fz;
+    if (roke_fuzzy_init(&fz, (const uint8_t*) pattern, strlen(pattern))) {
+        return -1;
+    }
+    return roke_fuzzy_match(&fz, (const uint8_t*) str, strlen(str));
+}
+
+/**
+ * score the path dir/name, matching dir first
+ */
+static int32_t
+fuzzy_score(const char* pattern, const char* dir, const char* name)
+{
+    roke_fuzzy_t fz;
+    int32_t score = INT32_MIN;
+    if (roke_fuzzy_init(&fz, (const uint8_t*) pattern, strlen(pattern))) {
+        return INT32_MIN;
+    }
+    uint32_t matched = roke_fuzzy_prefix(&fz, 0, (const uint8_t*) dir, strlen(dir));
+    if (roke_fuzzy_score(&fz, matched, (const uint8_t*) name, strlen(name), &score)) {
+        return INT32_MIN;
+    }
+    return score;
+}
+
+int
+test_fuzzy_match(void) {
+    int err = 0;
+    roke_fuzzy_t fz;
+
+    tassert_zero(fuzzy_match("rklbc", "roke/libroke.c"));
+    tassert_zero(fuzzy_match("abc", "abc"));
+    tassert_zero(fuzzy_match("abc", "a_very_long_name_before_the_b_and_then_c"));
+    tassert_nonzero(fuzzy_match("abc", "acb"));
+    tassert_nonzero(fuzzy_match("abc", "ab"));
+
+    // smart case
+    tassert_zero(fuzzy_match("rkl", "ROKE/LIB"));
+    tassert_zero(fuzzy_match("RKL", "ROKE/LIB"));
+    tassert_nonzero(fuzzy_match("RKL", "roke/lib"));
+    tassert_zero(fuzzy_match("Make", "CMakeLists.txt"));
+    tassert_nonzero(fuzzy_match("Make", "makefile"));
+
+    // bytes above 0x7F match themselves
+    tassert_zero(fuzzy_match("c\xc3\xa9", "caf\xc3\xa9"));
+
+    tassert_nonzero(roke_fuzzy_init(&fz, (const uint8_t*) "", 0));
+    tassert_nonzero(roke_fuzzy_init(&fz, (const uint8_t*)
+        "01234567890123456789012345678901234567890123456789012345678901234", 65));
+
+  end:
+    return err;
+}
+
+int
+test_fuzzy_prefix(void) {
+    int err = 0;
+    roke_fuzzy_t fz;
+
+    tassert_zero(roke_fuzzy_init(&fz, (const uint8_t*) "rklbc", 5));
+    uint32_t s = roke_fuzzy_prefix(&fz, 0, (const uint8_t*) "roke/", 5);
+    tassert_equal(s, 2);
+    tassert_equal(roke_fuzzy_prefix(&fz, s, (const uint8_t*) "libroke.c", 9), 5);
+    // a component which matches nothing leaves the state alone
+    tassert_equal(roke_fuzzy_prefix(&fz, s, (const uint8_t*) "xyz", 3), 2);
+
+  end:
+    return err;
+}
+
+/**
+ * compare the word at a time search with a byte at a time search
+ */
+int
+test_fuzzy_random(void) {
+    int err = 0;
+    roke_fuzzy_t fz;
+    uint8_t pattern[8];
+    uint8_t str[64];
+    uint32_t iter;
+
+    srand(7);
+    for (iter=0; iter<20000; iter++) {
+        size_t plen = 1 + (size_t) (rand() % 6);
+        size_t len = (size_t) (rand() % 60);
+        size_t i;
+        for (i=0; i<plen; i++) {
+            pattern[i] = (uint8_t) "abcAB\x80"[rand() % 6];
+        }
+        for (i=0; i<len; i++) {
+            str[i] = (uint8_t) "abcdABCD\x80\xff"[rand() % 10];
+        }
+        tassert_zero(roke_fuzzy_init(&fz, pattern, plen));
+
+        uint32_t expected = 0;
+        for (i=0; i<len && expected < plen; i++) {
+            if (fz.fold[str[i]] == fz.pat[expected]) {
+                expected++;
+            }
+        }
+        tassert_equal(roke_fuzzy_prefix(&fz, 0, str, len), expected);
+
+        // scoring agrees with matching
+        int32_t score;
+        int m = roke_fuzzy_score(&fz, 0, str, len, &score) == 0;
+        tassert_equal(m, expected == plen);
+    }
+
+  end:
+    return err;
+}
+
+int
+test_fuzzy_score(void) {
+    int err = 0;
+
+    // a match at a word boundary beats one inside a word
+    tassert_true(fuzzy_score("main", "", "main.c") > fuzzy_score("main", "", "domain.c"));
+    tassert_true(fuzzy_score("lr", "", "libroke.c") < fuzzy_score("lr", "", "lib_roke.c"));
+    tassert_true(fuzzy_score("fb", "", "fooBar") > fuzzy_score("fb", "", "foobar"));
+
+    // contiguous matches beat scattered ones
+    tassert_true(fuzzy_score("lib", "", "libroke.c") > fuzzy_score("lib", "", "l_i_b.c"));
+    tassert_true(fuzzy_score("roke", "", "roke.c") > fuzzy_score("roke", "", "rxoxkxe.c"));
+
+    // bytes matched in the name beat bytes matched in a directory
+    tassert_true(fuzzy_score("abc", "x", "abc") > fuzzy_score("abc", "ab", "c"));
+
+    // the pattern must be finished in the name
+    tassert_equal(fuzzy_score("abc", "ab", "x"), INT32_MIN);
+    tassert_equal(fuzzy_score("abc", "a", "c"), INT32_MIN);
+    tassert_true(fuzzy_score("rklbc", "roke/", "libroke.c") > INT32_MIN);
+
+  end:
+    return err;
+}
+
+int
+main(int argc, const char *argv[]) {
+
+    begin_test(argc, argv, spec);
+
+    run_test(test_fuzzy_match);
+    run_test(test_fuzzy_prefix);
+    run_test(test_fuzzy_random);
+    run_test(test_fuzzy_score);
+
+    end_test();
+}
@@ -0,0 +1,310 @@
+#include "roke/common/glob.h"
+
+/**
+ * @brief the length of the UTF-8 character at str[p]
+ *
+ * bytes which do not begin a valid sequence are characters of their own
+ */
+static inline size_t
+_glob_char_len(const uint8_t* str, size_t p, size_t end)
+{
+    uint8_t c = str[p];
+    size_t n, k;
+
+    if (c < 0x80) {
+        return 1;
+    } else if ((c & 0xE0) == 0xC0) {
+        n = 2;
+    } else if ((c & 0xF0) == 0xE0) {
+        n = 3;
+    } else if ((c & 0xF8) == 0xF0) {
+        n = 4;
+    } else {
+        return 1;
+    }
+    if (p + n > end) {
+        return 1;
+    }
+    for (k=1; k<n; k++) {
+        if ((str[p + k] & 0xC0) != 0x80) {
+            return 1;
+        }
+    }
+    return n;
+}
+
+/**
+ * @brief the length of the UTF-8 character which ends at str[q - 1]
+ */
+static inline size_t
+_glob_char_len_back(const uint8_t* str, size_t lower, size_t q)
+{
+    size_t k = q - 1;
+    while (k > lower && q - k < 4 && (str[k] & 0xC0) == 0x80) {
+        k--;
+    }
+    if (_glob_char_len(str, k, q) == q - k) {
+        return q - k;
+    }
+    return 1;
+}
+
+/**
+ * @brief match a segment forward from str[p], without passing end
+ * @return the offset after the match, or SIZE_MAX
+ */
+static size_t
+_glob_match_forward(const roke_glob_t* glob, const roke_glob_seg_t* seg,
+    const uint8_t* str, size_t p, size_t end)
+{
+    uint32_t k;
+
+    if (!seg->has_any) {
+        size_t n = seg->end - seg->begin;
+        if (p + n > end || memcmp(str + p, glob->lit + seg->begin, n) != 0) {
+            return SIZE_MAX;
+        }
+        return p + n;
+    }
+    for (k=seg->begin; k<seg->end; k++) {
+        if (p >= end) {
+            return SIZE_MAX;
+        }
+        if (glob->any[k]) {
+            p += _glob_char_len(str, p, end);
+        } else if (str[p] == glob->lit[k]) {
+            p++;
+        } else {
+            return SIZE_MAX;
+        }
+    }
+    return p;
+}
+
+/**
+ * @brief match a segment backward from str[q - 1], without passing lower
+ * @return the offset where the match begins, or SIZE_MAX
+ */
+static size_t
+_glob_match_backward(const roke_glob_t* glob, const roke_glob_seg_t* seg,
+    const uint8_t* str, size_t lower, size_t q)
+{
+    uint32_t k;
+
+    if (!seg->has_any) {
+        size_t n = seg->end - seg->begin;
+        if (q < lower + n || memcmp(str + q - n, glob->lit + seg->begin, n) != 0) {
+            return SIZE_MAX;
+        }
+        return q - n;
+    }
+    for (k=seg->end; k>seg->begin; k--) {
+        if (q <= lower) {
+            return SIZE_MAX;
+        }
+        if (glob->any[k - 1]) {
+            q -= _glob_char_len_back(str, lower, q);
+        } else if (str[q - 1] == glob->lit[k - 1]) {
+            q--;
+        } else {
+            return SIZE_MAX;
+        }
+    }
+    return q;
+}
+
+/**
+ * @brief find the leftmost match of a segment in str[p, end)
+ * @return the offset after the match, or SIZE_MAX
+ */
+static size_t
+_glob_search(const roke_glob_t* glob, const roke_glob_seg_t* seg,
+    const uint8_t* str, size_t p, size_t end)
+{
+    while (p < end) {
+        if (seg->find.patlen > 0) {
+            const uint8_t* m = roke_substr_find(&seg->find, str + p, end - p);
+            if (m == NULL) {
+                return SIZE_MAX;
+            }
+            p = (size_t) (m - str);
+        }
+        size_t r = _glob_match_forward(glob, seg, str, p, end);
+        if (r != SIZE_MAX) {
+            return r;
+        }
+        p++;
+    }
+    return SIZE_MAX;
+}
+
+/**
+ * @brief compile a glob pattern
+ * @return non-zero on failure
+ */
+int
+roke_glob_init(
+    roke_glob_t* glob,
+    const uint8_t* pattern,
+    size_t patlen)
+{
+    size_t i, n = 0;
+    uint32_t k, nstars = 0, nany = 0;
+    int in_seg = 0;
+
+    memset(glob, 0, sizeof(roke_glob_t));
+    glob->pattern = malloc(patlen + 1);
+    glob->lit = malloc(patlen + 1);
+    glob->any = malloc(patlen + 1);
+    // there is at most one segment for every two bytes, plus one
+    glob->segs = calloc(patlen / 2 + 1, sizeof(roke_glob_seg_t));
+    if (glob->pattern == NULL || glob->lit == NULL || glob->any == NULL ||
+            glob->segs == NULL) {
+        goto error;
+    }
+    memcpy(glob->pattern, pattern, patlen);
+    glob->pattern[patlen] = '\0';
+
+    glob->head = 1;
+    glob->tail = 1;
+    for (i=0; i<patlen; i++) {
+        uint8_t c = pattern[i];
+        if (c == '*') {
+            if (i == 0) {
+                glob->head = 0;
+            }
+            if (i + 1 == patlen) {
+                glob->tail = 0;
+            }
+            if (in_seg) {
+                glob->segs[glob->nsegs++].end = (uint32_t) n;
+                in_seg = 0;
+            }
+            nstars++;
+            continue;
+        }
+        if (!in_seg) {
+            glob->segs[glob->nsegs].begin = (uint32_t) n;
+            in_seg = 1;
+        }
+        // a trailing backslash is taken literally
+        if (c == '\\' && i + 1 < patlen) {
+            c = pattern[++i];
+            glob->any[n] = 0;
+        } else {
+            glob->any[n] = (c == '?');
+        }
+        if (glob->any[n]) {
+            glob->segs[glob->nsegs].has_any = 1;
+            nany++;
+        }
+        glob->lit[n++] = c;
+    }
+    if (in_seg) {
+        glob->segs[glob->nsegs++].end = (uint32_t) n;
+    }
+
+    for (k=0; k<glob->nsegs; k++) {
+        roke_glob_seg_t* seg = &glob->segs[k];
+        uint32_t e = seg->begin;
+        while (e < seg->end && !glob->any[e]) {
+            e++;
+        }
+        if (roke_substr_init(&seg->find, glob->lit + seg->begin, e - seg->begin)) {
+            goto error;
+        }
+    }
+
+    if (glob->nsegs == 0) {
+        glob->kind = (nstars > 0) ? ROKE_GLOB_ALL : ROKE_GLOB_EXACT;
+    } else if (glob->nsegs == 1 && nany == 0) {
+        static const int kinds[2][2] = {
+            {ROKE_GLOB_CONTAINS, ROKE_GLOB_SUFFIX},
+            {ROKE_GLOB_PREFIX, ROKE_GLOB_EXACT},
+        };
+        glob->kind = kinds[glob->head][glob->tail];
+    } else {
+        glob->kind = ROKE_GLOB_GENERAL;
+    }
+    return 0;
+
+  error:
+    roke_glob_free(glob);
+    return 1;
+}
+
+void
+roke_glob_free(roke_glob_t* glob)
+{
+    uint32_t k;
+    if (glob->segs != NULL) {
+        for (k=0; k<glob->nsegs; k++) {
+            roke_substr_free(&glob->segs[k].find);
+        }
+    }
+    free(glob->segs);
+    glob->segs = NULL;
+    glob->nsegs = 0;
+    free(glob->pattern);
+    glob->pattern = NULL;
+    free(glob->lit);
+    glob->lit = NULL;
+    free(glob->any);
+    glob->any = NULL;
+}
+
+/**
+ * @brief match a whole string against a compiled pattern
+ * @return 0 on match, non-zero otherwise
+ */
+int
+roke_glob_match(
+    const roke_glob_t* glob,
+    const uint8_t* str,
+    size_t len)
+{
+    const roke_glob_seg_t* segs = glob->segs;
+    size_t n, p = 0, end = len;
+    uint32_t first = 0, last = glob->nsegs;
+
+    switch (glob->kind) {
+        case ROKE_GLOB_ALL:
+            return 0;
+        case ROKE_GLOB_EXACT:
+            n = (glob->nsegs) ? segs[0].end : 0;
+            return !(len == n && memcmp(str, glob->lit, n) == 0);
+        case ROKE_GLOB_PREFIX:
+            n = segs[0].end;
+            return !(len >= n && memcmp(str, glob->lit, n) == 0);
+        case ROKE_GLOB_SUFFIX:
+            n = segs[0].end;
+            return !(len >= n && memcmp(str + len - n, glob->lit, n) == 0);
+        case ROKE_GLOB_CONTAINS:
+            return roke_substr_find(&segs[0].find, str, len) == NULL;
+    }
+
+    // no * at all, the only segment must match the whole string
+    if (glob->head && glob->tail && glob->nsegs == 1) {
+        return _glob_match_forward(glob, &segs[0], str, 0, len) != len;
+    }
+
+    if (glob->head) {
+        p = _glob_match_forward(glob, &segs[first++], str, 0, len);
+        if (p == SIZE_MAX) {
+            return 1;
+        }
+    }
+    if (glob->tail) {
+        end = _glob_match_backward(glob, &segs[--last], str, p, len);
+        if (end == SIZE_MAX) {
+            return 1;
+        }
+    }
+    for (; first<last; first++) {
+        p = _glob_search(glob, &segs[first], str, p, end);
+        if (p == SIZE_MAX) {
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,62 @@
+#ifndef ROKE_COMMON_GLOB_H
+#define ROKE_COMMON_GLOB_H
+
+/**
+ *
+ * @file roke/common/glob.h
+ * @brief shell-like glob patterns, compiled once and matched many times
+ *
+ * A pattern is split on * into segments of literal bytes and ?. The first
+ * segment must match at the start of the name and the last at its end,
+ * unless the pattern begins or ends with *. The segments between are
+ * found leftmost first, searching for their leading literal with the
+ * SIMD substring kernel.
+ *
+ * The common shapes, "literal", "literal*", "*literal" and "*literal*",
+ * are tested without the general loop.
+ *
+ * ? matches one UTF-8 character, and a backslash makes the next byte
+ * literal.
+ */
+
+#include "roke/common/compat.h"
+#include "roke/common/substr.h"
+
+#define ROKE_GLOB_GENERAL  0
+#define ROKE_GLOB_ALL      1   // only *, every name matches
+#define ROKE_GLOB_EXACT    2   // literal
+#define ROKE_GLOB_PREFIX   3   // literal*
+#define ROKE_GLOB_SUFFIX   4   // *literal
+#define ROKE_GLOB_CONTAINS 5   // *literal*
+
+/**
+ * @brief a run of literal bytes and ? between two *
+ */
+typedef struct roke_glob_seg {
+    uint32_t begin;         // offset into lit and any
+    uint32_t end;
+    int has_any;            // contains ?, so its length in bytes varies
+    roke_substr_t find;     // the literal bytes the segment begins with
+} roke_glob_seg_t;
+
+/**
+ * @brief a compiled glob pattern
+ */
+typedef struct roke_glob {
+    int kind;
+    uint8_t* pattern;       // the pattern as given
+    uint8_t* lit;           // the pattern without * and escapes
+    uint8_t* any;           // non-zero where lit stands for ?
+    int head;               // the first segment is anchored at the start
+    int tail;               // the last segment is anchored at the end
+    roke_glob_seg_t* segs;
+    uint32_t nsegs;
+} roke_glob_t;
+
+ROKE_INTERNAL_API int roke_glob_init(roke_glob_t* glob,
+    const uint8_t* pattern, size_t patlen);
+ROKE_INTERNAL_API void roke_glob_free(roke_glob_t* glob);
+ROKE_INTERNAL_API int roke_glob_match(const roke_glob_t* glob,
+    const uint8_t* str, size_t len);
+
+#endif
@@ -0,0 +1,166 @@
+#include "roke/common/argparse.h"
+#include "roke/common/unittest.h"
+#include "roke/common/glob.h"
+
+#ifndef _WIN32
+#include <fnmatch.h>
+#endif
+
+argparse_spec_t spec[] = {
+    {0, 0, 0, "Test the compiled glob matcher"},
+    {0, 'v', 0, "verbose"},
+    {"pattern", 'p', 0, "run tests that match the given glob-like pattern."},
+    {0, 0, 0, 0},
+};
+
+static int
+glob_match(const char* pattern, const char* str)
+{
+    roke_glob_t glob;
+    if (roke_glob_init(&glob, (const uint8_t*) pattern, strlen(pattern))) {
+        return -1;
+    }
+    int m = roke_glob_match(&glob, (const uint8_t*) str, strlen(str));
+    roke_glob_free(&glob);
+    return m;
+}
+
+static int
+glob_kind(const char* pattern)
+{
+    roke_glob_t glob;
+    if (roke_glob_init(&glob, (const uint8_t*) pattern, strlen(pattern))) {
+        return -1;
+    }
+    int kind = glob.kind;
+    roke_glob_free(&glob);
+    return kind;
+}
+
+int
+test_glob_basic(void) {
+    int err = 0;
+
+    tassert_zero(glob_match("aaa", "aaa"));
+    tassert_zero(glob_match("a*a", "a123a"));
+    tassert_zero(glob_match("a*a", "aa"));
+    tassert_zero(glob_match("a?a", "aba"));
+    tassert_zero(glob_match("???", "abc"));
+    tassert_zero(glob_match("\\a", "a"));
+    tassert_zero(glob_match("*", "abc"));
+    tassert_zero(glob_match("a*", "a"));
+    tassert_zero(glob_match("*c", "abc"));
+    tassert_zero(glob_match("*b*", "abc"));
+    tassert_zero(glob_match("a*b*c", "a123b123c"));
+    tassert_zero(glob_match("*\\.c", "test.c"));
+    tassert_zero(glob_match("\\*", "*"));
+    tassert_zero(glob_match("a\\?", "a?"));
+    tassert_zero(glob_match("*ab*ab", "abab"));
+    tassert_zero(glob_match("?*?", "ab"));
+    tassert_zero(glob_match("*?b?*", "xaby"));
+
+    tassert_nonzero(glob_match("abc", "123"));
+    tassert_nonzero(glob_match("abc", "abcd"));
+    tassert_nonzero(glob_match("abc", ""));
+    tassert_nonzero(glob_match("?", ""));
+    tassert_nonzero(glob_match("*\\.c", "test.h"));
+    tassert_nonzero(glob_match("a\\?", "ab"));
+    tassert_nonzero(glob_match("*ab*ab", "aba"));
+    tassert_nonzero(glob_match("a*b*c", "a123c"));
+    tassert_nonzero(glob_match("?*?", "a"));
+    // the first and last segments must not overlap
+    tassert_nonzero(glob_match("ab*ba", "aba"));
+
+    tassert_equal(glob_kind("*"), ROKE_GLOB_ALL);
+    tassert_equal(glob_kind("**"), ROKE_GLOB_ALL);
+    tassert_equal(glob_kind("abc"), ROKE_GLOB_EXACT);
+    tassert_equal(glob_kind("abc*"), ROKE_GLOB_PREFIX);
+    tassert_equal(glob_kind("*.ext"), ROKE_GLOB_SUFFIX);
+    tassert_equal(glob_kind("*abc*"), ROKE_GLOB_CONTAINS);
+    tassert_equal(glob_kind("*a\\*c*"), ROKE_GLOB_CONTAINS);
+    tassert_equal(glob_kind("a*c"), ROKE_GLOB_GENERAL);
+    tassert_equal(glob_kind("*a?c*"), ROKE_GLOB_GENERAL);
+
+  end:
+    return err;
+}
+
+int
+test_glob_utf8(void) {
+    int err = 0;
+
+    // ? is one character, not one byte
+    tassert_zero(glob_match("caf?", "caf\xc3\xa9"));
+    tassert_zero(glob_match("?af\xc3\xa9", "caf\xc3\xa9"));
+    tassert_zero(glob_match("*?\xc3\xa9", "caf\xc3\xa9"));
+    tassert_zero(glob_match("??", "\xe2\x82\xac\xf0\x9f\x98\x80"));
+    tassert_nonzero(glob_match("caf??", "caf\xc3\xa9"));
+    tassert_nonzero(glob_match("?", "\xe2\x82\xac\xf0\x9f\x98\x80"));
+
+    // bytes which are not valid UTF-8 are characters of their own
+    tassert_zero(glob_match("a??", "a\xc3\x28"));
+    tassert_zero(glob_match("a?", "a\xff"));
+
+  end:
+    return err;
+}
+
+#ifndef _WIN32
+/**
+ * compare with fnmatch on random ASCII patterns and strings drawn from
+ * a small alphabet
+ */
+int
+test_glob_fuzz(void) {
+    int err = 0;
+    const char* alphabet = "ab.*?\\";
+    char pattern[16];
+    char str[24];
+    uint32_t iter;
+
+    srand(5);
+
+    for (iter=0; iter<50000; iter++) {
+        size_t plen = (size_t) (rand() % 8);
+        size_t len = (size_t) (rand() % 12);
+        size_t i;
+
+        for (i=0; i<plen; i++) {
+            pattern[i] = alphabet[rand() % 6];
+        }
+        // fnmatch fails on a trailing backslash
+        if (plen > 0 && pattern[plen - 1] == '\\') {
+            pattern[plen - 1] = 'a';
+        }
+        pattern[plen] = '\0';
+        for (i=0; i<len; i++) {
+            str[i] = "ab.*"[rand() % 4];
+        }
+        str[len] = '\0';
+
+        int expected = fnmatch(pattern, str, 0) == 0;
+        int actual = glob_match(pattern, str) == 0;
+        if (actual != expected) {
+            fprintf(stderr, "pattern=%s string=%s\n", pattern, str);
+        }
+        tassert_equal(actual, expected);
+    }
+
+  end:
+    return err;
+}
+#endif
+
+int
+main(int argc, const char *argv[]) {
+
+    begin_test(argc, argv, spec);
+
+    run_test(test_glob_basic);
+    run_test(test_glob_utf8);
+#ifndef _WIN32
+    run_test(test_glob_fuzz);
+#endif
+
+    end_test();
+}
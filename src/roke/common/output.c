@@ -0,0 +1,171 @@
+
+#include "roke/common/output.h"
+
+#ifdef _WIN32
+struct iovec {
+    void* iov_base;
+    size_t iov_len;
+};
+#else
+#include <sys/uio.h>
+#endif
+
+/**
+ * @brief write every byte of a list of buffers, which are consumed
+ * @return non-zero if the descriptor could not be written
+ */
+static int
+_roke_output_writev(const roke_output_t* out, struct iovec* iov, int n)
+{
+    int fd = out->fd;
+    if (out->fp != NULL) {
+        int i;
+        for (i=0; i<n; i++) {
+            if (fwrite(iov[i].iov_base, 1, iov[i].iov_len, out->fp) != iov[i].iov_len) {
+                return 1;
+            }
+        }
+        return 0;
+    }
+#ifdef _WIN32
+    int i;
+    for (i=0; i<n; i++) {
+        const uint8_t* p = (const uint8_t*) iov[i].iov_base;
+        size_t len = iov[i].iov_len;
+        while (len > 0) {
+            int w = _write(fd, p, (len > INT_MAX) ? INT_MAX : (unsigned int) len);
+            if (w <= 0) {
+                return 1;
+            }
+            p += w;
+            len -= (size_t) w;
+        }
+    }
+    return 0;
+#else
+    while (n > 0) {
+        ssize_t w = writev(fd, iov, n);
+        if (w < 0 && errno == EINTR) {
+            continue;
+        }
+        if (w <= 0) {
+            return 1;
+        }
+        size_t done = (size_t) w;
+        while (n > 0 && done >= iov->iov_len) {
+            done -= iov->iov_len;
+            iov++;
+            n--;
+        }
+        if (n > 0) {
+            iov->iov_base = (uint8_t*) iov->iov_base + done;
+            iov->iov_len -= done;
+        }
+    }
+    return 0;
+#endif
+}
+
+/**
+ * @brief prepare to write to a file descriptor
+ * @param fd remains owned by the caller
+ * @return non-zero if the buffer could not be allocated
+ */
+int
+roke_output_init(roke_output_t* out, int fd)
+{
+    memset(out, 0, sizeof(roke_output_t));
+    out->fd = fd;
+    out->capacity = ROKE_OUTPUT_CAPACITY;
+    out->data = malloc(out->capacity);
+    return out->data == NULL;
+}
+
+/**
+ * @brief prepare to write to a stream, for a stream which may not have a
+ *        file descriptor, such as one opened by fmemopen
+ * @param fp remains owned by the caller, and is not flushed
+ * @return non-zero if the buffer could not be allocated
+ */
+int
+roke_output_init_file(roke_output_t* out, FILE* fp)
+{
+    memset(out, 0, sizeof(roke_output_t));
+    out->fd = -1;
+    out->fp = fp;
+    out->capacity = ROKE_OUTPUT_CAPACITY;
+    out->data = malloc(out->capacity);
+    return out->data == NULL;
+}
+
+/**
+ * @brief write the buffered bytes
+ * @return non-zero if this or an earlier write failed
+ */
+int
+roke_output_flush(roke_output_t* out)
+{
+    if (out->err || out->size == 0) {
+        return out->err;
+    }
+    uint32_t frame = (uint32_t) out->size;
+    struct iovec iov[2] = {{&frame, sizeof(frame)}, {out->data, out->size}};
+    out->err = (out->framed) ? _roke_output_writev(out, iov, 2) :
+        _roke_output_writev(out, iov + 1, 1);
+    out->size = 0;
+    return out->err;
+}
+
+/**
+ * @brief append bytes to the output, writing the buffer when it is full
+ * @return non-zero if the bytes could not be written, for example once
+ *         the reader has gone away
+ */
+int
+roke_output_write(roke_output_t* out, const void* data, size_t len)
+{
+    const uint8_t* p = (const uint8_t*) data;
+
+    if (out->err) {
+        return 1;
+    }
+    if (out->size + len <= out->capacity) {
+        memcpy(out->data + out->size, p, len);
+        out->size += len;
+        return 0;
+    }
+
+    // a large write is not copied, it leaves with the buffer in one call
+    if (len >= out->capacity / 2 && out->size + len <= UINT32_MAX) {
+        uint32_t frame = (uint32_t) (out->size + len);
+        struct iovec iov[3] = {{&frame, sizeof(frame)}, {out->data, out->size}, {(void*) p, len}};
+        out->err = (out->framed) ? _roke_output_writev(out, iov, 3) :
+            _roke_output_writev(out, iov + 1, 2);
+        out->size = 0;
+        return out->err;
+    }
+
+    while (len > 0) {
+        size_t n = out->capacity - out->size;
+        n = (n < len) ? n : len;
+        memcpy(out->data + out->size, p, n);
+        out->size += n;
+        p += n;
+        len -= n;
+        if (out->size == out->capacity && roke_output_flush(out)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief release the buffer, without writing what is left in it
+ */
+void
+roke_output_free(roke_output_t* out)
+{
+    free(out->data);
+    out->data = NULL;
+    out->size = 0;
+}
@@ -0,0 +1,40 @@
+#ifndef ROKE_COMMON_OUTPUT_H
+#define ROKE_COMMON_OUTPUT_H
+
+/**
+ *
+ * @file roke/common/output.h
+ * @brief buffered writes of search results to a file descriptor
+ *
+ * Results are copied into a large buffer which is written with a single
+ * system call once it is full or flushed, instead of going through stdio
+ * and its small buffer. A write which is larger than half the buffer
+ * skips the copy, and leaves with the bytes already buffered in one
+ * writev. A stream without a descriptor is written with fwrite instead.
+ *
+ * When framed is set every write is preceded by its length, a uint32 in
+ * host byte order, so that a reader can tell where the output ends.
+ */
+
+#include "roke/common/compat.h"
+
+#define ROKE_OUTPUT_CAPACITY (1 << 20)
+
+typedef struct roke_output {
+    int fd;
+    FILE* fp;           // written instead of fd when set
+    int err;            // set once a write has failed, later writes fail
+    int framed;         // precede every write with its length
+    uint8_t* data;
+    size_t size;
+    size_t capacity;
+} roke_output_t;
+
+ROKE_INTERNAL_API int roke_output_init(roke_output_t* out, int fd);
+ROKE_INTERNAL_API int roke_output_init_file(roke_output_t* out, FILE* fp);
+ROKE_INTERNAL_API int roke_output_write(roke_output_t* out,
+    const void* data, size_t len);
+ROKE_INTERNAL_API int roke_output_flush(roke_output_t* out);
+ROKE_INTERNAL_API void roke_output_free(roke_output_t* out);
+
+#endif
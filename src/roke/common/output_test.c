@@ -0,0 +1,208 @@
+#include "roke/common/argparse.h"
+#include "roke/common/unittest.h"
+#include "roke/common/output.h"
+
+#ifndef _WIN32
+#include <signal.h>
+#endif
+
+argparse_spec_t spec[] = {
+    {0, 0, 0, "Test buffered output"},
+    {0, 'v', 0, "verbose"},
+    {"pattern", 'p', 0, "run tests that match the given glob-like pattern."},
+    {0, 0, 0, 0},
+};
+
+/**
+ * fill data with a pattern which differs for every offset in a write
+ */
+static void
+fill(uint8_t* data, size_t len, uint32_t seed)
+{
+    size_t i;
+    for (i=0; i<len; i++) {
+        data[i] = (uint8_t) ((i * 31 + seed) % 251);
+    }
+}
+
+int
+test_output_file(void) {
+    int err = 0;
+    roke_output_t out;
+    size_t sizes[] = {1, 100, 4096, ROKE_OUTPUT_CAPACITY / 2, 7, ROKE_OUTPUT_CAPACITY + 5, 3};
+    size_t nsizes = sizeof(sizes) / sizeof(sizes[0]);
+    size_t total = 0, i;
+    uint8_t* expected = NULL;
+    uint8_t* actual = NULL;
+
+    for (i=0; i<nsizes; i++) {
+        total += sizes[i];
+    }
+    expected = malloc(total);
+    actual = malloc(total + 1);
+    FILE* fp = tmpfile();
+    tassert_nonnull(expected);
+    tassert_nonnull(actual);
+    tassert_nonnull(fp);
+
+    // small writes are buffered, large ones are written beside the buffer
+    tassert_zero(roke_output_init(&out, roke_fileno(fp)));
+    size_t offset = 0;
+    for (i=0; i<nsizes; i++) {
+        fill(expected + offset, sizes[i], (uint32_t) i);
+        tassert_zero(roke_output_write(&out, expected + offset, sizes[i]));
+        offset += sizes[i];
+    }
+    tassert_zero(roke_output_flush(&out));
+    roke_output_free(&out);
+
+    rewind(fp);
+    tassert_equal(fread(actual, 1, total + 1, fp), total);
+    tassert_zero(memcmp(expected, actual, total));
+
+  end:
+    if (fp != NULL) {
+        fclose(fp);
+    }
+    free(expected);
+    free(actual);
+    return err;
+}
+
+int
+test_output_framed(void) {
+    int err = 0;
+    roke_output_t out;
+    size_t sizes[] = {100, ROKE_OUTPUT_CAPACITY / 2, 7, ROKE_OUTPUT_CAPACITY + 5, 3};
+    size_t nsizes = sizeof(sizes) / sizeof(sizes[0]);
+    size_t total = 0, i;
+    uint8_t* expected = NULL;
+    uint8_t* actual = NULL;
+
+    for (i=0; i<nsizes; i++) {
+        total += sizes[i];
+    }
+    expected = malloc(total);
+    actual = malloc(total);
+    FILE* fp = tmpfile();
+    tassert_nonnull(expected);
+    tassert_nonnull(actual);
+    tassert_nonnull(fp);
+
+    tassert_zero(roke_output_init(&out, roke_fileno(fp)));
+    out.framed = 1;
+    size_t offset = 0;
+    for (i=0; i<nsizes; i++) {
+        fill(expected + offset, sizes[i], (uint32_t) i);
+        tassert_zero(roke_output_write(&out, expected + offset, sizes[i]));
+        offset += sizes[i];
+    }
+    tassert_zero(roke_output_flush(&out));
+    roke_output_free(&out);
+
+    // every write, buffered or not, is a frame which is never empty
+    rewind(fp);
+    offset = 0;
+    uint32_t frame;
+    while (fread(&frame, sizeof(frame), 1, fp) == 1) {
+        tassert_true(frame > 0);
+        tassert_true(offset + frame <= total);
+        tassert_equal(fread(actual + offset, 1, frame, fp), frame);
+        offset += frame;
+    }
+    tassert_equal(offset, total);
+    tassert_zero(memcmp(expected, actual, total));
+
+  end:
+    if (fp != NULL) {
+        fclose(fp);
+    }
+    free(expected);
+    free(actual);
+    return err;
+}
+
+#ifndef _WIN32
+int
+test_output_pipe(void) {
+    int err = 0;
+    int fds[2] = {-1, -1};
+    roke_output_t out;
+    uint8_t a[5000], b[5000], actual[10001];
+
+    tassert_zero(pipe(fds));
+    tassert_zero(roke_output_init(&out, fds[1]));
+
+    // the buffer is reused once flushed, before the pipe has been read
+    fill(a, sizeof(a), 1);
+    fill(b, sizeof(b), 2);
+    tassert_zero(roke_output_write(&out, a, sizeof(a)));
+    tassert_zero(roke_output_flush(&out));
+    tassert_zero(roke_output_write(&out, b, sizeof(b)));
+    tassert_zero(roke_output_flush(&out));
+    roke_output_free(&out);
+    close(fds[1]);
+    fds[1] = -1;
+
+    size_t total = 0;
+    ssize_t n;
+    while ((n = read(fds[0], actual + total, sizeof(actual) - total)) > 0) {
+        total += (size_t) n;
+    }
+    tassert_equal(total, sizeof(a) + sizeof(b));
+    tassert_zero(memcmp(actual, a, sizeof(a)));
+    tassert_zero(memcmp(actual + sizeof(a), b, sizeof(b)));
+
+  end:
+    if (fds[0] >= 0) {
+        close(fds[0]);
+    }
+    if (fds[1] >= 0) {
+        close(fds[1]);
+    }
+    return err;
+}
+
+int
+test_output_closed(void) {
+    int err = 0;
+    int fds[2] = {-1, -1};
+    roke_output_t out;
+    uint8_t a[100];
+
+    signal(SIGPIPE, SIG_IGN);
+    tassert_zero(pipe(fds));
+    close(fds[0]);
+    fds[0] = -1;
+
+    // once the reader has gone, the write fails and so does every later one
+    fill(a, sizeof(a), 3);
+    tassert_zero(roke_output_init(&out, fds[1]));
+    tassert_zero(roke_output_write(&out, a, sizeof(a)));
+    tassert_nonzero(roke_output_flush(&out));
+    tassert_nonzero(roke_output_write(&out, a, sizeof(a)));
+    tassert_nonzero(roke_output_flush(&out));
+    roke_output_free(&out);
+
+  end:
+    if (fds[1] >= 0) {
+        close(fds[1]);
+    }
+    return err;
+}
+#endif
+
+int
+main(int argc, const char *argv[]) {
+
+    begin_test(argc, argv, spec);
+
+    run_test(test_output_file);
+    run_test(test_output_framed);
+#ifndef _WIN32
+    run_test(test_output_pipe);
+    run_test(test_output_closed);
+#endif
+
+    end_test();
+}
@@ -0,0 +1,627 @@
+#include "roke/common/posting.h"
+#include "roke/common/cpu.h"
+
+#if defined(ROKE_ARCH_X86)
+    #include <emmintrin.h>
+    #include <tmmintrin.h>
+#elif defined(ROKE_ARCH_ARM64)
+    #include <arm_neon.h>
+#endif
+
+// lists with a size ratio above this use galloping search
+#define ROKE_POSTING_GALLOP_RATIO 32
+
+// number of data bytes used by a group of four values
+static const uint8_t _posting_group_len[256] = {
+     4,  5,  6,  7,  5,  6,  7,  8,  6,  7,  8,  9,  7,  8,  9, 10,
+     5,  6,  7,  8,  6,  7,  8,  9,  7,  8,  9, 10,  8,  9, 10, 11,
+     6,  7,  8,  9,  7,  8,  9, 10,  8,  9, 10, 11,  9, 10, 11, 12,
+     7,  8,  9, 10,  8,  9, 10, 11,  9, 10, 11, 12, 10, 11, 12, 13,
+     5,  6,  7,  8,  6,  7,  8,  9,  7,  8,  9, 10,  8,  9, 10, 11,
+     6,  7,  8,  9,  7,  8,  9, 10,  8,  9, 10, 11,  9, 10, 11, 12,
+     7,  8,  9, 10,  8,  9, 10, 11,  9, 10, 11, 12, 10, 11, 12, 13,
+     8,  9, 10, 11,  9, 10, 11, 12, 10, 11, 12, 13, 11, 12, 13, 14,
+     6,  7,  8,  9,  7,  8,  9, 10,  8,  9, 10, 11,  9, 10, 11, 12,
+     7,  8,  9, 10,  8,  9, 10, 11,  9, 10, 11, 12, 10, 11, 12, 13,
+     8,  9, 10, 11,  9, 10, 11, 12, 10, 11, 12, 13, 11, 12, 13, 14,
+     9, 10, 11, 12, 10, 11, 12, 13, 11, 12, 13, 14, 12, 13, 14, 15,
+     7,  8,  9, 10,  8,  9, 10, 11,  9, 10, 11, 12, 10, 11, 12, 13,
+     8,  9, 10, 11,  9, 10, 11, 12, 10, 11, 12, 13, 11, 12, 13, 14,
+     9, 10, 11, 12, 10, 11, 12, 13, 11, 12, 13, 14, 12, 13, 14, 15,
+    10, 11, 12, 13, 11, 12, 13, 14, 12, 13, 14, 15, 13, 14, 15, 16,
+};
+
+// pshufb masks which expand a group of four values to 32 bit lanes
+static const uint8_t _posting_shuffle[256][16] = {
+    {0,255,255,255,1,255,255,255,2,255,255,255,3,255,255,255},
+    {0,1,255,255,2,255,255,255,3,255,255,255,4,255,255,255},
+    {0,1,2,255,3,255,255,255,4,255,255,255,5,255,255,255},
+    {0,1,2,3,4,255,255,255,5,255,255,255,6,255,255,255},
+    {0,255,255,255,1,2,255,255,3,255,255,255,4,255,255,255},
+    {0,1,255,255,2,3,255,255,4,255,255,255,5,255,255,255},
+    {0,1,2,255,3,4,255,255,5,255,255,255,6,255,255,255},
+    {0,1,2,3,4,5,255,255,6,255,255,255,7,255,255,255},
+    {0,255,255,255,1,2,3,255,4,255,255,255,5,255,255,255},
+    {0,1,255,255,2,3,4,255,5,255,255,255,6,255,255,255},
+    {0,1,2,255,3,4,5,255,6,255,255,255,7,255,255,255},
+    {0,1,2,3,4,5,6,255,7,255,255,255,8,255,255,255},
+    {0,255,255,255,1,2,3,4,5,255,255,255,6,255,255,255},
+    {0,1,255,255,2,3,4,5,6,255,255,255,7,255,255,255},
+    {0,1,2,255,3,4,5,6,7,255,255,255,8,255,255,255},
+    {0,1,2,3,4,5,6,7,8,255,255,255,9,255,255,255},
+    {0,255,255,255,1,255,255,255,2,3,255,255,4,255,255,255},
+    {0,1,255,255,2,255,255,255,3,4,255,255,5,255,255,255},
+    {0,1,2,255,3,255,255,255,4,5,255,255,6,255,255,255},
+    {0,1,2,3,4,255,255,255,5,6,255,255,7,255,255,255},
+    {0,255,255,255,1,2,255,255,3,4,255,255,5,255,255,255},
+    {0,1,255,255,2,3,255,255,4,5,255,255,6,255,255,255},
+    {0,1,2,255,3,4,255,255,5,6,255,255,7,255,255,255},
+    {0,1,2,3,4,5,255,255,6,7,255,255,8,255,255,255},
+    {0,255,255,255,1,2,3,255,4,5,255,255,6,255,255,255},
+    {0,1,255,255,2,3,4,255,5,6,255,255,7,255,255,255},
+    {0,1,2,255,3,4,5,255,6,7,255,255,8,255,255,255},
+    {0,1,2,3,4,5,6,255,7,8,255,255,9,255,255,255},
+    {0,255,255,255,1,2,3,4,5,6,255,255,7,255,255,255},
+    {0,1,255,255,2,3,4,5,6,7,255,255,8,255,255,255},
+    {0,1,2,255,3,4,5,6,7,8,255,255,9,255,255,255},
+    {0,1,2,3,4,5,6,7,8,9,255,255,10,255,255,255},
+    {0,255,255,255,1,255,255,255,2,3,4,255,5,255,255,255},
+    {0,1,255,255,2,255,255,255,3,4,5,255,6,255,255,255},
+    {0,1,2,255,3,255,255,255,4,5,6,255,7,255,255,255},
+    {0,1,2,3,4,255,255,255,5,6,7,255,8,255,255,255},
+    {0,255,255,255,1,2,255,255,3,4,5,255,6,255,255,255},
+    {0,1,255,255,2,3,255,255,4,5,6,255,7,255,255,255},
+    {0,1,2,255,3,4,255,255,5,6,7,255,8,255,255,255},
+    {0,1,2,3,4,5,255,255,6,7,8,255,9,255,255,255},
+    {0,255,255,255,1,2,3,255,4,5,6,255,7,255,255,255},
+    {0,1,255,255,2,3,4,255,5,6,7,255,8,255,255,255},
+    {0,1,2,255,3,4,5,255,6,7,8,255,9,255,255,255},
+    {0,1,2,3,4,5,6,255,7,8,9,255,10,255,255,255},
+    {0,255,255,255,1,2,3,4,5,6,7,255,8,255,255,255},
+    {0,1,255,255,2,3,4,5,6,7,8,255,9,255,255,255},
+    {0,1,2,255,3,4,5,6,7,8,9,255,10,255,255,255},
+    {0,1,2,3,4,5,6,7,8,9,10,255,11,255,255,255},
+    {0,255,255,255,1,255,255,255,2,3,4,5,6,255,255,255},
+    {0,1,255,255,2,255,255,255,3,4,5,6,7,255,255,255},
+    {0,1,2,255,3,255,255,255,4,5,6,7,8,255,255,255},
+    {0,1,2,3,4,255,255,255,5,6,7,8,9,255,255,255},
+    {0,255,255,255,1,2,255,255,3,4,5,6,7,255,255,255},
+    {0,1,255,255,2,3,255,255,4,5,6,7,8,255,255,255},
+    {0,1,2,255,3,4,255,255,5,6,7,8,9,255,255,255},
+    {0,1,2,3,4,5,255,255,6,7,8,9,10,255,255,255},
+    {0,255,255,255,1,2,3,255,4,5,6,7,8,255,255,255},
+    {0,1,255,255,2,3,4,255,5,6,7,8,9,255,255,255},
+    {0,1,2,255,3,4,5,255,6,7,8,9,10,255,255,255},
+    {0,1,2,3,4,5,6,255,7,8,9,10,11,255,255,255},
+    {0,255,255,255,1,2,3,4,5,6,7,8,9,255,255,255},
+    {0,1,255,255,2,3,4,5,6,7,8,9,10,255,255,255},
+    {0,1,2,255,3,4,5,6,7,8,9,10,11,255,255,255},
+    {0,1,2,3,4,5,6,7,8,9,10,11,12,255,255,255},
+    {0,255,255,255,1,255,255,255,2,255,255,255,3,4,255,255},
+    {0,1,255,255,2,255,255,255,3,255,255,255,4,5,255,255},
+    {0,1,2,255,3,255,255,255,4,255,255,255,5,6,255,255},
+    {0,1,2,3,4,255,255,255,5,255,255,255,6,7,255,255},
+    {0,255,255,255,1,2,255,255,3,255,255,255,4,5,255,255},
+    {0,1,255,255,2,3,255,255,4,255,255,255,5,6,255,255},
+    {0,1,2,255,3,4,255,255,5,255,255,255,6,7,255,255},
+    {0,1,2,3,4,5,255,255,6,255,255,255,7,8,255,255},
+    {0,255,255,255,1,2,3,255,4,255,255,255,5,6,255,255},
+    {0,1,255,255,2,3,4,255,5,255,255,255,6,7,255,255},
+    {0,1,2,255,3,4,5,255,6,255,255,255,7,8,255,255},
+    {0,1,2,3,4,5,6,255,7,255,255,255,8,9,255,255},
+    {0,255,255,255,1,2,3,4,5,255,255,255,6,7,255,255},
+    {0,1,255,255,2,3,4,5,6,255,255,255,7,8,255,255},
+    {0,1,2,255,3,4,5,6,7,255,255,255,8,9,255,255},
+    {0,1,2,3,4,5,6,7,8,255,255,255,9,10,255,255},
+    {0,255,255,255,1,255,255,255,2,3,255,255,4,5,255,255},
+    {0,1,255,255,2,255,255,255,3,4,255,255,5,6,255,255},
+    {0,1,2,255,3,255,255,255,4,5,255,255,6,7,255,255},
+    {0,1,2,3,4,255,255,255,5,6,255,255,7,8,255,255},
+    {0,255,255,255,1,2,255,255,3,4,255,255,5,6,255,255},
+    {0,1,255,255,2,3,255,255,4,5,255,255,6,7,255,255},
+    {0,1,2,255,3,4,255,255,5,6,255,255,7,8,255,255},
+    {0,1,2,3,4,5,255,255,6,7,255,255,8,9,255,255},
+    {0,255,255,255,1,2,3,255,4,5,255,255,6,7,255,255},
+    {0,1,255,255,2,3,4,255,5,6,255,255,7,8,255,255},
+    {0,1,2,255,3,4,5,255,6,7,255,255,8,9,255,255},
+    {0,1,2,3,4,5,6,255,7,8,255,255,9,10,255,255},
+    {0,255,255,255,1,2,3,4,5,6,255,255,7,8,255,255},
+    {0,1,255,255,2,3,4,5,6,7,255,255,8,9,255,255},
+    {0,1,2,255,3,4,5,6,7,8,255,255,9,10,255,255},
+    {0,1,2,3,4,5,6,7,8,9,255,255,10,11,255,255},
+    {0,255,255,255,1,255,255,255,2,3,4,255,5,6,255,255},
+    {0,1,255,255,2,255,255,255,3,4,5,255,6,7,255,255},
+    {0,1,2,255,3,255,255,255,4,5,6,255,7,8,255,255},
+    {0,1,2,3,4,255,255,255,5,6,7,255,8,9,255,255},
+    {0,255,255,255,1,2,255,255,3,4,5,255,6,7,255,255},
+    {0,1,255,255,2,3,255,255,4,5,6,255,7,8,255,255},
+    {0,1,2,255,3,4,255,255,5,6,7,255,8,9,255,255},
+    {0,1,2,3,4,5,255,255,6,7,8,255,9,10,255,255},
+    {0,255,255,255,1,2,3,255,4,5,6,255,7,8,255,255},
+    {0,1,255,255,2,3,4,255,5,6,7,255,8,9,255,255},
+    {0,1,2,255,3,4,5,255,6,7,8,255,9,10,255,255},
+    {0,1,2,3,4,5,6,255,7,8,9,255,10,11,255,255},
+    {0,255,255,255,1,2,3,4,5,6,7,255,8,9,255,255},
+    {0,1,255,255,2,3,4,5,6,7,8,255,9,10,255,255},
+    {0,1,2,255,3,4,5,6,7,8,9,255,10,11,255,255},
+    {0,1,2,3,4,5,6,7,8,9,10,255,11,12,255,255},
+    {0,255,255,255,1,255,255,255,2,3,4,5,6,7,255,255},
+    {0,1,255,255,2,255,255,255,3,4,5,6,7,8,255,255},
+    {0,1,2,255,3,255,255,255,4,5,6,7,8,9,255,255},
+    {0,1,2,3,4,255,255,255,5,6,7,8,9,10,255,255},
+    {0,255,255,255,1,2,255,255,3,4,5,6,7,8,255,255},
+    {0,1,255,255,2,3,255,255,4,5,6,7,8,9,255,255},
+    {0,1,2,255,3,4,255,255,5,6,7,8,9,10,255,255},
+    {0,1,2,3,4,5,255,255,6,7,8,9,10,11,255,255},
+    {0,255,255,255,1,2,3,255,4,5,6,7,8,9,255,255},
+    {0,1,255,255,2,3,4,255,5,6,7,8,9,10,255,255},
+    {0,1,2,255,3,4,5,255,6,7,8,9,10,11,255,255},
+    {0,1,2,3,4,5,6,255,7,8,9,10,11,12,255,255},
+    {0,255,255,255,1,2,3,4,5,6,7,8,9,10,255,255},
+    {0,1,255,255,2,3,4,5,6,7,8,9,10,11,255,255},
+    {0,1,2,255,3,4,5,6,7,8,9,10,11,12,255,255},
+    {0,1,2,3,4,5,6,7,8,9,10,11,12,13,255,255},
+    {0,255,255,255,1,255,255,255,2,255,255,255,3,4,5,255},
+    {0,1,255,255,2,255,255,255,3,255,255,255,4,5,6,255},
+    {0,1,2,255,3,255,255,255,4,255,255,255,5,6,7,255},
+    {0,1,2,3,4,255,255,255,5,255,255,255,6,7,8,255},
+    {0,255,255,255,1,2,255,255,3,255,255,255,4,5,6,255},
+    {0,1,255,255,2,3,255,255,4,255,255,255,5,6,7,255},
+    {0,1,2,255,3,4,255,255,5,255,255,255,6,7,8,255},
+    {0,1,2,3,4,5,255,255,6,255,255,255,7,8,9,255},
+    {0,255,255,255,1,2,3,255,4,255,255,255,5,6,7,255},
+    {0,1,255,255,2,3,4,255,5,255,255,255,6,7,8,255},
+    {0,1,2,255,3,4,5,255,6,255,255,255,7,8,9,255},
+    {0,1,2,3,4,5,6,255,7,255,255,255,8,9,10,255},
+    {0,255,255,255,1,2,3,4,5,255,255,255,6,7,8,255},
+    {0,1,255,255,2,3,4,5,6,255,255,255,7,8,9,255},
+    {0,1,2,255,3,4,5,6,7,255,255,255,8,9,10,255},
+    {0,1,2,3,4,5,6,7,8,255,255,255,9,10,11,255},
+    {0,255,255,255,1,255,255,255,2,3,255,255,4,5,6,255},
+    {0,1,255,255,2,255,255,255,3,4,255,255,5,6,7,255},
+    {0,1,2,255,3,255,255,255,4,5,255,255,6,7,8,255},
+    {0,1,2,3,4,255,255,255,5,6,255,255,7,8,9,255},
+    {0,255,255,255,1,2,255,255,3,4,255,255,5,6,7,255},
+    {0,1,255,255,2,3,255,255,4,5,255,255,6,7,8,255},
+    {0,1,2,255,3,4,255,255,5,6,255,255,7,8,9,255},
+    {0,1,2,3,4,5,255,255,6,7,255,255,8,9,10,255},
+    {0,255,255,255,1,2,3,255,4,5,255,255,6,7,8,255},
+    {0,1,255,255,2,3,4,255,5,6,255,255,7,8,9,255},
+    {0,1,2,255,3,4,5,255,6,7,255,255,8,9,10,255},
+    {0,1,2,3,4,5,6,255,7,8,255,255,9,10,11,255},
+    {0,255,255,255,1,2,3,4,5,6,255,255,7,8,9,255},
+    {0,1,255,255,2,3,4,5,6,7,255,255,8,9,10,255},
+    {0,1,2,255,3,4,5,6,7,8,255,255,9,10,11,255},
+    {0,1,2,3,4,5,6,7,8,9,255,255,10,11,12,255},
+    {0,255,255,255,1,255,255,255,2,3,4,255,5,6,7,255},
+    {0,1,255,255,2,255,255,255,3,4,5,255,6,7,8,255},
+    {0,1,2,255,3,255,255,255,4,5,6,255,7,8,9,255},
+    {0,1,2,3,4,255,255,255,5,6,7,255,8,9,10,255},
+    {0,255,255,255,1,2,255,255,3,4,5,255,6,7,8,255},
+    {0,1,255,255,2,3,255,255,4,5,6,255,7,8,9,255},
+    {0,1,2,255,3,4,255,255,5,6,7,255,8,9,10,255},
+    {0,1,2,3,4,5,255,255,6,7,8,255,9,10,11,255},
+    {0,255,255,255,1,2,3,255,4,5,6,255,7,8,9,255},
+    {0,1,255,255,2,3,4,255,5,6,7,255,8,9,10,255},
+    {0,1,2,255,3,4,5,255,6,7,8,255,9,10,11,255},
+    {0,1,2,3,4,5,6,255,7,8,9,255,10,11,12,255},
+    {0,255,255,255,1,2,3,4,5,6,7,255,8,9,10,255},
+    {0,1,255,255,2,3,4,5,6,7,8,255,9,10,11,255},
+    {0,1,2,255,3,4,5,6,7,8,9,255,10,11,12,255},
+    {0,1,2,3,4,5,6,7,8,9,10,255,11,12,13,255},
+    {0,255,255,255,1,255,255,255,2,3,4,5,6,7,8,255},
+    {0,1,255,255,2,255,255,255,3,4,5,6,7,8,9,255},
+    {0,1,2,255,3,255,255,255,4,5,6,7,8,9,10,255},
+    {0,1,2,3,4,255,255,255,5,6,7,8,9,10,11,255},
+    {0,255,255,255,1,2,255,255,3,4,5,6,7,8,9,255},
+    {0,1,255,255,2,3,255,255,4,5,6,7,8,9,10,255},
+    {0,1,2,255,3,4,255,255,5,6,7,8,9,10,11,255},
+    {0,1,2,3,4,5,255,255,6,7,8,9,10,11,12,255},
+    {0,255,255,255,1,2,3,255,4,5,6,7,8,9,10,255},
+    {0,1,255,255,2,3,4,255,5,6,7,8,9,10,11,255},
+    {0,1,2,255,3,4,5,255,6,7,8,9,10,11,12,255},
+    {0,1,2,3,4,5,6,255,7,8,9,10,11,12,13,255},
+    {0,255,255,255,1,2,3,4,5,6,7,8,9,10,11,255},
+    {0,1,255,255,2,3,4,5,6,7,8,9,10,11,12,255},
+    {0,1,2,255,3,4,5,6,7,8,9,10,11,12,13,255},
+    {0,1,2,3,4,5,6,7,8,9,10,11,12,13,14,255},
+    {0,255,255,255,1,255,255,255,2,255,255,255,3,4,5,6},
+    {0,1,255,255,2,255,255,255,3,255,255,255,4,5,6,7},
+    {0,1,2,255,3,255,255,255,4,255,255,255,5,6,7,8},
+    {0,1,2,3,4,255,255,255,5,255,255,255,6,7,8,9},
+    {0,255,255,255,1,2,255,255,3,255,255,255,4,5,6,7},
+    {0,1,255,255,2,3,255,255,4,255,255,255,5,6,7,8},
+    {0,1,2,255,3,4,255,255,5,255,255,255,6,7,8,9},
+    {0,1,2,3,4,5,255,255,6,255,255,255,7,8,9,10},
+    {0,255,255,255,1,2,3,255,4,255,255,255,5,6,7,8},
+    {0,1,255,255,2,3,4,255,5,255,255,255,6,7,8,9},
+    {0,1,2,255,3,4,5,255,6,255,255,255,7,8,9,10},
+    {0,1,2,3,4,5,6,255,7,255,255,255,8,9,10,11},
+    {0,255,255,255,1,2,3,4,5,255,255,255,6,7,8,9},
+    {0,1,255,255,2,3,4,5,6,255,255,255,7,8,9,10},
+    {0,1,2,255,3,4,5,6,7,255,255,255,8,9,10,11},
+    {0,1,2,3,4,5,6,7,8,255,255,255,9,10,11,12},
+    {0,255,255,255,1,255,255,255,2,3,255,255,4,5,6,7},
+    {0,1,255,255,2,255,255,255,3,4,255,255,5,6,7,8},
+    {0,1,2,255,3,255,255,255,4,5,255,255,6,7,8,9},
+    {0,1,2,3,4,255,255,255,5,6,255,255,7,8,9,10},
+    {0,255,255,255,1,2,255,255,3,4,255,255,5,6,7,8},
+    {0,1,255,255,2,3,255,255,4,5,255,255,6,7,8,9},
+    {0,1,2,255,3,4,255,255,5,6,255,255,7,8,9,10},
+    {0,1,2,3,4,5,255,255,6,7,255,255,8,9,10,11},
+    {0,255,255,255,1,2,3,255,4,5,255,255,6,7,8,9},
+    {0,1,255,255,2,3,4,255,5,6,255,255,7,8,9,10},
+    {0,1,2,255,3,4,5,255,6,7,255,255,8,9,10,11},
+    {0,1,2,3,4,5,6,255,7,8,255,255,9,10,11,12},
+    {0,255,255,255,1,2,3,4,5,6,255,255,7,8,9,10},
+    {0,1,255,255,2,3,4,5,6,7,255,255,8,9,10,11},
+    {0,1,2,255,3,4,5,6,7,8,255,255,9,10,11,12},
+    {0,1,2,3,4,5,6,7,8,9,255,255,10,11,12,13},
+    {0,255,255,255,1,255,255,255,2,3,4,255,5,6,7,8},
+    {0,1,255,255,2,255,255,255,3,4,5,255,6,7,8,9},
+    {0,1,2,255,3,255,255,255,4,5,6,255,7,8,9,10},
+    {0,1,2,3,4,255,255,255,5,6,7,255,8,9,10,11},
+    {0,255,255,255,1,2,255,255,3,4,5,255,6,7,8,9},
+    {0,1,255,255,2,3,255,255,4,5,6,255,7,8,9,10},
+    {0,1,2,255,3,4,255,255,5,6,7,255,8,9,10,11},
+    {0,1,2,3,4,5,255,255,6,7,8,255,9,10,11,12},
+    {0,255,255,255,1,2,3,255,4,5,6,255,7,8,9,10},
+    {0,1,255,255,2,3,4,255,5,6,7,255,8,9,10,11},
+    {0,1,2,255,3,4,5,255,6,7,8,255,9,10,11,12},
+    {0,1,2,3,4,5,6,255,7,8,9,255,10,11,12,13},
+    {0,255,255,255,1,2,3,4,5,6,7,255,8,9,10,11},
+    {0,1,255,255,2,3,4,5,6,7,8,255,9,10,11,12},
+    {0,1,2,255,3,4,5,6,7,8,9,255,10,11,12,13},
+    {0,1,2,3,4,5,6,7,8,9,10,255,11,12,13,14},
+    {0,255,255,255,1,255,255,255,2,3,4,5,6,7,8,9},
+    {0,1,255,255,2,255,255,255,3,4,5,6,7,8,9,10},
+    {0,1,2,255,3,255,255,255,4,5,6,7,8,9,10,11},
+    {0,1,2,3,4,255,255,255,5,6,7,8,9,10,11,12},
+    {0,255,255,255,1,2,255,255,3,4,5,6,7,8,9,10},
+    {0,1,255,255,2,3,255,255,4,5,6,7,8,9,10,11},
+    {0,1,2,255,3,4,255,255,5,6,7,8,9,10,11,12},
+    {0,1,2,3,4,5,255,255,6,7,8,9,10,11,12,13},
+    {0,255,255,255,1,2,3,255,4,5,6,7,8,9,10,11},
+    {0,1,255,255,2,3,4,255,5,6,7,8,9,10,11,12},
+    {0,1,2,255,3,4,5,255,6,7,8,9,10,11,12,13},
+    {0,1,2,3,4,5,6,255,7,8,9,10,11,12,13,14},
+    {0,255,255,255,1,2,3,4,5,6,7,8,9,10,11,12},
+    {0,1,255,255,2,3,4,5,6,7,8,9,10,11,12,13},
+    {0,1,2,255,3,4,5,6,7,8,9,10,11,12,13,14},
+    {0,1,2,3,4,5,6,7,8,9,10,11,12,13,14,15},
+};
+
+/**
+ * @brief the maximum number of bytes needed to encode a list
+ */
+size_t
+roke_posting_bound(uint32_t count)
+{
+    return sizeof(uint32_t) + ((size_t) count + 3) / 4 + 4 * (size_t) count;
+}
+
+static inline uint32_t
+_posting_code(uint32_t v)
+{
+    if (v < (1u << 8))  return 0;
+    if (v < (1u << 16)) return 1;
+    if (v < (1u << 24)) return 2;
+    return 3;
+}
+
+/**
+ * @brief encode a sorted list of unique ids
+ * @param ids   the ids to encode, in ascending order
+ * @param count the number of ids
+ * @param dst   a buffer of at least roke_posting_bound(count) bytes
+ * @return the number of bytes written to dst
+ */
+size_t
+roke_posting_encode(
+    const uint32_t* ids,
+    uint32_t count,
+    uint8_t* dst)
+{
+    uint32_t i;
+    uint32_t prev = 0;
+    size_t nctrl = ((size_t) count + 3) / 4;
+    uint8_t* ctrl = dst + sizeof(uint32_t);
+    uint8_t* data = ctrl + nctrl;
+
+    memcpy(dst, &count, sizeof(uint32_t));
+    memset(ctrl, 0, nctrl);
+
+    for (i=0; i<count; i++) {
+        uint32_t v = ids[i] - prev;
+        uint32_t code = _posting_code(v);
+        prev = ids[i];
+
+        ctrl[i >> 2] |= (uint8_t) (code << ((i & 3) * 2));
+        switch (code) {
+            case 3: data[3] = (uint8_t) (v >> 24); // fall through
+            case 2: data[2] = (uint8_t) (v >> 16); // fall through
+            case 1: data[1] = (uint8_t) (v >> 8);  // fall through
+            default: data[0] = (uint8_t) v;
+        }
+        data += code + 1;
+    }
+
+    return (size_t) (data - dst);
+}
+
+/**
+ * @brief return the number of ids in an encoded list
+ */
+uint32_t
+roke_posting_count(const uint8_t* src, size_t srclen)
+{
+    uint32_t count;
+    if (srclen < sizeof(uint32_t)) {
+        return 0;
+    }
+    memcpy(&count, src, sizeof(uint32_t));
+    return count;
+}
+
+// decode values [i, count) one at a time
+static uint32_t
+_posting_decode_scalar(
+    const uint8_t* ctrl,
+    const uint8_t* data,
+    const uint8_t* end,
+    uint32_t i,
+    uint32_t count,
+    uint32_t prev,
+    uint32_t* dst)
+{
+    for (; i<count; i++) {
+        uint32_t code = (ctrl[i >> 2] >> ((i & 3) * 2)) & 3;
+        uint32_t v = 0;
+        if (data + code + 1 > end) {
+            break;
+        }
+        switch (code) {
+            case 3: v |= (uint32_t) data[3] << 24; // fall through
+            case 2: v |= (uint32_t) data[2] << 16; // fall through
+            case 1: v |= (uint32_t) data[1] << 8;  // fall through
+            default: v |= data[0];
+        }
+        data += code + 1;
+        prev += v;
+        dst[i] = prev;
+    }
+    return i;
+}
+
+#if defined(ROKE_ARCH_X86)
+ROKE_TARGET("ssse3")
+static uint32_t
+_posting_decode_ssse3(
+    const uint8_t* ctrl,
+    const uint8_t* data,
+    const uint8_t* end,
+    uint32_t count,
+    uint32_t* dst)
+{
+    uint32_t i = 0;
+    __m128i prev = _mm_setzero_si128();
+
+    // a full 16 byte load must remain inside the buffer
+    while (i + 4 <= count && data + 16 <= end) {
+        uint8_t c = ctrl[i >> 2];
+        __m128i mask = _mm_loadu_si128((const __m128i*) _posting_shuffle[c]);
+        __m128i v = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*) data), mask);
+        // prefix sum of the deltas
+        v = _mm_add_epi32(v, _mm_slli_si128(v, 4));
+        v = _mm_add_epi32(v, _mm_slli_si128(v, 8));
+        v = _mm_add_epi32(v, prev);
+        _mm_storeu_si128((__m128i*) (dst + i), v);
+        prev = _mm_shuffle_epi32(v, 0xFF);
+        data += _posting_group_len[c];
+        i += 4;
+    }
+
+    return _posting_decode_scalar(ctrl, data, end, i, count,
+        (i > 0) ? dst[i-1] : 0, dst);
+}
+#endif
+
+#if defined(ROKE_ARCH_ARM64)
+static uint32_t
+_posting_decode_neon(
+    const uint8_t* ctrl,
+    const uint8_t* data,
+    const uint8_t* end,
+    uint32_t count,
+    uint32_t* dst)
+{
+    uint32_t i = 0;
+    uint32x4_t zero = vdupq_n_u32(0);
+    uint32x4_t prev = zero;
+
+    while (i + 4 <= count && data + 16 <= end) {
+        uint8_t c = ctrl[i >> 2];
+        uint8x16_t mask = vld1q_u8(_posting_shuffle[c]);
+        uint32x4_t v = vreinterpretq_u32_u8(vqtbl1q_u8(vld1q_u8(data), mask));
+        v = vaddq_u32(v, vextq_u32(zero, v, 3));
+        v = vaddq_u32(v, vextq_u32(zero, v, 2));
+        v = vaddq_u32(v, prev);
+        vst1q_u32(dst + i, v);
+        prev = vdupq_n_u32(vgetq_lane_u32(v, 3));
+        data += _posting_group_len[c];
+        i += 4;
+    }
+
+    return _posting_decode_scalar(ctrl, data, end, i, count,
+        (i > 0) ? dst[i-1] : 0, dst);
+}
+#endif
+
+/**
+ * @brief decode an encoded list
+ * @param src    the encoded list
+ * @param srclen the number of bytes in src
+ * @param dst    a buffer with room for roke_posting_count(src) ids
+ * @return the number of ids decoded. this is less than the count if the
+ *         list is truncated
+ */
+uint32_t
+roke_posting_decode(
+    const uint8_t* src,
+    size_t srclen,
+    uint32_t* dst)
+{
+    uint32_t count = roke_posting_count(src, srclen);
+    size_t nctrl = ((size_t) count + 3) / 4;
+    if (sizeof(uint32_t) + nctrl > srclen) {
+        return 0;
+    }
+
+    const uint8_t* ctrl = src + sizeof(uint32_t);
+    const uint8_t* data = ctrl + nctrl;
+    const uint8_t* end = src + srclen;
+
+#if defined(ROKE_ARCH_X86)
+    if (roke_cpu_features() & ROKE_CPU_SSSE3) {
+        return _posting_decode_ssse3(ctrl, data, end, count, dst);
+    }
+#elif defined(ROKE_ARCH_ARM64)
+    if (roke_cpu_features() & ROKE_CPU_NEON) {
+        return _posting_decode_neon(ctrl, data, end, count, dst);
+    }
+#endif
+    return _posting_decode_scalar(ctrl, data, end, 0, count, 0, dst);
+}
+
+/**
+ * @brief intersect two sorted lists using a linear merge
+ * @return the number of ids written to dst
+ */
+uint32_t
+roke_posting_intersect_merge(
+    const uint32_t* a, uint32_t na,
+    const uint32_t* b, uint32_t nb,
+    uint32_t* dst)
+{
+    uint32_t i=0, j=0, n=0;
+    while (i < na && j < nb) {
+        if (a[i] < b[j]) {
+            i++;
+        } else if (b[j] < a[i]) {
+            j++;
+        } else {
+            dst[n++] = a[i];
+            i++;
+            j++;
+        }
+    }
+    return n;
+}
+
+/**
+ * @brief intersect a short list with a much longer list
+ *
+ * each id of the shorter list is found in the longer list by doubling
+ * the search step from the previous position, followed by a binary search.
+ */
+uint32_t
+roke_posting_intersect_gallop(
+    const uint32_t* a, uint32_t na,
+    const uint32_t* b, uint32_t nb,
+    uint32_t* dst)
+{
+    uint32_t i, n=0;
+    uint32_t lo = 0;
+
+    if (na > nb) {
+        return roke_posting_intersect_gallop(b, nb, a, na, dst);
+    }
+
+    for (i=0; i<na && lo<nb; i++) {
+        uint32_t x = a[i];
+        uint32_t step = 1;
+        uint32_t hi = lo;
+
+        // find a range (lo, hi] containing the first value >= x
+        while (hi < nb && b[hi] < x) {
+            lo = hi;
+            hi = (nb - hi > step) ? hi + step : nb;
+            step <<= 1;
+        }
+        while (lo < hi) {
+            uint32_t mid = lo + (hi - lo) / 2;
+            if (b[mid] < x) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        if (lo < nb && b[lo] == x) {
+            dst[n++] = x;
+            lo++;
+        }
+    }
+    return n;
+}
+
+#if defined(ROKE_ARCH_X86)
+// compare blocks of four ids against all rotations of each other
+ROKE_TARGET("sse2")
+static uint32_t
+_posting_intersect_sse2(
+    const uint32_t* a, uint32_t na,
+    const uint32_t* b, uint32_t nb,
+    uint32_t* dst)
+{
+    uint32_t i=0, j=0, n=0;
+
+    while (i + 4 <= na && j + 4 <= nb) {
+        __m128i va = _mm_loadu_si128((const __m128i*) (a + i));
+        __m128i vb = _mm_loadu_si128((const __m128i*) (b + j));
+        __m128i m = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi32(va, vb),
+                         _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, 0x39))),
+            _mm_or_si128(_mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, 0x4E)),
+                         _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, 0x93))));
+        int mask = _mm_movemask_ps(_mm_castsi128_ps(m));
+        uint32_t amax = a[i+3];
+        uint32_t bmax = b[j+3];
+
+        if (mask & 1) dst[n++] = a[i];
+        if (mask & 2) dst[n++] = a[i+1];
+        if (mask & 4) dst[n++] = a[i+2];
+        if (mask & 8) dst[n++] = a[i+3];
+
+        if (amax <= bmax) i += 4;
+        if (bmax <= amax) j += 4;
+    }
+
+    return n + roke_posting_intersect_merge(a + i, na - i, b + j, nb - j, dst + n);
+}
+#endif
+
+/**
+ * @brief intersect two sorted lists of unique ids
+ * @param dst a buffer with room for the shorter of the two lists
+ * @return the number of ids written to dst
+ *
+ * chooses between galloping search, SIMD block comparison and a
+ * linear merge based on the sizes of the lists and the cpu.
+ */
+uint32_t
+roke_posting_intersect(
+    const uint32_t* a, uint32_t na,
+    const uint32_t* b, uint32_t nb,
+    uint32_t* dst)
+{
+    if ((uint64_t) na * ROKE_POSTING_GALLOP_RATIO < nb ||
+        (uint64_t) nb * ROKE_POSTING_GALLOP_RATIO < na) {
+        return roke_posting_intersect_gallop(a, na, b, nb, dst);
+    }
+#if defined(ROKE_ARCH_X86)
+    if (roke_cpu_features() & ROKE_CPU_SSE2) {
+        return _posting_intersect_sse2(a, na, b, nb, dst);
+    }
+#endif
+    return roke_posting_intersect_merge(a, na, b, nb, dst);
+}
@@ -0,0 +1,41 @@
+#ifndef ROKE_COMMON_POSTING_H
+#define ROKE_COMMON_POSTING_H
+
+/**
+ *
+ * @file roke/common/posting.h
+ * @brief compressed posting lists of entry ids
+ *
+ * A posting list is a sorted list of unique 32 bit ids, for example the
+ * entries of an index which contain a trigram. Lists are delta encoded and
+ * packed using Stream VByte:
+ *
+ *   [uint32 count][control bytes][data bytes]
+ *
+ * each control byte describes the byte length (1-4) of four consecutive
+ * deltas, which allows a group of four values to be decoded with a single
+ * shuffle instruction. Index sections which store lists of ids should use
+ * this encoding.
+ */
+
+#include "roke/common/compat.h"
+
+ROKE_INTERNAL_API size_t roke_posting_bound(uint32_t count);
+ROKE_INTERNAL_API size_t roke_posting_encode(const uint32_t* ids,
+    uint32_t count, uint8_t* dst);
+ROKE_INTERNAL_API uint32_t roke_posting_count(const uint8_t* src,
+    size_t srclen);
+ROKE_INTERNAL_API uint32_t roke_posting_decode(const uint8_t* src,
+    size_t srclen, uint32_t* dst);
+
+ROKE_INTERNAL_API uint32_t roke_posting_intersect(
+    const uint32_t* a, uint32_t na,
+    const uint32_t* b, uint32_t nb, uint32_t* dst);
+ROKE_INTERNAL_API uint32_t roke_posting_intersect_merge(
+    const uint32_t* a, uint32_t na,
+    const uint32_t* b, uint32_t nb, uint32_t* dst);
+ROKE_INTERNAL_API uint32_t roke_posting_intersect_gallop(
+    const uint32_t* a, uint32_t na,
+    const uint32_t* b, uint32_t nb, uint32_t* dst);
+
+#endif
@@ -0,0 +1,120 @@
+#include "roke/common/argparse.h"
+#include "roke/common/posting.h"
+#include "roke/common/cpu.h"
+
+argparse_spec_t spec[] = {
+    {0, 0, 0, "posting list micro benchmark"},
+
+    {0, 0, 0, "Optional Arguments:"},
+    {"count", 'n', 0, "number of ids in each list (default 10000000)"},
+    {"rounds", 'r', 0, "number of times to repeat each benchmark (default 10)"},
+    {0, 0, 0, 0},
+};
+
+static double
+elapsed_since(clock_t t_start)
+{
+    return ((double)(clock() - t_start)) / CLOCKS_PER_SEC;
+}
+
+static void
+make_list(uint32_t* ids, uint32_t count, uint32_t maxgap)
+{
+    uint32_t i, v = 0;
+    for (i=0; i<count; i++) {
+        v += 1 + (uint32_t) (rand() % maxgap);
+        ids[i] = v;
+    }
+}
+
+static void
+report(const char* name, double seconds, uint64_t nitems)
+{
+    fprintf(stdout, "%-28s %8.3f ms %8.2f Mids/s\n", name, seconds * 1000.0,
+        (seconds > 0) ? nitems / seconds / 1e6 : 0.0);
+}
+
+int main(int argc, char** argv)
+{
+    int32_t count = 10000000;
+    int32_t rounds = 10;
+    int32_t r;
+    clock_t t_start;
+    uint32_t checksum = 0;
+
+    argparser_t *argparse = newArgParse(argc, (const char**) argv, spec);
+    argparser_default_kwarg_i(argparse, "count", &count);
+    argparser_default_kwarg_i(argparse, "rounds", &rounds);
+
+    uint32_t* a = malloc(sizeof(uint32_t) * count);
+    uint32_t* b = malloc(sizeof(uint32_t) * count);
+    uint32_t* out = malloc(sizeof(uint32_t) * count);
+    uint8_t* buf = malloc(roke_posting_bound(count));
+
+    make_list(a, count, 16);
+    make_list(b, count, 16);
+
+    fprintf(stdout, "cpu features: 0x%02x\n", roke_cpu_features());
+
+    t_start = clock();
+    size_t n = 0;
+    for (r=0; r<rounds; r++) {
+        n = roke_posting_encode(a, count, buf);
+    }
+    report("encode", elapsed_since(t_start) / rounds, count);
+    fprintf(stdout, "%-28s %8.3f bytes/id\n", "size", (double) n / count);
+
+    t_start = clock();
+    for (r=0; r<rounds; r++) {
+        checksum += roke_posting_decode(buf, n, out);
+    }
+    report("decode (simd)", elapsed_since(t_start) / rounds, count);
+
+    uint32_t features = roke_cpu_set_features_for_test(0);
+    t_start = clock();
+    for (r=0; r<rounds; r++) {
+        checksum += roke_posting_decode(buf, n, out);
+    }
+    report("decode (scalar)", elapsed_since(t_start) / rounds, count);
+    roke_cpu_set_features_for_test(features);
+
+    t_start = clock();
+    for (r=0; r<rounds; r++) {
+        checksum += roke_posting_intersect(a, count, b, count, out);
+    }
+    report("intersect 1:1 (simd)", elapsed_since(t_start) / rounds, 2 * (uint64_t) count);
+
+    t_start = clock();
+    for (r=0; r<rounds; r++) {
+        checksum += roke_posting_intersect_merge(a, count, b, count, out);
+    }
+    report("intersect 1:1 (merge)", elapsed_since(t_start) / rounds, 2 * (uint64_t) count);
+
+    // sample the short list across the whole range of the long list
+    uint32_t small = (count / 1000) ? count / 1000 : 1;
+    uint32_t i;
+    for (i=0; i<small; i++) {
+        a[i] = a[(uint64_t) i * count / small];
+    }
+
+    t_start = clock();
+    for (r=0; r<rounds; r++) {
+        checksum += roke_posting_intersect(a, small, b, count, out);
+    }
+    report("intersect 1:1000 (gallop)", elapsed_since(t_start) / rounds, small + (uint64_t) count);
+
+    t_start = clock();
+    for (r=0; r<rounds; r++) {
+        checksum += roke_posting_intersect_merge(a, small, b, count, out);
+    }
+    report("intersect 1:1000 (merge)", elapsed_since(t_start) / rounds, small + (uint64_t) count);
+
+    fprintf(stdout, "checksum: %u\n", checksum);
+
+    free(a);
+    free(b);
+    free(out);
+    free(buf);
+    argparser_delete(&argparse);
+    return 0;
+}
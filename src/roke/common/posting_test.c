@@ -0,0 +1,149 @@
+#include "roke/common/argparse.h"
+#include "roke/common/unittest.h"
+#include "roke/common/posting.h"
+#include "roke/common/cpu.h"
+
+argparse_spec_t spec[] = {
+    {0, 0, 0, "Test compressed posting lists"},
+    {0, 'v', 0, "verbose"},
+    {"pattern", 'p', 0, "run tests that match the given glob-like pattern."},
+    {0, 0, 0, 0},
+};
+
+// fill ids with a sorted list of unique ids, using gaps of up to maxgap
+static void
+make_list(uint32_t* ids, uint32_t count, uint32_t maxgap, uint32_t seed)
+{
+    uint32_t i, v = 0;
+    srand(seed);
+    for (i=0; i<count; i++) {
+        v += 1 + (uint32_t) (rand() % maxgap);
+        ids[i] = v;
+    }
+}
+
+int
+test_posting_roundtrip(void) {
+    int err = 0;
+
+    uint32_t ids[] = {0, 1, 255, 256, 65535, 65536, 16777215, 16777216, 4294967295u};
+    uint32_t count = sizeof(ids) / sizeof(ids[0]);
+    uint32_t out[16];
+    uint8_t buf[128];
+    uint32_t i;
+
+    size_t n = roke_posting_encode(ids, count, buf);
+    tassert_lessthan(n, roke_posting_bound(count) + 1);
+    tassert_equal(roke_posting_count(buf, n), count);
+    tassert_equal(roke_posting_decode(buf, n, out), count);
+    for (i=0; i<count; i++) {
+        tassert_equal(out[i], ids[i]);
+    }
+
+    // an empty list
+    n = roke_posting_encode(ids, 0, buf);
+    tassert_equal(n, 4);
+    tassert_equal(roke_posting_decode(buf, n, out), 0);
+
+    // a truncated list decodes the prefix which is present
+    n = roke_posting_encode(ids, count, buf);
+    tassert_lessthan(roke_posting_decode(buf, n - 4, out), count);
+
+  end:
+    return err;
+}
+
+int
+test_posting_simd_scalar(void) {
+    int err = 0;
+
+    uint32_t count = 10007;
+    uint32_t* ids = malloc(sizeof(uint32_t) * count);
+    uint32_t* out1 = malloc(sizeof(uint32_t) * count);
+    uint32_t* out2 = malloc(sizeof(uint32_t) * count);
+    uint8_t* buf = malloc(roke_posting_bound(count));
+    uint32_t i, gap;
+
+    for (gap=1; gap<=(1u<<20); gap<<=5) {
+        make_list(ids, count, gap, gap);
+        size_t n = roke_posting_encode(ids, count, buf);
+
+        tassert_equal(roke_posting_decode(buf, n, out1), count);
+
+        uint32_t features = roke_cpu_set_features_for_test(0);
+        uint32_t m = roke_posting_decode(buf, n, out2);
+        roke_cpu_set_features_for_test(features);
+        tassert_equal(m, count);
+
+        for (i=0; i<count; i++) {
+            tassert_equal(out1[i], ids[i]);
+            tassert_equal(out2[i], ids[i]);
+        }
+    }
+
+  end:
+    free(ids);
+    free(out1);
+    free(out2);
+    free(buf);
+    return err;
+}
+
+int
+test_posting_intersect(void) {
+    int err = 0;
+
+    uint32_t sizes[][2] = {{0, 10}, {7, 9}, {1000, 1000}, {1001, 333}, {10, 5000}, {4000, 20}};
+    uint32_t* a = malloc(sizeof(uint32_t) * 5000);
+    uint32_t* b = malloc(sizeof(uint32_t) * 5000);
+    uint32_t* expected = malloc(sizeof(uint32_t) * 5000);
+    uint32_t* actual = malloc(sizeof(uint32_t) * 5000);
+    size_t k;
+    uint32_t i;
+
+    for (k=0; k<sizeof(sizes)/sizeof(sizes[0]); k++) {
+        uint32_t na = sizes[k][0];
+        uint32_t nb = sizes[k][1];
+        make_list(a, na, 4, (uint32_t) k + 1);
+        make_list(b, nb, 3 + (uint32_t) k, (uint32_t) k + 100);
+
+        uint32_t n = roke_posting_intersect_merge(a, na, b, nb, expected);
+
+        tassert_equal(roke_posting_intersect(a, na, b, nb, actual), n);
+        for (i=0; i<n; i++) {
+            tassert_equal(actual[i], expected[i]);
+        }
+
+        tassert_equal(roke_posting_intersect_gallop(a, na, b, nb, actual), n);
+        for (i=0; i<n; i++) {
+            tassert_equal(actual[i], expected[i]);
+        }
+
+        uint32_t features = roke_cpu_set_features_for_test(0);
+        uint32_t m = roke_posting_intersect(b, nb, a, na, actual);
+        roke_cpu_set_features_for_test(features);
+        tassert_equal(m, n);
+        for (i=0; i<n; i++) {
+            tassert_equal(actual[i], expected[i]);
+        }
+    }
+
+  end:
+    free(a);
+    free(b);
+    free(expected);
+    free(actual);
+    return err;
+}
+
+int
+main(int argc, const char *argv[]) {
+
+    begin_test(argc, argv, spec);
+
+    run_test(test_posting_roundtrip);
+    run_test(test_posting_simd_scalar);
+    run_test(test_posting_intersect);
+
+    end_test();
+}
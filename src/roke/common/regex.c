@@ -8,7 +8,1314 @@
     #include <regex.h>
 #endif
 
-int regex_compile(rregex_t* prex, const uint8_t* pattern, size_t patlen)
+/**
+ * the literal fragments found in a pattern. buf holds the bytes of every
+ * fragment, with escapes removed, so it is never longer than the pattern.
+ */
+typedef struct regex_frags {
+    uint8_t* buf;
+    size_t nbuf;
+    size_t* begin;
+    size_t* len;
+    size_t count;
+    int exact;      // nothing but literal bytes was seen
+} regex_frags_t;
+
+static void
+_regex_frags_flush(regex_frags_t* frags, size_t run)
+{
+    if (frags->nbuf > run) {
+        frags->begin[frags->count] = run;
+        frags->len[frags->count] = frags->nbuf - run;
+        frags->count++;
+    }
+}
+
+/**
+ * @brief find the end of a bracket expression
+ * @param i the index of the opening bracket
+ * @return the index after the closing bracket, or 0 if the expression
+ *         is not terminated or contains a backslash, which POSIX treats
+ *         as a literal and trex as an escape
+ */
+static size_t
+_regex_skip_bracket(const uint8_t* pat, size_t i, size_t end)
+{
+    i++;
+    if (i < end && pat[i] == '^') {
+        i++;
+    }
+    if (i < end && pat[i] == ']') {
+        i++;
+    }
+    while (i < end && pat[i] != ']') {
+        if (pat[i] == '\\') {
+            return 0;
+        }
+        if (pat[i] == '[' && i + 1 < end &&
+                (pat[i+1] == ':' || pat[i+1] == '.' || pat[i+1] == '=')) {
+            uint8_t c = pat[i+1];
+            i += 2;
+            while (i + 1 < end && !(pat[i] == c && pat[i+1] == ']')) {
+                i++;
+            }
+            if (i + 1 >= end) {
+                return 0;
+            }
+            i += 2;
+            continue;
+        }
+        i++;
+    }
+    return (i < end) ? i + 1 : 0;
+}
+
+/**
+ * @brief find the closing parenthesis of a group
+ * @return its index, or 0 if there is none
+ */
+static size_t
+_regex_skip_group(const uint8_t* pat, size_t i, size_t end)
+{
+    int depth = 0;
+    while (i < end) {
+        if (pat[i] == '\\') {
+            i += 2;
+            continue;
+        }
+        if (pat[i] == '[') {
+            i = _regex_skip_bracket(pat, i, end);
+            if (i == 0) {
+                return 0;
+            }
+            continue;
+        }
+        if (pat[i] == '(') {
+            depth++;
+        } else if (pat[i] == ')') {
+            if (--depth == 0) {
+                return i;
+            }
+        }
+        i++;
+    }
+    return 0;
+}
+
+/**
+ * @brief test if a sequence has an alternation outside of any group
+ * @return 1 if it has, 0 if not, -1 if the sequence cannot be parsed
+ */
+static int
+_regex_has_alternation(const uint8_t* pat, size_t i, size_t end)
+{
+    while (i < end) {
+        if (pat[i] == '\\') {
+            i += 2;
+        } else if (pat[i] == '[') {
+            i = _regex_skip_bracket(pat, i, end);
+            if (i == 0) {
+                return -1;
+            }
+        } else if (pat[i] == '(') {
+            i = _regex_skip_group(pat, i, end);
+            if (i == 0) {
+                return -1;
+            }
+            i++;
+        } else if (pat[i] == '|') {
+            return 1;
+        } else {
+            i++;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief read the quantifiers following an atom
+ * @param min set to zero if the atom may not occur at all
+ * @param repeat set if the atom may occur more than once
+ * @return the index after the quantifiers, or 0 if an interval could
+ *         not be parsed
+ */
+static size_t
+_regex_quantifier(const uint8_t* pat, size_t i, size_t end, int* min, int* repeat)
+{
+    *min = 1;
+    *repeat = 0;
+    while (i < end) {
+        if (pat[i] == '*') {
+            *min = 0;
+            *repeat = 1;
+        } else if (pat[i] == '?') {
+            *min = 0;
+        } else if (pat[i] == '+') {
+            *repeat = 1;
+        } else if (pat[i] == '{') {
+            size_t lo = 0, hi = 0;
+            int has_lo = 0, has_hi = 0, comma = 0;
+            for (i++; i < end && isdigit(pat[i]); i++) {
+                lo = lo * 10 + (size_t) (pat[i] - '0');
+                has_lo = 1;
+            }
+            if (i < end && pat[i] == ',') {
+                comma = 1;
+                for (i++; i < end && isdigit(pat[i]); i++) {
+                    hi = hi * 10 + (size_t) (pat[i] - '0');
+                    has_hi = 1;
+                }
+            }
+            if (i >= end || pat[i] != '}' || !(has_lo || has_hi)) {
+                return 0;
+            }
+            if (lo == 0) {
+                *min = 0;
+            }
+            if (comma ? (!has_hi || hi > 1) : lo > 1) {
+                *repeat = 1;
+            }
+        } else {
+            break;
+        }
+        i++;
+    }
+    return i;
+}
+
+/**
+ * @brief collect the literal fragments of a sequence without alternation
+ * @return non-zero if the sequence cannot be parsed
+ *
+ * a byte which occurs exactly once extends the current fragment. any
+ * other atom ends it, and a group which must occur adds its own
+ * fragments.
+ */
+static int
+_regex_collect(regex_frags_t* frags, const uint8_t* pat, size_t i, size_t end)
+{
+    size_t run = frags->nbuf;
+
+    while (i < end) {
+        uint8_t c = pat[i];
+        int literal = -1;
+        size_t group_begin = 0, group_end = 0;
+        int min, repeat;
+
+        if (c == '\\') {
+            if (i + 1 >= end) {
+                return 1;
+            }
+            // escaped letters and digits are classes, anchors or back
+            // references, depending on the engine
+            if (pat[i+1] < 0x80 && !isalnum(pat[i+1])) {
+                literal = pat[i+1];
+            }
+            i += 2;
+        } else if (c == '[') {
+            i = _regex_skip_bracket(pat, i, end);
+            if (i == 0) {
+                return 1;
+            }
+        } else if (c == '(') {
+            group_end = _regex_skip_group(pat, i, end);
+            if (group_end == 0) {
+                return 1;
+            }
+            group_begin = i + 1;
+            i = group_end + 1;
+        } else if (c == '*' || c == '+' || c == '?' || c == '{' || c == ')' || c == '|') {
+            return 1;
+        } else {
+            if (c != '.' && c != '^' && c != '$') {
+                literal = c;
+            }
+            i++;
+        }
+
+        i = _regex_quantifier(pat, i, end, &min, &repeat);
+        if (i == 0) {
+            return 1;
+        }
+
+        if (literal < 0 || min == 0 || repeat) {
+            frags->exact = 0;
+        }
+        if (literal >= 0 && min > 0) {
+            frags->buf[frags->nbuf++] = (uint8_t) literal;
+            if (!repeat) {
+                continue;
+            }
+        }
+        _regex_frags_flush(frags, run);
+        run = frags->nbuf;
+
+        if (group_end > 0 && min > 0) {
+            int alt = _regex_has_alternation(pat, group_begin, group_end);
+            if (alt < 0) {
+                return 1;
+            }
+            if (alt == 0 && _regex_collect(frags, pat, group_begin, group_end)) {
+                return 1;
+            }
+            run = frags->nbuf;
+        }
+    }
+    _regex_frags_flush(frags, run);
+    return 0;
+}
+
+/**
+ * @brief extract the literal fragments which every match contains
+ * @return non-zero on allocation failure. a pattern which cannot be
+ *         analysed simply has no fragments
+ */
+static int
+_regex_literals(rregex_t* prex, const uint8_t* pattern, size_t patlen)
+{
+    regex_frags_t frags;
+    size_t order[ROKE_REGEX_MAX_LITERALS];
+    size_t i, j, n = 0;
+    int err = 0;
+
+    prex->literals = NULL;
+    prex->nliterals = 0;
+    prex->literal_only = 0;
+
+    frags.buf = malloc(patlen + 1);
+    frags.begin = malloc((patlen + 1) * sizeof(size_t));
+    frags.len = malloc((patlen + 1) * sizeof(size_t));
+    frags.nbuf = 0;
+    frags.count = 0;
+    frags.exact = 1;
+    if (frags.buf == NULL || frags.begin == NULL || frags.len == NULL) {
+        err = 1;
+        goto end;
+    }
+
+    if (_regex_has_alternation(pattern, 0, patlen) != 0 ||
+            _regex_collect(&frags, pattern, 0, patlen)) {
+        goto end;
+    }
+
+    // keep the longest fragments, longest first
+    for (i=0; i<frags.count; i++) {
+        for (j=n; j>0 && frags.len[order[j-1]] < frags.len[i]; j--) {
+            if (j < ROKE_REGEX_MAX_LITERALS) {
+                order[j] = order[j-1];
+            }
+        }
+        if (j < ROKE_REGEX_MAX_LITERALS) {
+            order[j] = i;
+            if (n < ROKE_REGEX_MAX_LITERALS) {
+                n++;
+            }
+        }
+    }
+    if (n == 0) {
+        goto end;
+    }
+
+    prex->literals = calloc(n, sizeof(roke_substr_t));
+    if (prex->literals == NULL) {
+        err = 1;
+        goto end;
+    }
+    for (i=0; i<n; i++) {
+        if (roke_substr_init(&prex->literals[i],
+                frags.buf + frags.begin[order[i]], frags.len[order[i]])) {
+            err = 1;
+            goto end;
+        }
+        prex->nliterals++;
+    }
+    prex->literal_only = frags.exact && frags.count == 1;
+
+  end:
+    free(frags.buf);
+    free(frags.begin);
+    free(frags.len);
+    return err;
+}
+
+/*
+ * lazy DFA
+ *
+ * patterns in the subset below are parsed into a tree, compiled into a
+ * program of byte set, split and jump instructions, and run as a DFA
+ * whose states are sets of program positions. states are only built
+ * when a name first needs them and are kept in a cache which is shared
+ * by every name the regex is matched against, so after a few names most
+ * bytes cost a single table lookup.
+ *
+ *   literals, and \ followed by a character which is not a letter or digit
+ *   .  [...]  [^...]  [:class:] inside brackets
+ *   \d \D \w \W \s \S
+ *   ( )  |  *  +  ?  {n}  {n,}  {n,m}
+ *   ^  $
+ *
+ * bytes are matched one at a time, as regcomp does in the C locale.
+ * other patterns, such as back references and word boundaries, are left
+ * to the platform engine.
+ */
+
+// limits on the size of the tree and program built for one pattern
+#define REGEX_MAX_DEPTH 256
+#define REGEX_MAX_INSTS 8192
+
+// the transition table of the cache is flushed when it would grow past
+// this many bytes
+#define REGEX_DFA_CACHE (1 << 20)
+#define REGEX_DFA_MIN_STATES 16
+
+static size_t _regex_dfa_cache = REGEX_DFA_CACHE;
+
+#define REGEX_UNKNOWN UINT32_MAX
+#define REGEX_MATCH 0x80000000u
+#define REGEX_DEAD 0
+
+// closure flags
+#define REGEX_AT_START 1
+#define REGEX_AT_END 2
+
+enum {
+    RX_NODE_SET,
+    RX_NODE_CAT,
+    RX_NODE_ALT,
+    RX_NODE_REPEAT,
+    RX_NODE_BOL,
+    RX_NODE_EOL,
+    RX_NODE_EMPTY,
+};
+
+enum {
+    RX_SET,     // consume a byte of sets[x]
+    RX_SPLIT,   // continue at both x and y
+    RX_JMP,     // continue at x
+    RX_BOL,     // the start of the string
+    RX_EOL,     // the end of the string
+    RX_MATCH,
+};
+
+typedef struct regex_set {
+    uint64_t bits[4];
+} regex_set_t;
+
+typedef struct regex_node {
+    uint8_t type;
+    uint32_t a;     // the set, or the first child
+    uint32_t b;     // the second child
+    int min;
+    int max;        // -1 for no limit
+} regex_node_t;
+
+typedef struct regex_inst {
+    uint8_t op;
+    uint32_t x;
+    uint32_t y;
+} regex_inst_t;
+
+typedef struct regex_parser {
+    const uint8_t* pat;
+    size_t len;
+    size_t pos;
+    int depth;
+    int unsupported;    // outside the subset, or out of memory
+    regex_node_t* nodes;
+    uint32_t nnodes;
+    uint32_t capnodes;
+    regex_set_t* sets;
+    uint32_t nsets;
+    uint32_t capsets;
+} regex_parser_t;
+
+typedef struct regex_dfa {
+    uint8_t* pattern;       // kept for the platform engine, see regex_match
+    regex_inst_t* insts;
+    uint32_t ninsts;
+    regex_set_t* sets;
+    uint16_t classes[256];  // byte to column of the transition table
+    uint8_t reps[256];      // a byte of every class
+    uint32_t nclasses;
+    int anchored;           // no match can begin after the first byte
+    int empty_match;
+
+    // the cache. state REGEX_DEAD is the empty set
+    uint32_t* trans;        // nstates * nclasses, REGEX_UNKNOWN if not built
+    uint32_t* begin;        // nstates + 1 offsets into pcs
+    uint8_t* matching;      // the state contains RX_MATCH
+    uint8_t* at_end;        // 0 unknown, 1 no match at the end, 2 match
+    uint32_t* pcs;
+    size_t npcs;
+    size_t cappcs;
+    uint32_t nstates;
+    uint32_t capstates;
+    uint32_t maxstates;
+    uint32_t* table;        // hash of a state to its id + 1
+    uint32_t tablemask;
+    uint32_t* startpcs;
+    uint32_t nstartpcs;
+    uint32_t start;
+
+    // scratch space for building states
+    uint32_t* stack;
+    uint32_t* list;
+    uint32_t* seeds;
+    uint32_t* mark;
+    uint32_t gen;
+} regex_dfa_t;
+
+static void
+_regex_set_add(regex_set_t* set, uint32_t lo, uint32_t hi)
+{
+    uint32_t b;
+    for (b=lo; b<=hi; b++) {
+        set->bits[b >> 6] |= ((uint64_t) 1) << (b & 63);
+    }
+}
+
+static inline int
+_regex_set_has(const regex_set_t* set, uint8_t b)
+{
+    return (set->bits[b >> 6] >> (b & 63)) & 1;
+}
+
+/**
+ * @brief add a named character class, as defined in the C locale
+ * @return non-zero if the name is not known
+ */
+static int
+_regex_set_class(regex_set_t* set, const uint8_t* name, size_t len)
+{
+    uint32_t b;
+    int (*fn)(int) = NULL;
+
+    #define _is(s) (len == strlen(s) && memcmp(name, s, len) == 0)
+    if (_is("alpha")) fn = isalpha;
+    else if (_is("digit")) fn = isdigit;
+    else if (_is("alnum")) fn = isalnum;
+    else if (_is("upper")) fn = isupper;
+    else if (_is("lower")) fn = islower;
+    else if (_is("space")) fn = isspace;
+    else if (_is("blank")) fn = isblank;
+    else if (_is("punct")) fn = ispunct;
+    else if (_is("print")) fn = isprint;
+    else if (_is("graph")) fn = isgraph;
+    else if (_is("cntrl")) fn = iscntrl;
+    else if (_is("xdigit")) fn = isxdigit;
+    #undef _is
+
+    if (fn == NULL) {
+        return 1;
+    }
+    for (b=0; b<0x80; b++) {
+        if (fn((int) b)) {
+            _regex_set_add(set, b, b);
+        }
+    }
+    return 0;
+}
+
+static void
+_regex_set_negate(regex_set_t* set)
+{
+    int i;
+    for (i=0; i<4; i++) {
+        set->bits[i] = ~set->bits[i];
+    }
+    // names never contain a null byte
+    set->bits[0] &= ~((uint64_t) 1);
+}
+
+static uint32_t
+_regex_node(regex_parser_t* p, uint8_t type, uint32_t a, uint32_t b)
+{
+    if (p->nnodes == p->capnodes) {
+        uint32_t cap = (p->capnodes) ? p->capnodes * 2 : 32;
+        regex_node_t* nodes = realloc(p->nodes, cap * sizeof(regex_node_t));
+        if (nodes == NULL) {
+            p->unsupported = 1;
+            return 0;
+        }
+        p->nodes = nodes;
+        p->capnodes = cap;
+    }
+    regex_node_t* n = &p->nodes[p->nnodes];
+    n->type = type;
+    n->a = a;
+    n->b = b;
+    n->min = 1;
+    n->max = 1;
+    return p->nnodes++;
+}
+
+static uint32_t
+_regex_set_node(regex_parser_t* p, const regex_set_t* set)
+{
+    if (p->nsets == p->capsets) {
+        uint32_t cap = (p->capsets) ? p->capsets * 2 : 16;
+        regex_set_t* sets = realloc(p->sets, cap * sizeof(regex_set_t));
+        if (sets == NULL) {
+            p->unsupported = 1;
+            return 0;
+        }
+        p->sets = sets;
+        p->capsets = cap;
+    }
+    p->sets[p->nsets] = *set;
+    return _regex_node(p, RX_NODE_SET, p->nsets++, 0);
+}
+
+/**
+ * @brief parse a bracket expression, after the opening bracket
+ */
+static uint32_t
+_regex_parse_bracket(regex_parser_t* p)
+{
+    regex_set_t set;
+    int negate = 0, first = 1;
+
+    memset(&set, 0, sizeof(set));
+    if (p->pos < p->len && p->pat[p->pos] == '^') {
+        negate = 1;
+        p->pos++;
+    }
+    for (;;) {
+        if (p->pos >= p->len) {
+            p->unsupported = 1;
+            return 0;
+        }
+        uint8_t c = p->pat[p->pos];
+        if (c == ']' && !first) {
+            p->pos++;
+            break;
+        }
+        first = 0;
+        if (c == '[' && p->pos + 1 < p->len) {
+            uint8_t kind = p->pat[p->pos + 1];
+            if (kind == '.' || kind == '=') {
+                // collating elements and equivalence classes
+                p->unsupported = 1;
+                return 0;
+            }
+            if (kind == ':') {
+                size_t name = p->pos + 2, end = name;
+                while (end + 1 < p->len && !(p->pat[end] == ':' && p->pat[end + 1] == ']')) {
+                    end++;
+                }
+                if (end + 1 >= p->len || _regex_set_class(&set, p->pat + name, end - name)) {
+                    p->unsupported = 1;
+                    return 0;
+                }
+                p->pos = end + 2;
+                continue;
+            }
+        }
+        p->pos++;
+        if (p->pos + 1 < p->len && p->pat[p->pos] == '-' && p->pat[p->pos + 1] != ']') {
+            uint8_t hi = p->pat[p->pos + 1];
+            if (hi == '[' || hi < c) {
+                p->unsupported = 1;
+                return 0;
+            }
+            _regex_set_add(&set, c, hi);
+            p->pos += 2;
+        } else {
+            _regex_set_add(&set, c, c);
+        }
+    }
+    if (negate) {
+        _regex_set_negate(&set);
+    }
+    return _regex_set_node(p, &set);
+}
+
+static uint32_t _regex_parse_alt(regex_parser_t* p);
+
+/**
+ * @brief parse a single atom, without its quantifiers
+ */
+static uint32_t
+_regex_parse_atom(regex_parser_t* p)
+{
+    regex_set_t set;
+    uint8_t c = p->pat[p->pos++];
+
+    memset(&set, 0, sizeof(set));
+    switch (c) {
+        case '(': {
+            if (++p->depth > REGEX_MAX_DEPTH) {
+                p->unsupported = 1;
+                return 0;
+            }
+            uint32_t n = _regex_parse_alt(p);
+            p->depth--;
+            if (p->pos >= p->len || p->pat[p->pos] != ')') {
+                p->unsupported = 1;
+                return 0;
+            }
+            p->pos++;
+            return n;
+        }
+        case '[':
+            return _regex_parse_bracket(p);
+        case '.':
+            _regex_set_negate(&set);
+            return _regex_set_node(p, &set);
+        case '^':
+            return _regex_node(p, RX_NODE_BOL, 0, 0);
+        case '$':
+            return _regex_node(p, RX_NODE_EOL, 0, 0);
+        case '*': case '+': case '?': case '{': case ')':
+            p->unsupported = 1;
+            return 0;
+        case '\\':
+            if (p->pos >= p->len) {
+                p->unsupported = 1;
+                return 0;
+            }
+            c = p->pat[p->pos++];
+            switch (c) {
+                case 'd': case 'D':
+                    _regex_set_class(&set, (const uint8_t*) "digit", 5);
+                    break;
+                case 'w': case 'W':
+                    _regex_set_class(&set, (const uint8_t*) "alnum", 5);
+                    _regex_set_add(&set, '_', '_');
+                    break;
+                case 's': case 'S':
+                    _regex_set_class(&set, (const uint8_t*) "space", 5);
+                    break;
+                default:
+                    if (c >= 0x80 || isalnum(c)) {
+                        p->unsupported = 1;
+                        return 0;
+                    }
+                    _regex_set_add(&set, c, c);
+                    return _regex_set_node(p, &set);
+            }
+            if (isupper(c)) {
+                _regex_set_negate(&set);
+            }
+            return _regex_set_node(p, &set);
+        default:
+            _regex_set_add(&set, c, c);
+            return _regex_set_node(p, &set);
+    }
+}
+
+/**
+ * @brief parse an interval, after the opening brace
+ */
+static void
+_regex_parse_interval(regex_parser_t* p, int* min, int* max)
+{
+    long lo = 0, hi = -1;
+    int digits = 0;
+
+    while (p->pos < p->len && isdigit(p->pat[p->pos]) && lo <= REGEX_MAX_INSTS) {
+        lo = lo * 10 + (p->pat[p->pos++] - '0');
+        digits++;
+    }
+    if (digits == 0) {
+        p->unsupported = 1;
+        return;
+    }
+    hi = lo;
+    if (p->pos < p->len && p->pat[p->pos] == ',') {
+        p->pos++;
+        hi = -1;
+        if (p->pos < p->len && isdigit(p->pat[p->pos])) {
+            hi = 0;
+            while (p->pos < p->len && isdigit(p->pat[p->pos]) && hi <= REGEX_MAX_INSTS) {
+                hi = hi * 10 + (p->pat[p->pos++] - '0');
+            }
+        }
+    }
+    if (p->pos >= p->len || p->pat[p->pos] != '}' ||
+            lo > REGEX_MAX_INSTS || hi > REGEX_MAX_INSTS || (hi >= 0 && hi < lo)) {
+        p->unsupported = 1;
+        return;
+    }
+    p->pos++;
+    *min = (int) lo;
+    *max = (int) hi;
+}
+
+static uint32_t
+_regex_parse_repeat(regex_parser_t* p)
+{
+    uint32_t n = _regex_parse_atom(p);
+    uint8_t type = (p->unsupported) ? RX_NODE_EMPTY : p->nodes[n].type;
+
+    while (!p->unsupported && p->pos < p->len) {
+        int min, max;
+        uint8_t c = p->pat[p->pos];
+        if (c == '*') {
+            min = 0, max = -1;
+        } else if (c == '+') {
+            min = 1, max = -1;
+        } else if (c == '?') {
+            min = 0, max = 1;
+        } else if (c == '{') {
+            p->pos++;
+            _regex_parse_interval(p, &min, &max);
+            if (p->unsupported) {
+                break;
+            }
+        } else {
+            break;
+        }
+        if (c != '{') {
+            p->pos++;
+        }
+        if (type == RX_NODE_BOL || type == RX_NODE_EOL) {
+            p->unsupported = 1;
+            break;
+        }
+        n = _regex_node(p, RX_NODE_REPEAT, n, 0);
+        if (!p->unsupported) {
+            p->nodes[n].min = min;
+            p->nodes[n].max = max;
+        }
+    }
+    return n;
+}
+
+static uint32_t
+_regex_parse_cat(regex_parser_t* p)
+{
+    uint32_t n = REGEX_UNKNOWN;
+    while (!p->unsupported && p->pos < p->len &&
+            p->pat[p->pos] != '|' && p->pat[p->pos] != ')') {
+        uint32_t r = _regex_parse_repeat(p);
+        n = (n == REGEX_UNKNOWN) ? r : _regex_node(p, RX_NODE_CAT, n, r);
+    }
+    if (n == REGEX_UNKNOWN) {
+        n = _regex_node(p, RX_NODE_EMPTY, 0, 0);
+    }
+    return n;
+}
+
+static uint32_t
+_regex_parse_alt(regex_parser_t* p)
+{
+    uint32_t n = _regex_parse_cat(p);
+    while (!p->unsupported && p->pos < p->len && p->pat[p->pos] == '|') {
+        p->pos++;
+        n = _regex_node(p, RX_NODE_ALT, n, _regex_parse_cat(p));
+    }
+    return n;
+}
+
+static uint32_t
+_regex_emit(regex_dfa_t* dfa, uint8_t op, uint32_t x, uint32_t y)
+{
+    if (dfa->ninsts >= REGEX_MAX_INSTS) {
+        return REGEX_UNKNOWN;
+    }
+    dfa->insts[dfa->ninsts].op = op;
+    dfa->insts[dfa->ninsts].x = x;
+    dfa->insts[dfa->ninsts].y = y;
+    return dfa->ninsts++;
+}
+
+/**
+ * @brief compile a tree into instructions
+ * @return non-zero if the program would be too large
+ */
+static int
+_regex_emit_node(regex_dfa_t* dfa, const regex_node_t* nodes, uint32_t n)
+{
+    const regex_node_t* node = &nodes[n];
+    uint32_t split, jmp;
+    int i;
+
+    switch (node->type) {
+        case RX_NODE_SET:
+            return _regex_emit(dfa, RX_SET, node->a, 0) == REGEX_UNKNOWN;
+        case RX_NODE_BOL:
+            return _regex_emit(dfa, RX_BOL, 0, 0) == REGEX_UNKNOWN;
+        case RX_NODE_EOL:
+            return _regex_emit(dfa, RX_EOL, 0, 0) == REGEX_UNKNOWN;
+        case RX_NODE_EMPTY:
+            return 0;
+        case RX_NODE_CAT:
+            return _regex_emit_node(dfa, nodes, node->a) ||
+                _regex_emit_node(dfa, nodes, node->b);
+        case RX_NODE_ALT:
+            split = _regex_emit(dfa, RX_SPLIT, 0, 0);
+            if (split == REGEX_UNKNOWN || _regex_emit_node(dfa, nodes, node->a)) {
+                return 1;
+            }
+            jmp = _regex_emit(dfa, RX_JMP, 0, 0);
+            if (jmp == REGEX_UNKNOWN) {
+                return 1;
+            }
+            dfa->insts[split].x = split + 1;
+            dfa->insts[split].y = dfa->ninsts;
+            if (_regex_emit_node(dfa, nodes, node->b)) {
+                return 1;
+            }
+            dfa->insts[jmp].x = dfa->ninsts;
+            return 0;
+        case RX_NODE_REPEAT:
+            for (i=0; i<node->min; i++) {
+                if (_regex_emit_node(dfa, nodes, node->a)) {
+                    return 1;
+                }
+            }
+            if (node->max < 0) {
+                // L1: split L2, L3; L2: a; jmp L1; L3:
+                split = _regex_emit(dfa, RX_SPLIT, 0, 0);
+                if (split == REGEX_UNKNOWN || _regex_emit_node(dfa, nodes, node->a) ||
+                        _regex_emit(dfa, RX_JMP, split, 0) == REGEX_UNKNOWN) {
+                    return 1;
+                }
+                dfa->insts[split].x = split + 1;
+                dfa->insts[split].y = dfa->ninsts;
+                return 0;
+            }
+            for (i=node->min; i<node->max; i++) {
+                split = _regex_emit(dfa, RX_SPLIT, 0, 0);
+                if (split == REGEX_UNKNOWN || _regex_emit_node(dfa, nodes, node->a)) {
+                    return 1;
+                }
+                dfa->insts[split].x = split + 1;
+                dfa->insts[split].y = dfa->ninsts;
+            }
+            return 0;
+    }
+    return 1;
+}
+
+/**
+ * @brief split the bytes into classes which no set tells apart
+ */
+static void
+_regex_dfa_classes(regex_dfa_t* dfa, uint32_t nsets)
+{
+    uint16_t map[512];
+    uint32_t s, b;
+
+    memset(dfa->classes, 0, sizeof(dfa->classes));
+    dfa->nclasses = 1;
+    for (s=0; s<nsets; s++) {
+        uint32_t n = 0;
+        memset(map, 0xFF, sizeof(map));
+        for (b=0; b<256; b++) {
+            uint32_t key = dfa->classes[b] * 2u + (uint32_t) _regex_set_has(&dfa->sets[s], (uint8_t) b);
+            if (map[key] == 0xFFFF) {
+                map[key] = (uint16_t) n++;
+            }
+            dfa->classes[b] = map[key];
+        }
+        dfa->nclasses = n;
+    }
+    for (b=256; b>0; b--) {
+        dfa->reps[dfa->classes[b - 1]] = (uint8_t) (b - 1);
+    }
+}
+
+/**
+ * @brief follow the instructions which do not consume a byte
+ * @param seeds the positions to start from
+ * @return the number of positions in dfa->list, sorted. only positions
+ *         of RX_SET, RX_MATCH and of assertions which could not be
+ *         decided yet are kept
+ */
+static uint32_t
+_regex_closure(regex_dfa_t* dfa, const uint32_t* seeds, uint32_t nseeds, int flags)
+{
+    uint32_t nstack = 0, n = 0, i;
+
+    if (++dfa->gen == 0) {
+        memset(dfa->mark, 0, dfa->ninsts * sizeof(uint32_t));
+        dfa->gen = 1;
+    }
+    for (i=nseeds; i>0; i--) {
+        dfa->stack[nstack++] = seeds[i - 1];
+    }
+    while (nstack > 0) {
+        uint32_t pc = dfa->stack[--nstack];
+        if (dfa->mark[pc] == dfa->gen) {
+            continue;
+        }
+        dfa->mark[pc] = dfa->gen;
+        const regex_inst_t* inst = &dfa->insts[pc];
+        switch (inst->op) {
+            case RX_SPLIT:
+                dfa->stack[nstack++] = inst->y;
+                dfa->stack[nstack++] = inst->x;
+                break;
+            case RX_JMP:
+                dfa->stack[nstack++] = inst->x;
+                break;
+            case RX_BOL:
+                if (flags & REGEX_AT_START) {
+                    dfa->stack[nstack++] = pc + 1;
+                }
+                break;
+            case RX_EOL:
+                if (flags & REGEX_AT_END) {
+                    dfa->stack[nstack++] = pc + 1;
+                } else {
+                    dfa->list[n++] = pc;
+                }
+                break;
+            default:
+                dfa->list[n++] = pc;
+                break;
+        }
+    }
+
+    // insertion sort, the lists are short
+    for (i=1; i<n; i++) {
+        uint32_t pc = dfa->list[i], j;
+        for (j=i; j>0 && dfa->list[j - 1] > pc; j--) {
+            dfa->list[j] = dfa->list[j - 1];
+        }
+        dfa->list[j] = pc;
+    }
+    return n;
+}
+
+static int
+_regex_list_matches(const regex_dfa_t* dfa, const uint32_t* list, uint32_t n)
+{
+    uint32_t i;
+    for (i=0; i<n; i++) {
+        if (dfa->insts[list[i]].op == RX_MATCH) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static uint32_t
+_regex_hash(const uint32_t* list, uint32_t n)
+{
+    uint32_t h = 2166136261u, i;
+    for (i=0; i<n; i++) {
+        h = (h ^ list[i]) * 16777619u;
+    }
+    return h;
+}
+
+/**
+ * @brief find or add the state for a sorted list of positions
+ * @return the state, or REGEX_UNKNOWN if the cache is full
+ */
+static uint32_t
+_regex_intern(regex_dfa_t* dfa, const uint32_t* list, uint32_t n)
+{
+    uint32_t h = _regex_hash(list, n) & dfa->tablemask;
+    uint32_t id;
+
+    for (; dfa->table[h] != 0; h = (h + 1) & dfa->tablemask) {
+        id = dfa->table[h] - 1;
+        uint32_t len = dfa->begin[id + 1] - dfa->begin[id];
+        if (len == n && memcmp(dfa->pcs + dfa->begin[id], list, n * sizeof(uint32_t)) == 0) {
+            return id;
+        }
+    }
+    if (dfa->nstates == dfa->maxstates) {
+        return REGEX_UNKNOWN;
+    }
+
+    if (dfa->nstates == dfa->capstates) {
+        uint32_t cap = dfa->capstates * 2;
+        if (cap > dfa->maxstates) {
+            cap = dfa->maxstates;
+        }
+        uint32_t* trans = realloc(dfa->trans, (size_t) cap * dfa->nclasses * sizeof(uint32_t));
+        if (trans == NULL) {
+            return REGEX_UNKNOWN;
+        }
+        dfa->trans = trans;
+        uint32_t* begin = realloc(dfa->begin, (cap + 1) * sizeof(uint32_t));
+        if (begin == NULL) {
+            return REGEX_UNKNOWN;
+        }
+        dfa->begin = begin;
+        uint8_t* matching = realloc(dfa->matching, cap);
+        if (matching == NULL) {
+            return REGEX_UNKNOWN;
+        }
+        dfa->matching = matching;
+        uint8_t* at_end = realloc(dfa->at_end, cap);
+        if (at_end == NULL) {
+            return REGEX_UNKNOWN;
+        }
+        dfa->at_end = at_end;
+        dfa->capstates = cap;
+    }
+    if (dfa->npcs + n > dfa->cappcs) {
+        size_t cap = (dfa->npcs + n) * 2;
+        uint32_t* pcs = realloc(dfa->pcs, cap * sizeof(uint32_t));
+        if (pcs == NULL) {
+            return REGEX_UNKNOWN;
+        }
+        dfa->pcs = pcs;
+        dfa->cappcs = cap;
+    }
+
+    id = dfa->nstates++;
+    memcpy(dfa->pcs + dfa->npcs, list, n * sizeof(uint32_t));
+    dfa->begin[id] = (uint32_t) dfa->npcs;
+    dfa->npcs += n;
+    dfa->begin[id + 1] = (uint32_t) dfa->npcs;
+    memset(dfa->trans + (size_t) id * dfa->nclasses, 0xFF, dfa->nclasses * sizeof(uint32_t));
+    dfa->matching[id] = (uint8_t) _regex_list_matches(dfa, list, n);
+    dfa->at_end[id] = 0;
+    dfa->table[h] = id + 1;
+    return id;
+}
+
+/**
+ * @brief empty the cache, keeping only the dead and the start state
+ * @return non-zero on failure
+ */
+static int
+_regex_flush(regex_dfa_t* dfa)
+{
+    dfa->nstates = 0;
+    dfa->npcs = 0;
+    memset(dfa->table, 0, (dfa->tablemask + 1) * sizeof(uint32_t));
+    if (_regex_intern(dfa, NULL, 0) != REGEX_DEAD) {
+        return 1;
+    }
+    dfa->start = _regex_intern(dfa, dfa->startpcs, dfa->nstartpcs);
+    return dfa->start == REGEX_UNKNOWN;
+}
+
+/**
+ * @brief build the transition of a state on a byte class
+ * @return the next state, with REGEX_MATCH set if it contains a match,
+ *         or REGEX_UNKNOWN on failure
+ */
+static uint32_t
+_regex_step(regex_dfa_t* dfa, uint32_t state, uint32_t c)
+{
+    uint32_t nseeds = 0, i;
+    uint8_t b = dfa->reps[c];
+
+    for (i=dfa->begin[state]; i<dfa->begin[state + 1]; i++) {
+        const regex_inst_t* inst = &dfa->insts[dfa->pcs[i]];
+        if (inst->op == RX_SET && _regex_set_has(&dfa->sets[inst->x], b)) {
+            dfa->seeds[nseeds++] = dfa->pcs[i] + 1;
+        }
+    }
+    // a match may begin at any byte
+    if (!dfa->anchored) {
+        dfa->seeds[nseeds++] = 0;
+    }
+
+    uint32_t n = _regex_closure(dfa, dfa->seeds, nseeds, 0);
+    uint32_t next = _regex_intern(dfa, dfa->list, n);
+    if (next == REGEX_UNKNOWN) {
+        // the cache is full. the source state is dropped with the rest,
+        // so this transition is not stored
+        if (_regex_flush(dfa)) {
+            return REGEX_UNKNOWN;
+        }
+        next = _regex_intern(dfa, dfa->list, n);
+        if (next == REGEX_UNKNOWN) {
+            return REGEX_UNKNOWN;
+        }
+        return next | ((dfa->matching[next]) ? REGEX_MATCH : 0);
+    }
+    next |= (dfa->matching[next]) ? REGEX_MATCH : 0;
+    dfa->trans[(size_t) state * dfa->nclasses + c] = next;
+    return next;
+}
+
+/**
+ * @brief test if a state matches once the end of the string is reached
+ */
+static int
+_regex_at_end(regex_dfa_t* dfa, uint32_t state)
+{
+    if (dfa->at_end[state] == 0) {
+        uint32_t nseeds = 0, i;
+        for (i=dfa->begin[state]; i<dfa->begin[state + 1]; i++) {
+            if (dfa->insts[dfa->pcs[i]].op == RX_EOL) {
+                dfa->seeds[nseeds++] = dfa->pcs[i];
+            }
+        }
+        uint32_t n = _regex_closure(dfa, dfa->seeds, nseeds, REGEX_AT_END);
+        dfa->at_end[state] = (uint8_t) (1 + _regex_list_matches(dfa, dfa->list, n));
+    }
+    return dfa->at_end[state] == 2;
+}
+
+static void
+_regex_dfa_free(regex_dfa_t* dfa)
+{
+    if (dfa == NULL) {
+        return;
+    }
+    free(dfa->pattern);
+    free(dfa->insts);
+    free(dfa->sets);
+    free(dfa->trans);
+    free(dfa->begin);
+    free(dfa->matching);
+    free(dfa->at_end);
+    free(dfa->pcs);
+    free(dfa->table);
+    free(dfa->startpcs);
+    free(dfa->stack);
+    free(dfa->list);
+    free(dfa->seeds);
+    free(dfa->mark);
+    free(dfa);
+}
+
+/**
+ * @brief compile a pattern into a lazy DFA
+ * @return the DFA, or NULL if the pattern is outside the subset
+ */
+static regex_dfa_t*
+_regex_dfa_compile(const uint8_t* pattern, size_t patlen)
+{
+    regex_parser_t p;
+    regex_dfa_t* dfa = NULL;
+    uint32_t root, n, t;
+
+    memset(&p, 0, sizeof(p));
+    p.pat = pattern;
+    p.len = patlen;
+    root = _regex_parse_alt(&p);
+    if (p.unsupported || p.pos != p.len) {
+        goto error;
+    }
+
+    dfa = calloc(1, sizeof(regex_dfa_t));
+    if (dfa == NULL) {
+        goto error;
+    }
+    dfa->pattern = malloc(patlen + 1);
+    dfa->insts = malloc(REGEX_MAX_INSTS * sizeof(regex_inst_t));
+    if (dfa->pattern == NULL || dfa->insts == NULL || _regex_emit_node(dfa, p.nodes, root) ||
+            _regex_emit(dfa, RX_MATCH, 0, 0) == REGEX_UNKNOWN) {
+        goto error;
+    }
+    memcpy(dfa->pattern, pattern, patlen);
+    dfa->pattern[patlen] = '\0';
+    dfa->sets = p.sets;
+    p.sets = NULL;
+    _regex_dfa_classes(dfa, p.nsets);
+
+    // every position appears at most once in a list, and a state adds at
+    // most one seed per position plus the restart. a position may be
+    // pushed by the seeds and by both arms of splits before it is visited
+    dfa->stack = malloc(3 * (dfa->ninsts + 1) * sizeof(uint32_t));
+    dfa->list = malloc((dfa->ninsts + 1) * sizeof(uint32_t));
+    dfa->seeds = malloc((dfa->ninsts + 1) * sizeof(uint32_t));
+    dfa->mark = calloc(dfa->ninsts, sizeof(uint32_t));
+    if (dfa->stack == NULL || dfa->list == NULL || dfa->seeds == NULL || dfa->mark == NULL) {
+        goto error;
+    }
+
+    dfa->maxstates = (uint32_t) (_regex_dfa_cache / (dfa->nclasses * sizeof(uint32_t)));
+    if (dfa->maxstates < REGEX_DFA_MIN_STATES) {
+        dfa->maxstates = REGEX_DFA_MIN_STATES;
+    }
+    for (t=1; t<2*dfa->maxstates; t<<=1);
+    dfa->tablemask = t - 1;
+    dfa->table = calloc(t, sizeof(uint32_t));
+    dfa->capstates = REGEX_DFA_MIN_STATES;
+    dfa->trans = malloc((size_t) dfa->capstates * dfa->nclasses * sizeof(uint32_t));
+    dfa->begin = malloc((dfa->capstates + 1) * sizeof(uint32_t));
+    dfa->matching = malloc(dfa->capstates);
+    dfa->at_end = malloc(dfa->capstates);
+    if (dfa->table == NULL || dfa->trans == NULL || dfa->begin == NULL ||
+            dfa->matching == NULL || dfa->at_end == NULL) {
+        goto error;
+    }
+
+    uint32_t zero = 0;
+    // a pattern which can only begin at the start of the string has no
+    // positions to restart from, and its dead state ends the scan early
+    dfa->anchored = (_regex_closure(dfa, &zero, 1, 0) == 0);
+    dfa->empty_match = _regex_list_matches(dfa, dfa->list,
+        _regex_closure(dfa, &zero, 1, REGEX_AT_START|REGEX_AT_END));
+
+    n = _regex_closure(dfa, &zero, 1, REGEX_AT_START);
+    dfa->startpcs = malloc((n + 1) * sizeof(uint32_t));
+    if (dfa->startpcs == NULL) {
+        goto error;
+    }
+    memcpy(dfa->startpcs, dfa->list, n * sizeof(uint32_t));
+    dfa->nstartpcs = n;
+    if (_regex_flush(dfa)) {
+        goto error;
+    }
+
+    free(p.nodes);
+    return dfa;
+
+  error:
+    free(p.nodes);
+    free(p.sets);
+    _regex_dfa_free(dfa);
+    return NULL;
+}
+
+/**
+ * @brief run the DFA over a string
+ * @return 0 on match, 1 if there is no match, -1 on failure
+ */
+static int
+_regex_dfa_match(regex_dfa_t* dfa, const uint8_t* str, size_t len)
+{
+    const uint16_t* classes = dfa->classes;
+    uint32_t nc = dfa->nclasses;
+    uint32_t s = dfa->start;
+    size_t i;
+
+    if (len == 0) {
+        return (dfa->empty_match) ? 0 : 1;
+    }
+    if (dfa->matching[s]) {
+        return 0;
+    }
+    for (i=0; i<len; i++) {
+        uint32_t c = classes[str[i]];
+        uint32_t t = dfa->trans[(size_t) s * nc + c];
+        if (t == REGEX_UNKNOWN) {
+            t = _regex_step(dfa, s, c);
+            if (t == REGEX_UNKNOWN) {
+                return -1;
+            }
+        }
+        if (t & REGEX_MATCH) {
+            return 0;
+        }
+        s = t;
+        if (s == REGEX_DEAD) {
+            return 1;
+        }
+    }
+    return (_regex_at_end(dfa, s)) ? 0 : 1;
+}
+
+/**
+ * @brief set the size of the DFA cache of patterns compiled from now on
+ */
+void
+regex_set_cache_for_test(size_t bytes)
+{
+    _regex_dfa_cache = (bytes) ? bytes : REGEX_DFA_CACHE;
+}
+
+/**
+ * @brief compile a pattern with the engine of the platform
+ * @return non-zero if the pattern is not valid
+ */
+static int
+_regex_native_compile(rregex_t* prex, const uint8_t* pattern)
 {
 #ifdef _WIN32
     //trex
@@ -18,13 +1325,56 @@ int regex_compile(rregex_t* prex, const uint8_t* pattern, size_t patlen)
 #else
     // gnu
     prex->ptr = malloc(sizeof(regex_t));
-    return regcomp(prex->ptr, (const char *)pattern, REG_EXTENDED);
+    return regcomp(prex->ptr, (const char *)pattern, REG_EXTENDED|REG_NOSUB);
 #endif
+}
 
+int regex_compile(rregex_t* prex, const uint8_t* pattern, size_t patlen)
+{
+    prex->ptr = NULL;
+    prex->error = NULL;
+    prex->literals = NULL;
+    prex->nliterals = 0;
+    prex->literal_only = 0;
+
+    prex->dfa = _regex_dfa_compile(pattern, patlen);
+    if (prex->dfa == NULL) {
+        int err = _regex_native_compile(prex, pattern);
+        if (err) {
+            return err;
+        }
+    }
+    return _regex_literals(prex, pattern, patlen);
 }
 
 int regex_match(rregex_t* prex, const uint8_t* str, size_t strlen)
 {
+    size_t i;
+    for (i=0; i<prex->nliterals; i++) {
+        if (roke_substr_find(&prex->literals[i], str, strlen) == NULL) {
+            return 1;
+        }
+    }
+    if (prex->literal_only) {
+        return 0;
+    }
+    if (prex->dfa != NULL) {
+        int r = _regex_dfa_match(prex->dfa, str, strlen);
+        if (r >= 0) {
+            return r;
+        }
+        // the cache could not be allocated, use the platform engine
+        // from now on
+        uint8_t* pattern = prex->dfa->pattern;
+        prex->dfa->pattern = NULL;
+        _regex_dfa_free(prex->dfa);
+        prex->dfa = NULL;
+        int err = _regex_native_compile(prex, pattern);
+        free(pattern);
+        if (err) {
+            return 1;
+        }
+    }
 #ifdef _WIN32
     //trex
     return trex_match(prex->ptr, (char*) str) ? 0 : 1;
@@ -36,6 +1386,18 @@ int regex_match(rregex_t* prex, const uint8_t* str, size_t strlen)
 
 int regex_free(rregex_t* prex)
 {
+    size_t i;
+    for (i=0; i<prex->nliterals; i++) {
+        roke_substr_free(&prex->literals[i]);
+    }
+    free(prex->literals);
+    prex->literals = NULL;
+    prex->nliterals = 0;
+    _regex_dfa_free(prex->dfa);
+    prex->dfa = NULL;
+    if (prex->ptr == NULL) {
+        return 0;
+    }
 #ifdef _WIN32
     //trex
     trex_free(prex->ptr);
@@ -44,5 +1406,6 @@ int regex_free(rregex_t* prex)
     regfree(prex->ptr);
     free(prex->ptr);
 #endif
+    prex->ptr = NULL;
     return 0;
-}
\ No newline at end of file
+}
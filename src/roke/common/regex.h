@@ -7,13 +7,33 @@
  *
  * @file roke/common/regex.h
  * @brief wrapper around regular expression engines
+ *
+ * Most patterns contain literal fragments which every match must
+ * contain, such as "report_" and ".csv" in "report_[0-9]+\.csv". These
+ * are extracted when the pattern is compiled and searched for first, so
+ * the regular expression engine only sees the names which contain all of
+ * them. A pattern which is a single literal is not passed to the engine
+ * at all.
+ *
+ * Patterns in the subset documented in regex.c are run by a lazy DFA,
+ * which gives the same results on every platform. Other patterns use
+ * POSIX regexec, or trex on Windows.
  */
 
 #include "roke/common/compat.h"
+#include "roke/common/substr.h"
+
+// the longest required fragments are kept, shorter ones rarely reject
+// a name which the longer ones let through
+#define ROKE_REGEX_MAX_LITERALS 4
 
 typedef struct rregex {
     void * ptr;
     char* error;
+    roke_substr_t* literals;    // fragments every match contains, longest first
+    size_t nliterals;
+    int literal_only;           // the pattern is literals[0] and nothing else
+    struct regex_dfa* dfa;      // NULL if the platform engine is used
 } rregex_t;
 
 ROKE_INTERNAL_API int regex_compile(rregex_t* prex,
@@ -21,5 +41,6 @@ ROKE_INTERNAL_API int regex_compile(rregex_t* prex,
 ROKE_INTERNAL_API int regex_match(rregex_t* prex,
     const uint8_t* str, size_t strlen);
 ROKE_INTERNAL_API int regex_free(rregex_t* prex);
+ROKE_INTERNAL_API void regex_set_cache_for_test(size_t bytes);
 
 #endif
@@ -88,6 +88,260 @@ regex_exception_test(void) {
 }
 
 
+// check the literal fragments extracted from a pattern, longest first
+static int
+check_literals(const char* pattern, int literal_only, const char** expected, size_t n)
+{
+    int err = 0;
+    rregex_t regex;
+    size_t i;
+
+    tassert_zero(_recomp(pattern));
+    tassert_equal(regex.nliterals, n);
+    tassert_equal(regex.literal_only, literal_only);
+    for (i=0; i<n; i++) {
+        tassert_equal(regex.literals[i].patlen, strlen(expected[i]));
+        tassert_zero(memcmp(regex.literals[i].pat, expected[i], strlen(expected[i])));
+    }
+    regex_free(&regex);
+
+  end:
+    if (err) {
+        fprintf(stderr, "pattern=%s\n", pattern);
+    }
+    return err;
+}
+
+#define _literals(p, exact, ...) do { \
+        const char* _e[] = {__VA_ARGS__}; \
+        tassert_zero(check_literals(p, exact, _e, sizeof(_e) / sizeof(_e[0]) - 1)); \
+    } while (0)
+
+int
+regex_literal_test(void) {
+    int err = 0;
+
+    _literals("abc", 1, "abc", 0);
+    _literals("a\\.b", 1, "a.b", 0);
+    _literals("report_[0-9]+\\.csv", 0, "report_", ".csv", 0);
+    _literals("^.*\\.c$", 0, ".c", 0);
+    _literals("ab*c", 0, "a", "c", 0);
+    _literals("ab+c", 0, "ab", "c", 0);
+    _literals("a{0,3}bcd", 0, "bcd", 0);
+    _literals("x(abc)?y", 0, "x", "y", 0);
+    _literals("(abc){2}de", 0, "abc", "de", 0);
+    _literals("(foo|bar)bazz", 0, "bazz", 0);
+    _literals("a.bb.ccc.dddd.eeeee", 0, "eeeee", "dddd", "ccc", "bb", 0);
+
+    // nothing is required by an alternation, and patterns which are not
+    // understood are passed to the engine as they are
+    _literals("foo|bar", 0, 0);
+    _literals("[[:alpha:]]+", 0, 0);
+    _literals("\\d+", 0, 0);
+
+  end:
+    return err;
+}
+
+/**
+ * compare with the engine alone on random patterns built from a few
+ * atoms and operators
+ */
+int
+regex_prefilter_fuzz(void) {
+    int err = 0;
+    const char* tokens[] = {"a", "b", "ab", "ba", ".", "[ab]", "\\.", "(", ")",
+        "|", "*", "+", "?", "{2}", "{0,1}", "^", "$"};
+    size_t ntokens = sizeof(tokens) / sizeof(tokens[0]);
+    char pattern[128];
+    char str[32];
+    uint32_t iter, k;
+
+    srand(11);
+
+    for (iter=0; iter<3000; iter++) {
+        uint32_t ntok = 1 + rand() % 8;
+        pattern[0] = '\0';
+        for (k=0; k<ntok; k++) {
+            strcat(pattern, tokens[rand() % ntokens]);
+        }
+
+        rregex_t regex, plain;
+        if (_recomp(pattern) != 0) {
+            regex_free(&regex);
+            continue;
+        }
+        tassert_zero(regex_compile(&plain, (uint8_t*) pattern, strlen(pattern)));
+        for (k=0; k<plain.nliterals; k++) {
+            roke_substr_free(&plain.literals[k]);
+        }
+        plain.nliterals = 0;
+        plain.literal_only = 0;
+
+        for (k=0; k<20; k++) {
+            size_t len = (size_t) (rand() % 12), i;
+            for (i=0; i<len; i++) {
+                str[i] = "ab.x"[rand() % 4];
+            }
+            str[len] = '\0';
+            int expected = regex_match(&plain, (uint8_t*) str, len) == 0;
+            int actual = _rematch(str) == 0;
+            if (actual != expected) {
+                fprintf(stderr, "pattern=%s string=%s\n", pattern, str);
+            }
+            tassert_equal(actual, expected);
+        }
+        regex_free(&regex);
+        regex_free(&plain);
+    }
+
+  end:
+    return err;
+}
+
+#ifndef _WIN32
+#include <regex.h>
+
+// match with POSIX regexec alone, as the DFA should
+static int
+compare_with_posix(const char* pattern, const char* alphabet, uint32_t nstrings, size_t maxlen)
+{
+    int err = 0;
+    rregex_t regex;
+    regex_t posix;
+    char str[256];
+    uint32_t k;
+
+    tassert_zero(regcomp(&posix, pattern, REG_EXTENDED|REG_NOSUB));
+    tassert_zero(_recomp(pattern));
+    tassert_nonnull(regex.dfa);
+
+    for (k=0; k<nstrings; k++) {
+        size_t len = (size_t) rand() % (maxlen + 1), i;
+        for (i=0; i<len; i++) {
+            str[i] = alphabet[(size_t) rand() % strlen(alphabet)];
+        }
+        str[len] = '\0';
+        int expected = regexec(&posix, str, 0, NULL, 0) == 0;
+        int actual = _rematch(str) == 0;
+        if (actual != expected) {
+            fprintf(stderr, "pattern=%s string=%s\n", pattern, str);
+        }
+        tassert_equal(actual, expected);
+    }
+
+  end:
+    regex_free(&regex);
+    regfree(&posix);
+    return err;
+}
+
+/**
+ * compare the DFA with POSIX regexec on random patterns in the subset
+ * which both support
+ */
+int
+regex_dfa_fuzz(void) {
+    int err = 0;
+    const char* tokens[] = {"a", "b", "ab", ".", "[ab]", "[^a]", "[[:alpha:]_]",
+        "[a-c]", "\\.", "\\w", "\\S", "(", ")", "|", "*", "+", "?", "{2}",
+        "{1,3}", "{0,}", "^", "$"};
+    size_t ntokens = sizeof(tokens) / sizeof(tokens[0]);
+    char pattern[128];
+    uint32_t iter, k, ncompared = 0;
+
+    srand(13);
+
+    for (iter=0; iter<5000; iter++) {
+        uint32_t ntok = 1 + rand() % 10;
+        pattern[0] = '\0';
+        for (k=0; k<ntok; k++) {
+            strcat(pattern, tokens[rand() % ntokens]);
+        }
+
+        // only patterns which are valid and in the subset are compared
+        regex_t posix;
+        if (regcomp(&posix, pattern, REG_EXTENDED|REG_NOSUB) != 0) {
+            continue;
+        }
+        regfree(&posix);
+        rregex_t regex;
+        if (_recomp(pattern) != 0) {
+            continue;
+        }
+        int supported = regex.dfa != NULL;
+        regex_free(&regex);
+        if (!supported) {
+            continue;
+        }
+
+        tassert_zero(compare_with_posix(pattern, "ab._ X", 30, 12));
+        ncompared++;
+    }
+    tassert_true(ncompared > 1000);
+
+  end:
+    return err;
+}
+
+/**
+ * a pattern with more states than fit in the cache, which is flushed
+ * and rebuilt while matching
+ */
+int
+regex_dfa_cache_test(void) {
+    int err = 0;
+
+    srand(17);
+    regex_set_cache_for_test(1024);
+    tassert_zero(compare_with_posix("(a|b)*a(a|b){6}", "ab", 1000, 100));
+    tassert_zero(compare_with_posix("^(ab|a)*b$", "ab", 1000, 40));
+
+  end:
+    regex_set_cache_for_test(0);
+    return err;
+}
+#endif
+
+int
+regex_dfa_subset_test(void) {
+    int err = 0;
+    rregex_t regex;
+
+    // \d is a digit on every platform
+    _recomp("^x\\d+$");
+    tassert_nonnull(regex.dfa);
+    tassert_zero(_rematch("x123"));
+    tassert_nonzero(_rematch("xd"));
+    tassert_nonzero(_rematch("x12a"));
+    regex_free(&regex);
+
+    // anchored patterns stop at the first byte which cannot match
+    _recomp("^ab");
+    tassert_zero(_rematch("abc"));
+    tassert_nonzero(_rematch("cab"));
+    tassert_nonzero(_rematch(""));
+    regex_free(&regex);
+
+    _recomp("a|^$");
+    tassert_zero(_rematch(""));
+    tassert_zero(_rematch("ba"));
+    tassert_nonzero(_rematch("b"));
+    regex_free(&regex);
+
+    // word boundaries and back references are left to the platform
+#ifndef _WIN32
+    _recomp("\\bab");
+    tassert_null(regex.dfa);
+    tassert_zero(_rematch("x ab"));
+    tassert_nonzero(_rematch("xab"));
+    regex_free(&regex);
+#endif
+
+  end:
+    return err;
+}
+
 int
 main(int argc, const char *argv[]) {
 
@@ -97,6 +351,13 @@ main(int argc, const char *argv[]) {
     run_test(regex_inset_test);
     run_test(regex_outset_test);
     run_test(regex_exception_test);
+    run_test(regex_literal_test);
+    run_test(regex_prefilter_fuzz);
+    run_test(regex_dfa_subset_test);
+#ifndef _WIN32
+    run_test(regex_dfa_fuzz);
+    run_test(regex_dfa_cache_test);
+#endif
 
     end_test();
 }
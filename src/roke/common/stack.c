@@ -47,6 +47,9 @@ int rstack_push(rstack_t *stack, uint32_t index, uint32_t depth, const uint8_t*
     item->index = index;
     item->depth = depth;
     item->path = strdup_safe(path);
+    item->size = 0;
+    item->mtime = 0;
+    item->mode = 0;
 
     return 0;
 }
@@ -14,6 +14,10 @@ typedef struct rstack_data {
     uint32_t index;
     uint32_t depth;
     uint8_t* path;
+    // metadata of the directory, set by the caller after pushing
+    uint64_t size;
+    uint32_t mtime;
+    uint32_t mode;
 } rstack_data_t;
 
 typedef struct rstack {
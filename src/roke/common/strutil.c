@@ -3,6 +3,59 @@
 #include "roke/common/pathutil.h"
 #include "utf8/utf8proc.h"
 
+#define ASCII_ONES  0x0101010101010101ull
+#define ASCII_HIGH  0x8080808080808080ull
+
+/**
+ * @brief test if a string contains only ASCII bytes
+ */
+int
+is_ascii(const uint8_t* str, size_t len)
+{
+    uint64_t acc = 0, w;
+    size_t i = 0;
+    for (; i + 8 <= len; i += 8) {
+        memcpy(&w, str + i, 8);
+        acc |= w;
+    }
+    for (; i < len; i++) {
+        acc |= str[i];
+    }
+    return (acc & ASCII_HIGH) == 0;
+}
+
+/**
+ * @brief lowercase the ASCII bytes at the start of a string
+ * @return the number of bytes copied, which stops before the first byte
+ *         with the high bit set, or after n bytes
+ */
+static size_t
+_ascii_tolower(uint8_t* dst, const uint8_t* src, size_t n)
+{
+    size_t i = 0;
+    uint64_t w;
+
+    // eight bytes at a time. for every byte b without the high bit, the
+    // high bit of b + (0x80 - 'A') is set if b >= 'A', and that of
+    // b + (0x7F - 'Z') if b > 'Z'
+    for (; i + 8 <= n; i += 8) {
+        memcpy(&w, src + i, 8);
+        if (w & ASCII_HIGH) {
+            break;
+        }
+        uint64_t ge_a = w + ASCII_ONES * (0x80 - 'A');
+        uint64_t gt_z = w + ASCII_ONES * (0x7F - 'Z');
+        uint64_t upper = ge_a & ~gt_z & ASCII_HIGH;
+        w |= upper >> 2;
+        memcpy(dst + i, &w, 8);
+    }
+    for (; i < n && src[i] < 0x80; i++) {
+        uint8_t c = src[i];
+        dst[i] = (uint8_t) (c | (((uint8_t) (c - 'A') < 26) ? 0x20 : 0));
+    }
+    return i;
+}
+
 size_t tolowercase(uint8_t* dst, size_t dstlen, const uint8_t* str)
 {
       utf8proc_ssize_t inplen = strlen((char*) str);
@@ -15,11 +68,37 @@ size_t tolowercase(uint8_t* dst, size_t dstlen, const uint8_t* str)
       // reserve one byte for the null terminator
       dstlen -= 1;
 
-      // decode the first code point in the string
-      count = utf8proc_iterate(inptmp, inplen, &codepoint);
+      // loop while characters remain
+      while (inplen>0) {
+        // most names are ASCII, which does not need utf8proc
+        if (*inptmp < 0x80) {
+            size_t room = (size_t) (dstlen - total);
+            size_t n = _ascii_tolower(tmpout, inptmp,
+                ((size_t) inplen < room) ? (size_t) inplen : room);
+            if (n == 0) {
+                total = 0;
+                break;
+            }
+            inplen -= (utf8proc_ssize_t) n;
+            inptmp += n;
+            tmpout += n;
+            total += (utf8proc_ssize_t) n;
+            continue;
+        }
+
+        count = utf8proc_iterate(inptmp, inplen, &codepoint);
 
-      // loop while characters remain, and we encounter no errors.
-      while (inplen>0 && codepoint!=-1) {
+        // bytes which are not valid UTF-8 are copied as they are
+        if (count<=0 || codepoint==-1) {
+            if ((dstlen - total) < 1) {
+                total = 0;
+                break;
+            }
+            *tmpout++ = *inptmp++;
+            inplen -= 1;
+            total += 1;
+            continue;
+        }
         inplen -= count;
         inptmp += count;
 
@@ -36,9 +115,6 @@ size_t tolowercase(uint8_t* dst, size_t dstlen, const uint8_t* str)
         count = utf8proc_encode_char(codepoint, tmpout);
         tmpout += count;
         total += count;
-
-        // decode the next code point
-        count = utf8proc_iterate(inptmp, inplen, &codepoint);
       }
 
       dst[total] = '\0';
@@ -46,6 +122,61 @@ size_t tolowercase(uint8_t* dst, size_t dstlen, const uint8_t* str)
       return (size_t) total;
 }
 
+// the number of code points a string may decompose into
+#define NORMALIZE_MAX_CODEPOINTS 1024
+
+/**
+ * @brief normalize a string to NFKC and fold its case
+ * @param dstlen the size of dst, including the null terminator
+ * @param str    a null terminated string
+ * @param len    the length of str
+ * @return the length of the result, zero if it does not fit in dst
+ *
+ * decomposed names, as created on macOS, and names using compatibility
+ * characters such as ligatures and full width letters normalize to the
+ * same string as the text a user would type. ASCII is only lowercased.
+ * strings which are not valid UTF-8, or which decompose into too many
+ * code points, are lowercased with tolowercase instead.
+ */
+size_t
+tonormalized(uint8_t* dst, size_t dstlen, const uint8_t* str, size_t len)
+{
+    // one more than the limit, so that reencoding in place has room for
+    // the null terminator
+    utf8proc_int32_t buffer[NORMALIZE_MAX_CODEPOINTS + 1];
+    const utf8proc_option_t options = UTF8PROC_STABLE | UTF8PROC_COMPAT |
+        UTF8PROC_COMPOSE | UTF8PROC_CASEFOLD;
+    utf8proc_ssize_t n;
+
+    if (dstlen == 0) {
+        return 0;
+    }
+
+    if (is_ascii(str, len)) {
+        if (len >= dstlen) {
+            dst[0] = '\0';
+            return 0;
+        }
+        _ascii_tolower(dst, str, len);
+        dst[len] = '\0';
+        return len;
+    }
+
+    n = utf8proc_decompose(str, (utf8proc_ssize_t) len, buffer,
+        NORMALIZE_MAX_CODEPOINTS, options);
+    if (n < 0 || n > NORMALIZE_MAX_CODEPOINTS) {
+        return tolowercase(dst, dstlen, str);
+    }
+
+    n = utf8proc_reencode(buffer, n, options);
+    if (n < 0 || (size_t) n >= dstlen) {
+        dst[0] = '\0';
+        return 0;
+    }
+    memcpy(dst, buffer, (size_t) n + 1);
+    return (size_t) n;
+}
+
 uint8_t*
 strdup_safe(const uint8_t *str)
 {
@@ -11,6 +11,9 @@
 #include "roke/common/compat.h"
 
 ROKE_INTERNAL_API size_t tolowercase(uint8_t* dst, size_t dstlen, const uint8_t* str);
+ROKE_INTERNAL_API size_t tonormalized(uint8_t* dst, size_t dstlen,
+    const uint8_t* str, size_t len);
+ROKE_INTERNAL_API int is_ascii(const uint8_t* str, size_t len);
 ROKE_INTERNAL_API uint8_t* strdup_safe(const uint8_t *str);
 ROKE_INTERNAL_API size_t strcpy_safe(uint8_t *dst, size_t dst_len, const uint8_t *str);
 ROKE_INTERNAL_API int has_suffix(const uint8_t *str, size_t lenstr, const uint8_t *suffix, size_t lensuffix);
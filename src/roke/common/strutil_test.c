@@ -133,6 +133,69 @@ define_test(strutil_utf8_lowercase)
 
     tassert_str_equal((char*) buf, (char*) exp);
 
+    // ASCII runs are folded eight bytes at a time, around other characters
+    str = (uint8_t*) "ABCDEFGHIJKLMNOPQRSTUVWXYZ@[`{ \xc3\x84" "BC_0123456789\xce\xa3XYZ";
+    exp = (uint8_t*) "abcdefghijklmnopqrstuvwxyz@[`{ \xc3\xa4" "bc_0123456789\xcf\x83xyz";
+    tassert_equal(tolowercase(buf, sizeof(buf), str), strlen((char*) exp));
+    tassert_str_equal((char*) buf, (char*) exp);
+
+    // names which do not fit are not folded
+    tassert_equal(tolowercase(buf, 8, (uint8_t*) "ABCDEFGHIJ"), 0);
+
+    tassert_true(is_ascii((uint8_t*) "hello world, hello world", 24));
+    tassert_false(is_ascii((uint8_t*) "hello world, hello w\xc3\xb6rld", 25));
+    tassert_false(is_ascii((uint8_t*) "\xff", 1));
+    tassert_true(is_ascii((uint8_t*) "", 0));
+
+    // bytes which are not valid UTF-8 are kept
+    tassert_equal(tolowercase(buf, sizeof(buf), (uint8_t*) "AB\xff.C"), 5);
+    tassert_str_equal((char*) buf, "ab\xff.c");
+
+    exit_test();
+}
+
+static size_t
+normalized(uint8_t* buf, size_t buflen, const char* str)
+{
+    return tonormalized(buf, buflen, (const uint8_t*) str, strlen(str));
+}
+
+define_test(strutil_utf8_normalize)
+{
+    uint8_t buf[1024];
+    uint8_t expected[1024];
+
+    // a composed and a decomposed e acute normalize to the composed form
+    tassert_equal(normalized(buf, sizeof(buf), "Caf\xc3\xa9"), 5);
+    tassert_str_equal((char*) buf, "caf\xc3\xa9");
+    tassert_equal(normalized(buf, sizeof(buf), "CAFE\xcc\x81"), 5);
+    tassert_str_equal((char*) buf, "caf\xc3\xa9");
+
+    // compatibility characters: the fi ligature, full width A, Kelvin sign
+    normalized(buf, sizeof(buf), "\xef\xac\x81le \xef\xbc\xa1 \xe2\x84\xaa");
+    tassert_str_equal((char*) buf, "file a k");
+
+    // case folding maps sharp s to ss, and final sigma to sigma
+    normalized(buf, sizeof(buf), "Stra\xc3\x9f" "e \xce\xa3\xcf\x82");
+    tassert_str_equal((char*) buf, "strasse \xcf\x83\xcf\x83");
+
+    // normalizing is idempotent
+    normalized(expected, sizeof(expected), "\xc3\x85ngstr\xc3\xb6m \xef\xac\x81");
+    normalized(buf, sizeof(buf), (char*) expected);
+    tassert_str_equal((char*) buf, (char*) expected);
+
+    // ASCII is only lowercased
+    tassert_equal(normalized(buf, sizeof(buf), "README.Md"), 9);
+    tassert_str_equal((char*) buf, "readme.md");
+
+    // strings which are not UTF-8 are lowercased byte by byte
+    tassert_equal(normalized(buf, sizeof(buf), "AB\xff.C"), 5);
+    tassert_str_equal((char*) buf, "ab\xff.c");
+
+    // strings which do not fit are not normalized
+    tassert_equal(normalized(buf, 8, "ABCDEFGHIJ"), 0);
+    tassert_equal(normalized(buf, 4, "caf\xc3\xa9"), 0);
+
     exit_test();
 }
 
@@ -143,6 +206,7 @@ main(int argc, const char **argv) {
     run_test(strutil_utf8_strglob_test);
     run_test(test_string_escape);
 	run_test(strutil_utf8_lowercase);
+    run_test(strutil_utf8_normalize);
 
     end_test();
 }
\ No newline at end of file
@@ -0,0 +1,433 @@
+#include "roke/common/substr.h"
+#include "roke/common/cpu.h"
+
+#if defined(ROKE_ARCH_X86)
+    #include <immintrin.h>
+#elif defined(ROKE_ARCH_ARM64)
+    #include <arm_neon.h>
+#endif
+
+// a load which does not cross a page boundary cannot fault, even when it
+// reads past the end of the string. this allows short names to be tested
+// with a single vector load.
+#define ROKE_SUBSTR_PAGE_SIZE 4096
+
+static inline int
+_substr_load_safe(const uint8_t* p, size_t n)
+{
+    return ((uintptr_t) p & (ROKE_SUBSTR_PAGE_SIZE - 1)) <= ROKE_SUBSTR_PAGE_SIZE - n;
+}
+
+/**
+ * @brief find the first occurrence of pat in str, one byte at a time
+ */
+const uint8_t*
+roke_substr_scalar(
+    const uint8_t* pat,
+    size_t patlen,
+    const uint8_t* str,
+    size_t len)
+{
+    if (patlen == 0) {
+        return str;
+    }
+    if (len < patlen) {
+        return NULL;
+    }
+
+    // one past the last position where a match can begin
+    const uint8_t* end = str + len - patlen + 1;
+    const uint8_t* p = str;
+    while (p < end) {
+        p = memchr(p, pat[0], (size_t) (end - p));
+        if (p == NULL) {
+            return NULL;
+        }
+        if (p[patlen-1] == pat[patlen-1] && memcmp(p + 1, pat + 1, patlen - 1) == 0) {
+            return p;
+        }
+        p++;
+    }
+    return NULL;
+}
+
+// ASCII letters fold to lowercase, every other byte is left alone
+static inline uint8_t
+_substr_fold(uint8_t c)
+{
+    return (uint8_t) (c | (((uint8_t) (c - 'A') < 26) ? 0x20 : 0));
+}
+
+// compare n bytes of a string with lowercase pattern bytes, ignoring case
+static inline int
+_substr_equal_icase(const uint8_t* str, const uint8_t* pat, size_t n)
+{
+    size_t i;
+    for (i=0; i<n; i++) {
+        if (_substr_fold(str[i]) != pat[i]) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// or-ing 0x20 into a byte folds the case of a letter and of nothing else
+// which could equal a lowercase letter, so a byte is compared with a
+// letter of the pattern after or-ing it with this mask
+static inline uint8_t
+_substr_case_mask(uint8_t c)
+{
+    return ((uint8_t) (c - 'a') < 26) ? 0x20 : 0;
+}
+
+/**
+ * @brief find the first occurrence of pat in str, ignoring ASCII case
+ * @param pat a pattern whose ASCII letters are lowercase
+ */
+const uint8_t*
+roke_substr_scalar_icase(
+    const uint8_t* pat,
+    size_t patlen,
+    const uint8_t* str,
+    size_t len)
+{
+    size_t i;
+    if (patlen == 0) {
+        return str;
+    }
+    if (len < patlen) {
+        return NULL;
+    }
+    uint8_t first = pat[0];
+    uint8_t mask = _substr_case_mask(first);
+    for (i=0; i + patlen <= len; i++) {
+        if ((str[i] | mask) == first && _substr_equal_icase(str + i + 1, pat + 1, patlen - 1)) {
+            return str + i;
+        }
+    }
+    return NULL;
+}
+
+#if defined(ROKE_ARCH_X86)
+// each kernel is written once and instantiated with and without case
+// folding. icase is a constant in every caller, so the folding vanishes
+// from the case sensitive kernels.
+ROKE_TARGET("sse2")
+static inline const uint8_t*
+_substr_sse2_impl(
+    const uint8_t* pat,
+    size_t patlen,
+    const uint8_t* str,
+    size_t len,
+    int icase)
+{
+    if (patlen < 2 || len < patlen) {
+        return (icase) ? roke_substr_scalar_icase(pat, patlen, str, len)
+                       : roke_substr_scalar(pat, patlen, str, len);
+    }
+
+    const __m128i first = _mm_set1_epi8((char) pat[0]);
+    const __m128i last = _mm_set1_epi8((char) pat[patlen-1]);
+    const __m128i first_mask = _mm_set1_epi8((char) ((icase) ? _substr_case_mask(pat[0]) : 0));
+    const __m128i last_mask = _mm_set1_epi8((char) ((icase) ? _substr_case_mask(pat[patlen-1]) : 0));
+    size_t npos = len - patlen + 1;
+    size_t i;
+
+    for (i=0; i<npos; i+=16) {
+        const uint8_t* a = str + i;
+        const uint8_t* b = a + patlen - 1;
+        if (i + patlen - 1 + 16 > len && !(_substr_load_safe(a, 16) && _substr_load_safe(b, 16))) {
+            return (icase) ? roke_substr_scalar_icase(pat, patlen, a, len - i)
+                           : roke_substr_scalar(pat, patlen, a, len - i);
+        }
+        __m128i va = _mm_loadu_si128((const __m128i*) a);
+        __m128i vb = _mm_loadu_si128((const __m128i*) b);
+        if (icase) {
+            va = _mm_or_si128(va, first_mask);
+            vb = _mm_or_si128(vb, last_mask);
+        }
+        __m128i eq = _mm_and_si128(_mm_cmpeq_epi8(first, va), _mm_cmpeq_epi8(last, vb));
+        uint32_t mask = (uint32_t) _mm_movemask_epi8(eq);
+        if (npos - i < 16) {
+            mask &= (1u << (npos - i)) - 1;
+        }
+        while (mask) {
+            uint32_t j = roke_ctz64(mask);
+            if ((icase) ? _substr_equal_icase(a + j + 1, pat + 1, patlen - 2)
+                        : memcmp(a + j + 1, pat + 1, patlen - 2) == 0) {
+                return a + j;
+            }
+            mask &= mask - 1;
+        }
+    }
+    return NULL;
+}
+
+ROKE_TARGET("avx2")
+static inline const uint8_t*
+_substr_avx2_impl(
+    const uint8_t* pat,
+    size_t patlen,
+    const uint8_t* str,
+    size_t len,
+    int icase)
+{
+    if (patlen < 2 || len < patlen) {
+        return (icase) ? roke_substr_scalar_icase(pat, patlen, str, len)
+                       : roke_substr_scalar(pat, patlen, str, len);
+    }
+
+    const __m256i first = _mm256_set1_epi8((char) pat[0]);
+    const __m256i last = _mm256_set1_epi8((char) pat[patlen-1]);
+    const __m256i first_mask = _mm256_set1_epi8((char) ((icase) ? _substr_case_mask(pat[0]) : 0));
+    const __m256i last_mask = _mm256_set1_epi8((char) ((icase) ? _substr_case_mask(pat[patlen-1]) : 0));
+    size_t npos = len - patlen + 1;
+    size_t i;
+
+    for (i=0; i<npos; i+=32) {
+        const uint8_t* a = str + i;
+        const uint8_t* b = a + patlen - 1;
+        if (i + patlen - 1 + 32 > len && !(_substr_load_safe(a, 32) && _substr_load_safe(b, 32))) {
+            return (icase) ? roke_substr_scalar_icase(pat, patlen, a, len - i)
+                           : roke_substr_scalar(pat, patlen, a, len - i);
+        }
+        __m256i va = _mm256_loadu_si256((const __m256i*) a);
+        __m256i vb = _mm256_loadu_si256((const __m256i*) b);
+        if (icase) {
+            va = _mm256_or_si256(va, first_mask);
+            vb = _mm256_or_si256(vb, last_mask);
+        }
+        __m256i eq = _mm256_and_si256(_mm256_cmpeq_epi8(first, va), _mm256_cmpeq_epi8(last, vb));
+        uint32_t mask = (uint32_t) _mm256_movemask_epi8(eq);
+        if (npos - i < 32) {
+            mask &= (1u << (npos - i)) - 1;
+        }
+        while (mask) {
+            uint32_t j = roke_ctz64(mask);
+            if ((icase) ? _substr_equal_icase(a + j + 1, pat + 1, patlen - 2)
+                        : memcmp(a + j + 1, pat + 1, patlen - 2) == 0) {
+                return a + j;
+            }
+            mask &= mask - 1;
+        }
+    }
+    return NULL;
+}
+
+ROKE_TARGET("avx512f,avx512bw")
+static inline const uint8_t*
+_substr_avx512_impl(
+    const uint8_t* pat,
+    size_t patlen,
+    const uint8_t* str,
+    size_t len,
+    int icase)
+{
+    if (patlen < 2 || len < patlen) {
+        return (icase) ? roke_substr_scalar_icase(pat, patlen, str, len)
+                       : roke_substr_scalar(pat, patlen, str, len);
+    }
+
+    const __m512i first = _mm512_set1_epi8((char) pat[0]);
+    const __m512i last = _mm512_set1_epi8((char) pat[patlen-1]);
+    const __m512i first_mask = _mm512_set1_epi8((char) ((icase) ? _substr_case_mask(pat[0]) : 0));
+    const __m512i last_mask = _mm512_set1_epi8((char) ((icase) ? _substr_case_mask(pat[patlen-1]) : 0));
+    size_t npos = len - patlen + 1;
+    size_t i;
+
+    for (i=0; i<npos; i+=64) {
+        const uint8_t* a = str + i;
+        const uint8_t* b = a + patlen - 1;
+        if (i + patlen - 1 + 64 > len && !(_substr_load_safe(a, 64) && _substr_load_safe(b, 64))) {
+            return (icase) ? roke_substr_scalar_icase(pat, patlen, a, len - i)
+                           : roke_substr_scalar(pat, patlen, a, len - i);
+        }
+        __m512i va = _mm512_loadu_si512((const void*) a);
+        __m512i vb = _mm512_loadu_si512((const void*) b);
+        if (icase) {
+            va = _mm512_or_si512(va, first_mask);
+            vb = _mm512_or_si512(vb, last_mask);
+        }
+        uint64_t mask = _mm512_cmpeq_epi8_mask(first, va) & _mm512_cmpeq_epi8_mask(last, vb);
+        if (npos - i < 64) {
+            mask &= (((uint64_t) 1) << (npos - i)) - 1;
+        }
+        while (mask) {
+            uint32_t j = roke_ctz64(mask);
+            if ((icase) ? _substr_equal_icase(a + j + 1, pat + 1, patlen - 2)
+                        : memcmp(a + j + 1, pat + 1, patlen - 2) == 0) {
+                return a + j;
+            }
+            mask &= mask - 1;
+        }
+    }
+    return NULL;
+}
+
+ROKE_TARGET("sse2")
+static const uint8_t*
+_substr_sse2(const uint8_t* pat, size_t patlen, const uint8_t* str, size_t len)
+{
+    return _substr_sse2_impl(pat, patlen, str, len, 0);
+}
+
+ROKE_TARGET("sse2")
+static const uint8_t*
+_substr_sse2_icase(const uint8_t* pat, size_t patlen, const uint8_t* str, size_t len)
+{
+    return _substr_sse2_impl(pat, patlen, str, len, 1);
+}
+
+ROKE_TARGET("avx2")
+static const uint8_t*
+_substr_avx2(const uint8_t* pat, size_t patlen, const uint8_t* str, size_t len)
+{
+    return _substr_avx2_impl(pat, patlen, str, len, 0);
+}
+
+ROKE_TARGET("avx2")
+static const uint8_t*
+_substr_avx2_icase(const uint8_t* pat, size_t patlen, const uint8_t* str, size_t len)
+{
+    return _substr_avx2_impl(pat, patlen, str, len, 1);
+}
+
+ROKE_TARGET("avx512f,avx512bw")
+static const uint8_t*
+_substr_avx512(const uint8_t* pat, size_t patlen, const uint8_t* str, size_t len)
+{
+    return _substr_avx512_impl(pat, patlen, str, len, 0);
+}
+
+ROKE_TARGET("avx512f,avx512bw")
+static const uint8_t*
+_substr_avx512_icase(const uint8_t* pat, size_t patlen, const uint8_t* str, size_t len)
+{
+    return _substr_avx512_impl(pat, patlen, str, len, 1);
+}
+#endif
+
+#if defined(ROKE_ARCH_ARM64)
+static inline const uint8_t*
+_substr_neon_impl(
+    const uint8_t* pat,
+    size_t patlen,
+    const uint8_t* str,
+    size_t len,
+    int icase)
+{
+    if (patlen < 2 || len < patlen) {
+        return (icase) ? roke_substr_scalar_icase(pat, patlen, str, len)
+                       : roke_substr_scalar(pat, patlen, str, len);
+    }
+
+    const uint8x16_t first = vdupq_n_u8(pat[0]);
+    const uint8x16_t last = vdupq_n_u8(pat[patlen-1]);
+    const uint8x16_t first_mask = vdupq_n_u8((icase) ? _substr_case_mask(pat[0]) : 0);
+    const uint8x16_t last_mask = vdupq_n_u8((icase) ? _substr_case_mask(pat[patlen-1]) : 0);
+    size_t npos = len - patlen + 1;
+    size_t i;
+
+    for (i=0; i<npos; i+=16) {
+        const uint8_t* a = str + i;
+        const uint8_t* b = a + patlen - 1;
+        if (i + patlen - 1 + 16 > len && !(_substr_load_safe(a, 16) && _substr_load_safe(b, 16))) {
+            return (icase) ? roke_substr_scalar_icase(pat, patlen, a, len - i)
+                           : roke_substr_scalar(pat, patlen, a, len - i);
+        }
+        uint8x16_t va = vld1q_u8(a);
+        uint8x16_t vb = vld1q_u8(b);
+        if (icase) {
+            va = vorrq_u8(va, first_mask);
+            vb = vorrq_u8(vb, last_mask);
+        }
+        uint8x16_t eq = vandq_u8(vceqq_u8(first, va), vceqq_u8(last, vb));
+        // there is no movemask, narrow every byte to 4 bits of a 64 bit mask
+        uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(
+            vshrn_n_u16(vreinterpretq_u16_u8(eq), 4)), 0);
+        if (npos - i < 16) {
+            mask &= (((uint64_t) 1) << ((npos - i) * 4)) - 1;
+        }
+        while (mask) {
+            uint32_t j = roke_ctz64(mask) >> 2;
+            if ((icase) ? _substr_equal_icase(a + j + 1, pat + 1, patlen - 2)
+                        : memcmp(a + j + 1, pat + 1, patlen - 2) == 0) {
+                return a + j;
+            }
+            mask &= ~(((uint64_t) 0xF) << (j * 4));
+        }
+    }
+    return NULL;
+}
+
+static const uint8_t*
+_substr_neon(const uint8_t* pat, size_t patlen, const uint8_t* str, size_t len)
+{
+    return _substr_neon_impl(pat, patlen, str, len, 0);
+}
+
+static const uint8_t*
+_substr_neon_icase(const uint8_t* pat, size_t patlen, const uint8_t* str, size_t len)
+{
+    return _substr_neon_impl(pat, patlen, str, len, 1);
+}
+#endif
+
+/**
+ * @brief choose the widest kernel supported by this cpu
+ * @param icase select the kernels which ignore ASCII case
+ */
+static roke_substr_fn
+_substr_select(int icase)
+{
+#if defined(ROKE_ARCH_X86)
+    uint32_t features = roke_cpu_features();
+    if (features & ROKE_CPU_AVX512BW) {
+        return (icase) ? _substr_avx512_icase : _substr_avx512;
+    }
+    if (features & ROKE_CPU_AVX2) {
+        return (icase) ? _substr_avx2_icase : _substr_avx2;
+    }
+    if (features & ROKE_CPU_SSE2) {
+        return (icase) ? _substr_sse2_icase : _substr_sse2;
+    }
+#elif defined(ROKE_ARCH_ARM64)
+    if (roke_cpu_features() & ROKE_CPU_NEON) {
+        return (icase) ? _substr_neon_icase : _substr_neon;
+    }
+#endif
+    return (icase) ? roke_substr_scalar_icase : roke_substr_scalar;
+}
+
+/**
+ * @brief compile a literal pattern
+ * @return non-zero on failure
+ */
+int
+roke_substr_init(
+    roke_substr_t* sub,
+    const uint8_t* pat,
+    size_t patlen)
+{
+    sub->pat = malloc(patlen + 1);
+    if (sub->pat == NULL) {
+        sub->patlen = 0;
+        sub->find = roke_substr_scalar;
+        sub->find_icase = roke_substr_scalar_icase;
+        return 1;
+    }
+    memcpy(sub->pat, pat, patlen);
+    sub->pat[patlen] = '\0';
+    sub->patlen = patlen;
+    sub->find = _substr_select(0);
+    sub->find_icase = _substr_select(1);
+    return 0;
+}
+
+void
+roke_substr_free(roke_substr_t* sub)
+{
+    free(sub->pat);
+    sub->pat = NULL;
+    sub->patlen = 0;
+}
@@ -0,0 +1,68 @@
+#ifndef ROKE_COMMON_SUBSTR_H
+#define ROKE_COMMON_SUBSTR_H
+
+/**
+ *
+ * @file roke/common/substr.h
+ * @brief SIMD substring search for short patterns
+ *
+ * Names are short, so the table setup and data dependent shifts of
+ * Boyer-Moore cost more than they save. Instead every candidate position
+ * is tested at once by comparing a block of the string against the first
+ * byte of the pattern, and the block offset by the pattern length against
+ * the last byte. Only positions where both bytes match are compared in
+ * full.
+ *
+ * The kernel is selected when the pattern is compiled, using the widest
+ * instruction set reported by roke_cpu_features.
+ *
+ * Every kernel also has a variant which ignores ASCII case. The bytes of
+ * the string are or-ed with 0x20 wherever the pattern has a letter,
+ * which folds the case of that letter and cannot turn any other byte
+ * into it, so the comparisons stay a single instruction.
+ */
+
+#include "roke/common/compat.h"
+
+typedef const uint8_t* (*roke_substr_fn)(const uint8_t* pat, size_t patlen,
+    const uint8_t* str, size_t len);
+
+/**
+ * @brief a compiled literal pattern
+ */
+typedef struct roke_substr {
+    uint8_t* pat;
+    size_t patlen;
+    roke_substr_fn find;
+    roke_substr_fn find_icase;  // requires the letters of pat to be lowercase
+} roke_substr_t;
+
+ROKE_INTERNAL_API int roke_substr_init(roke_substr_t* sub,
+    const uint8_t* pat, size_t patlen);
+ROKE_INTERNAL_API void roke_substr_free(roke_substr_t* sub);
+ROKE_INTERNAL_API const uint8_t* roke_substr_scalar(const uint8_t* pat,
+    size_t patlen, const uint8_t* str, size_t len);
+ROKE_INTERNAL_API const uint8_t* roke_substr_scalar_icase(const uint8_t* pat,
+    size_t patlen, const uint8_t* str, size_t len);
+
+/**
+ * @brief find the first occurrence of the pattern in a string
+ * @return a pointer to the match, or NULL
+ */
+static inline const uint8_t*
+roke_substr_find(const roke_substr_t* sub, const uint8_t* str, size_t len)
+{
+    return sub->find(sub->pat, sub->patlen, str, len);
+}
+
+/**
+ * @brief find the first occurrence of the pattern, ignoring ASCII case
+ * @return a pointer to the match, or NULL
+ */
+static inline const uint8_t*
+roke_substr_find_icase(const roke_substr_t* sub, const uint8_t* str, size_t len)
+{
+    return sub->find_icase(sub->pat, sub->patlen, str, len);
+}
+
+#endif
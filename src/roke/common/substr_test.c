@@ -0,0 +1,260 @@
+#include "roke/common/argparse.h"
+#include "roke/common/unittest.h"
+#include "roke/common/substr.h"
+#include "roke/common/boyer_moore.h"
+#include "roke/common/cpu.h"
+
+argparse_spec_t spec[] = {
+    {0, 0, 0, "Test the SIMD substring search"},
+    {0, 'v', 0, "verbose"},
+    {"pattern", 'p', 0, "run tests that match the given glob-like pattern."},
+    {0, 0, 0, 0},
+};
+
+// every kernel which may be selected, the widest first
+static uint32_t feature_sets[] = {
+    ROKE_CPU_SSE2|ROKE_CPU_SSSE3|ROKE_CPU_SSE41|ROKE_CPU_AVX2|ROKE_CPU_AVX512BW|ROKE_CPU_NEON,
+    ROKE_CPU_SSE2|ROKE_CPU_SSSE3|ROKE_CPU_SSE41|ROKE_CPU_AVX2,
+    ROKE_CPU_SSE2,
+    0,
+};
+#define NFEATURE_SETS (sizeof(feature_sets) / sizeof(feature_sets[0]))
+
+// compile a pattern using only the features supported by this cpu
+static int
+init_with_features(roke_substr_t* sub, uint32_t features,
+    const uint8_t* pat, size_t patlen)
+{
+    uint32_t supported = roke_cpu_features();
+    roke_cpu_set_features_for_test(supported & features);
+    int err = roke_substr_init(sub, pat, patlen);
+    roke_cpu_set_features_for_test(supported);
+    return err;
+}
+
+#define find(s) roke_substr_find(&sub, (uint8_t*) s, strlen(s))
+
+int
+test_substr_basic(void) {
+    int err = 0;
+    roke_substr_t sub;
+    size_t k;
+
+    for (k=0; k<NFEATURE_SETS; k++) {
+        tassert_zero(init_with_features(&sub, feature_sets[k], (uint8_t*) "abc", 3));
+
+        const char* s = "xxabcxx";
+        tassert_equal(find(s), (const uint8_t*) s + 2);
+        tassert_nonnull(find("abc"));
+        tassert_null(find("ab"));
+        tassert_null(find("abd abd abd abd abd abd abd abd abd abd"));
+        tassert_null(find("ABC"));
+        tassert_null(find(""));
+
+        s = "abd abd abd abd abd abd abd abd abd abd abd abd abd abd abd abc";
+        tassert_equal(find(s), (const uint8_t*) s + strlen(s) - 3);
+
+        roke_substr_free(&sub);
+
+        // empty and single byte patterns
+        tassert_zero(init_with_features(&sub, feature_sets[k], (uint8_t*) "", 0));
+        s = "abc";
+        tassert_equal(find(s), (const uint8_t*) s);
+        roke_substr_free(&sub);
+
+        tassert_zero(init_with_features(&sub, feature_sets[k], (uint8_t*) "c", 1));
+        tassert_equal(find(s), (const uint8_t*) s + 2);
+        tassert_null(find("ab"));
+        roke_substr_free(&sub);
+    }
+
+  end:
+    return err;
+}
+
+/**
+ * compare every kernel with Boyer-Moore on random strings drawn from a
+ * small alphabet, so that partial matches are common
+ */
+int
+test_substr_fuzz(void) {
+    int err = 0;
+    uint8_t str[300];
+    uint8_t pat[40];
+    uint32_t iter;
+    size_t k;
+
+    srand(42);
+
+    for (iter=0; iter<20000; iter++) {
+        uint32_t nalpha = 1 + rand() % 4;
+        size_t len = (size_t) (rand() % 200);
+        size_t patlen = 1 + (size_t) (rand() % 20);
+        size_t i;
+
+        for (i=0; i<len; i++) {
+            str[i] = (uint8_t) ('a' + rand() % nalpha);
+        }
+        str[len] = '\0';
+
+        // take the pattern from the string half of the time
+        if (len >= patlen && rand() % 2) {
+            size_t start = (size_t) rand() % (len - patlen + 1);
+            memcpy(pat, str + start, patlen);
+        } else {
+            for (i=0; i<patlen; i++) {
+                pat[i] = (uint8_t) ('a' + rand() % nalpha);
+            }
+        }
+        pat[patlen] = '\0';
+
+        bmopt_t bmopt;
+        boyer_moore_init(&bmopt, pat, patlen);
+        const uint8_t* expected = boyer_moore_match(&bmopt, str, len);
+        boyer_moore_free(&bmopt);
+
+        for (k=0; k<NFEATURE_SETS; k++) {
+            roke_substr_t sub;
+            tassert_zero(init_with_features(&sub, feature_sets[k], pat, patlen));
+            const uint8_t* actual = roke_substr_find(&sub, str, len);
+            roke_substr_free(&sub);
+            if (actual != expected) {
+                fprintf(stderr, "features=0x%x pattern=%s string=%s\n",
+                    feature_sets[k], pat, str);
+            }
+            tassert_equal(actual, expected);
+        }
+    }
+
+  end:
+    return err;
+}
+
+// the first occurrence of pat in str, folding the case of str one byte
+// at a time
+static const uint8_t*
+naive_find_icase(const uint8_t* pat, size_t patlen, const uint8_t* str, size_t len)
+{
+    size_t i, k;
+    for (i=0; i + patlen <= len; i++) {
+        for (k=0; k<patlen; k++) {
+            uint8_t c = str[i + k];
+            if (c >= 'A' && c <= 'Z') {
+                c = (uint8_t) (c + 32);
+            }
+            if (c != pat[k]) {
+                break;
+            }
+        }
+        if (k == patlen) {
+            return str + i;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * compare every case insensitive kernel with a naive search. the
+ * alphabet has letters of both cases and the bytes which differ from
+ * them only in bit 0x20
+ */
+int
+test_substr_icase_fuzz(void) {
+    int err = 0;
+    const char* alphabet = "aAbB@`[{\xc1\xe1";
+    size_t nalpha = strlen(alphabet);
+    uint8_t str[300];
+    uint8_t pat[40];
+    uint32_t iter;
+    size_t k;
+
+    srand(43);
+
+    for (iter=0; iter<20000; iter++) {
+        size_t len = (size_t) (rand() % 200);
+        size_t patlen = 1 + (size_t) (rand() % 12);
+        size_t i;
+
+        for (i=0; i<len; i++) {
+            str[i] = (uint8_t) alphabet[(size_t) rand() % nalpha];
+        }
+        str[len] = '\0';
+        // patterns are lowercase
+        for (i=0; i<patlen; i++) {
+            uint8_t c = (uint8_t) alphabet[(size_t) rand() % nalpha];
+            pat[i] = (c >= 'A' && c <= 'Z') ? (uint8_t) (c + 32) : c;
+        }
+        pat[patlen] = '\0';
+
+        const uint8_t* expected = naive_find_icase(pat, patlen, str, len);
+        for (k=0; k<NFEATURE_SETS; k++) {
+            roke_substr_t sub;
+            tassert_zero(init_with_features(&sub, feature_sets[k], pat, patlen));
+            const uint8_t* actual = roke_substr_find_icase(&sub, str, len);
+            roke_substr_free(&sub);
+            if (actual != expected) {
+                fprintf(stderr, "features=0x%x pattern=%s string=%s\n",
+                    feature_sets[k], pat, str);
+            }
+            tassert_equal(actual, expected);
+        }
+    }
+
+    // the scalar kernel, which the others fall back to
+    tassert_nonnull(roke_substr_scalar_icase((uint8_t*) "main", 4, (uint8_t*) "libMAIN.c", 9));
+    tassert_null(roke_substr_scalar_icase((uint8_t*) "m@in", 4, (uint8_t*) "M`IN", 4));
+
+  end:
+    return err;
+}
+
+#ifndef _WIN32
+/**
+ * strings which end at the end of a readable page must not be read past
+ */
+int
+test_substr_page_boundary(void) {
+    int err = 0;
+    size_t page = 4096;
+    size_t len, k;
+
+    uint8_t* mem = mmap(NULL, 2 * page, PROT_READ|PROT_WRITE,
+        MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+    tassert_notequal(mem, MAP_FAILED);
+    tassert_zero(mprotect(mem + page, page, PROT_NONE));
+
+    for (len=0; len<130; len++) {
+        uint8_t* str = mem + page - len;
+        memset(str, 'a', len);
+        if (len > 0) {
+            str[len-1] = 'b';
+        }
+        for (k=0; k<NFEATURE_SETS; k++) {
+            roke_substr_t sub;
+            tassert_zero(init_with_features(&sub, feature_sets[k], (uint8_t*) "ab", 2));
+            const uint8_t* r = roke_substr_find(&sub, str, len);
+            roke_substr_free(&sub);
+            tassert_equal(r, (len >= 2) ? str + len - 2 : NULL);
+        }
+    }
+
+  end:
+    munmap(mem, 2 * page);
+    return err;
+}
+#endif
+
+int
+main(int argc, const char *argv[]) {
+
+    begin_test(argc, argv, spec);
+
+    run_test(test_substr_basic);
+    run_test(test_substr_fuzz);
+    run_test(test_substr_icase_fuzz);
+#ifndef _WIN32
+    run_test(test_substr_page_boundary);
+#endif
+
+    end_test();
+}
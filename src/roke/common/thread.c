@@ -0,0 +1,179 @@
+#include "roke/common/thread.h"
+
+/**
+ * @brief the function and argument passed to a new thread
+ */
+typedef struct roke_thread_start {
+    roke_thread_fn fn;
+    void* arg;
+} roke_thread_start_t;
+
+#ifdef _WIN32
+static DWORD WINAPI
+_roke_thread_main(LPVOID param)
+{
+    roke_thread_start_t start = *(roke_thread_start_t*) param;
+    free(param);
+    start.fn(start.arg);
+    return 0;
+}
+#else
+static void*
+_roke_thread_main(void* param)
+{
+    roke_thread_start_t start = *(roke_thread_start_t*) param;
+    free(param);
+    start.fn(start.arg);
+    return NULL;
+}
+#endif
+
+/**
+ * @brief start a thread running fn(arg)
+ * @return non-zero if the thread could not be created
+ */
+int
+roke_thread_create(roke_thread_t* thread, roke_thread_fn fn, void* arg)
+{
+    roke_thread_start_t* start = malloc(sizeof(roke_thread_start_t));
+    if (start == NULL) {
+        return 1;
+    }
+    start->fn = fn;
+    start->arg = arg;
+
+#ifdef _WIN32
+    *thread = CreateThread(NULL, 0, _roke_thread_main, start, 0, NULL);
+    if (*thread == NULL) {
+        free(start);
+        return 1;
+    }
+#else
+    if (pthread_create(thread, NULL, _roke_thread_main, start) != 0) {
+        free(start);
+        return 1;
+    }
+#endif
+    return 0;
+}
+
+int
+roke_thread_join(roke_thread_t* thread)
+{
+#ifdef _WIN32
+    WaitForSingleObject(*thread, INFINITE);
+    CloseHandle(*thread);
+    return 0;
+#else
+    return pthread_join(*thread, NULL);
+#endif
+}
+
+/**
+ * @brief let a thread run to completion without being joined
+ */
+int
+roke_thread_detach(roke_thread_t* thread)
+{
+#ifdef _WIN32
+    return CloseHandle(*thread) == 0;
+#else
+    return pthread_detach(*thread);
+#endif
+}
+
+void
+roke_mutex_init(roke_mutex_t* mutex)
+{
+#ifdef _WIN32
+    InitializeCriticalSection(mutex);
+#else
+    pthread_mutex_init(mutex, NULL);
+#endif
+}
+
+void
+roke_mutex_lock(roke_mutex_t* mutex)
+{
+#ifdef _WIN32
+    EnterCriticalSection(mutex);
+#else
+    pthread_mutex_lock(mutex);
+#endif
+}
+
+void
+roke_mutex_unlock(roke_mutex_t* mutex)
+{
+#ifdef _WIN32
+    LeaveCriticalSection(mutex);
+#else
+    pthread_mutex_unlock(mutex);
+#endif
+}
+
+void
+roke_mutex_destroy(roke_mutex_t* mutex)
+{
+#ifdef _WIN32
+    DeleteCriticalSection(mutex);
+#else
+    pthread_mutex_destroy(mutex);
+#endif
+}
+
+void
+roke_cond_init(roke_cond_t* cond)
+{
+#ifdef _WIN32
+    InitializeConditionVariable(cond);
+#else
+    pthread_cond_init(cond, NULL);
+#endif
+}
+
+void
+roke_cond_wait(roke_cond_t* cond, roke_mutex_t* mutex)
+{
+#ifdef _WIN32
+    SleepConditionVariableCS(cond, mutex, INFINITE);
+#else
+    pthread_cond_wait(cond, mutex);
+#endif
+}
+
+void
+roke_cond_broadcast(roke_cond_t* cond)
+{
+#ifdef _WIN32
+    WakeAllConditionVariable(cond);
+#else
+    pthread_cond_broadcast(cond);
+#endif
+}
+
+void
+roke_cond_destroy(roke_cond_t* cond)
+{
+#ifdef _WIN32
+    (void) cond;
+#else
+    pthread_cond_destroy(cond);
+#endif
+}
+
+/**
+ * @brief the number of processors available to this process
+ */
+uint32_t
+roke_cpu_count(void)
+{
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return (info.dwNumberOfProcessors > 0) ? (uint32_t) info.dwNumberOfProcessors : 1;
+#else
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return (n > 0) ? (uint32_t) n : 1;
+#endif
+}
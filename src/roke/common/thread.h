@@ -0,0 +1,46 @@
+#ifndef ROKE_COMMON_THREAD_H
+#define ROKE_COMMON_THREAD_H
+
+/**
+ *
+ * @file roke/common/thread.h
+ * @brief a minimal portable wrapper around threads
+ *
+ * pthreads on POSIX systems and the native API on windows. Only the
+ * primitives needed by the parallel scan are provided.
+ */
+
+#include "roke/common/compat.h"
+
+#ifdef _WIN32
+    #include <windows.h>
+    typedef HANDLE roke_thread_t;
+    typedef CRITICAL_SECTION roke_mutex_t;
+    typedef CONDITION_VARIABLE roke_cond_t;
+#else
+    #include <pthread.h>
+    typedef pthread_t roke_thread_t;
+    typedef pthread_mutex_t roke_mutex_t;
+    typedef pthread_cond_t roke_cond_t;
+#endif
+
+typedef void (*roke_thread_fn)(void* arg);
+
+ROKE_INTERNAL_API int roke_thread_create(roke_thread_t* thread,
+    roke_thread_fn fn, void* arg);
+ROKE_INTERNAL_API int roke_thread_join(roke_thread_t* thread);
+ROKE_INTERNAL_API int roke_thread_detach(roke_thread_t* thread);
+
+ROKE_INTERNAL_API void roke_mutex_init(roke_mutex_t* mutex);
+ROKE_INTERNAL_API void roke_mutex_lock(roke_mutex_t* mutex);
+ROKE_INTERNAL_API void roke_mutex_unlock(roke_mutex_t* mutex);
+ROKE_INTERNAL_API void roke_mutex_destroy(roke_mutex_t* mutex);
+
+ROKE_INTERNAL_API void roke_cond_init(roke_cond_t* cond);
+ROKE_INTERNAL_API void roke_cond_wait(roke_cond_t* cond, roke_mutex_t* mutex);
+ROKE_INTERNAL_API void roke_cond_broadcast(roke_cond_t* cond);
+ROKE_INTERNAL_API void roke_cond_destroy(roke_cond_t* cond);
+
+ROKE_INTERNAL_API uint32_t roke_cpu_count(void);
+
+#endif
@@ -0,0 +1,166 @@
+#include "roke/common/topk.h"
+
+/**
+ * @brief non-zero if a ranks below b
+ */
+static inline int
+_topk_worse(const roke_ranked_t* a, const roke_ranked_t* b)
+{
+    if (a->score != b->score) {
+        return a->score < b->score;
+    }
+    return a->order > b->order;
+}
+
+static void
+_topk_sift_up(roke_ranked_t* items, uint32_t i)
+{
+    roke_ranked_t item = items[i];
+    while (i > 0) {
+        uint32_t parent = (i - 1) / 2;
+        if (!_topk_worse(&item, &items[parent])) {
+            break;
+        }
+        items[i] = items[parent];
+        i = parent;
+    }
+    items[i] = item;
+}
+
+static void
+_topk_sift_down(roke_ranked_t* items, uint32_t size, uint32_t i)
+{
+    roke_ranked_t item = items[i];
+    while (2 * i + 1 < size) {
+        uint32_t child = 2 * i + 1;
+        if (child + 1 < size && _topk_worse(&items[child + 1], &items[child])) {
+            child++;
+        }
+        if (!_topk_worse(&items[child], &item)) {
+            break;
+        }
+        items[i] = items[child];
+        i = child;
+    }
+    items[i] = item;
+}
+
+void
+roke_topk_init(roke_topk_t* topk, uint32_t k)
+{
+    memset(topk, 0, sizeof(roke_topk_t));
+    topk->k = k;
+}
+
+void
+roke_topk_free(roke_topk_t* topk)
+{
+    uint32_t i;
+    for (i=0; i<topk->size; i++) {
+        free(topk->items[i].path);
+    }
+    free(topk->items);
+    topk->items = NULL;
+    topk->size = 0;
+    topk->capacity = 0;
+}
+
+/**
+ * @brief test if a result would be kept, before doing the work to push it
+ */
+int
+roke_topk_accepts(const roke_topk_t* topk, int64_t score, uint64_t order)
+{
+    roke_ranked_t item = {score, order, NULL};
+    if (topk->k == 0 || topk->size < topk->k) {
+        return 1;
+    }
+    return _topk_worse(&topk->items[0], &item);
+}
+
+/**
+ * @brief offer a result to the heap
+ * @param path owned by the heap from now on, freed if the result is
+ *             rejected or later displaced. may be NULL
+ * @return non-zero on failure
+ */
+int
+roke_topk_push(roke_topk_t* topk, int64_t score, uint64_t order, uint8_t* path)
+{
+    roke_ranked_t item = {score, order, path};
+
+    if (topk->k > 0 && topk->size == topk->k) {
+        if (!_topk_worse(&topk->items[0], &item)) {
+            free(path);
+            return 0;
+        }
+        free(topk->items[0].path);
+        topk->items[0] = item;
+        _topk_sift_down(topk->items, topk->size, 0);
+        return 0;
+    }
+
+    if (topk->size == topk->capacity) {
+        uint32_t n = (topk->capacity) ? 2 * topk->capacity : 16;
+        if (topk->k > 0 && n > topk->k) {
+            n = topk->k;
+        }
+        roke_ranked_t* tmp = realloc(topk->items, n * sizeof(roke_ranked_t));
+        if (tmp == NULL) {
+            free(path);
+            return 1;
+        }
+        topk->items = tmp;
+        topk->capacity = n;
+    }
+    topk->items[topk->size] = item;
+    _topk_sift_up(topk->items, topk->size);
+    topk->size++;
+    return 0;
+}
+
+/**
+ * @brief move every result of src into dst
+ *
+ * src is left empty, and may be reused or freed.
+ */
+int
+roke_topk_merge(roke_topk_t* dst, roke_topk_t* src)
+{
+    int err = 0;
+    uint32_t i;
+    for (i=0; i<src->size; i++) {
+        roke_ranked_t* item = &src->items[i];
+        if (!err) {
+            err = roke_topk_push(dst, item->score, item->order, item->path);
+        } else {
+            free(item->path);
+        }
+    }
+    src->size = 0;
+    return err;
+}
+
+static int
+_topk_cmp(const void* a, const void* b)
+{
+    const roke_ranked_t* x = (const roke_ranked_t*) a;
+    const roke_ranked_t* y = (const roke_ranked_t*) b;
+    if (_topk_worse(y, x)) {
+        return -1;
+    }
+    return _topk_worse(x, y) ? 1 : 0;
+}
+
+/**
+ * @brief sort the results best first
+ *
+ * the items are no longer a heap, nothing may be pushed afterwards.
+ */
+void
+roke_topk_sort(roke_topk_t* topk)
+{
+    if (topk->size > 1) {
+        qsort(topk->items, topk->size, sizeof(roke_ranked_t), _topk_cmp);
+    }
+}
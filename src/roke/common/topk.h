@@ -0,0 +1,46 @@
+#ifndef ROKE_COMMON_TOPK_H
+#define ROKE_COMMON_TOPK_H
+
+/**
+ *
+ * @file roke/common/topk.h
+ * @brief the k best results of a ranked search
+ *
+ * Results are kept in a min heap, so that the worst result kept is at the
+ * root and a candidate which does not beat it is rejected in one
+ * comparison. Keeping k results from n candidates is O(n log k).
+ *
+ * A result is ranked by its score, higher first, and ties are broken by
+ * its order, lower first. Orders are unique, so the results are the same
+ * whichever order they are pushed in, and heaps filled by separate
+ * threads merge into the same k results as a single heap.
+ *
+ * A result may carry a path. Candidates are usually pushed without one,
+ * and the path is built only for the results which are left at the end.
+ */
+
+#include "roke/common/compat.h"
+
+typedef struct roke_ranked {
+    int64_t score;      // higher is better
+    uint64_t order;     // breaks ties, lower is better
+    uint8_t* path;      // owned by the heap, may be NULL
+} roke_ranked_t;
+
+typedef struct roke_topk {
+    roke_ranked_t* items;
+    uint32_t size;
+    uint32_t capacity;
+    uint32_t k;         // the number of results kept, zero to keep every result
+} roke_topk_t;
+
+ROKE_INTERNAL_API void roke_topk_init(roke_topk_t* topk, uint32_t k);
+ROKE_INTERNAL_API void roke_topk_free(roke_topk_t* topk);
+ROKE_INTERNAL_API int roke_topk_accepts(const roke_topk_t* topk,
+    int64_t score, uint64_t order);
+ROKE_INTERNAL_API int roke_topk_push(roke_topk_t* topk,
+    int64_t score, uint64_t order, uint8_t* path);
+ROKE_INTERNAL_API int roke_topk_merge(roke_topk_t* dst, roke_topk_t* src);
+ROKE_INTERNAL_API void roke_topk_sort(roke_topk_t* topk);
+
+#endif
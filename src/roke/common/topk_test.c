@@ -0,0 +1,120 @@
+#include "roke/common/argparse.h"
+#include "roke/common/unittest.h"
+#include "roke/common/topk.h"
+
+argparse_spec_t spec[] = {
+    {0, 0, 0, "Test the top-k heap"},
+    {0, 'v', 0, "verbose"},
+    {"pattern", 'p', 0, "run tests that match the given glob-like pattern."},
+    {0, 0, 0, 0},
+};
+
+static uint8_t*
+path_of(uint64_t order)
+{
+    char tmp[32];
+    snprintf(tmp, sizeof(tmp), "%" PRIu64, order);
+    uint8_t* path = malloc(strlen(tmp) + 1);
+    memcpy(path, tmp, strlen(tmp) + 1);
+    return path;
+}
+
+int
+test_topk_basic(void) {
+    int err = 0;
+    roke_topk_t topk;
+    const int64_t scores[] = {5, 1, 9, 7, 3, 9, 2, 8};
+    uint64_t i;
+
+    roke_topk_init(&topk, 3);
+    for (i=0; i<8; i++) {
+        tassert_zero(roke_topk_push(&topk, scores[i], i, path_of(i)));
+    }
+    tassert_equal(topk.size, 3);
+    tassert_false(roke_topk_accepts(&topk, 8, 100));
+    tassert_true(roke_topk_accepts(&topk, 8, 0));
+
+    roke_topk_sort(&topk);
+    // the two 9s tie, the lower order is first
+    tassert_equal(topk.items[0].score, 9);
+    tassert_equal(topk.items[0].order, 2);
+    tassert_str_equal((char*) topk.items[0].path, "2");
+    tassert_equal(topk.items[1].order, 5);
+    tassert_equal(topk.items[2].score, 8);
+    tassert_str_equal((char*) topk.items[2].path, "7");
+
+    roke_topk_free(&topk);
+
+    // zero keeps everything
+    roke_topk_init(&topk, 0);
+    for (i=0; i<100; i++) {
+        tassert_zero(roke_topk_push(&topk, (int64_t) (i % 7), i, NULL));
+    }
+    tassert_equal(topk.size, 100);
+    roke_topk_sort(&topk);
+    for (i=1; i<100; i++) {
+        tassert_true(topk.items[i-1].score > topk.items[i].score ||
+            (topk.items[i-1].score == topk.items[i].score &&
+             topk.items[i-1].order < topk.items[i].order));
+    }
+    roke_topk_free(&topk);
+
+  end:
+    return err;
+}
+
+/**
+ * heaps filled from parts of the input merge into the same results as a
+ * single heap
+ */
+int
+test_topk_merge(void) {
+    int err = 0;
+    roke_topk_t all, merged, parts[4];
+    uint32_t i, k = 10;
+
+    srand(3);
+    roke_topk_init(&all, k);
+    roke_topk_init(&merged, k);
+    for (i=0; i<4; i++) {
+        roke_topk_init(&parts[i], k);
+    }
+
+    for (i=0; i<1000; i++) {
+        int64_t score = rand() % 50;
+        tassert_zero(roke_topk_push(&all, score, i, path_of(i)));
+        tassert_zero(roke_topk_push(&parts[i % 4], score, i, path_of(i)));
+    }
+    for (i=0; i<4; i++) {
+        tassert_zero(roke_topk_merge(&merged, &parts[i]));
+        tassert_equal(parts[i].size, 0);
+    }
+
+    roke_topk_sort(&all);
+    roke_topk_sort(&merged);
+    tassert_equal(merged.size, k);
+    for (i=0; i<k; i++) {
+        tassert_equal(merged.items[i].score, all.items[i].score);
+        tassert_equal(merged.items[i].order, all.items[i].order);
+        tassert_str_equal((char*) merged.items[i].path, (char*) all.items[i].path);
+    }
+
+  end:
+    roke_topk_free(&all);
+    roke_topk_free(&merged);
+    for (i=0; i<4; i++) {
+        roke_topk_free(&parts[i]);
+    }
+    return err;
+}
+
+int
+main(int argc, const char *argv[]) {
+
+    begin_test(argc, argv, spec);
+
+    run_test(test_topk_basic);
+    run_test(test_topk_merge);
+
+    end_test();
+}
@@ -20,6 +20,7 @@ ROKE_INTERNAL_API extern int verbose_logging;
 
 #define begin_test(_argc, _argv, _spec)                                        \
     int error           = 0;                                                   \
+    int failed          = 0;                                                   \
     argparser_t *argparse = newArgParse(_argc, _argv, _spec);                  \
     verbose_logging = argparser_get_flag(argparse, 'v');                       \
     tprintf("Test %s begin.\n", _argv[0]);
@@ -37,8 +38,24 @@ ROKE_INTERNAL_API extern int verbose_logging;
         tprintf("%s", "\n *** skipping " #test "\n");                          \
     }
 
+// run a test, recording a failure without stopping the tests after it
+#define run_test_continue(test, ...)                                           \
+    if (!argparser_has_kwarg(argparse, "pattern") ||                           \
+        strglob((uint8_t*)argparser_get_kwarg(argparse, "pattern"),            \
+                (uint8_t*) #test)==0) {                                        \
+        tprintf("%s", "\n *** running " #test "\n");                           \
+        if ((error = test(__VA_ARGS__)) != 0) {                                \
+            fprintf(stderr, "%s", "\n *** Test " #test " failed.\n");          \
+            failed = error;                                                    \
+            error = 0;                                                         \
+        }                                                                      \
+    } else {                                                                   \
+        tprintf("%s", "\n *** skipping " #test "\n");                          \
+    }
+
 #define end_test(...)                                                          \
     end:                                                                       \
+    if (error == 0) { error = failed; }                                        \
     argparser_delete(&argparse);                                               \
     if (error || verbose_logging) { fprintf(stderr, "\n"); }                   \
     fprintf(stderr, "Test %s exited with status %d\n", argv[0], error);        \
@@ -12,11 +12,14 @@ the strings can be indexed by
 */
 
 #include "roke/libroke_internal.h"
-
-#define ROKE_INDEX_SIZE 1
-
-#ifndef ROKE_INDEX_SIZE
-    #define ROKE_INDEX_SIZE 0
+#include "roke/common/cpu.h"
+#include "roke/common/thread.h"
+
+#ifndef _WIN32
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
 #endif
 
 #ifdef _DIRENT_HAVE_D_TYPE
@@ -25,6 +28,21 @@ the strings can be indexed by
 
 #endif
 
+/**
+ * @brief fold a pattern the way names are folded before they are matched
+ * @param dst a buffer of ROKE_PATH_MAX bytes
+ * @param str a null terminated pattern
+ * @return the length of the folded pattern
+ */
+static size_t
+_string_matcher_fold(int flags, uint8_t* dst, const uint8_t* str, size_t len)
+{
+    if (flags&ROKE_NORMALIZE) {
+        return tonormalized(dst, ROKE_PATH_MAX, str, len);
+    }
+    return tolowercase(dst, ROKE_PATH_MAX, str);
+}
+
 int
 string_matcher_init(
     string_matcher_t* matcher,
@@ -33,82 +51,632 @@ string_matcher_init(
     int flags)
 {
     int err = 0;
-    matcher->flags = flags;
+    if (flags&ROKE_FUZZY) {
+        // fuzzy patterns are matched against names as they are stored
+        flags &= ~ROKE_NORMALIZE;
+    }
+    matcher->flags = flags & ~ROKE_MATCH_MULTI;
+    matcher->npatterns = 1;
     const uint8_t* tmp = NULL;
 
     matcher->scratch = malloc(sizeof(uint8_t) * ROKE_PATH_MAX);
     if (!matcher->scratch)
         return 1;
 
+    matcher->pattern = malloc(patlen + 1);
+    if (!matcher->pattern) {
+        free(matcher->scratch);
+        matcher->scratch = NULL;
+        return 1;
+    }
+    memcpy(matcher->pattern, pattern, patlen);
+    matcher->pattern[patlen] = '\0';
+    matcher->patlen = patlen;
+
+    if (flags&ROKE_QUERY) {
+        return roke_query_compile(&matcher->data.query, pattern, patlen, flags);
+    }
+
     switch (flags&ROKE_MATCH_MASK) {
         case ROKE_GLOB:
             tmp = pattern;
-            if (flags&ROKE_CASE_INSENSITIVE) {
-                patlen = tolowercase(matcher->scratch, ROKE_PATH_MAX, pattern);
+            if (flags&(ROKE_CASE_INSENSITIVE|ROKE_NORMALIZE)) {
+                patlen = _string_matcher_fold(flags, matcher->scratch,
+                    matcher->pattern, patlen);
                 tmp = matcher->scratch;
             }
 
-            matcher->data.glob_pattern = strdup_safe(tmp);
+            err = roke_glob_init(&matcher->data.glob, tmp, patlen);
             break;
         case ROKE_REGEX:
+            // like with ROKE_CASE_INSENSITIVE, the expression is matched
+            // against the folded name as it is written
             err = regex_compile(&matcher->data.regex, pattern, patlen);
             break;
-        default:
+        case ROKE_FUZZY:
+            // smart case, so ROKE_CASE_INSENSITIVE only has to lower the pattern
             tmp = pattern;
             if (flags&ROKE_CASE_INSENSITIVE) {
-                patlen = tolowercase(matcher->scratch, ROKE_PATH_MAX, pattern);
+                patlen = _string_matcher_fold(flags, matcher->scratch,
+                    matcher->pattern, patlen);
                 tmp = matcher->scratch;
             }
-            err = boyer_moore_init(&matcher->data.bmopt, tmp, patlen);
+            err = roke_fuzzy_init(&matcher->data.fuzzy, tmp, patlen);
+            break;
+        default:
+            tmp = pattern;
+            if (flags&(ROKE_CASE_INSENSITIVE|ROKE_NORMALIZE)) {
+                patlen = _string_matcher_fold(flags, matcher->scratch,
+                    matcher->pattern, patlen);
+                tmp = matcher->scratch;
+            }
+            err = roke_substr_init(&matcher->data.substr, tmp, patlen);
+            matcher->ascii_pattern = is_ascii(tmp, patlen);
             break;
 
     }
     return err;
 }
 
+/**
+ * @brief initialize a matcher for several patterns
+ * @param flags ROKE_MATCH_ANY or ROKE_MATCH_ALL, and the kind of pattern
+ *
+ * a name matches if it contains any (or all) of the patterns. literal
+ * patterns are compiled into a single Aho-Corasick automaton, so every
+ * name is read once however many patterns there are. globs and regular
+ * expressions are matched one at a time.
+ */
+int
+string_matcher_init_multi(
+    string_matcher_t* matcher,
+    const uint8_t** patterns,
+    const size_t* lens,
+    uint32_t npatterns,
+    int flags)
+{
+    const uint8_t** folded = NULL;
+    size_t* folded_lens = NULL;
+    size_t total = 0;
+    uint32_t i, nfolded = 0;
+
+    memset(matcher, 0, sizeof(string_matcher_t));
+    matcher->flags = (flags&ROKE_MATCH_MULTI) ? flags : (flags|ROKE_MATCH_ANY);
+
+    for (i=0; i<npatterns; i++) {
+        total += lens[i] + 1;
+    }
+    matcher->scratch = malloc(sizeof(uint8_t) * ROKE_PATH_MAX);
+    matcher->pattern = malloc(total + 1);
+    if (!matcher->scratch || !matcher->pattern) {
+        goto error;
+    }
+    for (i=0, total=0; i<npatterns; i++) {
+        memcpy(matcher->pattern + total, patterns[i], lens[i]);
+        matcher->pattern[total + lens[i]] = '\0';
+        total += lens[i] + 1;
+    }
+    matcher->patlen = total;
+
+    if ((flags&ROKE_MATCH_MASK) == 0) {
+        matcher->data.multi.ac = calloc(1, sizeof(roke_ac_t));
+        matcher->data.multi.seen = calloc((npatterns + 63) / 64 + 1, sizeof(uint64_t));
+        folded = calloc(npatterns + 1, sizeof(uint8_t*));
+        folded_lens = calloc(npatterns + 1, sizeof(size_t));
+        if (!matcher->data.multi.ac || !matcher->data.multi.seen ||
+            !folded || !folded_lens) {
+            goto error;
+        }
+
+        const uint8_t* p = matcher->pattern;
+        for (i=0; i<npatterns; i++) {
+            folded[i] = p;
+            folded_lens[i] = lens[i];
+            if (flags&(ROKE_CASE_INSENSITIVE|ROKE_NORMALIZE)) {
+                uint8_t* lower = malloc(ROKE_PATH_MAX);
+                if (lower == NULL) {
+                    goto error;
+                }
+                folded_lens[i] = _string_matcher_fold(flags, lower, p, lens[i]);
+                folded[i] = lower;
+                nfolded++;
+            }
+            p += lens[i] + 1;
+        }
+
+        if (roke_ac_init(matcher->data.multi.ac, folded, folded_lens, npatterns)!=0) {
+            free(matcher->data.multi.ac);
+            matcher->data.multi.ac = NULL;
+            goto error;
+        }
+    } else {
+        matcher->data.multi.subs = calloc(npatterns + 1, sizeof(string_matcher_t));
+        if (!matcher->data.multi.subs) {
+            goto error;
+        }
+        for (i=0; i<npatterns; i++) {
+            if (string_matcher_init(&matcher->data.multi.subs[i],
+                    patterns[i], lens[i], flags&~ROKE_MATCH_MULTI)!=0) {
+                while (i-- > 0) {
+                    string_matcher_free(&matcher->data.multi.subs[i]);
+                }
+                goto error;
+            }
+        }
+    }
+    matcher->npatterns = npatterns;
+
+    while (nfolded-- > 0) {
+        free((uint8_t*) folded[nfolded]);
+    }
+    free(folded);
+    free(folded_lens);
+    return 0;
+
+  error:
+    while (nfolded-- > 0) {
+        free((uint8_t*) folded[nfolded]);
+    }
+    free(folded);
+    free(folded_lens);
+    matcher->npatterns = 0;
+    string_matcher_free(matcher);
+    return 1;
+}
+
+/**
+ * @brief match a case insensitive literal pattern
+ *
+ * the ASCII letters of a name are folded in the SIMD kernel. only names
+ * with bytes above 0x7F, which Unicode folding could change, are folded
+ * with utf8proc. an ASCII match in the name is a match in the folded name
+ * too, so those names are only folded when the kernel finds nothing.
+ */
+static int
+_string_matcher_match_icase(
+    string_matcher_t* matcher,
+    const uint8_t* str,
+    size_t len)
+{
+    const roke_substr_t* sub = &matcher->data.substr;
+
+    if (matcher->ascii_pattern) {
+        if (roke_substr_find_icase(sub, str, len) != NULL) {
+            return 0;
+        }
+        if (is_ascii(str, len)) {
+            return 1;
+        }
+    } else if (is_ascii(str, len)) {
+        // the pattern folds to a character which no ASCII name contains
+        return 1;
+    }
+
+    len = tolowercase(matcher->scratch, ROKE_PATH_MAX, str);
+    return (roke_substr_find(sub, matcher->scratch, len) != NULL) ? 0 : 1;
+}
+
+/**
+ * @brief match a name against every pattern of a multi-pattern matcher
+ * @param folded non-zero if the name is already folded
+ */
+static int
+_string_matcher_match_multi(
+    string_matcher_t* matcher,
+    const uint8_t* str,
+    size_t len,
+    int folded)
+{
+    int all = matcher->flags&ROKE_MATCH_ALL;
+    uint32_t i;
+
+    if (matcher->data.multi.ac != NULL) {
+        const roke_ac_t* ac = matcher->data.multi.ac;
+        if (!folded && matcher->flags&ROKE_CASE_INSENSITIVE) {
+            len = tolowercase(matcher->scratch, ROKE_PATH_MAX, str);
+            str = matcher->scratch;
+        }
+        if (all) {
+            return roke_ac_match_all(ac, str, len,
+                matcher->data.multi.seen) == ac->npatterns ? 0 : 1;
+        }
+        return roke_ac_match_any(ac, str, len) ? 0 : 1;
+    }
+
+    for (i=0; i<matcher->npatterns; i++) {
+        string_matcher_t* sub = &matcher->data.multi.subs[i];
+        int m = ((folded) ? string_matcher_match_folded(sub, str, len) :
+            string_matcher_match(sub, str, len))==0;
+        if (m != (all==0)) {
+            continue;
+        }
+        // the first failure decides ALL, the first match decides ANY
+        return (all) ? 1 : 0;
+    }
+    return (all) ? 0 : 1;
+}
+
 int
 string_matcher_match(
     string_matcher_t* matcher,
     const uint8_t* str,
     size_t len)
 {
-    int err = 0;
-    const uint8_t* s = str;
+    if (matcher->flags&ROKE_QUERY) {
+        // only the name pattern of a query can be tested without an index
+        const string_matcher_t* pre = matcher->data.query->prefilter;
+        return (pre) ? string_matcher_match((string_matcher_t*) pre, str, len) : 0;
+    }
+    if (matcher->flags&ROKE_NORMALIZE) {
+        len = tonormalized(matcher->scratch, ROKE_PATH_MAX, str, len);
+        return string_matcher_match_folded(matcher, matcher->scratch, len);
+    }
+    if (matcher->flags&ROKE_MATCH_MULTI) {
+        return _string_matcher_match_multi(matcher, str, len, 0);
+    }
+    if ((matcher->flags&(ROKE_MATCH_MASK|ROKE_CASE_INSENSITIVE)) == ROKE_CASE_INSENSITIVE) {
+        return _string_matcher_match_icase(matcher, str, len);
+    }
     if (matcher->flags&ROKE_CASE_INSENSITIVE) {
         len = tolowercase(matcher->scratch, ROKE_PATH_MAX, str);
-        s = matcher->scratch;
+        str = matcher->scratch;
+    }
+    return string_matcher_match_folded(matcher, str, len);
+}
+
+/**
+ * @brief match a name which is already folded the way the matcher folds
+ *        names, for example a normalized name stored in an index
+ */
+int
+string_matcher_match_folded(
+    string_matcher_t* matcher,
+    const uint8_t* str,
+    size_t len)
+{
+    int err = 0;
+    if (matcher->flags&ROKE_QUERY) {
+        const string_matcher_t* pre = matcher->data.query->prefilter;
+        return (pre) ? string_matcher_match_folded((string_matcher_t*) pre, str, len) : 0;
+    }
+    if (matcher->flags&ROKE_MATCH_MULTI) {
+        return _string_matcher_match_multi(matcher, str, len, 1);
     }
 
     switch ((matcher->flags)&ROKE_MATCH_MASK) {
         case ROKE_GLOB:
-            err = strglob(matcher->data.glob_pattern, s);
+            err = roke_glob_match(&matcher->data.glob, str, len);
             break;
         case ROKE_REGEX:
-            err = regex_match(&matcher->data.regex, s, len);
+            err = regex_match(&matcher->data.regex, str, len);
+            break;
+        case ROKE_FUZZY:
+            err = roke_fuzzy_match(&matcher->data.fuzzy, str, len);
             break;
         default:
-            err = (boyer_moore_match(&matcher->data.bmopt,
-                                     s, len)!=NULL)?0:1;
+            err = (roke_substr_find(&matcher->data.substr,
+                                    str, len)!=NULL)?0:1;
             break;
 
     }
     return err;
 }
 
+/**
+ * @brief match the names of a block of entries
+ * @param strings the address which entry offsets are relative to
+ * @param size    the number of bytes at strings. names which do not fit
+ *                are never matched
+ * @param entries the first entry of the block
+ * @param n       the number of entries in the block
+ * @param bitmap  (n + 63) / 64 words, bit i is set if entry i matches
+ * @return the number of matching entries
+ *
+ * the kind of pattern is resolved once per block instead of once per name,
+ * so that a literal pattern is a tight loop over the substring kernel.
+ */
+uint32_t
+string_matcher_match_block(
+    string_matcher_t* matcher,
+    const uint8_t* strings,
+    size_t size,
+    const roke_entry_t* entries,
+    uint32_t n,
+    uint64_t* bitmap)
+{
+    uint32_t i;
+    uint32_t nmatch = 0;
+
+    if (matcher->flags&ROKE_QUERY) {
+        // every entry is a candidate unless the query requires a name pattern
+        string_matcher_t* pre = matcher->data.query->prefilter;
+        if (pre != NULL) {
+            return string_matcher_match_block(pre, strings, size, entries, n, bitmap);
+        }
+        memset(bitmap, 0, sizeof(uint64_t) * ((n + 63) / 64));
+        for (i=0; i<n; i++) {
+            if ((uint64_t) entries[i].offset + entries[i].namelen < size) {
+                bitmap[i >> 6] |= ((uint64_t) 1) << (i & 63);
+                nmatch++;
+            }
+        }
+        return nmatch;
+    }
+
+    memset(bitmap, 0, sizeof(uint64_t) * ((n + 63) / 64));
+
+    if ((matcher->flags&(ROKE_MATCH_MASK|ROKE_CASE_INSENSITIVE|ROKE_NORMALIZE|ROKE_MATCH_MULTI)) == ROKE_MATCH_ANY) {
+        const roke_ac_t* ac = matcher->data.multi.ac;
+        for (i=0; i<n; i++) {
+            const roke_entry_t* ent = &entries[i];
+            if ((uint64_t) ent->offset + ent->namelen >= size) {
+                continue;
+            }
+            uint64_t m = roke_ac_match_any(ac, strings + ent->offset, ent->namelen) != 0;
+            bitmap[i >> 6] |= m << (i & 63);
+            nmatch += (uint32_t) m;
+        }
+        return nmatch;
+    }
+
+    if ((matcher->flags&(ROKE_MATCH_MASK|ROKE_CASE_INSENSITIVE|ROKE_NORMALIZE|ROKE_MATCH_MULTI)) == 0) {
+        const roke_substr_t* sub = &matcher->data.substr;
+        roke_substr_fn find = sub->find;
+        for (i=0; i<n; i++) {
+            const roke_entry_t* ent = &entries[i];
+            if ((uint64_t) ent->offset + ent->namelen >= size) {
+                continue;
+            }
+            uint64_t m = find(sub->pat, sub->patlen,
+                strings + ent->offset, ent->namelen) != NULL;
+            bitmap[i >> 6] |= m << (i & 63);
+            nmatch += (uint32_t) m;
+        }
+        return nmatch;
+    }
+
+    for (i=0; i<n; i++) {
+        const roke_entry_t* ent = &entries[i];
+        if ((uint64_t) ent->offset + ent->namelen >= size) {
+            continue;
+        }
+        if (string_matcher_match(matcher, strings + ent->offset, ent->namelen)==0) {
+            bitmap[i >> 6] |= ((uint64_t) 1) << (i & 63);
+            nmatch++;
+        }
+    }
+    return nmatch;
+}
+
+/**
+ * @brief match the normalized names of a block of entries
+ * @param idx    an index with normalized names
+ * @param begin  the first entry of the block
+ * @param n      the number of entries in the block
+ * @param bitmap (n + 63) / 64 words, bit i is set if entry begin + i matches
+ * @return the number of matching entries
+ *
+ * the names are folded when the index is built, so a ROKE_NORMALIZE
+ * matcher compares them as they are stored, without decompressing or
+ * folding any name.
+ */
+uint32_t
+string_matcher_match_norm_block(
+    string_matcher_t* matcher,
+    const roke_index_t* idx,
+    uint32_t begin,
+    uint32_t n,
+    uint64_t* bitmap)
+{
+    const uint32_t* offsets = idx->norm + begin;
+    const uint8_t* names = idx->norm_names;
+    uint64_t size = idx->norm_size;
+    uint32_t i;
+    uint32_t nmatch = 0;
+
+    if (matcher->flags&ROKE_QUERY) {
+        string_matcher_t* pre = matcher->data.query->prefilter;
+        if (pre != NULL) {
+            return string_matcher_match_norm_block(pre, idx, begin, n, bitmap);
+        }
+    }
+
+    memset(bitmap, 0, sizeof(uint64_t) * ((n + 63) / 64));
+
+    if ((matcher->flags&(ROKE_MATCH_MASK|ROKE_MATCH_MULTI|ROKE_QUERY)) == 0) {
+        const roke_substr_t* sub = &matcher->data.substr;
+        roke_substr_fn find = sub->find;
+        for (i=0; i<n; i++) {
+            if (offsets[i + 1] <= offsets[i] || offsets[i + 1] > size) {
+                continue;
+            }
+            uint64_t m = find(sub->pat, sub->patlen, names + offsets[i],
+                offsets[i + 1] - offsets[i] - 1) != NULL;
+            bitmap[i >> 6] |= m << (i & 63);
+            nmatch += (uint32_t) m;
+        }
+        return nmatch;
+    }
+
+    for (i=0; i<n; i++) {
+        if (offsets[i + 1] <= offsets[i] || offsets[i + 1] > size) {
+            continue;
+        }
+        if (string_matcher_match_folded(matcher, names + offsets[i],
+                offsets[i + 1] - offsets[i] - 1)==0) {
+            bitmap[i >> 6] |= ((uint64_t) 1) << (i & 63);
+            nmatch++;
+        }
+    }
+    return nmatch;
+}
+
+/**
+ * @brief test if the matcher could match any name in an index
+ * @param bloom the trigram sketch of the index
+ * @return zero if no name in the index can match, non-zero otherwise
+ *
+ * literal patterns are tested directly. glob patterns are split on
+ * wildcards and every literal run is tested. regular expressions test
+ * the literal fragments which every match contains. a multi-pattern matcher tests each pattern,
+ * and needs any (or all) of them to pass. fuzzy patterns always pass.
+ *
+ * with ROKE_NORMALIZE every trigram of the folded pattern is tested, which
+ * requires a sketch which contains the trigrams of the normalized names.
+ */
+int
+string_matcher_sketch_test(
+    string_matcher_t* matcher,
+    const roke_bloom_t* bloom)
+{
+    int fold = matcher->flags&(ROKE_CASE_INSENSITIVE|ROKE_NORMALIZE);
+    int ascii_only = (matcher->flags&ROKE_NORMALIZE) ? 0 :
+        matcher->flags&ROKE_CASE_INSENSITIVE;
+    const uint8_t* p;
+    size_t n = 0;
+    uint32_t i;
+
+    if (matcher->flags&ROKE_QUERY) {
+        string_matcher_t* pre = matcher->data.query->prefilter;
+        return (pre) ? string_matcher_sketch_test(pre, bloom) : 1;
+    }
+
+    if (matcher->flags&ROKE_MATCH_MULTI) {
+        int all = matcher->flags&ROKE_MATCH_ALL;
+        p = matcher->pattern;
+        for (i=0; i<matcher->npatterns; i++) {
+            int m;
+            if (matcher->data.multi.ac != NULL) {
+                n = strlen((const char*) p);
+                const uint8_t* pat = p;
+                if (fold) {
+                    n = _string_matcher_fold(matcher->flags, matcher->scratch, p, n);
+                    pat = matcher->scratch;
+                }
+                m = roke_bloom_test_trigrams(bloom, pat, n, ascii_only);
+            } else {
+                m = string_matcher_sketch_test(&matcher->data.multi.subs[i], bloom);
+            }
+            if (m != (all!=0)) {
+                return m;
+            }
+            p += strlen((const char*) p) + 1;
+        }
+        return (all) ? 1 : 0;
+    }
+
+    switch ((matcher->flags)&ROKE_MATCH_MASK) {
+        case ROKE_GLOB:
+            for (p=matcher->data.glob.pattern; ; p++) {
+                if (*p=='*' || *p=='?' || *p=='\0') {
+                    if (!roke_bloom_test_trigrams(bloom, matcher->scratch, n, ascii_only)) {
+                        return 0;
+                    }
+                    n = 0;
+                    if (*p=='\0') {
+                        break;
+                    }
+                } else {
+                    if (*p=='\\' && *(p+1)!='\0') {
+                        p++;
+                    }
+                    if (n < ROKE_PATH_MAX) {
+                        matcher->scratch[n++] = *p;
+                    }
+                }
+            }
+            return 1;
+        case ROKE_REGEX:
+            for (i=0; i<matcher->data.regex.nliterals; i++) {
+                const roke_substr_t* lit = &matcher->data.regex.literals[i];
+                if (!roke_bloom_test_trigrams(bloom, lit->pat, lit->patlen, ascii_only)) {
+                    return 0;
+                }
+            }
+            return 1;
+        case ROKE_FUZZY:
+            // the bytes of a fuzzy match need not be next to each other
+            return 1;
+        default:
+            return roke_bloom_test_trigrams(bloom, matcher->data.substr.pat,
+                matcher->data.substr.patlen, ascii_only);
+    }
+}
+
+/**
+ * @brief initialize a matcher with the same pattern as another matcher
+ *
+ * matchers keep scratch buffers, so every thread matching names must
+ * use its own matcher.
+ */
+int
+string_matcher_clone(
+    string_matcher_t* dst,
+    const string_matcher_t* src)
+{
+    if (src->flags&ROKE_MATCH_MULTI) {
+        const uint8_t** patterns = malloc((src->npatterns + 1) * sizeof(uint8_t*));
+        size_t* lens = malloc((src->npatterns + 1) * sizeof(size_t));
+        const uint8_t* p = src->pattern;
+        int err = 1;
+        uint32_t i;
+
+        if (patterns != NULL && lens != NULL) {
+            for (i=0; i<src->npatterns; i++) {
+                patterns[i] = p;
+                lens[i] = strlen((const char*) p);
+                p += lens[i] + 1;
+            }
+            err = string_matcher_init_multi(dst, patterns, lens, src->npatterns, src->flags);
+        }
+        free(patterns);
+        free(lens);
+        return err;
+    }
+    return string_matcher_init(dst, src->pattern, src->patlen, src->flags);
+}
+
 int
 string_matcher_free(
     string_matcher_t* matcher)
 {
     int err = 0;
+    free(matcher->scratch);
+    matcher->scratch = NULL;
+    free(matcher->pattern);
+    matcher->pattern = NULL;
+    if (matcher->flags&ROKE_QUERY) {
+        roke_query_free(matcher->data.query);
+        matcher->data.query = NULL;
+        return err;
+    }
+    if (matcher->flags&ROKE_MATCH_MULTI) {
+        uint32_t i;
+        if (matcher->data.multi.ac != NULL) {
+            roke_ac_free(matcher->data.multi.ac);
+            free(matcher->data.multi.ac);
+        }
+        if (matcher->data.multi.subs != NULL) {
+            for (i=0; i<matcher->npatterns; i++) {
+                string_matcher_free(&matcher->data.multi.subs[i]);
+            }
+            free(matcher->data.multi.subs);
+        }
+        free(matcher->data.multi.seen);
+        memset(&matcher->data.multi, 0, sizeof(matcher->data.multi));
+        return err;
+    }
     switch ((matcher->flags)&ROKE_MATCH_MASK) {
         case ROKE_GLOB:
-            free(matcher->data.glob_pattern);
+            roke_glob_free(&matcher->data.glob);
             break;
         case ROKE_REGEX:
             regex_free(&matcher->data.regex);
             break;
+        case ROKE_FUZZY:
+            break;
         default:
-            boyer_moore_free(&matcher->data.bmopt);
+            roke_substr_free(&matcher->data.substr);
             break;
 
     }
@@ -125,7 +693,7 @@ int roke_dirent_info(
     *is_dir = 0;
     *size = 0;
     #ifdef _DIRENT_HAVE_D_TYPE
-        if (dir->d_type != DT_UNKNOWN && dir->d_type != DT_LNK && (ROKE_INDEX_SIZE)==0) {
+        if (dir->d_type != DT_UNKNOWN && dir->d_type != DT_LNK) {
             // don't have to stat if we have d_type info, unless
             // it's a symlink (since we stat, not lstat)
             *is_dir = (dir->d_type == DT_DIR);
@@ -149,6 +717,47 @@ int roke_dirent_info(
     return 0;
 }
 
+/**
+ * @brief collect the metadata for a path
+ * @param path   the path to a file or directory
+ * @param is_dir set to true if the path is a directory, following symlinks
+ * @param meta   updated to contain the size, mtime and mode of the path.
+ *               the mode describes the link itself for symbolic links
+ * @return non-zero if the path could not be stat'd
+ */
+int roke_dirent_stat(
+    uint8_t* path,
+    int* is_dir,
+    roke_meta_t* meta)
+{
+    struct stat64_t stbuf;
+
+    *is_dir = 0;
+    memset(meta, 0, sizeof(roke_meta_t));
+
+    _nstatcalls++;
+    if (lstat64_utf8((char*) path, &stbuf)!=0) {
+        fprintf(stderr, "error: unable to stat: %s\n ", (char*)path);
+        return -1;
+    }
+
+    meta->size = (uint64_t) stbuf.st_size;
+    meta->mtime = (stbuf.st_mtime < 0) ? 0 :
+        (stbuf.st_mtime > UINT32_MAX) ? UINT32_MAX : (uint32_t) stbuf.st_mtime;
+    meta->mode = (uint32_t) stbuf.st_mode;
+    *is_dir = S_ISDIR(stbuf.st_mode);
+
+    // directories are traversed through symlinks
+    if ((stbuf.st_mode & S_IFMT) == S_IFLNK) {
+        _nstatcalls++;
+        if (stat64_utf8((char*) path, &stbuf)==0) {
+            *is_dir = S_ISDIR(stbuf.st_mode);
+        }
+    }
+
+    return 0;
+}
+
 /**
  * @brief get the default config directory
  * @param dst    the buffer to write too
@@ -213,41 +822,49 @@ int roke_get_config_dir(char* dst, size_t dstlen, char* default_path)
     return len;
 }
 
+/**
+ * @brief write a line to a text index
+ */
+static void
+_roke_write_entry(
+    FILE* fp,
+    uint32_t index,
+    const roke_meta_t* meta,
+    const char* name)
+{
+    fprintf(fp, "%" PRIu32 " %" PRIu64 " %" PRIu32 " %" PRIu32 " %s\n",
+        index, meta->size, meta->mtime, meta->mode, name);
+}
+
 /**
  * @brief parse a string to retrieve the index and file name
  * @param str a null terminated string to parse
  * @param index updated to contain the parent index
+ * @param meta  updated to contain the size, mtime and mode
  * @param name  updated to contain the file or directory name
  * @return
  *
- * Each line of the index file contains a three tuple. (index, size, name)
- * parse the line and update the index and name arguments. this function
- * destroys the input str
+ * Each line of the index file contains a five tuple.
+ * (index, size, mtime, mode, name) parse the line and update the index
+ * and name arguments. this function destroys the input str
  */
 int
 roke_parse_entry(
     uint8_t* str,
     uint32_t* index,
-    uint64_t* f_size,
+    roke_meta_t* meta,
     uint8_t** name)
 {
     uint8_t* tmp = str;
-    uint8_t* s_index=str;
-    uint8_t* s_size=NULL;
-    uint8_t* s_name=NULL;
+    // the start of the index, size, mtime, mode and name components
+    uint8_t* fields[5] = {str, NULL, NULL, NULL, NULL};
+    int nfields = 1;
 
     for (; *tmp!='\0'; tmp++) {
-        // find the start of the size component
-        if (*tmp==' ' && s_size==NULL) {
-            *tmp='\0';
-            tmp++;
-            s_size=tmp;
-        }
-        // find the start of the name component
-        else if (*tmp==' ' && s_name==NULL) {
+        // find the start of the next component, the name may contain spaces
+        if (*tmp==' ' && nfields < 5) {
             *tmp='\0';
-            tmp++;
-            s_name=tmp;
+            fields[nfields++] = tmp + 1;
         }
         // find the end of the line, the end of the name component
         else if (*tmp=='\n'||*tmp=='\r') {
@@ -256,9 +873,15 @@ roke_parse_entry(
         }
     }
 
-    *index = strtoul((char*)s_index, NULL, 10);
-    *f_size = strtoul((char*)s_size, NULL, 10);
-    *name = s_name;
+    if (nfields < 5) {
+        return 1;
+    }
+
+    *index = strtoul((char*)fields[0], NULL, 10);
+    meta->size = strtoull((char*)fields[1], NULL, 10);
+    meta->mtime = strtoul((char*)fields[2], NULL, 10);
+    meta->mode = strtoul((char*)fields[3], NULL, 10);
+    *name = fields[4];
 
     return 0;
 }
@@ -288,7 +911,19 @@ roke_build_index(
     const char* root,
     char** blacklist)
 {
-    return roke_build_index_impl(stdout, config_dir, name, root, blacklist, 0);
+    return roke_build_index_impl(stdout, config_dir, name, root, blacklist, 0, 0);
+}
+
+int
+roke_build_index_ex(
+    const char* config_dir,
+    const char* name,
+    const char* root,
+    char** blacklist,
+    int build_flags)
+{
+    return roke_build_index_impl(stdout, config_dir, name, root, blacklist,
+        build_flags, 0);
 }
 
 int
@@ -305,36 +940,81 @@ roke_build_index_fd(
         return -1;
     }
 
-    int err = roke_build_index_impl(output, config_dir, name, root, blacklist, 1);
+    int err = roke_build_index_impl(output, config_dir, name, root, blacklist, 0, 1);
 
     fclose(output);
 
     return err;
 }
+
 /**
- * @brief build an index file
- * @param config_dir null terminated string ending in a path separator
- *                   the directory path containing index files
- * @param name      the name of the index file to create or update.
- * @param root      the directory root to begin searching for files
- * @param blacklist null terminated list of strings. directories that exactly
- *                  match a name in this list will not be searched.
- * @return
- *
- * Scan the given directory, and all sub directories for files. build
- * an index file of the directories and files found. When finished, convert
- * the text file into a binary format using roke_binarize_index
+ * @brief replace the binary index of a text index with the one written
+ *        by roke_binarize_index
+ * @param discard remove the new index instead, after a failed build
+ * @return non-zero on failure
  *
- * if the task is aborted the binary index will not be updated, which
- * will prevent persisting a corrupt database
+ * the rename is atomic, so a search which has mapped the previous index
+ * keeps reading it, and no search ever maps a partially written index.
+ * roke-server notices the new file and maps it for the next query.
  */
-int
-roke_build_index_impl(
-    FILE* output,
+static int
+_roke_index_publish(const uint8_t* index_path, int discard)
+{
+    uint8_t bin_path[ROKE_PATH_MAX];
+    uint8_t tmp_path[ROKE_PATH_MAX];
+
+    size_t n = strcpy_safe(bin_path, sizeof(bin_path), index_path);
+    if (n==-1 || n + 4 >= sizeof(bin_path)) {
+        return 1;
+    }
+    strcpy_safe(tmp_path, sizeof(tmp_path), index_path);
+    strcpy_safe(bin_path + n - 3, 4, (uint8_t*)"bin");
+    strcpy_safe(tmp_path + n - 3, 8, (uint8_t*)"bin.tmp");
+
+    if (discard) {
+        remove((char*) tmp_path);
+        return 0;
+    }
+
+#ifdef _WIN32
+    // rename does not replace an existing file on windows
+    remove((char*) bin_path);
+#endif
+    if (rename((char*) tmp_path, (char*) bin_path)!=0) {
+        fprintf(stderr, "failed to publish: %s\n", bin_path);
+        remove((char*) tmp_path);
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief build an index file
+ * @param config_dir null terminated string ending in a path separator
+ *                   the directory path containing index files
+ * @param name      the name of the index file to create or update.
+ * @param root      the directory root to begin searching for files
+ * @param blacklist null terminated list of strings. directories that exactly
+ *                  match a name in this list will not be searched.
+ * @param build_flags ROKE_BUILD_METADATA to store the size, mtime and mode
+ *                  of every entry. requires a stat call per entry.
+ * @return
+ *
+ * Scan the given directory, and all sub directories for files. build
+ * an index file of the directories and files found. When finished, convert
+ * the text file into a binary format using roke_binarize_index
+ *
+ * if the task is aborted the binary index will not be updated, which
+ * will prevent persisting a corrupt database
+ */
+int
+roke_build_index_impl(
+    FILE* output,
     const char* config_dir,
     const char* name,
     const char* root,
     char** blacklist,
+    int build_flags,
     int verbose)
 {
     int i;
@@ -365,6 +1045,10 @@ roke_build_index_impl(
     _nstatcalls = 0;
 
     int aborted = 0;
+    uint32_t ranges_capacity = 1024;
+    uint32_t* parents = NULL;
+    uint32_t* file_begin = NULL;
+    roke_range_t* ranges = NULL;
 
     if (_roke_cancel_build==1) {
         _roke_cancel_build = 0;
@@ -404,11 +1088,30 @@ roke_build_index_impl(
         goto error;
     }
 
-    // write the root index as the first entry in the index
-    fprintf(didx, "%d %d %s\n", 0, 0, root);
-    ndirs += 1;
+    // directories are numbered when they are popped from the stack, which
+    // visits the tree in depth first pre-order. every subtree is then a
+    // contiguous range of directories, and because the files of a directory
+    // are written when it is visited, a contiguous range of files.
+    // parents and file_begin record the tree for computing the ranges.
+    parents = malloc(sizeof(uint32_t) * ranges_capacity);
+    file_begin = malloc(sizeof(uint32_t) * ranges_capacity);
+    if (parents == NULL || file_begin == NULL) {
+        fprintf(stderr, "error: failed to allocate directory ranges\n");
+        aborted = 1;
+        goto error;
+    }
 
+    // the root is the first entry in the index
     rstack_push(&stack, 0, 0, (uint8_t*) root);
+    if (build_flags&ROKE_BUILD_METADATA) {
+        roke_meta_t meta;
+        int is_dir;
+        rstack_data_t* elem = rstack_head(&stack);
+        roke_dirent_stat((uint8_t*) root, &is_dir, &meta);
+        elem->size = meta.size;
+        elem->mtime = meta.mtime;
+        elem->mode = meta.mode;
+    }
 
     roke_inode_cache_t cache;
     roke_inode_cache_init(&cache, 1024 * 64 /* * 8 */);
@@ -428,11 +1131,51 @@ roke_build_index_impl(
         }
 
         rstack_data_t* elem = rstack_head(&stack);
-        uint32_t elem_index = elem->index;
+        uint32_t elem_index = ndirs;
+        uint32_t elem_parent = elem->index;
         uint32_t elem_depth = elem->depth;
         uint8_t* elem_path  = strdup_safe(elem->path);
+        roke_meta_t elem_meta = {elem->size, elem->mtime, elem->mode};
         rstack_pop(&stack);
 
+        if (ndirs == ranges_capacity) {
+            ranges_capacity *= 2;
+            uint32_t* tmp1 = realloc(parents, sizeof(uint32_t) * ranges_capacity);
+            if (tmp1 != NULL) {
+                parents = tmp1;
+            }
+            uint32_t* tmp2 = realloc(file_begin, sizeof(uint32_t) * ranges_capacity);
+            if (tmp2 != NULL) {
+                file_begin = tmp2;
+            }
+            if (tmp1 == NULL || tmp2 == NULL) {
+                fprintf(stderr, "error: failed to allocate directory ranges\n");
+                free(elem_path);
+                aborted = 1;
+                break;
+            }
+        }
+
+        // write a directory entry to the directory index
+        // the entry is [index][size][mtime][mode][name]
+        // where index is a pointer to the parent
+        if (elem_index == 0) {
+            _roke_write_entry(didx, 0, &elem_meta, root);
+        } else {
+            uint8_t* elem_name = (uint8_t*) strrchr((char*) elem_path, SEP);
+            elem_name = (elem_name == NULL) ? elem_path : elem_name + 1;
+            _roke_write_entry(didx, elem_parent, &elem_meta, (char*) elem_name);
+        }
+        parents[elem_index] = elem_parent;
+        file_begin[elem_index] = nfiles;
+        ndirs += 1;
+
+        if (elem_depth > ROKE_RECURSION_DEPTH) {
+            fprintf(eidx, "recursion depth too deep: %s\n", elem_path);
+            free(elem_path);
+            continue;
+        }
+
         d = opendir((char*)elem_path);
         if (!d) {
             fprintf(eidx, "failed to open directory: %s\n", elem_path);
@@ -457,6 +1200,8 @@ roke_build_index_impl(
 
             int is_dir  = 0;
             off_t f_size = 0;
+            roke_meta_t meta;
+            memset(&meta, 0, sizeof(meta));
 
             {
                 // todo check for errors
@@ -464,38 +1209,28 @@ roke_build_index_impl(
                 _joinpath(parts, 2, temp_path, sizeof(temp_path));
             }
 
-            if (roke_dirent_info(dir, temp_path, &is_dir, &f_size)!=0) {
-                fprintf(eidx, "failed to stat path: %s\n", temp_path);
+            if (build_flags&ROKE_BUILD_METADATA) {
+                if (roke_dirent_stat(temp_path, &is_dir, &meta)!=0) {
+                    fprintf(eidx, "failed to stat path: %s\n", temp_path);
+                }
+            } else {
+                if (roke_dirent_info(dir, temp_path, &is_dir, &f_size)!=0) {
+                    fprintf(eidx, "failed to stat path: %s\n", temp_path);
+                }
+                meta.size = (uint64_t) f_size;
             }
 
-            // minimum file size is 1KB
-            // maximum file size is 4096GB, in a 32bit integer
-            f_size = (f_size==0) ? 0 : (f_size >> 10 || 1);
-
             if (is_dir) {
-                // write a directory entry to the directory index
-                // the entry is [index][size][name]
-                // where index is a pointer to the parent
+                // the directory entry is written when it is visited
 
                 if (roke_inode_cache_insert(&cache, dir->d_ino)!=ROKE_INODE_CACHE_EXISTS) {
 
-                    fprintf(didx, "%" PFMT_SIZE_T " %" PFMT_SIZE_T " %s\n", (size_t) elem_index, (size_t) f_size, dir->d_name);
-
-                    {
-                        // todo check for errors
-                        const uint8_t* parts[] = { elem_path, (uint8_t*) dir->d_name };
-                        _joinpath(parts, 2, temp_path, sizeof(temp_path));
-                    }
-
-                    if (elem_depth < ROKE_RECURSION_DEPTH) {
-
-                        //printf("ino: %d %s\n", dir->d_ino, temp_path);
-                        rstack_push(&stack, ndirs, elem_depth + 1, temp_path);
-                        ndirs += 1;
-
-                        
-                    } else {
-                        fprintf(eidx, "recursion depth too deep: %s\n", temp_path);
+                    //printf("ino: %d %s\n", dir->d_ino, temp_path);
+                    if (rstack_push(&stack, elem_index, elem_depth + 1, temp_path)==0) {
+                        rstack_data_t* child = rstack_head(&stack);
+                        child->size = meta.size;
+                        child->mtime = meta.mtime;
+                        child->mode = meta.mode;
                     }
 
                 } else {
@@ -505,9 +1240,9 @@ roke_build_index_impl(
 
             } else {
                 // write a file entry to the file index
-                // the entry is [index][size][name]
+                // the entry is [index][size][mtime][mode][name]
                 // where index is a pointer to the parent
-                fprintf(fidx, "%" PFMT_SIZE_T " %" PFMT_SIZE_T " %s\n", (size_t) elem_index, (size_t) f_size, dir->d_name);
+                _roke_write_entry(fidx, elem_index, &meta, dir->d_name);
                 nfiles += 1;
             }
         }
@@ -559,10 +1294,22 @@ roke_build_index_impl(
     }
 
     if (aborted==0) {
-        roke_binarize_index(didx_path, ndirs);
-        roke_binarize_index(fidx_path, nfiles);
+        ranges = malloc(sizeof(roke_range_t) * (ndirs + 1));
+        if (ranges != NULL) {
+            roke_compute_ranges(parents, file_begin, ndirs, nfiles, ranges);
+        }
+        // both indexes are published together once both are written,
+        // so that a search sees the directories and files of one build
+        int failed = roke_binarize_index(didx_path, ndirs, build_flags, ranges);
+        failed = roke_binarize_index(fidx_path, nfiles, build_flags, NULL) || failed;
+        _roke_index_publish(fidx_path, failed);
+        _roke_index_publish(didx_path, failed);
     }
 
+    free(parents);
+    free(file_begin);
+    free(ranges);
+
     if (verbose==0) {
         printf("n stat calls: %" PFMT_SIZE_T "\n", _nstatcalls);
     }
@@ -570,28 +1317,104 @@ roke_build_index_impl(
     return aborted;
 }
 
+/**
+ * @brief compute the subtree ranges of every directory
+ * @param parents    the parent of every directory, in pre-order
+ * @param file_begin the id of the first file of every directory
+ * @param ndirs      the number of directories
+ * @param nfiles     the number of files
+ * @param ranges     an array of ndirs ranges to fill in
+ *
+ * in pre-order a parent always has a smaller id than its children, so
+ * visiting the directories in reverse order propagates the end of every
+ * subtree up to its parent in a single pass.
+ */
+void
+roke_compute_ranges(
+    const uint32_t* parents,
+    const uint32_t* file_begin,
+    uint32_t ndirs,
+    uint32_t nfiles,
+    roke_range_t* ranges)
+{
+    uint32_t k;
+    for (k=0; k<ndirs; k++) {
+        ranges[k].dir_end = k + 1;
+        ranges[k].file_begin = file_begin[k];
+    }
+    for (k=ndirs; k-- > 1;) {
+        uint32_t p = parents[k];
+        if (p < k && ranges[k].dir_end > ranges[p].dir_end) {
+            ranges[p].dir_end = ranges[k].dir_end;
+        }
+    }
+    for (k=0; k<ndirs; k++) {
+        uint32_t end = ranges[k].dir_end;
+        ranges[k].file_end = (end < ndirs) ? file_begin[end] : nfiles;
+    }
+}
+
+/**
+ * @brief append a section to the end of a binary index
+ * @param fp     the binary index
+ * @param sec    the section table slot to fill in
+ * @param tag    the section tag
+ * @param offset the end of the data currently in the file
+ * @param data   the content of the section
+ * @param size   the number of bytes in the section
+ * @return the end of the file after writing the section
+ *
+ * sections are aligned to 8 bytes so that columns can be used in place.
+ */
+static uint64_t
+_roke_write_section(
+    FILE* fp,
+    roke_section_t* sec,
+    uint32_t tag,
+    uint64_t offset,
+    const void* data,
+    size_t size)
+{
+    offset = (offset + 7) & ~((uint64_t) 7);
+    sec->tag = tag;
+    sec->flags = 0;
+    sec->offset = offset;
+    sec->size = size;
+    fseek(fp, (long) offset, SEEK_SET);
+    fwrite(data, sizeof(uint8_t), size, fp);
+    return offset + size;
+}
+
 /**
  * @brief convert a text index into a binary index.
  * @param index_path the path to an index (.d.idx or .f.idx)
  * @param nitems the number of elements expected to be found in the index file
- * @param is_dir  true if this is a directory index (.d.idx)
- * @return
+ * @param build_flags ROKE_BUILD_METADATA to write the metadata columns,
+ *                    ROKE_BUILD_COMPRESS to store the names in frames,
+ *                    ROKE_BUILD_NORMALIZE to store the normalized names
+ * @param ranges the subtree range of every directory, or NULL
+ * @return non-zero on failure
  *
  * This implementation parses the index files in an on demand process.
+ * The binary index is written beside its final path with a .tmp suffix,
+ * and replaces it when it is published by _roke_index_publish.
  */
 int
 roke_binarize_index(
     uint8_t* index_path,
-    uint32_t nitems)
+    uint32_t nitems,
+    int build_flags,
+    const roke_range_t* ranges)
 {
     uint8_t bin_path[ROKE_PATH_MAX];
     uint8_t buffer[ROKE_PATH_MAX];
+    int err = 1;
 
     size_t n = strcpy_safe(bin_path, sizeof(bin_path), index_path);
-    if (n==-1) {
+    if (n==-1 || n + 4 >= sizeof(bin_path)) {
         return 1;
     }
-    strcpy_safe(bin_path + n - 3, 4, (uint8_t*)"bin");
+    strcpy_safe(bin_path + n - 3, 8, (uint8_t*)"bin.tmp");
 
     FILE* sidx = NULL;
     FILE* bidx = NULL;
@@ -608,111 +1431,411 @@ roke_binarize_index(
         goto error;
     }
 
+    // the section table and the name sketch are stored between the
+    // header and the entries, so that they can be read without mapping
+    // the whole index
+    roke_section_t sections[ROKE_SECTION_MAX];
+    memset(sections, 0, sizeof(sections));
+
+    roke_bloom_t bloom;
+    if (roke_bloom_init(&bloom, roke_bloom_size_for(nitems))!=0) {
+        goto error;
+    }
+    sections[0].tag = ROKE_SECTION_SKETCH;
+    sections[0].offset = ROKE_HEADER_SIZE + sizeof(sections);
+    sections[0].size = bloom.nbytes;
+
     // write a header to the binary file so that it can be memmapped easily
 
     char* headera = "ROKE";
-    uint32_t headerb = 0;
-    fwrite ( headera,  sizeof(char),     4, bidx);
-    fwrite ( &nitems,  sizeof(uint32_t), 1, bidx);
-    fwrite ( &headerb, sizeof(uint32_t), 1, bidx);
-    fwrite ( &headerb, sizeof(uint32_t), 1, bidx);
-
-    uint32_t elem_offset = 16;
-    uint32_t name_offset = 16 + sizeof(roke_entry_t) * nitems;
-    uint64_t f_size;
-    while (fgets((char*)buffer, sizeof(buffer), sidx) != NULL) {
+    uint32_t header_size = (uint32_t) (sections[0].offset + sections[0].size);
+    uint32_t nsections = ROKE_SECTION_MAX;
+    fwrite ( headera,      sizeof(char),     4, bidx);
+    fwrite ( &nitems,      sizeof(uint32_t), 1, bidx);
+    fwrite ( &header_size, sizeof(uint32_t), 1, bidx);
+    fwrite ( &nsections,   sizeof(uint32_t), 1, bidx);
+
+    // metadata columns are collected in memory and written after the names
+    uint32_t* col_mtime = NULL;
+    uint64_t* col_size = NULL;
+    uint32_t* col_mode = NULL;
+    if (build_flags&ROKE_BUILD_METADATA) {
+        col_mtime = calloc(nitems + 1, sizeof(uint32_t));
+        col_size = calloc(nitems + 1, sizeof(uint64_t));
+        col_mode = calloc(nitems + 1, sizeof(uint32_t));
+        if (!col_mtime || !col_size || !col_mode) {
+            fprintf(stderr, "error: failed to allocate metadata columns\n");
+            goto error_columns;
+        }
+    }
+
+    // compressed names are collected in memory and written after the entries
+    roke_frame_writer_t frames;
+    int compress = (build_flags&ROKE_BUILD_COMPRESS) != 0;
+    if (compress) {
+        uint32_t codec = ROKE_CODEC_ZSTD;
+        if (!roke_codec_available(codec)) {
+            fprintf(stderr, "warning: built without zstd, names are stored in uncompressed frames\n");
+            codec = ROKE_CODEC_STORED;
+        }
+        roke_frame_writer_init(&frames, codec, ROKE_FRAME_ENTRIES);
+    }
+
+    // normalized names are collected in memory and written after the entries
+    uint32_t* norm = NULL;
+    uint8_t* norm_names = NULL;
+    size_t norm_size = 0;
+    size_t norm_capacity = 0;
+    if (build_flags&ROKE_BUILD_NORMALIZE) {
+        norm = calloc(nitems + 1, sizeof(uint32_t));
+        if (norm == NULL) {
+            fprintf(stderr, "error: failed to allocate normalized names\n");
+            goto error_frames;
+        }
+    }
+
+    uint32_t elem_offset = header_size;
+    uint32_t name_offset = header_size + sizeof(roke_entry_t) * nitems;
+    uint32_t i = 0;
+    roke_meta_t meta;
+    uint8_t folded[ROKE_PATH_MAX];
+    while (i < nitems && fgets((char*)buffer, sizeof(buffer), sidx) != NULL) {
         roke_entry_t ent;
         uint8_t* name;
 
-        roke_parse_entry(buffer, &ent.index, &f_size, &name);
+        // a line which can not be parsed is the rest of a name holding a
+        // newline, the entry itself was read from the line before
+        if (roke_parse_entry(buffer, &ent.index, &meta, &name)!=0) {
+            continue;
+        }
 
         ent.namelen = (uint16_t) strlen((char*)name);
         ent.offset = name_offset;
-        ent.f_size = f_size; // only valid if ROKE_INDEX_SIZE is true
+        ent.f_size = meta.size;
+
+        if (compress && roke_frame_writer_add(&frames, name, ent.namelen+1, &ent.offset)!=0) {
+            fprintf(stderr, "error: failed to compress names\n");
+            goto error_frames;
+        }
+
+        if (col_mode != NULL) {
+            col_mtime[i] = meta.mtime;
+            col_size[i] = meta.size;
+            col_mode[i] = meta.mode;
+        }
+
+        if (norm != NULL) {
+            if (norm_size + ROKE_PATH_MAX > norm_capacity) {
+                size_t capacity = (norm_capacity) ? norm_capacity * 2 : 64 * 1024;
+                uint8_t* tmp = realloc(norm_names, capacity);
+                if (tmp == NULL) {
+                    fprintf(stderr, "error: failed to allocate normalized names\n");
+                    goto error_frames;
+                }
+                norm_names = tmp;
+                norm_capacity = capacity;
+            }
+            size_t len = tonormalized(norm_names + norm_size, ROKE_PATH_MAX,
+                name, ent.namelen);
+            // the sketch holds the trigrams of the names as they are matched
+            roke_bloom_add_trigrams(&bloom, norm_names + norm_size, len);
+            if (norm_size + len + 1 > UINT32_MAX) {
+                // the offsets are 32 bits. without the section the names
+                // are normalized while searching instead
+                fprintf(stderr, "warning: normalized names exceed 4 GiB, they are not stored\n");
+                free(norm);
+                free(norm_names);
+                norm = NULL;
+                norm_names = NULL;
+                norm_size = 0;
+                norm_capacity = 0;
+            } else {
+                norm[i] = (uint32_t) norm_size;
+                norm_size += len + 1;
+            }
+        }
+        i++;
 
         fseek(bidx, elem_offset, SEEK_SET);
         fwrite ( &ent, sizeof(roke_entry_t), 1, bidx);
         elem_offset += sizeof(roke_entry_t);
 
-        fseek(bidx, name_offset, SEEK_SET);
-        fwrite(name, sizeof(uint8_t), ent.namelen+1, bidx);
-        name_offset += ent.namelen+1;
+        if (!compress) {
+            fseek(bidx, name_offset, SEEK_SET);
+            fwrite(name, sizeof(uint8_t), ent.namelen+1, bidx);
+            name_offset += ent.namelen+1;
+        }
+
+        roke_bloom_add_trigrams(&bloom, name, ent.namelen);
+        if (!is_ascii(name, ent.namelen)) {
+            // case insensitive patterns are matched against names folded by
+            // tolowercase, which folds some characters to ASCII (KELVIN SIGN
+            // to 'k'), so the trigrams of the folded name are added as well
+            size_t len = tolowercase(folded, sizeof(folded), name);
+            roke_bloom_add_trigrams(&bloom, folded, len);
+        }
+    }
+
+    // the header and the sections are sized for nitems entries, an index
+    // file which ends early fails the build
+    if (i < nitems) {
+        fprintf(stderr, "error: expected %u entries, found %u in: %s\n",
+            nitems, i, index_path);
+        goto error_frames;
+    }
+
+    uint64_t offset = name_offset;
+    if (norm != NULL) {
+        norm[nitems] = (uint32_t) norm_size;
+        offset = _roke_write_section(bidx, &sections[6], ROKE_SECTION_NORM,
+            offset, norm, sizeof(uint32_t) * ((size_t) nitems + 1));
+        fwrite(norm_names, sizeof(uint8_t), norm_size, bidx);
+        sections[6].size += norm_size;
+        offset += norm_size;
+    }
+
+    if (compress) {
+        if (roke_frame_writer_finish(&frames)!=0) {
+            fprintf(stderr, "error: failed to compress names\n");
+            goto error_frames;
+        }
+        offset = _roke_write_section(bidx, &sections[5], ROKE_SECTION_NAMES,
+            offset, frames.out, frames.out_size);
     }
 
+    if (ranges != NULL) {
+        offset = _roke_write_section(bidx, &sections[4], ROKE_SECTION_RANGE,
+            offset, ranges, sizeof(roke_range_t) * nitems);
+    }
+
+    if (col_mode != NULL) {
+        offset = _roke_write_section(bidx, &sections[1], ROKE_SECTION_MTIME,
+            offset, col_mtime, sizeof(uint32_t) * nitems);
+        offset = _roke_write_section(bidx, &sections[2], ROKE_SECTION_SIZE,
+            offset, col_size, sizeof(uint64_t) * nitems);
+        offset = _roke_write_section(bidx, &sections[3], ROKE_SECTION_MODE,
+            offset, col_mode, sizeof(uint32_t) * nitems);
+    }
+
+    fseek(bidx, ROKE_HEADER_SIZE, SEEK_SET);
+    fwrite(sections, sizeof(roke_section_t), ROKE_SECTION_MAX, bidx);
+    fwrite(bloom.bits, sizeof(uint8_t), bloom.nbytes, bidx);
+    err = ferror(bidx);
+
     //fprintf(stderr, "sizeof(roke_entry_t): %d\n", sizeof(roke_entry_t));
 
+  error_frames:
+    if (compress) {
+        roke_frame_writer_free(&frames);
+    }
+    free(norm);
+    free(norm_names);
+
+  error_columns:
+    free(col_mtime);
+    free(col_size);
+    free(col_mode);
+    roke_bloom_free(&bloom);
+
   error:
     if (sidx != NULL)
         fclose(sidx);
-    if (bidx != NULL)
-        fclose(bidx);
+    if (bidx != NULL && fclose(bidx)!=0) {
+        err = 1;
+    }
+    if (err && bidx != NULL) {
+        remove((char*) bin_path);
+    }
 
-    return 0;
+    return err;
+}
+
+
+void
+roke_locate_options_init(roke_locate_options_t* opts)
+{
+    memset(opts, 0, sizeof(roke_locate_options_t));
 }
 
 /**
- * @brief find files patching a given set of patterns
- * @param config_dir null terminated string ending in a path separator
- *                   the directory path containing index files
- * @param patterns   array of at most 2 patterns to use in matching
- *                   the first pattern is used to match file names
- *                   the second pattern is used to match file paths
- * @param npatterns  length of the patterns array
- * @param match_flags set to true to perform case insensitive matching
- * @return
+ * @brief the matchers built from the patterns of a query
+ */
+typedef struct roke_matchers {
+    string_matcher_t* matchers;
+    string_matcher_t** strmatch;    // null terminated
+    size_t n;                       // the number of matchers initialized
+} roke_matchers_t;
+
+static void
+_roke_matchers_free(roke_matchers_t* m)
+{
+    size_t i;
+    for (i=0; i<m->n; i++) {
+        string_matcher_free(m->strmatch[i]);
+    }
+    free(m->matchers);
+    free(m->strmatch);
+    memset(m, 0, sizeof(roke_matchers_t));
+}
+
+/**
+ * @brief build the matchers for a set of patterns
+ * @return non-zero on failure
  *
- * This implementation of find memory maps the index files to improve
- * lookup speed by removing the need to parse a text file.
+ * with ROKE_QUERY the patterns are a query. with ROKE_MATCH_ANY or
+ * ROKE_MATCH_ALL every pattern matches names, and they are combined into
+ * a single matcher. otherwise the first pattern matches names and every
+ * other pattern must match the full path.
  */
-int
-roke_locate(
-    const char* config_dir,
+static int
+_roke_matchers_init(
+    roke_matchers_t* m,
     const char** patterns,
     size_t npatterns,
-    int match_flags,
-    int limit)
+    int match_flags)
 {
-    string_matcher_t smopt1;
-    string_matcher_t smopt2;
-    // array of string matchers, final entry must be a null pointer
-    string_matcher_t* smopts[3];
-    memset(smopts, 0, sizeof(smopts));
-
-    int i=0;
+    size_t* lens = NULL;
+    size_t i;
     int err;
-    
-    err = string_matcher_init(&smopt1, (uint8_t*)patterns[0], strlen((char*)patterns[0]), match_flags);
-    if (err!=0) {
-        printf("error: failed to initialize string matcher\n");
-        goto error;
-    }
 
-    smopts[0] = &smopt1;
-    smopts[1] = NULL;
+    memset(m, 0, sizeof(roke_matchers_t));
+    if (npatterns == 0) {
+        return 1;
+    }
 
-    if (npatterns > 1) {
-        err = string_matcher_init(&smopt2, (uint8_t*)patterns[1], strlen((char*)patterns[1]), match_flags);
+    m->matchers = calloc(npatterns, sizeof(string_matcher_t));
+    // array of string matchers, final entry must be a null pointer
+    m->strmatch = calloc(npatterns + 1, sizeof(string_matcher_t*));
+    lens = calloc(npatterns, sizeof(size_t));
+    if (m->matchers == NULL || m->strmatch == NULL || lens == NULL) {
+        goto error;
+    }
+    for (i=0; i<npatterns; i++) {
+        lens[i] = strlen(patterns[i]);
+    }
 
+    if (match_flags&ROKE_QUERY) {
+        // the shell splits a query into words, join them back together
+        size_t total = 0;
+        for (i=0; i<npatterns; i++) {
+            total += lens[i] + 1;
+        }
+        uint8_t* text = malloc(total + 1);
+        if (text == NULL) {
+            goto error;
+        }
+        for (i=0, total=0; i<npatterns; i++) {
+            memcpy(text + total, patterns[i], lens[i]);
+            total += lens[i];
+            text[total++] = ' ';
+        }
+        text[total] = '\0';
+        err = string_matcher_init(&m->matchers[0], text, total, match_flags);
+        free(text);
+        if (err!=0) {
+            goto error;
+        }
+        m->strmatch[m->n] = &m->matchers[m->n];
+        m->n++;
+    } else if (match_flags&ROKE_MATCH_MULTI) {
+        err = string_matcher_init_multi(&m->matchers[0], (const uint8_t**) patterns,
+            lens, (uint32_t) npatterns, match_flags);
         if (err!=0) {
             printf("error: failed to initialize string matcher\n");
             goto error;
         }
-
-        smopts[1] = &smopt2;
-        smopts[2] = NULL;
+        m->strmatch[m->n] = &m->matchers[m->n];
+        m->n++;
+    } else {
+        for (i=0; i<npatterns; i++) {
+            err = string_matcher_init(&m->matchers[i], (uint8_t*)patterns[i], lens[i], match_flags);
+            if (err!=0) {
+                printf("error: failed to initialize string matcher\n");
+                goto error;
+            }
+            m->strmatch[m->n] = &m->matchers[m->n];
+            m->n++;
+        }
     }
 
-    int v = roke_locate_impl(stdout, (uint8_t*)config_dir, smopts, limit);
+    free(lens);
+    return 0;
 
 error:
+    free(lens);
+    _roke_matchers_free(m);
+    return 1;
+}
+
+/**
+ * @brief find files matching a given set of patterns, writing to fd
+ */
+static int
+_roke_locate_output(
+    int fd,
+    const char* config_dir,
+    const char** patterns,
+    size_t npatterns,
+    const roke_locate_options_t* opts)
+{
+    roke_matchers_t m;
+    roke_output_t out;
 
-    for (i=0; smopts[i]!=NULL; i++) {
-        string_matcher_free(smopts[i]);
+    if (_roke_matchers_init(&m, patterns, npatterns, opts->match_flags)!=0) {
+        return 1;
     }
+    if (roke_output_init(&out, fd)!=0) {
+        _roke_matchers_free(&m);
+        return 1;
+    }
+
+    int v = roke_locate_output_impl(&out, (uint8_t*)config_dir, m.strmatch, opts);
+    v = roke_output_flush(&out) || v;
+
+    roke_output_free(&out);
+    _roke_matchers_free(&m);
 
     return v;
 }
 
+/**
+ * @brief find files patching a given set of patterns
+ * @param config_dir null terminated string ending in a path separator
+ *                   the directory path containing index files
+ * @param patterns   array of patterns to use in matching
+ *                   the first pattern is used to match file names
+ *                   the remaining patterns are used to match file paths.
+ *                   with ROKE_MATCH_ANY or ROKE_MATCH_ALL every pattern
+ *                   is used to match file names. with ROKE_QUERY the
+ *                   patterns are joined by spaces and parsed as a query:
+ *                     name:*.log AND path:/var/ AND NOT name:*.gz AND size>10M
+ *                   the terms are name:, path:, name~ and path~ (regular
+ *                   expressions), size>, size<, size=, newer:, older:
+ *                   and type:. any other word is a name pattern.
+ * @param npatterns  length of the patterns array
+ * @param match_flags ROKE_CASE_INSENSITIVE, ROKE_GLOB, ROKE_REGEX,
+ *                   ROKE_MATCH_ANY, ROKE_MATCH_ALL and ROKE_QUERY
+ * @return
+ *
+ * This implementation of find memory maps the index files to improve
+ * lookup speed by removing the need to parse a text file.
+ */
+int
+roke_locate(
+    const char* config_dir,
+    const char** patterns,
+    size_t npatterns,
+    int match_flags,
+    int limit)
+{
+    roke_locate_options_t opts;
+    roke_locate_options_init(&opts);
+    opts.match_flags = match_flags;
+    opts.limit = limit;
+
+    return roke_locate_ex(config_dir, patterns, npatterns, &opts);
+}
+
 int
 roke_locate_fd(
     int fd,
@@ -722,54 +1845,229 @@ roke_locate_fd(
     int match_flags,
     int limit)
 {
+    roke_locate_options_t opts;
+    roke_locate_options_init(&opts);
+    opts.match_flags = match_flags;
+    opts.limit = limit;
 
-    FILE* output = roke_fdopen(fd, "w");
-    if (output==NULL) {
-        fprintf(stderr, "invalid file descriptor: %d\n", fd);
-        return -1;
-    }
-
-    string_matcher_t smopt1;
-    string_matcher_t smopt2;
-    string_matcher_t* smopts[3]; // hardcoding to 3 for now...
-    int i=0;
-    string_matcher_init(&smopt1, (uint8_t*)patterns[0], strlen(patterns[0]), match_flags);
+    return roke_locate_ex_fd(fd, config_dir, patterns, npatterns, &opts);
+}
 
-    smopts[0] = &smopt1;
-    smopts[1] = NULL;
+/**
+ * @brief find files matching a given set of patterns and filters
+ * @param config_dir null terminated string ending in a path separator
+ *                   the directory path containing index files
+ * @param patterns   array of patterns, see roke_locate
+ * @param npatterns  length of the patterns array
+ * @param opts       match flags, limit and metadata filters
+ * @return
+ */
+int
+roke_locate_ex(
+    const char* config_dir,
+    const char** patterns,
+    size_t npatterns,
+    const roke_locate_options_t* opts)
+{
+    fflush(stdout);
+    return _roke_locate_output(roke_fileno(stdout), config_dir, patterns, npatterns, opts);
+}
 
-    if (npatterns > 1) {
-        string_matcher_init(&smopt2, (uint8_t*)patterns[1], strlen(patterns[1]), match_flags);
-        smopts[1] = &smopt2;
-        smopts[2] = NULL;
+int
+roke_locate_ex_fd(
+    int fd,
+    const char* config_dir,
+    const char** patterns,
+    size_t npatterns,
+    const roke_locate_options_t* opts)
+{
+    struct stat st;
+    if (fstat(fd, &st)!=0) {
+        fprintf(stderr, "invalid file descriptor: %d\n", fd);
+        return -1;
     }
 
-    int v = roke_locate_impl(output, (uint8_t*) config_dir, smopts, limit);
-
-    for (i=0; smopts[i]!=NULL; i++) {
-        string_matcher_free(smopts[i]);
-    }
+    int v = _roke_locate_output(fd, config_dir, patterns, npatterns, opts);
 
-    fclose(output);
+    roke_close(fd);
 
     return v;
 }
 
-
+/**
+ * @brief parse a size filter
+ * @param str a size with an optional unit suffix (c, k, M, G, T).
+ *            units are powers of 1024, and plain numbers are bytes.
+ *            +N matches sizes greater than N, -N matches sizes less than N,
+ *            and N matches sizes which round up to N in the given unit.
+ * @param opts updated to contain the size filter
+ * @return non-zero if the string could not be parsed
+ */
 int
-roke_index_open(roke_index_t* idx, uint8_t* path)
+roke_parse_size_filter(
+    const char* str,
+    roke_locate_options_t* opts)
 {
+    char sign = 0;
+    char* end = NULL;
+    uint64_t unit = 1;
 
-    idx->data = NULL;
-
-    idx->fp = fopen_safe(path, "r");
-    if (idx->fp == NULL) {
-        fprintf(stderr, "error opening %s\n", path);
+    if (*str == '+' || *str == '-') {
+        sign = *str++;
+    }
+    if (!isdigit((unsigned char) *str)) {
         return 1;
     }
 
-    fseek(idx->fp, 0, SEEK_END);
-    idx->fsize = ftell(idx->fp);
+    errno = 0;
+    uint64_t n = strtoull(str, &end, 10);
+    if (errno == ERANGE) {
+        return 1;
+    }
+    switch (*end) {
+        case '\0':
+        case 'c': unit = 1; break;
+        case 'k':
+        case 'K': unit = 1ull << 10; break;
+        case 'M': unit = 1ull << 20; break;
+        case 'G': unit = 1ull << 30; break;
+        case 'T': unit = 1ull << 40; break;
+        default: return 1;
+    }
+    if (*end != '\0' && *(end + 1) != '\0') {
+        return 1;
+    }
+    // a size which does not fit in 64 bits would wrap to a small bound
+    if (n > UINT64_MAX / unit || (sign == '+' && n * unit == UINT64_MAX)) {
+        return 1;
+    }
+
+    if (sign == '+') {
+        opts->filters |= ROKE_FILTER_SIZE_MIN;
+        opts->size_min = n * unit + 1;
+    } else if (sign == '-') {
+        if (n == 0) {
+            return 1;
+        }
+        opts->filters |= ROKE_FILTER_SIZE_MAX;
+        opts->size_max = n * unit - 1;
+    } else {
+        opts->filters |= ROKE_FILTER_SIZE_MIN | ROKE_FILTER_SIZE_MAX;
+        opts->size_min = (n == 0) ? 0 : (n - 1) * unit + 1;
+        opts->size_max = n * unit;
+    }
+    return 0;
+}
+
+/**
+ * @brief parse a time filter
+ * @param str a duration relative to now, a number followed by a unit
+ *            (s, m, h, d or w, the default is days), or a date YYYY-MM-DD
+ *            in local time
+ * @param now the current time
+ * @param t   updated to contain the unix time described by str
+ * @return non-zero if the string could not be parsed
+ */
+int
+roke_parse_time_filter(
+    const char* str,
+    int64_t now,
+    int64_t* t)
+{
+    int year, month, day;
+    char* end = NULL;
+    int64_t unit = 86400;
+
+    if (strlen(str) == 10 && sscanf(str, "%4d-%2d-%2d", &year, &month, &day) == 3) {
+        struct tm tm;
+        memset(&tm, 0, sizeof(tm));
+        tm.tm_year = year - 1900;
+        tm.tm_mon = month - 1;
+        tm.tm_mday = day;
+        tm.tm_isdst = -1;
+        *t = (int64_t) mktime(&tm);
+        return (*t == -1) ? 1 : 0;
+    }
+
+    if (!isdigit((unsigned char) *str)) {
+        return 1;
+    }
+
+    int64_t n = (int64_t) strtoll(str, &end, 10);
+    switch (*end) {
+        case 's': unit = 1; break;
+        case 'm': unit = 60; break;
+        case 'h': unit = 3600; break;
+        case '\0':
+        case 'd': unit = 86400; break;
+        case 'w': unit = 7 * 86400; break;
+        default: return 1;
+    }
+    if (*end != '\0' && *(end + 1) != '\0') {
+        return 1;
+    }
+
+    *t = now - n * unit;
+    return 0;
+}
+
+/**
+ * @brief parse a type filter
+ * @param str a combination of the letters f (regular file), d (directory)
+ *            and l (symbolic link), optionally separated by commas
+ * @param opts updated to contain the type filter
+ * @return non-zero if the string could not be parsed
+ */
+int
+roke_parse_type_filter(
+    const char* str,
+    roke_locate_options_t* opts)
+{
+    uint32_t types = 0;
+    for (; *str != '\0'; str++) {
+        switch (*str) {
+            case 'f': types |= ROKE_TYPE_FILE; break;
+            case 'd': types |= ROKE_TYPE_DIR; break;
+            case 'l': types |= ROKE_TYPE_LINK; break;
+            case ',': break;
+            default: return 1;
+        }
+    }
+    if (types == 0) {
+        return 1;
+    }
+    opts->filters |= ROKE_FILTER_TYPE;
+    opts->types = types;
+    return 0;
+}
+
+int
+roke_index_open(roke_index_t* idx, uint8_t* path)
+{
+    return roke_index_open_ex(idx, path, ROKE_FRAME_CACHE);
+}
+
+/**
+ * @brief map an index
+ * @param ncache the number of decompressed frames to cache when the names
+ *               are compressed. one is enough for a sequential scan.
+ */
+int
+roke_index_open_ex(roke_index_t* idx, uint8_t* path, uint32_t ncache)
+{
+
+    idx->data = NULL;
+    idx->names = NULL;
+    idx->norm = NULL;
+
+    idx->fp = fopen_safe(path, "r");
+    if (idx->fp == NULL) {
+        fprintf(stderr, "error opening %s\n", path);
+        return 1;
+    }
+
+    fseek(idx->fp, 0, SEEK_END);
+    idx->fsize = ftell(idx->fp);
     fseek(idx->fp, 0, SEEK_SET);
     idx->data = mmap(NULL, idx->fsize, PROT_READ, MMAP_FLAGS, roke_fileno(idx->fp), 0);
     if (idx->data == MAP_FAILED) {
@@ -777,185 +2075,4885 @@ roke_index_open(roke_index_t* idx, uint8_t* path)
         goto map_error;
     }
 
-    uint32_t *pnitems = ((uint32_t*)idx->data)+1;
-    idx->nitems = *pnitems;
+    uint32_t *header = (uint32_t*)idx->data;
+    idx->nitems = header[1];
+
+    // indexes without a section table store the entries after the header
+    uint32_t header_size = (header[2]==0) ? ROKE_HEADER_SIZE : header[2];
+    idx->nsections = (header[2]==0) ? 0 : header[3];
+    idx->sections = (roke_section_t*) (((uint8_t*)idx->data)+ROKE_HEADER_SIZE);
+    if (header_size + sizeof(roke_entry_t) * (size_t) idx->nitems > idx->fsize ||
+        ROKE_HEADER_SIZE + sizeof(roke_section_t) * (size_t) idx->nsections > header_size) {
+        fprintf(stderr, "error: corrupt index %s\n", path);
+        munmap(idx->data, idx->fsize);
+        idx->data = NULL;
+        goto map_error;
+    }
+
+    // get the arrays of entries out of the mem map
+    idx->entries = (roke_entry_t*) (((uint8_t*)idx->data)+header_size);
+
+    // get the initial mem position for which the offset is added
+    // to produce a name
+    idx->strings = idx->data;
+
+    // optional metadata columns
+    uint64_t size;
+    idx->mtime = (uint32_t*) roke_index_section(idx, ROKE_SECTION_MTIME, &size);
+    if (size != sizeof(uint32_t) * (uint64_t) idx->nitems) {
+        idx->mtime = NULL;
+    }
+    idx->size = (uint64_t*) roke_index_section(idx, ROKE_SECTION_SIZE, &size);
+    if (size != sizeof(uint64_t) * (uint64_t) idx->nitems) {
+        idx->size = NULL;
+    }
+    idx->mode = (uint32_t*) roke_index_section(idx, ROKE_SECTION_MODE, &size);
+    if (size != sizeof(uint32_t) * (uint64_t) idx->nitems) {
+        idx->mode = NULL;
+    }
+    idx->ranges = (roke_range_t*) roke_index_section(idx, ROKE_SECTION_RANGE, &size);
+    if (size != sizeof(roke_range_t) * (uint64_t) idx->nitems) {
+        idx->ranges = NULL;
+    }
+
+    idx->norm = (uint32_t*) roke_index_section(idx, ROKE_SECTION_NORM, &size);
+    idx->norm_names = NULL;
+    idx->norm_size = 0;
+    if (size < sizeof(uint32_t) * ((uint64_t) idx->nitems + 1)) {
+        idx->norm = NULL;
+    } else {
+        idx->norm_names = (uint8_t*) (idx->norm + idx->nitems + 1);
+        idx->norm_size = size - sizeof(uint32_t) * ((uint64_t) idx->nitems + 1);
+    }
+
+    uint8_t* names = roke_index_section(idx, ROKE_SECTION_NAMES, &size);
+    if (names != NULL) {
+        idx->names = malloc(sizeof(roke_frame_reader_t));
+        if (idx->names == NULL ||
+            roke_frame_reader_init(idx->names, names, size, ncache)!=0 ||
+            (uint64_t) idx->names->nframes * idx->names->frame_entries < idx->nitems) {
+            fprintf(stderr, "error: unable to read compressed names %s\n", path);
+            roke_index_close(idx);
+            return 1;
+        }
+    }
+
+    return 0;
+
+  map_error:
+    fclose(idx->fp);
+    idx->fp = NULL;
+
+    return 1;
+
+}
+
+
+int
+roke_index_close(roke_index_t* idx)
+{
+    int rc;
+
+    if (idx->data != NULL) {
+        rc = munmap(idx->data, idx->fsize);
+        if (rc != 0) {
+            fprintf(stderr, "warning: error unmapping directory index.");
+        }
+    }
+    idx->data = NULL;
+
+    if (idx->names != NULL) {
+        roke_frame_reader_free(idx->names);
+        free(idx->names);
+    }
+    idx->names = NULL;
+
+    if (idx->fp != NULL) {
+        fclose(idx->fp);
+    }
+    idx->fp = NULL;
+
+    return 0;
+}
+
+
+/**
+ * @brief get a pointer to a section of a mapped index
+ * @param tag  the section to find
+ * @param size updated to contain the size of the section, may be NULL
+ * @return NULL if the index does not contain the section
+ */
+uint8_t*
+roke_index_section(
+    roke_index_t* idx,
+    uint32_t tag,
+    uint64_t* size)
+{
+    uint32_t i;
+    if (size != NULL) {
+        *size = 0;
+    }
+    for (i=0; i<idx->nsections; i++) {
+        roke_section_t* sec = &idx->sections[i];
+        if (sec->tag == tag && sec->offset + sec->size <= idx->fsize) {
+            if (size != NULL) {
+                *size = sec->size;
+            }
+            return ((uint8_t*)idx->data) + sec->offset;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief find a section of an index without mapping the index
+ * @param path    the path to a binary index
+ * @param tag     the section to find
+ * @param section updated to contain the section table entry
+ * @return non-zero if the index does not contain the section
+ */
+int
+roke_index_find_section(
+    const uint8_t* path,
+    uint32_t tag,
+    roke_section_t* section)
+{
+    uint32_t header[4];
+    roke_section_t sections[ROKE_SECTION_MAX];
+    uint32_t i;
+    int err = 1;
+
+    FILE* fp = fopen_safe(path, "rb");
+    if (fp == NULL) {
+        return 1;
+    }
+
+    if (fread(header, sizeof(uint32_t), 4, fp) != 4 ||
+        memcmp(header, "ROKE", 4) != 0 || header[2] == 0) {
+        goto error;
+    }
+
+    uint32_t nsections = (header[3] < ROKE_SECTION_MAX) ? header[3] : ROKE_SECTION_MAX;
+    if (fread(sections, sizeof(roke_section_t), nsections, fp) != nsections) {
+        goto error;
+    }
+
+    for (i=0; i<nsections; i++) {
+        if (sections[i].tag == tag) {
+            *section = sections[i];
+            err = 0;
+            break;
+        }
+    }
+
+  error:
+    fclose(fp);
+    return err;
+}
+
+/**
+ * @brief read the name sketch of an index without mapping the index
+ * @param path  the path to a binary index
+ * @param bloom initialized to contain the sketch
+ * @return non-zero if the index has no sketch. the bloom filter is
+ *         initialized to accept every pattern in that case.
+ */
+int
+roke_index_read_sketch(
+    const uint8_t* path,
+    roke_bloom_t* bloom)
+{
+    roke_section_t section;
+
+    roke_bloom_wrap(bloom, NULL, 0);
+
+    if (roke_index_find_section(path, ROKE_SECTION_SKETCH, &section) != 0 ||
+        section.size > ROKE_BLOOM_MAX_SIZE ||
+        (section.size & (section.size - 1)) != 0) {
+        return 1;
+    }
+
+    FILE* fp = fopen_safe(path, "rb");
+    if (fp == NULL) {
+        return 1;
+    }
+
+    if (roke_bloom_init(bloom, (size_t) section.size) != 0) {
+        fclose(fp);
+        return 1;
+    }
+
+    fseek(fp, (long) section.offset, SEEK_SET);
+    if (fread(bloom->bits, sizeof(uint8_t), bloom->nbytes, fp) != bloom->nbytes) {
+        roke_bloom_free(bloom);
+        fclose(fp);
+        return 1;
+    }
+
+    fclose(fp);
+    return 0;
+}
+
+/**
+ * @brief the ROKE_TYPE_* of an entry, zero for other kinds of file
+ *
+ * without metadata an entry is a directory or a file by the index which
+ * holds it.
+ */
+static inline uint32_t
+_roke_entry_type(roke_index_t* idx, uint32_t i, int is_dir)
+{
+    if (idx->mode == NULL) {
+        return is_dir ? ROKE_TYPE_DIR : ROKE_TYPE_FILE;
+    }
+    switch (idx->mode[i] & S_IFMT) {
+        case S_IFDIR: return ROKE_TYPE_DIR;
+        case S_IFLNK: return ROKE_TYPE_LINK;
+        case S_IFREG: return ROKE_TYPE_FILE;
+        default: return 0;
+    }
+}
+
+/**
+ * @brief test an entry against the metadata filters
+ * @param is_dir true if the index is a directory index
+ * @return non-zero if the entry passes all filters
+ *
+ * the caller must ensure the columns required by the filters exist.
+ * without a mode column the type is determined by the kind of index.
+ */
+static inline int
+_roke_filter_match(
+    const roke_locate_options_t* opts,
+    roke_index_t* idx,
+    uint32_t i,
+    int is_dir)
+{
+    uint32_t filters = opts->filters;
+
+    if (filters&ROKE_FILTER_NEWER && (int64_t) idx->mtime[i] < opts->newer) {
+        return 0;
+    }
+    if (filters&ROKE_FILTER_OLDER && (int64_t) idx->mtime[i] >= opts->older) {
+        return 0;
+    }
+    if (filters&ROKE_FILTER_SIZE_MIN && idx->size[i] < opts->size_min) {
+        return 0;
+    }
+    if (filters&ROKE_FILTER_SIZE_MAX && idx->size[i] > opts->size_max) {
+        return 0;
+    }
+    if (filters&ROKE_FILTER_TYPE) {
+        if ((_roke_entry_type(idx, i, is_dir) & opts->types) == 0) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/**
+ * @brief test if an index contains the columns needed by the filters
+ */
+static int
+_roke_filter_supported(
+    const roke_locate_options_t* opts,
+    roke_index_t* idx)
+{
+    uint32_t filters = opts->filters;
+    if ((filters&(ROKE_FILTER_NEWER|ROKE_FILTER_OLDER)) && idx->mtime == NULL) {
+        return 0;
+    }
+    if ((filters&(ROKE_FILTER_SIZE_MIN|ROKE_FILTER_SIZE_MAX)) && idx->size == NULL) {
+        return 0;
+    }
+    // without a mode column a link can not be told from a file
+    if ((filters&ROKE_FILTER_TYPE) && (opts->types&ROKE_TYPE_LINK) && idx->mode == NULL) {
+        return 0;
+    }
+    return 1;
+}
+
+/**
+ * @brief find the directory of an index with a given absolute path
+ * @param didx a directory index with subtree ranges
+ * @param path an absolute path
+ * @param dir  set to the id of the directory
+ * @return non-zero if the path is not contained in the index
+ *
+ * if the path is an ancestor of the root of the index, the root is
+ * returned. otherwise the path is resolved one component at a time,
+ * skipping over the subtree of every sibling which does not match.
+ */
+int
+roke_index_resolve_dir(
+    roke_index_t* didx,
+    const uint8_t* path,
+    uint32_t* dir)
+{
+    if (didx->nitems == 0 || didx->ranges == NULL) {
+        return 1;
+    }
+
+    uint16_t namelen;
+    const uint8_t* root = roke_index_name(didx, 0, &namelen);
+    size_t rootlen = namelen;
+    size_t pathlen = strlen((const char*) path);
+
+    // ignore trailing separators, except for the file system root
+    while (rootlen > 1 && root[rootlen-1] == SEP) {
+        rootlen--;
+    }
+    while (pathlen > 1 && path[pathlen-1] == SEP) {
+        pathlen--;
+    }
+
+    *dir = 0;
+
+    if (pathlen <= rootlen) {
+        // the path is the root, or an ancestor of the root
+        if (memcmp(path, root, pathlen) == 0 &&
+            (pathlen == rootlen || root[pathlen] == SEP || path[pathlen-1] == SEP)) {
+            return 0;
+        }
+        return 1;
+    }
+
+    if (memcmp(path, root, rootlen) != 0 ||
+        (path[rootlen] != SEP && root[rootlen-1] != SEP)) {
+        return 1;
+    }
+
+    const uint8_t* p = path + rootlen;
+    const uint8_t* end = path + pathlen;
+    uint32_t cur = 0;
+
+    while (p < end) {
+        while (p < end && *p == SEP) {
+            p++;
+        }
+        const uint8_t* q = p;
+        while (q < end && *q != SEP) {
+            q++;
+        }
+        if (q == p) {
+            break;
+        }
+        size_t len = (size_t) (q - p);
+
+        // the children of cur are the first directory after cur and
+        // every directory following the end of a sibling subtree
+        uint32_t c = cur + 1;
+        uint32_t cur_end = didx->ranges[cur].dir_end;
+        while (c < cur_end) {
+            const uint8_t* name = roke_index_name(didx, c, &namelen);
+            if (namelen == len && memcmp(name, p, len) == 0) {
+                break;
+            }
+            if (didx->ranges[c].dir_end <= c) {
+                // corrupt ranges would never terminate
+                return 1;
+            }
+            c = didx->ranges[c].dir_end;
+        }
+        if (c >= cur_end || c >= didx->nitems) {
+            return 1;
+        }
+        cur = c;
+        p = q;
+    }
+
+    *dir = cur;
+    return 0;
+}
+
+/**
+ * @brief write the absolute path of an entry
+ * @param fidx the index containing the entry
+ * @param didx the directory index, which may be fidx
+ * @return the length of the path, zero if it does not fit in dst
+ *
+ * the path is built from the entry up to the root of the index, copying
+ * every name as it is found so that a compressed name is not needed
+ * after its frame has been evicted from the cache.
+ */
+static size_t
+_roke_index_path(
+    roke_index_t* fidx,
+    roke_index_t* didx,
+    uint32_t i,
+    uint8_t* dst,
+    size_t dstlen)
+{
+    roke_index_t* idx = fidx;
+    size_t pos = dstlen - 1;
+    uint32_t depth;
+
+    dst[pos] = '\0';
+
+    for (depth=0; depth<ROKE_RECURSION_DEPTH; depth++) {
+        uint16_t len;
+        const uint8_t* name = roke_index_name(idx, i, &len);
+
+        // separate the name from its child, unless it ends in a separator
+        int sep = (depth > 0 && (len == 0 || name[len-1] != SEP));
+        if ((size_t) len + sep > pos) {
+            return 0;
+        }
+        if (sep) {
+            dst[--pos] = SEP;
+        }
+        pos -= len;
+        memcpy(dst + pos, name, len);
+
+        if (idx == didx && i == 0) {
+            break;
+        }
+
+        // every entry outside of the index is treated as a child of the root
+        uint32_t parent = idx->entries[i].index;
+        idx = didx;
+        i = (parent < didx->nitems) ? parent : 0;
+    }
+
+    size_t n = dstlen - 1 - pos;
+    memmove(dst, dst + pos, n + 1);
+    return n;
+}
+
+/**
+ * @brief the state of the query parser
+ */
+typedef struct roke_qparser {
+    const uint8_t* p;
+    const uint8_t* end;
+    int flags;          // match flags applied to every pattern
+    int64_t now;        // relative times are measured from now
+    int tok;            // the current token: 0 at the end, '(', ')' or 'w'
+    int quoted;         // the word contained quotes, it is never a keyword
+    uint8_t word[ROKE_PATH_MAX];
+    size_t wordlen;
+    uint32_t filters;
+    uint32_t types;
+} roke_qparser_t;
+
+static void
+_roke_qnode_free(roke_qnode_t* node)
+{
+    uint32_t i;
+    if (node == NULL) {
+        return;
+    }
+    for (i=0; i<node->nchildren; i++) {
+        _roke_qnode_free(node->children[i]);
+    }
+    free(node->children);
+    if (node->op == ROKE_QOP_NAME || node->op == ROKE_QOP_PATH) {
+        string_matcher_free(&node->matcher);
+    }
+    free(node);
+}
+
+static roke_qnode_t*
+_roke_qnode_new(int op)
+{
+    roke_qnode_t* node = calloc(1, sizeof(roke_qnode_t));
+    if (node != NULL) {
+        node->op = op;
+        roke_locate_options_init(&node->filter);
+    }
+    return node;
+}
+
+static int
+_roke_qnode_add(roke_qnode_t* node, roke_qnode_t* child)
+{
+    roke_qnode_t** tmp = realloc(node->children,
+        (node->nchildren + 1) * sizeof(roke_qnode_t*));
+    if (tmp == NULL) {
+        return 1;
+    }
+    node->children = tmp;
+    node->children[node->nchildren++] = child;
+    return 0;
+}
+
+/**
+ * @brief read the next token
+ *
+ * words end at white space or a parenthesis. double quotes may be used
+ * anywhere in a word to include either, and are removed.
+ */
+static int
+_roke_qparser_next(roke_qparser_t* qp)
+{
+    int quote = 0;
+
+    while (qp->p < qp->end && isspace(*qp->p)) {
+        qp->p++;
+    }
+    qp->wordlen = 0;
+    qp->quoted = 0;
+
+    if (qp->p >= qp->end) {
+        return (qp->tok = 0);
+    }
+    if (*qp->p == '(' || *qp->p == ')') {
+        return (qp->tok = *qp->p++);
+    }
+
+    while (qp->p < qp->end) {
+        uint8_t c = *qp->p;
+        if (c == '"') {
+            quote = !quote;
+            qp->quoted = 1;
+            qp->p++;
+            continue;
+        }
+        if (!quote && (isspace(c) || c == '(' || c == ')')) {
+            break;
+        }
+        if (qp->wordlen + 1 >= sizeof(qp->word)) {
+            return (qp->tok = -1);
+        }
+        qp->word[qp->wordlen++] = c;
+        qp->p++;
+    }
+    qp->word[qp->wordlen] = '\0';
+    return (qp->tok = (quote) ? -1 : 'w');
+}
+
+static int
+_roke_qparser_keyword(roke_qparser_t* qp, const char* keyword)
+{
+    return qp->tok == 'w' && !qp->quoted && strcmp((char*) qp->word, keyword) == 0;
+}
+
+static int
+_roke_has_prefix(const uint8_t* str, const char* prefix)
+{
+    return strncmp((const char*) str, prefix, strlen(prefix)) == 0;
+}
+
+/**
+ * @brief compile the current word into a predicate
+ *
+ *   name:PATTERN   the name contains PATTERN, or matches it as a glob
+ *                  if it contains * ? or [
+ *   path:PATTERN   the same, for the full path
+ *   name~REGEX     the name matches a regular expression
+ *   path~REGEX     the full path matches a regular expression
+ *   size>N size<N size=N
+ *   newer:T older:T
+ *   type:fdl
+ *
+ * any other word is a name pattern.
+ */
+static roke_qnode_t*
+_roke_qparser_predicate(roke_qparser_t* qp)
+{
+    const uint8_t* w = qp->word;
+    int op = ROKE_QOP_NAME;
+    int kind = -1;
+    roke_qnode_t* node = NULL;
+    char size[64];
+    int err = 0;
+
+    if (_roke_has_prefix(w, "name:") || _roke_has_prefix(w, "path:")) {
+        op = (w[0] == 'n') ? ROKE_QOP_NAME : ROKE_QOP_PATH;
+        w += 5;
+    } else if (_roke_has_prefix(w, "name~") || _roke_has_prefix(w, "path~")) {
+        op = (w[0] == 'n') ? ROKE_QOP_NAME : ROKE_QOP_PATH;
+        kind = ROKE_REGEX;
+        w += 5;
+    } else if (_roke_has_prefix(w, "size>") || _roke_has_prefix(w, "size<") ||
+               _roke_has_prefix(w, "size=") || _roke_has_prefix(w, "newer:") ||
+               _roke_has_prefix(w, "older:") || _roke_has_prefix(w, "type:")) {
+        op = ROKE_QOP_META;
+    }
+
+    node = _roke_qnode_new(op);
+    if (node == NULL) {
+        return NULL;
+    }
+
+    if (op == ROKE_QOP_META) {
+        roke_locate_options_t* f = &node->filter;
+        const char* value = strpbrk((const char*) w, ":<>=") + 1;
+        if (w[0] == 's') {
+            // size<N and size>N are strict, as with the --size option
+            snprintf(size, sizeof(size), "%s%s",
+                (w[4] == '>') ? "+" : (w[4] == '<') ? "-" : "", value);
+            err = roke_parse_size_filter(size, f);
+        } else if (w[0] == 'n') {
+            err = roke_parse_time_filter(value, qp->now, &f->newer);
+            f->filters |= ROKE_FILTER_NEWER;
+        } else if (w[0] == 'o') {
+            err = roke_parse_time_filter(value, qp->now, &f->older);
+            f->filters |= ROKE_FILTER_OLDER;
+        } else {
+            err = roke_parse_type_filter(value, f);
+        }
+        qp->filters |= f->filters;
+        qp->types |= f->types;
+    } else {
+        if (kind < 0) {
+            kind = (strpbrk((const char*) w, "*?[") != NULL) ? ROKE_GLOB : 0;
+        }
+        int flags = (qp->flags & (ROKE_CASE_INSENSITIVE|ROKE_NORMALIZE)) | kind;
+        err = string_matcher_init(&node->matcher, w, strlen((const char*) w), flags);
+        if (err) {
+            // the matcher is only freed with the node if it was initialized
+            node->op = ROKE_QOP_META;
+        }
+    }
+
+    if (err) {
+        fprintf(stderr, "error: invalid query term: %s\n", qp->word);
+        _roke_qnode_free(node);
+        return NULL;
+    }
+    return node;
+}
+
+static roke_qnode_t* _roke_qparser_or(roke_qparser_t* qp);
+
+// unary := NOT unary | ( or ) | predicate
+static roke_qnode_t*
+_roke_qparser_unary(roke_qparser_t* qp)
+{
+    roke_qnode_t* node = NULL;
+    roke_qnode_t* child = NULL;
+
+    if (_roke_qparser_keyword(qp, "NOT")) {
+        _roke_qparser_next(qp);
+        child = _roke_qparser_unary(qp);
+        if (child == NULL) {
+            return NULL;
+        }
+        node = _roke_qnode_new(ROKE_QOP_NOT);
+        if (node == NULL || _roke_qnode_add(node, child)) {
+            _roke_qnode_free(child);
+            _roke_qnode_free(node);
+            return NULL;
+        }
+        return node;
+    }
+
+    if (qp->tok == '(') {
+        _roke_qparser_next(qp);
+        node = _roke_qparser_or(qp);
+        if (node == NULL) {
+            return NULL;
+        }
+        if (qp->tok != ')') {
+            fprintf(stderr, "error: invalid query: expected )\n");
+            _roke_qnode_free(node);
+            return NULL;
+        }
+        _roke_qparser_next(qp);
+        return node;
+    }
+
+    if (qp->tok != 'w' || _roke_qparser_keyword(qp, "AND") ||
+            _roke_qparser_keyword(qp, "OR")) {
+        fprintf(stderr, "error: invalid query: expected a term\n");
+        return NULL;
+    }
+    node = _roke_qparser_predicate(qp);
+    _roke_qparser_next(qp);
+    return node;
+}
+
+/**
+ * @brief parse a list of operands joined by an operator
+ * @param op ROKE_QOP_AND or ROKE_QOP_OR. AND binds more tightly, and
+ *           may be left out between two terms
+ */
+static roke_qnode_t*
+_roke_qparser_list(roke_qparser_t* qp, int op)
+{
+    const char* keyword = (op == ROKE_QOP_AND) ? "AND" : "OR";
+    roke_qnode_t* node = NULL;
+    roke_qnode_t* child;
+
+    while (1) {
+        child = (op == ROKE_QOP_AND) ? _roke_qparser_unary(qp) : _roke_qparser_list(qp, ROKE_QOP_AND);
+        if (child == NULL) {
+            goto error;
+        }
+        if (node == NULL) {
+            node = child;
+        } else {
+            if (node->op != op) {
+                roke_qnode_t* list = _roke_qnode_new(op);
+                if (list == NULL || _roke_qnode_add(list, node)) {
+                    _roke_qnode_free(list);
+                    goto error;
+                }
+                node = list;
+            }
+            if (_roke_qnode_add(node, child)) {
+                goto error;
+            }
+        }
+        child = NULL;
+
+        if (_roke_qparser_keyword(qp, keyword)) {
+            _roke_qparser_next(qp);
+        } else if (op == ROKE_QOP_OR || qp->tok == 0 || qp->tok == ')' ||
+                   _roke_qparser_keyword(qp, "OR")) {
+            break;
+        }
+        // otherwise two terms next to each other are joined by AND
+    }
+    return node;
+
+  error:
+    _roke_qnode_free(child);
+    _roke_qnode_free(node);
+    return NULL;
+}
+
+static roke_qnode_t*
+_roke_qparser_or(roke_qparser_t* qp)
+{
+    return _roke_qparser_list(qp, ROKE_QOP_OR);
+}
+
+/**
+ * @brief estimate the cost of every node and order children by cost
+ *
+ * metadata is a column lookup. names are read directly from the index,
+ * while paths must be built from every parent first. regular expressions
+ * are the slowest kind of pattern.
+ */
+static uint32_t
+_roke_query_plan(roke_qnode_t* node)
+{
+    uint32_t i, j;
+
+    switch (node->op) {
+        case ROKE_QOP_META:
+            node->cost = 1;
+            break;
+        case ROKE_QOP_NAME:
+        case ROKE_QOP_PATH:
+            switch (node->matcher.flags&ROKE_MATCH_MASK) {
+                case ROKE_REGEX: node->cost = 8; break;
+                case ROKE_GLOB: node->cost = 3; break;
+                default: node->cost = 2; break;
+            }
+            if (node->op == ROKE_QOP_PATH) {
+                node->cost += 2;
+            }
+            break;
+        default:
+            node->cost = 0;
+            for (i=0; i<node->nchildren; i++) {
+                node->cost += _roke_query_plan(node->children[i]);
+            }
+            // a stable insertion sort, the lists are short
+            for (i=1; i<node->nchildren; i++) {
+                roke_qnode_t* t = node->children[i];
+                for (j=i; j>0 && node->children[j-1]->cost > t->cost; j--) {
+                    node->children[j] = node->children[j-1];
+                }
+                node->children[j] = t;
+            }
+            break;
+    }
+    return node->cost;
+}
+
+/**
+ * @brief compile a query
+ * @param text  the query, see _roke_qparser_predicate for the terms.
+ *              terms are combined with AND, OR, NOT and parentheses, and
+ *              terms next to each other are joined by AND
+ * @param flags ROKE_CASE_INSENSITIVE and ROKE_NORMALIZE apply to every
+ *              pattern
+ * @return non-zero if the query is invalid
+ */
+int
+roke_query_compile(
+    roke_query_t** query,
+    const uint8_t* text,
+    size_t len,
+    int flags)
+{
+    roke_qparser_t* qp = NULL;
+    roke_query_t* q = NULL;
+
+    *query = NULL;
+    qp = calloc(1, sizeof(roke_qparser_t));
+    q = calloc(1, sizeof(roke_query_t));
+    if (qp == NULL || q == NULL) {
+        goto error;
+    }
+
+    qp->p = text;
+    qp->end = text + len;
+    qp->flags = flags;
+    qp->now = (int64_t) time(NULL);
+
+    _roke_qparser_next(qp);
+    if (qp->tok == 0) {
+        fprintf(stderr, "error: empty query\n");
+        goto error;
+    }
+    q->root = _roke_qparser_or(qp);
+    if (q->root == NULL) {
+        goto error;
+    }
+    if (qp->tok != 0) {
+        fprintf(stderr, "error: invalid query: unexpected %s\n",
+            (qp->tok == 'w') ? (char*) qp->word : (qp->tok < 0) ? "quote" : ")");
+        goto error;
+    }
+    q->filters = qp->filters;
+    q->types = qp->types;
+
+    _roke_query_plan(q->root);
+
+    // a name pattern required by the whole query can be matched first
+    if (q->root->op == ROKE_QOP_NAME) {
+        q->prefilter = &q->root->matcher;
+    } else if (q->root->op == ROKE_QOP_AND) {
+        uint32_t i;
+        for (i=0; i<q->root->nchildren; i++) {
+            if (q->root->children[i]->op == ROKE_QOP_NAME) {
+                q->prefilter = &q->root->children[i]->matcher;
+                break;
+            }
+        }
+    }
+
+    free(qp);
+    *query = q;
+    return 0;
+
+  error:
+    free(qp);
+    roke_query_free(q);
+    return 1;
+}
+
+void
+roke_query_free(roke_query_t* query)
+{
+    if (query != NULL) {
+        _roke_qnode_free(query->root);
+        free(query);
+    }
+}
+
+/**
+ * @brief an entry being tested against a query
+ */
+typedef struct roke_qctx {
+    roke_index_t* fidx;
+    roke_index_t* didx;
+    uint32_t i;
+    uint8_t* path;
+    size_t pathcap;
+    size_t pathlen;     // zero until the path is needed
+} roke_qctx_t;
+
+static int
+_roke_query_eval(const roke_qnode_t* node, roke_qctx_t* ctx)
+{
+    uint32_t i;
+    uint16_t len;
+    const uint8_t* name;
+
+    switch (node->op) {
+        case ROKE_QOP_AND:
+            for (i=0; i<node->nchildren; i++) {
+                if (!_roke_query_eval(node->children[i], ctx)) {
+                    return 0;
+                }
+            }
+            return 1;
+        case ROKE_QOP_OR:
+            for (i=0; i<node->nchildren; i++) {
+                if (_roke_query_eval(node->children[i], ctx)) {
+                    return 1;
+                }
+            }
+            return 0;
+        case ROKE_QOP_NOT:
+            return !_roke_query_eval(node->children[0], ctx);
+        case ROKE_QOP_META:
+            return _roke_filter_match(&node->filter, ctx->fidx, ctx->i,
+                ctx->fidx == ctx->didx);
+        case ROKE_QOP_NAME:
+            if (node->matcher.flags&ROKE_NORMALIZE && ctx->fidx->norm != NULL) {
+                size_t normlen;
+                name = roke_index_norm_name(ctx->fidx, ctx->i, &normlen);
+                return string_matcher_match_folded((string_matcher_t*) &node->matcher,
+                    name, normlen)==0;
+            }
+            name = roke_index_name(ctx->fidx, ctx->i, &len);
+            return string_matcher_match((string_matcher_t*) &node->matcher, name, len)==0;
+        case ROKE_QOP_PATH:
+            if (ctx->pathlen == 0) {
+                ctx->pathlen = _roke_index_path(ctx->fidx, ctx->didx, ctx->i,
+                    ctx->path, ctx->pathcap);
+                if (ctx->pathlen == 0) {
+                    return 0;
+                }
+            }
+            return string_matcher_match((string_matcher_t*) &node->matcher,
+                ctx->path, ctx->pathlen)==0;
+        default:
+            return 0;
+    }
+}
+
+/**
+ * @brief test if an entry matches a query
+ * @param path    a buffer for the path of the entry
+ * @param pathlen the size of the path buffer
+ * @param len     set to the length of the path if it was built, else zero
+ * @return non-zero if the entry matches
+ */
+int
+roke_query_match(
+    const roke_query_t* query,
+    roke_index_t* fidx,
+    roke_index_t* didx,
+    uint32_t i,
+    uint8_t* path,
+    size_t pathlen,
+    size_t* len)
+{
+    roke_qctx_t ctx = {fidx, didx, i, path, pathlen, 0};
+    int m = _roke_query_eval(query->root, &ctx);
+    *len = ctx.pathlen;
+    return m;
+}
+
+/**
+ * @brief get the names of the block of entries beginning at begin
+ * @param end     the end of the range being scanned
+ * @param strings set to the address which entry offsets are relative to
+ * @param size    set to the number of bytes at strings
+ * @return the end of the block
+ *
+ * a block of compressed names never spans more than one frame.
+ */
+static uint32_t
+_roke_index_block(
+    roke_index_t* idx,
+    uint32_t begin,
+    uint32_t end,
+    const uint8_t** strings,
+    size_t* size)
+{
+    uint32_t block_end = (end - begin > ROKE_MATCH_BLOCK) ? begin + ROKE_MATCH_BLOCK : end;
+
+    if (idx->names == NULL) {
+        *strings = idx->strings;
+        *size = idx->fsize;
+        return block_end;
+    }
+
+    uint32_t frame = begin / idx->names->frame_entries;
+    uint64_t frame_end = ((uint64_t) frame + 1) * idx->names->frame_entries;
+    if (block_end > frame_end) {
+        block_end = (uint32_t) frame_end;
+    }
+
+    uint32_t usize;
+    *strings = roke_frame_reader_get(idx->names, frame, &usize);
+    *size = (*strings == NULL) ? 0 : usize;
+    if (*strings == NULL) {
+        *strings = (const uint8_t*) "";
+    }
+    return block_end;
+}
+
+/**
+ * @brief a growable buffer of formatted results
+ */
+typedef struct roke_buffer {
+    uint8_t* data;
+    size_t size;
+    size_t capacity;
+    // the size of data after each result, as size_t, or NULL. kept for
+    // results which are trimmed to a limit, whose separators may also
+    // appear in a name
+    struct roke_buffer* ends;
+} roke_buffer_t;
+
+static int
+_roke_buffer_append(roke_buffer_t* buf, const uint8_t* data, size_t len)
+{
+    if (buf->size + len > buf->capacity) {
+        size_t n = (buf->capacity) ? buf->capacity : 4096;
+        while (n < buf->size + len) {
+            n *= 2;
+        }
+        uint8_t* tmp = realloc(buf->data, n);
+        if (tmp == NULL) {
+            return 1;
+        }
+        buf->data = tmp;
+        buf->capacity = n;
+    }
+    memcpy(buf->data + buf->size, data, len);
+    buf->size += len;
+    return 0;
+}
+
+/**
+ * @brief append a result in the format of roke_locate_options_t.format
+ * @param suffix appended to the path, the separator of a directory
+ */
+static int
+_roke_buffer_result(
+    roke_buffer_t* buf,
+    int format,
+    const uint8_t* path,
+    size_t len,
+    const uint8_t* suffix,
+    size_t suffix_len)
+{
+    int err;
+    if (format == ROKE_FORMAT_RECORDS) {
+        uint32_t size = (uint32_t) (len + suffix_len);
+        err = _roke_buffer_append(buf, (const uint8_t*) &size, sizeof(size)) ||
+            _roke_buffer_append(buf, path, len) ||
+            _roke_buffer_append(buf, suffix, suffix_len);
+    } else {
+        uint8_t end = (format == ROKE_FORMAT_NUL) ? '\0' : '\n';
+        err = _roke_buffer_append(buf, path, len) ||
+            _roke_buffer_append(buf, suffix, suffix_len) ||
+            _roke_buffer_append(buf, &end, 1);
+    }
+    if (!err && buf->ends != NULL) {
+        err = _roke_buffer_append(buf->ends, (const uint8_t*) &buf->size, sizeof(size_t));
+    }
+    return err;
+}
+
+/**
+ * @brief append the first len bytes of the results of src to dst
+ *
+ * the ends of the results are appended to the ends of dst, if both
+ * buffers keep them.
+ */
+static int
+_roke_buffer_append_results(roke_buffer_t* dst, const roke_buffer_t* src, size_t len)
+{
+    size_t base = dst->size;
+    size_t i;
+
+    if (_roke_buffer_append(dst, src->data, len)) {
+        return 1;
+    }
+    if (dst->ends == NULL || src->ends == NULL) {
+        return 0;
+    }
+    const size_t* ends = (const size_t*) src->ends->data;
+    for (i=0; i<src->ends->size / sizeof(size_t) && ends[i] <= len; i++) {
+        size_t end = base + ends[i];
+        if (_roke_buffer_append(dst->ends, (const uint8_t*) &end, sizeof(end))) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief write a result in the format of roke_locate_options_t.format
+ */
+static int
+_roke_output_result(roke_output_t* out, int format, const uint8_t* path, size_t len)
+{
+    if (format == ROKE_FORMAT_RECORDS) {
+        uint32_t size = (uint32_t) len;
+        return roke_output_write(out, &size, sizeof(size)) ||
+            roke_output_write(out, path, len);
+    }
+    uint8_t end = (format == ROKE_FORMAT_NUL) ? '\0' : '\n';
+    return roke_output_write(out, path, len) || roke_output_write(out, &end, 1);
+}
+
+/**
+ * @brief the number of bytes used by the first n results of a buffer
+ *        which keeps the ends of its results
+ */
+static size_t
+_roke_buffer_results(const roke_buffer_t* buf, int n)
+{
+    size_t nends = buf->ends->size / sizeof(size_t);
+    if (n <= 0) {
+        return 0;
+    }
+    if ((size_t) n > nends) {
+        return buf->size;
+    }
+    return ((const size_t*) buf->ends->data)[n - 1];
+}
+
+// the number of results checked at once by ROKE_FILTER_EXISTS
+#define ROKE_VERIFY_WINDOW 1024
+
+/**
+ * @brief formatted results which are checked to exist before they are
+ *        written
+ *
+ * the results are taken a window at a time, and the paths of a window
+ * are checked together by the threads of exists. the limit applies to
+ * the results which exist, so a window holds no more results than are
+ * needed to reach it.
+ */
+typedef struct roke_verify {
+    roke_exists_t exists;
+    roke_output_t* out;
+    int format;
+    int limit;              // zero for no limit
+    int count;              // the number of results written
+    int done;               // set once the limit is reached or a write failed
+    uint32_t skip;          // results to drop unchecked, already written
+    const uint8_t* paths[ROKE_VERIFY_WINDOW];
+    uint32_t lens[ROKE_VERIFY_WINDOW];
+    const uint8_t* results[ROKE_VERIFY_WINDOW];
+    size_t sizes[ROKE_VERIFY_WINDOW];
+    uint8_t found[ROKE_VERIFY_WINDOW];
+} roke_verify_t;
+
+/**
+ * @brief start checking the results written to out
+ * @return NULL on failure
+ */
+static roke_verify_t*
+_roke_verify_open(roke_output_t* out, const roke_locate_options_t* opts)
+{
+    roke_verify_t* v = calloc(1, sizeof(roke_verify_t));
+
+    if (v == NULL) {
+        return NULL;
+    }
+    // opts->threads sizes the scan. lookups wait on the disk, and keep
+    // their own pool whatever the number of cpus used to scan
+    if (roke_exists_init(&v->exists, ROKE_EXISTS_THREADS)!=0) {
+        free(v);
+        return NULL;
+    }
+    v->out = out;
+    v->format = opts->format;
+    v->limit = opts->limit;
+    return v;
+}
+
+static void
+_roke_verify_close(roke_verify_t* v)
+{
+    if (v != NULL) {
+        roke_exists_free(&v->exists);
+        free(v);
+    }
+}
+
+/**
+ * @brief write the results of a buffer which still exist, in order
+ * @param data results written by _roke_buffer_result
+ * @return non-zero once no more results are wanted
+ */
+static int
+_roke_verify_write(roke_verify_t* v, const uint8_t* data, size_t len)
+{
+    size_t pos = 0;
+    uint32_t i;
+
+    while (pos < len && !v->done) {
+        uint32_t n = 0, max = ROKE_VERIFY_WINDOW;
+        if (v->limit > 0 && (uint32_t) (v->limit - v->count) < max) {
+            max = (uint32_t) (v->limit - v->count);
+        }
+        while (n < max && pos < len) {
+            const uint8_t* path = data + pos;
+            const uint8_t* result = data + pos;
+            size_t plen, size;
+            if (v->format == ROKE_FORMAT_RECORDS) {
+                uint32_t rlen = 0;
+                size_t left = len - pos - sizeof(rlen);
+                if (len - pos < sizeof(rlen)) {
+                    pos = len;
+                    break;
+                }
+                memcpy(&rlen, path, sizeof(rlen));
+                path += sizeof(rlen);
+                plen = (rlen < left) ? rlen : left;
+                size = sizeof(rlen) + plen;
+            } else {
+                uint8_t end = (v->format == ROKE_FORMAT_NUL) ? '\0' : '\n';
+                const uint8_t* nl = memchr(path, end, len - pos);
+                plen = (nl != NULL) ? (size_t) (nl - path) : len - pos;
+                size = plen + (nl != NULL);
+            }
+            pos += size;
+            if (v->skip > 0) {
+                // written from an earlier scan of the same index
+                v->skip--;
+                continue;
+            }
+            v->paths[n] = path;
+            v->lens[n] = (uint32_t) plen;
+            v->results[n] = result;
+            v->sizes[n] = size;
+            n++;
+        }
+        if (n == 0) {
+            continue;
+        }
+
+        roke_exists_check(&v->exists, v->paths, v->lens, n, v->found);
+
+        for (i=0; i<n && !v->done; i++) {
+            if (!v->found[i]) {
+                continue;
+            }
+            if (roke_output_write(v->out, v->results[i], v->sizes[i])) {
+                v->done = 1;
+                break;
+            }
+            v->count++;
+            v->done = (v->limit > 0 && v->count >= v->limit);
+        }
+    }
+    return v->done;
+}
+
+/**
+ * @brief the destination of formatted results, an output or a buffer
+ *
+ * ranked results are offered to a heap instead, and written once every
+ * index has been searched.
+ */
+typedef struct roke_sink {
+    roke_output_t* out;
+    roke_buffer_t* buf;
+    roke_topk_t* topk;      // ranked results, or NULL
+    uint32_t index;         // the position of the index in the results
+    roke_verify_t* verify;  // checks the results written to out, or NULL
+} roke_sink_t;
+
+/**
+ * @brief write the first len bytes of the results of a buffer
+ */
+static int
+_roke_sink_write(roke_sink_t* sink, const roke_buffer_t* results, size_t len)
+{
+    const uint8_t* data = results->data;
+    if (sink->buf != NULL) {
+        return _roke_buffer_append_results(sink->buf, results, len);
+    }
+    if (sink->out == NULL) {
+        // ranked results are held by the heap, nothing is written yet
+        return 0;
+    }
+    // stop searching once the reader has gone away, or the verifier has
+    // written enough results
+    int done = (sink->verify != NULL) ? _roke_verify_write(sink->verify, data, len) :
+        roke_output_write(sink->out, data, len);
+    // results are written once their chunk is merged, so that the first
+    // results are not held back by the rest of the scan. the buffer only
+    // batches the results of one chunk
+    return roke_output_flush(sink->out) || done;
+}
+
+/**
+ * @brief non-zero once the results which exist have reached the limit
+ */
+static int
+_roke_sink_done(const roke_sink_t* sink)
+{
+    return sink->verify != NULL && sink->verify->done;
+}
+
+/**
+ * @brief a unit of work which may be cancelled by the thread merging
+ * the results
+ *
+ * work is numbered in output order. once enough results are written,
+ * every item after the last one written is cancelled. a chunk of an
+ * index is also cancelled when the index it belongs to is.
+ */
+typedef struct roke_cancel {
+    roke_mutex_t* lock;
+    const uint32_t* first;  // items at or after this one are cancelled
+    uint32_t item;
+    const struct roke_cancel* parent;
+} roke_cancel_t;
+
+static int
+_roke_cancelled(const roke_cancel_t* cancel)
+{
+    for (; cancel != NULL; cancel = cancel->parent) {
+        roke_mutex_lock(cancel->lock);
+        int cancelled = (cancel->item >= *cancel->first);
+        roke_mutex_unlock(cancel->lock);
+        if (cancelled) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief copy a query, so that it may be used by another thread
+ * @return the number of matchers copied, or -1 on failure
+ */
+static int
+_roke_matchers_clone(
+    string_matcher_t** src,
+    string_matcher_t* matchers,
+    string_matcher_t** strmatch)
+{
+    int n = 0;
+    while (src[n] != NULL) {
+        if (n >= ROKE_SCAN_MAX_PATTERNS ||
+            string_matcher_clone(&matchers[n], src[n])!=0) {
+            while (n-- > 0) {
+                string_matcher_free(&matchers[n]);
+            }
+            strmatch[0] = NULL;
+            return -1;
+        }
+        strmatch[n] = &matchers[n];
+        n++;
+    }
+    strmatch[n] = NULL;
+    return n;
+}
+
+/**
+ * @brief how the results of an index are ranked
+ *
+ * every result is identified by its order: the position of the index,
+ * then directories before files, then the entry. ties are broken by the
+ * order, so the results are the same however the work is divided.
+ */
+typedef struct roke_rank {
+    uint32_t k;                 // results kept, zero to keep every result
+    uint64_t order;             // the position of the index, see ROKE_RANK_ORDER
+    uint32_t root_depth;        // the number of directories above the root
+    // for a fuzzy pattern, the number of pattern bytes matched by the
+    // path of every directory, see _roke_fuzzy_dirstate
+    const uint8_t* dirstate;
+    // otherwise the depth of every directory, see _roke_dir_depths
+    const uint16_t* depths;
+} roke_rank_t;
+
+#define ROKE_RANK_ORDER(index, is_dir, i) \
+    (((uint64_t) (index) << 33) | ((uint64_t) !(is_dir) << 32) | (uint64_t) (i))
+
+/**
+ * @brief match a fuzzy pattern against the path of every directory
+ * @return the number of pattern bytes matched by each directory and the
+ *         separator after it, or NULL on failure
+ *
+ * a directory always comes after its parent in the index, so one pass
+ * extends the state of each parent by the name of its child.
+ */
+static uint8_t*
+_roke_fuzzy_dirstate(const roke_fuzzy_t* fz, roke_index_t* didx)
+{
+    uint8_t* state = malloc((size_t) didx->nitems + 1);
+    const uint8_t sep[] = {SEP};
+    uint32_t d;
+
+    if (state == NULL) {
+        return NULL;
+    }
+    for (d=0; d<didx->nitems; d++) {
+        uint16_t len;
+        const uint8_t* name = roke_index_name(didx, d, &len);
+        uint32_t parent = didx->entries[d].index;
+        uint32_t matched = 0;
+        if (d > 0) {
+            matched = (parent < d) ? state[parent] : state[0];
+        }
+        matched = roke_fuzzy_prefix(fz, matched, name, len);
+        if (len == 0 || name[len - 1] != SEP) {
+            matched = roke_fuzzy_prefix(fz, matched, sep, 1);
+        }
+        state[d] = (uint8_t) matched;
+    }
+    return state;
+}
+
+/**
+ * @brief match and score the names of a block of entries against a
+ *        fuzzy pattern
+ * @param first  the entry at the start of the block
+ * @param scores set to the score of every entry which matches
+ * @return the number of matching entries
+ *
+ * the path of each entry is matched by continuing from the state of its
+ * parent, so only the name is read. the scoring pass is run only on the
+ * names which the word at a time search lets through.
+ */
+static uint32_t
+_roke_fuzzy_block(
+    const roke_fuzzy_t* fz,
+    const roke_rank_t* rank,
+    roke_index_t* fidx,
+    roke_index_t* didx,
+    const uint8_t* strings,
+    size_t size,
+    uint32_t first,
+    uint32_t n,
+    uint64_t* bitmap,
+    int32_t* scores)
+{
+    const roke_entry_t* entries = fidx->entries + first;
+    uint32_t i;
+    uint32_t nmatch = 0;
+
+    memset(bitmap, 0, sizeof(uint64_t) * ((n + 63) / 64));
+    for (i=0; i<n; i++) {
+        const roke_entry_t* ent = &entries[i];
+        if ((uint64_t) ent->offset + ent->namelen >= size) {
+            continue;
+        }
+        // the root is matched from the start of the pattern, entries
+        // outside of the index as children of the root
+        uint32_t matched = 0;
+        if (fidx != didx || first + i > 0) {
+            matched = rank->dirstate[(ent->index < didx->nitems) ? ent->index : 0];
+        }
+        const uint8_t* name = strings + ent->offset;
+        if (roke_fuzzy_prefix(fz, matched, name, ent->namelen) < fz->patlen ||
+            roke_fuzzy_score(fz, matched, name, ent->namelen, &scores[i])!=0) {
+            continue;
+        }
+        bitmap[i >> 6] |= ((uint64_t) 1) << (i & 63);
+        nmatch++;
+    }
+    return nmatch;
+}
+
+/**
+ * @brief match the names of the candidates in a block of entries
+ * @param cand   the next candidate, advanced past the block
+ * @param first  the entry at the start of the block
+ * @param scores set to the score of every entry which matches a fuzzy
+ *               pattern
+ * @return the number of matching entries
+ *
+ * the names are tested the way the block is tested when every entry is
+ * a candidate, but only the candidates are read.
+ */
+static uint32_t
+_roke_match_ids(
+    string_matcher_t* matcher,
+    const roke_fuzzy_t* fuzzy,
+    const roke_rank_t* rank,
+    int norm,
+    roke_index_t* fidx,
+    roke_index_t* didx,
+    const uint32_t** cand,
+    const uint32_t* cand_end,
+    uint32_t first,
+    uint32_t n,
+    uint64_t* bitmap,
+    int32_t* scores)
+{
+    uint32_t nmatch = 0;
+
+    memset(bitmap, 0, sizeof(uint64_t) * ((n + 63) / 64));
+    for (; *cand < cand_end && **cand < first + n; (*cand)++) {
+        uint32_t i = **cand;
+        int m;
+        if (norm) {
+            size_t len;
+            const uint8_t* name = roke_index_norm_name(fidx, i, &len);
+            m = string_matcher_match_folded(matcher, name, len)==0;
+        } else {
+            uint16_t len;
+            const uint8_t* name = roke_index_name(fidx, i, &len);
+            if (fuzzy != NULL) {
+                uint32_t matched = 0;
+                if (fidx != didx || i > 0) {
+                    uint32_t parent = fidx->entries[i].index;
+                    matched = rank->dirstate[(parent < didx->nitems) ? parent : 0];
+                }
+                m = roke_fuzzy_prefix(fuzzy, matched, name, len) >= fuzzy->patlen &&
+                    roke_fuzzy_score(fuzzy, matched, name, len, &scores[i - first])==0;
+            } else {
+                m = len > 0 && string_matcher_match(matcher, name, len)==0;
+            }
+        }
+        if (m) {
+            bitmap[(i - first) >> 6] |= ((uint64_t) 1) << ((i - first) & 63);
+            nmatch++;
+        }
+    }
+    return nmatch;
+}
+
+/**
+ * @brief the number of directories between every directory and the root
+ * @return the depths, or NULL on failure
+ *
+ * a directory always comes after its parent in the index, so one pass
+ * adds one to the depth of each parent.
+ */
+static uint16_t*
+_roke_dir_depths(roke_index_t* didx)
+{
+    uint16_t* depths = malloc(((size_t) didx->nitems + 1) * sizeof(uint16_t));
+    uint32_t d;
+
+    if (depths == NULL) {
+        return NULL;
+    }
+    depths[0] = 0;
+    for (d=1; d<didx->nitems; d++) {
+        // every entry outside of the index is treated as a child of the root
+        uint32_t parent = didx->entries[d].index;
+        uint32_t depth = 1 + ((parent < d) ? depths[parent] : 0);
+        depths[d] = (uint16_t) ((depth < ROKE_RECURSION_DEPTH) ? depth : ROKE_RECURSION_DEPTH);
+    }
+    return depths;
+}
+
+/**
+ * @brief the number of directories between an entry and the root
+ */
+static uint32_t
+_roke_index_depth(
+    const roke_rank_t* rank,
+    roke_index_t* fidx,
+    roke_index_t* didx,
+    uint32_t i)
+{
+    if (fidx == didx && i == 0) {
+        return 0;
+    }
+    uint32_t parent = fidx->entries[i].index;
+    uint32_t depth = 1 + rank->depths[(parent < didx->nitems) ? parent : 0];
+    return (depth < ROKE_RECURSION_DEPTH) ? depth : ROKE_RECURSION_DEPTH;
+}
+
+/**
+ * @brief test if a name is the whole of a literal pattern
+ *
+ * the name is folded the way the matcher folds names. other kinds of
+ * pattern never match exactly.
+ */
+static int
+_roke_rank_exact(
+    string_matcher_t* matcher,
+    roke_index_t* fidx,
+    uint32_t i)
+{
+    const roke_substr_t* sub = &matcher->data.substr;
+    const uint8_t* name;
+    size_t len;
+
+    if (matcher->flags&(ROKE_MATCH_MASK|ROKE_MATCH_MULTI|ROKE_QUERY)) {
+        return 0;
+    }
+    if ((matcher->flags&ROKE_NORMALIZE) && fidx->norm != NULL) {
+        name = roke_index_norm_name(fidx, i, &len);
+    } else {
+        uint16_t namelen;
+        name = roke_index_name(fidx, i, &namelen);
+        len = namelen;
+        if (matcher->flags&(ROKE_CASE_INSENSITIVE|ROKE_NORMALIZE)) {
+            len = _string_matcher_fold(matcher->flags, matcher->scratch, name, len);
+            name = matcher->scratch;
+        }
+    }
+    return len == sub->patlen && memcmp(name, sub->pat, len) == 0;
+}
+
+/**
+ * @brief rank a result by relevance
+ *
+ * names which are exactly the pattern come first, then shallower paths,
+ * then recently modified entries when the index stores metadata.
+ */
+static int64_t
+_roke_rank_score(
+    const roke_rank_t* rank,
+    string_matcher_t* matcher,
+    roke_index_t* fidx,
+    roke_index_t* didx,
+    uint32_t i)
+{
+    int64_t exact = _roke_rank_exact(matcher, fidx, i);
+    int64_t depth = rank->root_depth + _roke_index_depth(rank, fidx, didx, i);
+    if (depth > 0xFFFF) {
+        depth = 0xFFFF;
+    }
+    int64_t mtime = (fidx->mtime != NULL) ? fidx->mtime[i] : 0;
+    return (exact << 62) | ((0xFFFF - depth) << 32) | mtime;
+}
+
+/**
+ * @brief a range of entries scanned by one thread, and its results
+ */
+typedef struct roke_scan_chunk {
+    uint32_t begin;
+    uint32_t end;
+    roke_buffer_t out;
+    roke_buffer_t ends; // the ends of the results in out
+    roke_topk_t top;    // ranked results
+    int count;
+    int done;
+} roke_scan_chunk_t;
+
+/**
+ * @brief the state shared by the threads scanning an index
+ *
+ * chunks are claimed in order. the thread which started the scan writes
+ * the results of each chunk once every chunk before it is finished, so
+ * the output is in the same order as a single threaded scan.
+ */
+typedef struct roke_scan {
+    string_matcher_t** strmatch;
+    const roke_locate_options_t* opts;
+    roke_index_t* fidx;
+    roke_index_t* didx;
+    const char* suffix;
+    int limit;
+    const roke_rank_t* rank;
+    const roke_cancel_t* parent;
+
+    roke_scan_chunk_t* chunks;
+    uint32_t nchunks;
+
+    roke_mutex_t lock;
+    roke_cond_t cond;
+    uint32_t next;      // the next chunk to claim
+    uint32_t cancel;    // chunks at or after this one are not needed
+} roke_scan_t;
+
+/**
+ * @brief the path of the parent of the last result, and what the path
+ *        patterns made of it
+ *
+ * the files of a directory are stored together, so most results share
+ * the parent of the result before them. the path of the parent is built
+ * and matched once, and each result only appends its name.
+ */
+typedef struct roke_dir_memo {
+    uint32_t dir;       // the directory held, UINT32_MAX for none
+    size_t len;         // the length of its path, with a separator after it
+    // for each path pattern, non-zero if a literal matches the directory,
+    // or the number of bytes of a fuzzy pattern it matched
+    uint32_t state[ROKE_SCAN_MAX_PATTERNS + 1];
+} roke_dir_memo_t;
+
+/**
+ * @brief match a path pattern against the path of a directory
+ * @param path a directory with a separator after it, null terminated
+ * @return the state of the pattern for every path below the directory
+ */
+static uint32_t
+_roke_dir_memo_state(string_matcher_t* matcher, const uint8_t* path, size_t len)
+{
+    switch (matcher->flags&(ROKE_MATCH_MASK|ROKE_MATCH_MULTI|ROKE_QUERY)) {
+        case 0:
+            return string_matcher_match(matcher, path, len)==0;
+        case ROKE_FUZZY:
+            if (!(matcher->flags&ROKE_CASE_INSENSITIVE)) {
+                return roke_fuzzy_prefix(&matcher->data.fuzzy, 0, path, len);
+            }
+            return 0;
+        default:
+            return 0;
+    }
+}
+
+/**
+ * @brief match a path pattern against a path below a memoized directory
+ * @param dirlen the length of the directory and its separator, which
+ *               are the first bytes of the path
+ * @return 0 on match, non-zero otherwise
+ *
+ * a literal which is not in the directory can only match if it ends in
+ * the name, so only the end of the directory is searched again. folding
+ * turns a character into no fewer than a quarter of its bytes.
+ */
+static int
+_roke_dir_memo_match(
+    string_matcher_t* matcher,
+    uint32_t state,
+    const uint8_t* path,
+    size_t dirlen,
+    size_t len)
+{
+    switch (matcher->flags&(ROKE_MATCH_MASK|ROKE_MATCH_MULTI|ROKE_QUERY)) {
+        case 0: {
+            if (state) {
+                return 0;
+            }
+            size_t back = 4 * matcher->data.substr.patlen;
+            size_t begin = (dirlen > back) ? dirlen - back : 0;
+            while (begin > 0 && (path[begin] & 0xC0) == 0x80) {
+                begin--;
+            }
+            return string_matcher_match(matcher, path + begin, len - begin);
+        }
+        case ROKE_FUZZY:
+            if (!(matcher->flags&ROKE_CASE_INSENSITIVE)) {
+                return roke_fuzzy_prefix(&matcher->data.fuzzy, state,
+                    path + dirlen, len - dirlen) != matcher->data.fuzzy.patlen;
+            }
+            return string_matcher_match(matcher, path, len);
+        default:
+            return string_matcher_match(matcher, path, len);
+    }
+}
+
+/**
+ * @brief build the path of an entry, reusing the path of its parent if
+ *        it is the parent of the last entry
+ * @param dirlen set to the length of the parent and its separator at the
+ *               start of the path, zero for the root
+ * @return the length of the path, or zero on failure
+ */
+static size_t
+_roke_dir_memo_path(
+    roke_dir_memo_t* memo,
+    string_matcher_t** strmatch,
+    roke_index_t* fidx,
+    roke_index_t* didx,
+    uint32_t i,
+    uint8_t* dst,
+    size_t dstlen,
+    size_t* dirlen)
+{
+    uint16_t namelen;
+    int k;
+
+    *dirlen = 0;
+    if (fidx == didx && i == 0) {
+        memo->dir = UINT32_MAX;
+        return _roke_index_path(fidx, didx, i, dst, dstlen);
+    }
+
+    uint32_t parent = fidx->entries[i].index;
+    if (parent >= didx->nitems) {
+        parent = 0;
+    }
+    if (parent != memo->dir) {
+        size_t n = _roke_index_path(didx, didx, parent, dst, dstlen);
+        memo->dir = UINT32_MAX;
+        if (n == 0 || n + 1 >= dstlen) {
+            return 0;
+        }
+        if (dst[n - 1] != SEP) {
+            dst[n++] = SEP;
+            dst[n] = '\0';
+        }
+        for (k=1; strmatch[k]!=NULL; k++) {
+            memo->state[k] = _roke_dir_memo_state(strmatch[k], dst, n);
+        }
+        memo->dir = parent;
+        memo->len = n;
+    }
+
+    const uint8_t* name = roke_index_name(fidx, i, &namelen);
+    if (memo->len + namelen >= dstlen) {
+        return 0;
+    }
+    memcpy(dst + memo->len, name, namelen);
+    dst[memo->len + namelen] = '\0';
+    *dirlen = memo->len;
+    return memo->len + namelen;
+}
+
+/**
+ * @brief match the entries [begin, end) and format the results
+ * @param ids    the entries of [begin, end) which may match, as sorted
+ *               uint32_t ids, or NULL to test every entry
+ * @param limit  stop after this many results, zero for no limit
+ * @param suffix appended to the path of every result. NULL writes the
+ *               uint32_t id of every result to out instead of its path
+ * @param rank   offer the results to top instead of writing them to out,
+ *               without building their paths. the ids are still written
+ *               if suffix is NULL. may be NULL
+ * @param cancel stop when this work is cancelled, may be NULL
+ * @return the number of results written to out, or -1 on failure
+ */
+static int
+_roke_scan_range(
+    string_matcher_t** strmatch,
+    const roke_locate_options_t* opts,
+    roke_index_t* fidx,
+    roke_index_t* didx,
+    uint32_t begin,
+    uint32_t end,
+    const roke_buffer_t* ids,
+    int limit,
+    const char* suffix,
+    roke_buffer_t* out,
+    const roke_rank_t* rank,
+    roke_topk_t* top,
+    const roke_cancel_t* cancel)
+{
+    uint32_t block_begin, block_end;
+    uint64_t bitmap[ROKE_MATCH_BLOCK / 64];
+    int32_t scores[ROKE_MATCH_BLOCK];
+    uint8_t buffer1[4096];
+    size_t suffix_len = (suffix != NULL) ? strlen(suffix) : 0;
+    int is_dir = (fidx == didx);
+    int count = 0;
+    const roke_query_t* query = (strmatch[0]->flags&ROKE_QUERY) ?
+        strmatch[0]->data.query : NULL;
+    int norm = (strmatch[0]->flags&ROKE_NORMALIZE) && fidx->norm != NULL;
+    const roke_fuzzy_t* fuzzy = (rank != NULL && rank->dirstate != NULL) ?
+        &strmatch[0]->data.fuzzy : NULL;
+    // a query may build the path in the buffer, so the memo is only used
+    // without one
+    int npatterns = 0;
+    while (strmatch[npatterns] != NULL) {
+        npatterns++;
+    }
+    int use_memo = (query == NULL && npatterns <= ROKE_SCAN_MAX_PATTERNS);
+    roke_dir_memo_t memo;
+    memo.dir = UINT32_MAX;
+    memo.len = 0;
+
+    const uint32_t* cand = NULL;
+    const uint32_t* cand_end = NULL;
+    if (ids != NULL) {
+        cand = (const uint32_t*) ids->data;
+        cand_end = cand + ids->size / sizeof(uint32_t);
+        while (cand < cand_end && *cand < begin) {
+            cand++;
+        }
+    }
+
+    // match the names a block at a time, then build the path and apply
+    // the remaining tests only to the entries which matched
+    for (block_begin=begin; block_begin < end; block_begin=block_end) {
+
+        if (_roke_cancelled(cancel)) {
+            break;
+        }
+
+        uint32_t n;
+        if (ids != NULL) {
+            // skip the blocks which hold no candidate
+            if (cand == cand_end || *cand >= end) {
+                break;
+            }
+            if (*cand > block_begin) {
+                block_begin = *cand;
+            }
+            block_end = (end - block_begin > ROKE_MATCH_BLOCK) ?
+                block_begin + ROKE_MATCH_BLOCK : end;
+            n = block_end - block_begin;
+            if (_roke_match_ids(strmatch[0], fuzzy, rank, norm, fidx, didx,
+                    &cand, cand_end, block_begin, n, bitmap, scores)==0) {
+                continue;
+            }
+        } else if (norm) {
+            block_end = (end - block_begin > ROKE_MATCH_BLOCK) ?
+                block_begin + ROKE_MATCH_BLOCK : end;
+            n = block_end - block_begin;
+            if (string_matcher_match_norm_block(strmatch[0], fidx,
+                    block_begin, n, bitmap)==0) {
+                continue;
+            }
+        } else {
+            const uint8_t* strings;
+            size_t size;
+            block_end = _roke_index_block(fidx, block_begin, end, &strings, &size);
+            n = block_end - block_begin;
+
+            if (fuzzy != NULL) {
+                if (_roke_fuzzy_block(fuzzy, rank, fidx, didx, strings, size,
+                        block_begin, n, bitmap, scores)==0) {
+                    continue;
+                }
+            } else if (string_matcher_match_block(strmatch[0], strings, size,
+                    fidx->entries + block_begin, n, bitmap)==0) {
+                continue;
+            }
+        }
+
+        uint32_t w;
+        for (w=0; w < (n + 63) / 64; w++) {
+            uint64_t bits = bitmap[w];
+            while (bits) {
+                uint32_t idx = block_begin + w * 64 + roke_ctz64(bits);
+                bits &= bits - 1;
+
+                if (opts->filters && !_roke_filter_match(opts, fidx, idx, is_dir)) {
+                    continue;
+                }
+
+                size_t len = 0;
+                if (query != NULL && !roke_query_match(query, fidx, didx, idx,
+                        buffer1, sizeof(buffer1), &len)) {
+                    continue;
+                }
+
+                // ranked results and ids only need a path for the path
+                // patterns
+                if ((rank == NULL && suffix != NULL) || strmatch[1] != NULL) {
+                    size_t dirlen = 0;
+                    if (use_memo) {
+                        len = _roke_dir_memo_path(&memo, strmatch, fidx, didx, idx,
+                            buffer1, sizeof(buffer1), &dirlen);
+                    } else if (len == 0) {
+                        len = _roke_index_path(fidx, didx, idx, buffer1, sizeof(buffer1));
+                    }
+                    if (len == 0) {
+                        continue;
+                    }
+
+                    int i, m=0;
+                    for (i=1; strmatch[i]!=NULL; i++) {
+                        if (_roke_dir_memo_match(strmatch[i], (dirlen) ? memo.state[i] : 0,
+                                buffer1, dirlen, len)!=0) {
+                            m=1;
+                            break;
+                        }
+                    }
+                    if (m!=0) {
+                        continue;
+                    }
+                }
+
+                if (rank != NULL) {
+                    // among equal scores, shorter names are better
+                    int64_t score = (fuzzy != NULL) ?
+                        (int64_t) scores[idx - block_begin] * 65536 -
+                        fidx->entries[idx].namelen :
+                        _roke_rank_score(rank, strmatch[0], fidx, didx, idx);
+                    if (roke_topk_push(top, score,
+                            rank->order | ROKE_RANK_ORDER(0, is_dir, idx), NULL)) {
+                        return -1;
+                    }
+                    if (suffix == NULL &&
+                        _roke_buffer_append(out, (const uint8_t*) &idx, sizeof(idx))) {
+                        return -1;
+                    }
+                    count++;
+                    continue;
+                }
+
+                if (suffix == NULL) {
+                    if (_roke_buffer_append(out, (const uint8_t*) &idx, sizeof(idx))) {
+                        return -1;
+                    }
+                } else if (_roke_buffer_result(out, opts->format, buffer1, len,
+                        (const uint8_t*) suffix, suffix_len)) {
+                    return -1;
+                }
+                count++;
+
+                if (limit > 0 && count >= limit) {
+                    return count;
+                }
+            }
+        }
+    }
+
+    return count;
+}
+
+/**
+ * @brief give a thread its own view of a mapped index
+ *
+ * the map is shared, but compressed names are decompressed into buffers
+ * owned by the reader, so every thread needs its own reader.
+ */
+static int
+_roke_index_share(roke_index_t* dst, const roke_index_t* src)
+{
+    *dst = *src;
+    if (src->names != NULL) {
+        dst->names = malloc(sizeof(roke_frame_reader_t));
+        if (dst->names == NULL ||
+            roke_frame_reader_init(dst->names, src->names->data,
+                src->names->size, src->names->ncache)!=0) {
+            free(dst->names);
+            dst->names = NULL;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void
+_roke_index_unshare(roke_index_t* idx)
+{
+    if (idx->names != NULL) {
+        roke_frame_reader_free(idx->names);
+        free(idx->names);
+        idx->names = NULL;
+    }
+}
+
+/**
+ * @brief claim and scan chunks until none are left
+ */
+static void
+_roke_scan_worker(void* arg)
+{
+    roke_scan_t* scan = (roke_scan_t*) arg;
+    string_matcher_t matchers[ROKE_SCAN_MAX_PATTERNS];
+    string_matcher_t* strmatch[ROKE_SCAN_MAX_PATTERNS + 1];
+    roke_index_t fidx, didx;
+    roke_index_t* pdidx = &didx;
+    int err = 0;
+
+    memset(&fidx, 0, sizeof(fidx));
+    memset(&didx, 0, sizeof(didx));
+
+    int nmatchers = _roke_matchers_clone(scan->strmatch, matchers, strmatch);
+    err = (nmatchers < 0);
+
+    if (!err) {
+        err = _roke_index_share(&fidx, scan->fidx);
+    }
+    if (!err && scan->fidx != scan->didx) {
+        err = _roke_index_share(&didx, scan->didx);
+    } else {
+        pdidx = &fidx;
+    }
+
+    while (1) {
+        roke_mutex_lock(&scan->lock);
+        uint32_t chunk = scan->next;
+        if (chunk >= scan->nchunks || chunk >= scan->cancel) {
+            roke_mutex_unlock(&scan->lock);
+            break;
+        }
+        scan->next++;
+        roke_mutex_unlock(&scan->lock);
+
+        roke_cancel_t cancel = {&scan->lock, &scan->cancel, chunk, scan->parent};
+        roke_scan_chunk_t* c = &scan->chunks[chunk];
+        c->out.ends = &c->ends;
+        c->count = (err) ? -1 : _roke_scan_range(strmatch, scan->opts,
+            &fidx, pdidx, c->begin, c->end, NULL, scan->limit, scan->suffix,
+            &c->out, scan->rank, &c->top, &cancel);
+
+        roke_mutex_lock(&scan->lock);
+        c->done = 1;
+        roke_cond_broadcast(&scan->cond);
+        roke_mutex_unlock(&scan->lock);
+    }
+
+    _roke_index_unshare(&fidx);
+    if (pdidx == &didx) {
+        _roke_index_unshare(&didx);
+    }
+    while (nmatchers-- > 0) {
+        string_matcher_free(&matchers[nmatchers]);
+    }
+}
+
+static uint32_t _roke_scan_chunk = ROKE_SCAN_CHUNK;
+
+/**
+ * @brief change the number of entries claimed at a time by a thread
+ * @return the previous chunk size
+ *
+ * used by unit tests to scan small indexes with several threads.
+ */
+uint32_t
+roke_scan_set_chunk_for_test(uint32_t chunk)
+{
+    uint32_t t = _roke_scan_chunk;
+    _roke_scan_chunk = (chunk > 0) ? chunk : ROKE_SCAN_CHUNK;
+    return t;
+}
+
+/**
+ * @brief the number of threads to use for a query
+ * @param nitems the number of independent items of work
+ */
+static uint32_t
+_roke_scan_threads(
+    string_matcher_t** strmatch,
+    const roke_locate_options_t* opts,
+    uint32_t nitems)
+{
+    uint32_t i;
+    for (i=0; strmatch[i]!=NULL; i++) {
+        if (i >= ROKE_SCAN_MAX_PATTERNS) {
+            return 1;
+        }
+    }
+    uint32_t nthreads = (opts->threads > 0) ? (uint32_t) opts->threads : roke_cpu_count();
+    return (nthreads < nitems) ? nthreads : nitems;
+}
+
+/**
+ * @brief find the entries [begin, end) of an index matching a query
+ * @param count  the number of results written so far, incremented by the
+ *               number of results written
+ * @param suffix appended to every result. NULL writes the uint32_t id of
+ *               every result instead of its path
+ * @param rank   offer the results to top instead of writing them to the
+ *               sink. the limit is the size of top. may be NULL
+ * @param cancel stop when this work is cancelled, may be NULL
+ */
+static int
+roke_locate_index_impl(
+    roke_sink_t* sink,
+    string_matcher_t** strmatch,
+    const roke_locate_options_t* opts,
+    roke_index_t* fidx,
+    roke_index_t* didx,
+    uint32_t begin,
+    uint32_t end,
+    int* count,
+    char* suffix,
+    const roke_rank_t* rank,
+    roke_topk_t* top,
+    const roke_cancel_t* cancel)
+{
+    int limit = (opts->limit > 0 && rank == NULL) ? opts->limit - (*count) : 0;
+    uint32_t c, t;
+
+    if (opts->limit > 0 && rank == NULL && limit <= 0) {
+        return 0;
+    }
+    if (end > fidx->nitems) {
+        end = fidx->nitems;
+    }
+    if (begin >= end) {
+        return 0;
+    }
+
+    uint32_t chunk_size = _roke_scan_chunk;
+    uint32_t nchunks = (uint32_t) (((uint64_t) end - begin + chunk_size - 1) / chunk_size);
+    uint32_t nthreads = _roke_scan_threads(strmatch, opts, nchunks);
+
+    if (nthreads <= 1 || nchunks < 2) {
+        // write each chunk as it is scanned, so that the first results
+        // are not held back by the rest of the index
+        roke_buffer_t ends = {NULL, 0, 0, NULL};
+        roke_buffer_t out = {NULL, 0, 0, (sink->buf != NULL) ? &ends : NULL};
+        int err = 0;
+        for (c=0; c<nchunks && !err; c++) {
+            uint32_t cbegin = begin + c * chunk_size;
+            uint32_t cend = (end - cbegin > chunk_size) ? cbegin + chunk_size : end;
+            out.size = 0;
+            ends.size = 0;
+            int n = _roke_scan_range(strmatch, opts, fidx, didx, cbegin, cend,
+                NULL, limit, suffix, &out, rank, top, cancel);
+            err = (n < 0) || _roke_sink_write(sink, &out, out.size);
+            if (n > 0) {
+                (*count) += n;
+                if (limit > 0 && (limit -= n) <= 0) {
+                    break;
+                }
+            }
+        }
+        free(out.data);
+        free(ends.data);
+        return err;
+    }
+
+    roke_scan_t scan;
+    memset(&scan, 0, sizeof(scan));
+    scan.strmatch = strmatch;
+    scan.opts = opts;
+    scan.fidx = fidx;
+    scan.didx = didx;
+    scan.suffix = suffix;
+    scan.limit = limit;
+    scan.rank = rank;
+    scan.parent = cancel;
+    scan.nchunks = nchunks;
+    scan.cancel = nchunks;
+    scan.chunks = calloc(nchunks, sizeof(roke_scan_chunk_t));
+    roke_thread_t* threads = calloc(nthreads, sizeof(roke_thread_t));
+    if (scan.chunks == NULL || threads == NULL) {
+        free(scan.chunks);
+        free(threads);
+        return 1;
+    }
+    for (c=0; c<nchunks; c++) {
+        scan.chunks[c].begin = begin + c * chunk_size;
+        scan.chunks[c].end = (end - scan.chunks[c].begin > chunk_size) ?
+            scan.chunks[c].begin + chunk_size : end;
+        roke_topk_init(&scan.chunks[c].top, (rank != NULL) ? rank->k : 0);
+    }
+    roke_mutex_init(&scan.lock);
+    roke_cond_init(&scan.cond);
+
+    uint32_t nstarted = 0;
+    for (t=0; t<nthreads; t++) {
+        if (roke_thread_create(&threads[nstarted], _roke_scan_worker, &scan)==0) {
+            nstarted++;
+        }
+    }
+    if (nstarted == 0) {
+        // scan on this thread rather than fail the query
+        _roke_scan_worker(&scan);
+    }
+
+    // write the results in chunk order as they become available
+    int err = 0;
+    int total = 0;
+    for (c=0; c<nchunks; c++) {
+        roke_scan_chunk_t* chunk = &scan.chunks[c];
+
+        roke_mutex_lock(&scan.lock);
+        while (!chunk->done) {
+            roke_cond_wait(&scan.cond, &scan.lock);
+        }
+        roke_mutex_unlock(&scan.lock);
+
+        if (chunk->count < 0) {
+            err = 1;
+        } else if (rank != NULL) {
+            // nothing is written until every chunk is ranked, except for
+            // the ids of the results
+            err = roke_topk_merge(top, &chunk->top);
+            if (!err && suffix == NULL) {
+                err = _roke_sink_write(sink, &chunk->out, chunk->out.size);
+            }
+            total += chunk->count;
+        } else if (chunk->count > 0) {
+            // the limit is applied to the merged results, the last chunk
+            // written may contain more results than are needed
+            int n = chunk->count;
+            if (limit > 0 && total + n > limit) {
+                n = limit - total;
+            }
+            // ids have a fixed size, results are trimmed at their ends
+            size_t size = (suffix == NULL) ? (size_t) n * sizeof(uint32_t) :
+                _roke_buffer_results(&chunk->out, n);
+            if (_roke_sink_write(sink, &chunk->out, size)) {
+                err = 1;
+            }
+            total += n;
+        }
+        free(chunk->out.data);
+        free(chunk->ends.data);
+        chunk->out.data = NULL;
+        chunk->ends.data = NULL;
+
+        if (err || (limit > 0 && total >= limit)) {
+            // stop the workers, and skip the chunks which were not written
+            roke_mutex_lock(&scan.lock);
+            scan.cancel = c + 1;
+            roke_mutex_unlock(&scan.lock);
+            break;
+        }
+    }
+
+    for (t=0; t<nstarted; t++) {
+        roke_thread_join(&threads[t]);
+    }
+    for (c=0; c<nchunks; c++) {
+        free(scan.chunks[c].out.data);
+        free(scan.chunks[c].ends.data);
+        roke_topk_free(&scan.chunks[c].top);
+    }
+
+    roke_cond_destroy(&scan.cond);
+    roke_mutex_destroy(&scan.lock);
+    free(scan.chunks);
+    free(threads);
+
+    (*count) += total;
+    return err;
+}
+
+/**
+ * @brief build the paths of the best results of an index, and offer
+ *        them to the results of every index
+ * @return non-zero on failure
+ */
+static int
+_roke_rank_collect(
+    roke_sink_t* sink,
+    roke_topk_t* top,
+    roke_index_t* fidx,
+    roke_index_t* didx)
+{
+    uint8_t buffer1[4096];
+    uint32_t i;
+    int err = 0;
+
+    for (i=0; i<top->size && !err; i++) {
+        const roke_ranked_t* item = &top->items[i];
+        int is_dir = !((item->order >> 32) & 1);
+        uint32_t id = (uint32_t) item->order;
+
+        if (!roke_topk_accepts(sink->topk, item->score, item->order)) {
+            continue;
+        }
+        // leave room for the separator after a directory
+        size_t len = _roke_index_path((is_dir) ? didx : fidx, didx, id,
+            buffer1, sizeof(buffer1) - 1);
+        if (len == 0) {
+            continue;
+        }
+        if (is_dir) {
+            buffer1[len++] = SEP;
+        }
+        uint8_t* path = malloc(len + 1);
+        if (path == NULL) {
+            err = 1;
+            break;
+        }
+        memcpy(path, buffer1, len);
+        path[len] = '\0';
+        err = roke_topk_push(sink->topk, item->score, item->order, path);
+    }
+    return err;
+}
+
+/**
+ * @brief the identity of one generation of an index file
+ *
+ * an index is replaced by renaming a new file over it, so a new
+ * generation has a new inode as well as a new size and mtime.
+ */
+typedef struct roke_index_sig {
+    uint64_t ino;
+    uint64_t size;
+    int64_t mtime;
+} roke_index_sig_t;
+
+static void
+_roke_index_sig(roke_index_sig_t* sig, const struct stat64_t* st)
+{
+    sig->ino = (uint64_t) st->st_ino;
+    sig->size = (uint64_t) st->st_size;
+    sig->mtime = (int64_t) st->st_mtime;
+}
+
+/**
+ * @brief a directory and file index kept mapped between queries
+ */
+typedef struct roke_cached_index {
+    char* name;                 // the directory index, ending in .d.bin
+    int open;
+    roke_index_sig_t dsig, fsig;
+    roke_index_t didx, fidx;
+    roke_bloom_t dsketch, fsketch;
+    int dnorm, fnorm;           // the sketch holds normalized trigrams
+} roke_cached_index_t;
+
+/**
+ * @brief the indexes of a config directory, kept mapped by roke-server
+ */
+typedef struct roke_index_cache {
+    uint8_t config_dir[ROKE_PATH_MAX];
+    roke_cached_index_t* items;     // sorted by name
+    uint32_t count;
+} roke_index_cache_t;
+
+/**
+ * @brief the paths of the directory and file index of an index name
+ */
+static void
+_roke_index_paths(
+    const uint8_t* config_dir,
+    const char* name,
+    uint8_t* didx_path,
+    uint8_t* fidx_path,
+    size_t pathlen)
+{
+    const uint8_t* parts[] = { config_dir, (const uint8_t*) name };
+    // todo check for errors
+    _joinpath(parts, 2, didx_path, pathlen);
+    strcpy_safe(fidx_path, pathlen, didx_path);
+    fidx_path[strlen((char*)fidx_path) - 5] = 'f';
+}
+
+static void
+_roke_cached_index_close(roke_cached_index_t* item)
+{
+    if (item->open) {
+        roke_index_close(&item->didx);
+        roke_index_close(&item->fidx);
+        roke_bloom_free(&item->dsketch);
+        roke_bloom_free(&item->fsketch);
+        item->open = 0;
+    }
+}
+
+/**
+ * @brief map an index and read its sketches
+ * @return non-zero if the index could not be opened
+ */
+static int
+_roke_cached_index_open(roke_cached_index_t* item, const uint8_t* config_dir)
+{
+    uint8_t didx_path[4096];
+    uint8_t fidx_path[4096];
+    struct stat64_t st;
+    roke_section_t section;
+
+    _roke_index_paths(config_dir, item->name, didx_path, fidx_path, sizeof(didx_path));
+
+    if (roke_index_open_ex(&item->didx, didx_path, ROKE_FRAME_CACHE)!=0) {
+        return 1;
+    }
+    if (roke_index_open_ex(&item->fidx, fidx_path, 1)!=0) {
+        roke_index_close(&item->didx);
+        return 1;
+    }
+
+    // the generation which was mapped, not whatever is at the path now
+    fstat(roke_fileno(item->didx.fp), &st);
+    _roke_index_sig(&item->dsig, &st);
+    fstat(roke_fileno(item->fidx.fp), &st);
+    _roke_index_sig(&item->fsig, &st);
+
+    roke_index_read_sketch(didx_path, &item->dsketch);
+    roke_index_read_sketch(fidx_path, &item->fsketch);
+    item->dnorm = roke_index_find_section(didx_path, ROKE_SECTION_NORM, &section)==0;
+    item->fnorm = roke_index_find_section(fidx_path, ROKE_SECTION_NORM, &section)==0;
+    item->open = 1;
+    return 0;
+}
+
+/**
+ * @brief test if the files of an index have been replaced since it was
+ *        mapped
+ */
+static int
+_roke_cached_index_stale(roke_cached_index_t* item, const uint8_t* config_dir)
+{
+    uint8_t didx_path[4096];
+    uint8_t fidx_path[4096];
+    struct stat64_t st;
+    roke_index_sig_t sig;
+
+    _roke_index_paths(config_dir, item->name, didx_path, fidx_path, sizeof(didx_path));
+
+    if (stat64_utf8((char*) didx_path, &st)!=0) {
+        return 1;
+    }
+    _roke_index_sig(&sig, &st);
+    if (memcmp(&sig, &item->dsig, sizeof(sig))!=0) {
+        return 1;
+    }
+    if (stat64_utf8((char*) fidx_path, &st)!=0) {
+        return 1;
+    }
+    _roke_index_sig(&sig, &st);
+    return memcmp(&sig, &item->fsig, sizeof(sig))!=0;
+}
+
+/**
+ * @brief an index opened for a query, and the entries to search
+ */
+typedef struct roke_open_index {
+    roke_index_t didx;
+    roke_index_t fidx;
+    int cached;             // the indexes belong to a roke_index_cache_t
+    int dmatch;             // the directories may match
+    int fmatch;             // the files may match
+    uint32_t dbegin, dend;
+    uint32_t fbegin, fend;
+} roke_open_index_t;
+
+static void
+_roke_open_index_close(roke_open_index_t* oi)
+{
+    if (!oi->cached) {
+        roke_index_close(&oi->fidx);
+        roke_index_close(&oi->didx);
+    }
+}
+
+/**
+ * @brief open an index, unless it can not contain a result
+ * @param name   the name of the directory index, ending in .d.bin
+ * @param cached the index already mapped by a roke_index_cache_t, or
+ *               NULL to map it
+ * @return zero if the index was opened, and must be closed by
+ *         _roke_open_index_close
+ */
+static int
+_roke_open_index(
+    roke_open_index_t* oi,
+    const uint8_t* config_dir,
+    const char* name,
+    roke_cached_index_t* cached,
+    string_matcher_t** strmatch,
+    const roke_locate_options_t* opts)
+{
+    uint8_t didx_path[4096];
+    uint8_t fidx_path[4096];
+    roke_bloom_t dsketch, fsketch;
+
+    if (cached != NULL) {
+        if (!cached->open) {
+            return 1;
+        }
+        // the sketch only holds the trigrams of normalized names if the
+        // index stores them
+        roke_bloom_t empty;
+        roke_bloom_wrap(&empty, NULL, 0);
+        int norm = (strmatch[0]->flags&ROKE_NORMALIZE);
+        oi->dmatch = string_matcher_sketch_test(strmatch[0],
+            (norm && !cached->dnorm) ? &empty : &cached->dsketch);
+        oi->fmatch = string_matcher_sketch_test(strmatch[0],
+            (norm && !cached->fnorm) ? &empty : &cached->fsketch);
+        if (!oi->dmatch && !oi->fmatch) {
+            return 1;
+        }
+        oi->didx = cached->didx;
+        oi->fidx = cached->fidx;
+        oi->cached = 1;
+        goto opened;
+    }
+
+    _roke_index_paths(config_dir, name, didx_path, fidx_path, sizeof(didx_path));
+
+    // reject the index using the name sketches before mapping it.
+    // every result must match the first pattern by name.
+    roke_index_read_sketch(didx_path, &dsketch);
+    roke_index_read_sketch(fidx_path, &fsketch);
+    if (strmatch[0]->flags&ROKE_NORMALIZE) {
+        // the sketch only holds the trigrams of normalized names if the
+        // index stores them
+        roke_section_t section;
+        if (roke_index_find_section(didx_path, ROKE_SECTION_NORM, &section)!=0) {
+            roke_bloom_free(&dsketch);
+            roke_bloom_wrap(&dsketch, NULL, 0);
+        }
+        if (roke_index_find_section(fidx_path, ROKE_SECTION_NORM, &section)!=0) {
+            roke_bloom_free(&fsketch);
+            roke_bloom_wrap(&fsketch, NULL, 0);
+        }
+    }
+    oi->dmatch = string_matcher_sketch_test(strmatch[0], &dsketch);
+    oi->fmatch = string_matcher_sketch_test(strmatch[0], &fsketch);
+    roke_bloom_free(&dsketch);
+    roke_bloom_free(&fsketch);
+
+    if (!oi->dmatch && !oi->fmatch) {
+        return 1;
+    }
+
+    // parents are looked up at random, while files are scanned in order
+    if (roke_index_open_ex(&oi->didx, didx_path, ROKE_FRAME_CACHE)!=0)
+        goto error_didx;
+
+    if (roke_index_open_ex(&oi->fidx, fidx_path, 1)!=0)
+        goto error_fidx;
+    oi->cached = 0;
+
+  opened:
+    ;
+
+    // the columns used by the query are needed as well as the filters
+    roke_locate_options_t needed = *opts;
+    if (strmatch[0]->flags&ROKE_QUERY) {
+        needed.filters |= strmatch[0]->data.query->filters;
+        needed.types |= strmatch[0]->data.query->types;
+    }
+
+    if (!_roke_filter_supported(&needed, &oi->didx) ||
+        !_roke_filter_supported(&needed, &oi->fidx)) {
+        fprintf(stderr, "warning: skipping %s, rebuild the index with metadata to use filters\n", name);
+        goto error;
+    }
+
+    // by default search every entry of the index
+    oi->dbegin = 0;
+    oi->dend = oi->didx.nitems;
+    oi->fbegin = 0;
+    oi->fend = oi->fidx.nitems;
+
+    if (opts->under != NULL) {
+        uint32_t subdir;
+        if (oi->didx.ranges == NULL) {
+            fprintf(stderr, "warning: skipping %s, rebuild the index to use --under\n", name);
+            goto error;
+        }
+        if (roke_index_resolve_dir(&oi->didx, (const uint8_t*) opts->under, &subdir)!=0) {
+            goto error;
+        }
+        oi->dbegin = subdir;
+        oi->dend = oi->didx.ranges[subdir].dir_end;
+        oi->fbegin = oi->didx.ranges[subdir].file_begin;
+        oi->fend = oi->didx.ranges[subdir].file_end;
+    }
+
+    return 0;
+
+  error:
+    _roke_open_index_close(oi);
+    return 1;
+
+  error_fidx:
+    roke_index_close(&oi->fidx);
+  error_didx:
+    roke_index_close(&oi->didx);
+
+    return 1;
+}
+
+/**
+ * @brief prepare to rank the results of an index
+ * @param index the position of the index in the results
+ * @param dirstate set to the state of every directory, which must be
+ *                 freed: what a fuzzy pattern matched of its path, or
+ *                 its depth otherwise
+ * @return non-zero on failure
+ */
+static int
+_roke_rank_init(
+    roke_rank_t* rank,
+    string_matcher_t** strmatch,
+    roke_index_t* didx,
+    uint32_t index,
+    uint32_t k,
+    uint8_t** dirstate)
+{
+    rank->k = k;
+    rank->order = ROKE_RANK_ORDER(index, 1, 0);
+    rank->root_depth = 0;
+    rank->dirstate = NULL;
+    rank->depths = NULL;
+    *dirstate = NULL;
+
+    // depths are compared between indexes, so they are measured from /
+    uint16_t len, i;
+    const uint8_t* root = roke_index_name(didx, 0, &len);
+    for (i=1; i<len; i++) {
+        rank->root_depth += (root[i] == SEP && root[i - 1] != SEP);
+    }
+    rank->root_depth += (len > 1 && root[len - 1] != SEP);
+
+    if ((strmatch[0]->flags&(ROKE_MATCH_MASK|ROKE_MATCH_MULTI|ROKE_QUERY)) == ROKE_FUZZY) {
+        *dirstate = _roke_fuzzy_dirstate(&strmatch[0]->data.fuzzy, didx);
+        if (*dirstate == NULL) {
+            return 1;
+        }
+        rank->dirstate = *dirstate;
+    } else {
+        uint16_t* depths = _roke_dir_depths(didx);
+        if (depths == NULL) {
+            return 1;
+        }
+        rank->depths = depths;
+        *dirstate = (uint8_t*) depths;
+    }
+    return 0;
+}
+
+/**
+ * @brief find the entries of one index matching a query
+ * @param name   the name of the directory index, ending in .d.bin
+ * @param cached the index if it is already mapped, or NULL
+ * @return the number of results written to sink
+ */
+static int
+_roke_locate_one(
+    roke_sink_t* sink,
+    const uint8_t* config_dir,
+    const char* name,
+    roke_cached_index_t* cached,
+    string_matcher_t** strmatch,
+    const roke_locate_options_t* opts,
+    const roke_cancel_t* cancel)
+{
+    int count = 0;
+    roke_open_index_t oi;
+
+    if (_roke_open_index(&oi, config_dir, name, cached, strmatch, opts)!=0) {
+        return 0;
+    }
+
+    // ranked results are kept in a heap for the index, and only the
+    // paths of the results which are left are built
+    roke_rank_t rank, *prank = NULL;
+    roke_topk_t top;
+    uint8_t* dirstate = NULL;
+    roke_topk_init(&top, 0);
+    if (sink->topk != NULL) {
+        if (_roke_rank_init(&rank, strmatch, &oi.didx, sink->index,
+                sink->topk->k, &dirstate)!=0) {
+            goto end;
+        }
+        roke_topk_init(&top, rank.k);
+        prank = &rank;
+    }
+
+    // match the pattern against directories
+    if (oi.dmatch) {
+        roke_locate_index_impl(sink, strmatch, opts, &oi.didx, &oi.didx,
+            oi.dbegin, oi.dend, &count, "/", prank, &top, cancel);
+    }
+
+    // match the pattern against files
+    if (oi.fmatch && !_roke_sink_done(sink)) {
+        roke_locate_index_impl(sink, strmatch, opts, &oi.fidx, &oi.didx,
+            oi.fbegin, oi.fend, &count, "", prank, &top, cancel);
+    }
+
+    if (prank != NULL) {
+        count = (int) top.size;
+        _roke_rank_collect(sink, &top, &oi.fidx, &oi.didx);
+    }
+    roke_topk_free(&top);
+    free(dirstate);
+
+  end:
+    _roke_open_index_close(&oi);
+
+    return count;
+}
+
+/**
+ * @brief an index searched by the pool, and its results
+ */
+typedef struct roke_locate_job {
+    char* name;
+    roke_cached_index_t* cached;
+    roke_buffer_t out;
+    roke_buffer_t ends; // the ends of the results in out
+    roke_topk_t top;    // ranked results
+    int count;
+    int done;
+} roke_locate_job_t;
+
+/**
+ * @brief the state shared by the threads searching a config directory
+ *
+ * indexes are claimed in order, and their results are written in the
+ * same order by the thread which started the query.
+ */
+typedef struct roke_locate_pool {
+    const uint8_t* config_dir;
+    string_matcher_t** strmatch;
+    roke_locate_options_t opts;
+    int ranked;
+
+    roke_locate_job_t* jobs;
+    uint32_t njobs;
+
+    roke_mutex_t lock;
+    roke_cond_t cond;
+    uint32_t next;      // the next index to claim
+    uint32_t cancel;    // indexes at or after this one are not needed
+} roke_locate_pool_t;
+
+/**
+ * @brief claim and search indexes until none are left
+ */
+static void
+_roke_locate_worker(void* arg)
+{
+    roke_locate_pool_t* pool = (roke_locate_pool_t*) arg;
+    string_matcher_t matchers[ROKE_SCAN_MAX_PATTERNS];
+    string_matcher_t* strmatch[ROKE_SCAN_MAX_PATTERNS + 1];
+
+    int nmatchers = _roke_matchers_clone(pool->strmatch, matchers, strmatch);
+
+    while (1) {
+        roke_mutex_lock(&pool->lock);
+        uint32_t item = pool->next;
+        if (item >= pool->njobs || item >= pool->cancel) {
+            roke_mutex_unlock(&pool->lock);
+            break;
+        }
+        pool->next++;
+        roke_mutex_unlock(&pool->lock);
+
+        roke_locate_job_t* job = &pool->jobs[item];
+        job->out.ends = &job->ends;
+        roke_cancel_t cancel = {&pool->lock, &pool->cancel, item, NULL};
+        roke_sink_t sink = {NULL, &job->out, (pool->ranked) ? &job->top : NULL, item, NULL};
+        job->count = (nmatchers < 0) ? 0 : _roke_locate_one(&sink,
+            pool->config_dir, job->name, job->cached, strmatch, &pool->opts, &cancel);
+
+        roke_mutex_lock(&pool->lock);
+        job->done = 1;
+        roke_cond_broadcast(&pool->cond);
+        roke_mutex_unlock(&pool->lock);
+    }
+
+    while (nmatchers-- > 0) {
+        string_matcher_free(&matchers[nmatchers]);
+    }
+}
+
+static int
+_roke_name_cmp(const void* a, const void* b)
+{
+    return strcmp(*(char* const*) a, *(char* const*) b);
+}
+
+/**
+ * @brief list the directory indexes in a config directory, sorted by name
+ * @return the number of names, or -1 on failure
+ */
+static int
+_roke_list_indexes(const uint8_t* config_dir, char*** names)
+{
+    DIR *d = NULL;
+    struct dirent *dir;
+    char** list = NULL;
+    int count = 0, capacity = 0;
+
+    d = opendir((char*)config_dir);
+    if (!d) {
+        fprintf(stderr, "failed to open config directory\n");
+        return -1;
+    }
+
+    while ((dir = readdir(d)) != NULL) {
+
+        // find all databases,
+        size_t name_len = strlen(dir->d_name);
+        if (!has_suffix((uint8_t*) dir->d_name, name_len, (uint8_t*)".d.bin", 6)) {
+            continue;
+        }
+
+        if (count == capacity) {
+            capacity = (capacity) ? 2 * capacity : 16;
+            char** tmp = realloc(list, capacity * sizeof(char*));
+            if (tmp == NULL) {
+                goto error;
+            }
+            list = tmp;
+        }
+        list[count] = malloc(name_len + 1);
+        if (list[count] == NULL) {
+            goto error;
+        }
+        memcpy(list[count], dir->d_name, name_len + 1);
+        count++;
+    }
+
+    closedir(d);
+
+    // readdir order depends on the file system, sort the names so that
+    // results are always written in the same order
+    if (count > 0) {
+        qsort(list, count, sizeof(char*), _roke_name_cmp);
+    }
+
+    *names = list;
+    return count;
+
+  error:
+    closedir(d);
+    while (count-- > 0) {
+        free(list[count]);
+    }
+    free(list);
+    return -1;
+}
+
+static void
+_roke_index_cache_init(roke_index_cache_t* cache, const uint8_t* config_dir)
+{
+    memset(cache, 0, sizeof(roke_index_cache_t));
+    strcpy_safe(cache->config_dir, sizeof(cache->config_dir), config_dir);
+}
+
+static void
+_roke_index_cache_free(roke_index_cache_t* cache)
+{
+    uint32_t i;
+    for (i=0; i<cache->count; i++) {
+        _roke_cached_index_close(&cache->items[i]);
+        free(cache->items[i].name);
+    }
+    free(cache->items);
+    cache->items = NULL;
+    cache->count = 0;
+}
+
+/**
+ * @brief bring the cache up to date with the config directory
+ * @return non-zero on failure, leaving the cache unchanged
+ *
+ * indexes which were added are mapped, indexes which were removed are
+ * unmapped, and indexes whose files were replaced by a new build are
+ * mapped again. the rest are kept as they are, so a query only costs a
+ * directory listing and two stats per index.
+ */
+static int
+_roke_index_cache_refresh(roke_index_cache_t* cache)
+{
+    char** names = NULL;
+    uint32_t i, j = 0;
+
+    int n = _roke_list_indexes(cache->config_dir, &names);
+    if (n < 0) {
+        return 1;
+    }
+    roke_cached_index_t* items = calloc((n > 0) ? (size_t) n : 1, sizeof(roke_cached_index_t));
+    if (items == NULL) {
+        for (i=0; i<(uint32_t) n; i++) {
+            free(names[i]);
+        }
+        free(names);
+        return 1;
+    }
+
+    // both lists are sorted by name
+    for (i=0; i<(uint32_t) n; i++) {
+        roke_cached_index_t* item = &items[i];
+        while (j < cache->count && strcmp(cache->items[j].name, names[i]) < 0) {
+            j++;
+        }
+        roke_cached_index_t* old = (j < cache->count &&
+            strcmp(cache->items[j].name, names[i])==0) ? &cache->items[j] : NULL;
+        if (old != NULL && old->open &&
+            !_roke_cached_index_stale(old, cache->config_dir)) {
+            // keep the mapping, the old entry no longer owns it
+            *item = *old;
+            old->open = 0;
+            item->name = names[i];
+        } else {
+            item->name = names[i];
+            _roke_cached_index_open(item, cache->config_dir);
+        }
+    }
+    free(names);
+
+    _roke_index_cache_free(cache);
+    cache->items = items;
+    cache->count = (uint32_t) n;
+    return 0;
+}
+
+/**
+ * @brief test if the results of a query are ranked instead of written in
+ *        index order
+ */
+static int
+_roke_ranked(string_matcher_t** strmatch, const roke_locate_options_t* opts)
+{
+    return (opts->match_flags&ROKE_RANK) ||
+        (strmatch[0]->flags&(ROKE_MATCH_MASK|ROKE_MATCH_MULTI|ROKE_QUERY)) == ROKE_FUZZY;
+}
+
+/**
+ * @brief find files in the indexes of a config directory, or in the
+ *        indexes already mapped by a cache
+ * @param cache the mapped indexes, or NULL to map the indexes listed in
+ *              config_dir
+ * @return non-zero if the indexes could not be listed, memory could not
+ *         be allocated or the results could not be written
+ */
+static int
+_roke_locate_run(
+    roke_output_t* output,
+    const uint8_t* config_dir,
+    roke_index_cache_t* cache,
+    string_matcher_t** strmatch,
+    const roke_locate_options_t* opts)
+{
+    int err=0;
+    int count=0;
+    int limit = opts->limit;
+    char** names = NULL;
+    uint32_t i, t;
+    int ranked = _roke_ranked(strmatch, opts);
+    roke_topk_t top;
+    roke_verify_t* verify = NULL;
+    int nnames;
+
+    roke_topk_init(&top, (limit > 0) ? (uint32_t) limit : 0);
+
+    // results which no longer exist are dropped as they are written, so
+    // the limit is applied by the verifier instead of the scan. indexes
+    // searched by the pool are scanned for a window past the limit, and
+    // scanned again when the verifier dropped too many of their results.
+    // ranked results are checked once they are ranked
+    roke_locate_options_t vopts;
+    int fetch = 0;
+    if (opts->filters&ROKE_FILTER_EXISTS) {
+        verify = _roke_verify_open(output, opts);
+        if (verify == NULL) {
+            return 1;
+        }
+        vopts = *opts;
+        vopts.filters &= ~ROKE_FILTER_EXISTS;
+        if (!ranked) {
+            if (opts->limit > 0) {
+                fetch = (opts->limit < INT_MAX - ROKE_VERIFY_WINDOW) ?
+                    opts->limit + ROKE_VERIFY_WINDOW : INT_MAX;
+            }
+            vopts.limit = 0;
+            limit = 0;
+        }
+        opts = &vopts;
+    }
+
+    if (cache != NULL) {
+        nnames = (int) cache->count;
+        names = malloc(((nnames > 0) ? (size_t) nnames : 1) * sizeof(char*));
+        if (names == NULL) {
+            return 1;
+        }
+        for (i=0; i<cache->count; i++) {
+            names[i] = cache->items[i].name;
+        }
+    } else {
+        nnames = _roke_list_indexes(config_dir, &names);
+    }
+    if (nnames <= 0) {
+        free(names);
+        _roke_verify_close(verify);
+        return nnames < 0;
+    }
+
+    roke_sink_t sink = {output, NULL, (ranked) ? &top : NULL, 0, (ranked) ? NULL : verify};
+    uint32_t nthreads = _roke_scan_threads(strmatch, opts, (uint32_t) nnames);
+
+    if (nthreads <= 1) {
+        for (i=0; i<(uint32_t) nnames; i++) {
+            if ((!ranked && limit > 0 && count >= limit) || _roke_sink_done(&sink)) {
+                break;
+            }
+            roke_locate_options_t local = *opts;
+            local.limit = (!ranked && limit > 0) ? limit - count : limit;
+            sink.index = i;
+            count += _roke_locate_one(&sink, config_dir, names[i],
+                (cache != NULL) ? &cache->items[i] : NULL, strmatch, &local, NULL);
+        }
+        goto end;
+    }
+
+    roke_locate_pool_t pool;
+    memset(&pool, 0, sizeof(pool));
+    pool.config_dir = config_dir;
+    pool.strmatch = strmatch;
+    pool.opts = *opts;
+    if (fetch > 0) {
+        pool.opts.limit = fetch;
+    }
+    pool.ranked = ranked;
+    pool.njobs = (uint32_t) nnames;
+    pool.cancel = pool.njobs;
+    pool.jobs = calloc(pool.njobs, sizeof(roke_locate_job_t));
+    roke_thread_t* threads = calloc(nthreads, sizeof(roke_thread_t));
+    if (pool.jobs == NULL || threads == NULL) {
+        free(pool.jobs);
+        free(threads);
+        err = 1;
+        goto end;
+    }
+    for (i=0; i<pool.njobs; i++) {
+        pool.jobs[i].name = names[i];
+        pool.jobs[i].cached = (cache != NULL) ? &cache->items[i] : NULL;
+        roke_topk_init(&pool.jobs[i].top, top.k);
+    }
+
+    // every index is scanned by an equal share of the threads
+    uint32_t total_threads = (opts->threads > 0) ? (uint32_t) opts->threads : roke_cpu_count();
+    pool.opts.threads = (total_threads / nthreads > 1) ? (int) (total_threads / nthreads) : 1;
+
+    roke_mutex_init(&pool.lock);
+    roke_cond_init(&pool.cond);
+
+    uint32_t nstarted = 0;
+    for (t=0; t<nthreads; t++) {
+        if (roke_thread_create(&threads[nstarted], _roke_locate_worker, &pool)==0) {
+            nstarted++;
+        }
+    }
+    if (nstarted == 0) {
+        _roke_locate_worker(&pool);
+    }
+
+    // write the results in index order as they become available
+    for (i=0; i<pool.njobs; i++) {
+        roke_locate_job_t* job = &pool.jobs[i];
+
+        roke_mutex_lock(&pool.lock);
+        while (!job->done) {
+            roke_cond_wait(&pool.cond, &pool.lock);
+        }
+        roke_mutex_unlock(&pool.lock);
+
+        if (ranked) {
+            roke_topk_merge(&top, &job->top);
+            continue;
+        }
+
+        int n = job->count;
+        if (limit > 0 && count + n > limit) {
+            n = limit - count;
+        }
+        _roke_sink_write(&sink, &job->out, _roke_buffer_results(&job->out, n));
+        count += n;
+        free(job->out.data);
+        free(job->ends.data);
+        job->out.data = NULL;
+        job->ends.data = NULL;
+
+        if (fetch > 0 && job->count >= fetch && !_roke_sink_done(&sink)) {
+            // the scan stopped at its bound, continue past the results
+            // which were already checked
+            roke_locate_options_t local = *opts;
+            local.threads = pool.opts.threads;
+            verify->skip = (uint32_t) job->count;
+            sink.index = i;
+            _roke_locate_one(&sink, config_dir, names[i], job->cached, strmatch, &local, NULL);
+            verify->skip = 0;
+        }
+
+        if ((limit > 0 && count >= limit) || _roke_sink_done(&sink)) {
+            // stop the workers, and skip the indexes which were not written
+            roke_mutex_lock(&pool.lock);
+            pool.cancel = i + 1;
+            roke_mutex_unlock(&pool.lock);
+            break;
+        }
+    }
+
+    for (t=0; t<nstarted; t++) {
+        roke_thread_join(&threads[t]);
+    }
+    for (i=0; i<pool.njobs; i++) {
+        free(pool.jobs[i].out.data);
+        free(pool.jobs[i].ends.data);
+        roke_topk_free(&pool.jobs[i].top);
+    }
+
+    roke_cond_destroy(&pool.cond);
+    roke_mutex_destroy(&pool.lock);
+    free(pool.jobs);
+    free(threads);
+
+  end:
+    if (ranked && verify != NULL) {
+        roke_buffer_t buf = {NULL, 0, 0};
+        roke_topk_sort(&top);
+        for (i=0; i<top.size; i++) {
+            const uint8_t* path = top.items[i].path;
+            if (_roke_buffer_result(&buf, opts->format, path, strlen((const char*) path), (const uint8_t*) "", 0)) {
+                break;
+            }
+        }
+        _roke_verify_write(verify, buf.data, buf.size);
+        free(buf.data);
+    } else if (ranked) {
+        roke_topk_sort(&top);
+        for (i=0; i<top.size; i++) {
+            const uint8_t* path = top.items[i].path;
+            if (_roke_output_result(output, opts->format, path, strlen((const char*) path))) {
+                break;
+            }
+        }
+    }
+    roke_topk_free(&top);
+    _roke_verify_close(verify);
+
+    // the names of a cache belong to the cache
+    for (i=0; cache == NULL && i<(uint32_t) nnames; i++) {
+        free(names[i]);
+    }
+    free(names);
+
+    // a failed write stops the search, and fails the query
+    return err || output->err;
+}
+
+/**
+ * @brief find files patching a given set of patterns
+ * @param config_dir null terminated string ending in a path separator
+ *                   the directory path containing index files
+ * @param strmatch   null terminated list of pointers to string
+ *                   matchers
+ * @param opts       the result limit and metadata filters
+ * @return non-zero if the search failed or the results could not be
+ *         written
+ *
+ * This implementation of find memory maps the index files to improve
+ * lookup speed by removing the need to parse a text file.
+ *
+ * When there is more than one index they are opened and searched by a
+ * pool of threads. The threads available are divided between the
+ * indexes, and the results of each index are written in order of the
+ * index names once every index before it has been searched.
+ *
+ * Ranked results are kept in a heap of the best opts->limit results
+ * for every thread, which are merged once every index is searched and
+ * written best first.
+ */
+int roke_locate_impl(
+    FILE* output,
+    const uint8_t* config_dir,
+    string_matcher_t** strmatch,
+    const roke_locate_options_t* opts)
+{
+    roke_output_t out;
+
+    // the stream may not have a descriptor, so it is written through
+    if (roke_output_init_file(&out, output)!=0) {
+        return 1;
+    }
+    int v = _roke_locate_run(&out, config_dir, NULL, strmatch, opts);
+    // the stream is flushed so that its write errors are seen as well
+    v = roke_output_flush(&out) || fflush(output)!=0 || v;
+    roke_output_free(&out);
+    return v;
+}
+
+/**
+ * @brief find files patching a given set of patterns, see roke_locate_impl
+ * @param output the results are buffered, and must be flushed by the caller
+ */
+int roke_locate_output_impl(
+    roke_output_t* output,
+    const uint8_t* config_dir,
+    string_matcher_t** strmatch,
+    const roke_locate_options_t* opts)
+{
+    return _roke_locate_run(output, config_dir, NULL, strmatch, opts);
+}
+
+/**
+ * @brief count the entries of one index matching a query
+ * @param name the name of the directory index, ending in .d.bin
+ * @return the number of matches, or -1 on failure
+ *
+ * the matches are counted where they are matched, without building
+ * their paths. a fuzzy pattern is matched against the whole path, by
+ * continuing from the state of the parent as ranking does.
+ */
+static int64_t
+_roke_count_one(
+    const uint8_t* config_dir,
+    const char* name,
+    string_matcher_t** strmatch,
+    const roke_locate_options_t* opts)
+{
+    roke_open_index_t oi;
+    roke_sink_t sink = {NULL, NULL, NULL, 0, NULL};
+    roke_rank_t rank, *prank = NULL;
+    roke_topk_t top;
+    uint8_t* dirstate = NULL;
+    int count = 0;
+    int err = 0;
+
+    if (_roke_open_index(&oi, config_dir, name, NULL, strmatch, opts)!=0) {
+        return 0;
+    }
+
+    roke_topk_init(&top, 1);
+    if ((strmatch[0]->flags&(ROKE_MATCH_MASK|ROKE_MATCH_MULTI|ROKE_QUERY)) == ROKE_FUZZY) {
+        err = _roke_rank_init(&rank, strmatch, &oi.didx, 0, 1, &dirstate);
+        prank = &rank;
+    }
+    if (!err && oi.dmatch) {
+        err = roke_locate_index_impl(&sink, strmatch, opts, &oi.didx, &oi.didx,
+            oi.dbegin, oi.dend, &count, NULL, prank, &top, NULL);
+    }
+    if (!err && oi.fmatch && !(opts->limit > 0 && count >= opts->limit)) {
+        err = roke_locate_index_impl(&sink, strmatch, opts, &oi.fidx, &oi.didx,
+            oi.fbegin, oi.fend, &count, NULL, prank, &top, NULL);
+    }
+
+    free(dirstate);
+    roke_topk_free(&top);
+    _roke_open_index_close(&oi);
+    return (err) ? -1 : count;
+}
+
+/**
+ * @brief count the files matching a given set of patterns and filters
+ * @param config_dir the directory containing the index files
+ * @param patterns   array of patterns, see roke_locate
+ * @param npatterns  length of the patterns array
+ * @param opts       match flags and metadata filters. the limit stops
+ *                   the count once that many matches are found, so a
+ *                   limit of 1 tests if anything matches
+ * @param counts     set to the count of every index, in the order
+ *                   roke_locate writes them. may be NULL
+ * @param ncounts    the length of counts, set to the number of indexes,
+ *                   which may be more than were written. may be NULL
+ * @return the number of matches, or -1 on failure
+ *
+ * no path is built and nothing is written, so a count costs the name
+ * matching and filters of a query and nothing more.
+ */
+int64_t
+roke_count(
+    const char* config_dir,
+    const char** patterns,
+    size_t npatterns,
+    const roke_locate_options_t* opts,
+    roke_index_count_t* counts,
+    size_t* ncounts)
+{
+    roke_matchers_t m;
+    char** names = NULL;
+    int64_t total = 0;
+    uint32_t i;
+
+    if (_roke_matchers_init(&m, patterns, npatterns, opts->match_flags)!=0) {
+        return -1;
+    }
+
+    int nnames = _roke_list_indexes((const uint8_t*) config_dir, &names);
+    if (nnames < 0) {
+        _roke_matchers_free(&m);
+        return -1;
+    }
+
+    roke_locate_options_t local = *opts;
+    for (i=0; i<(uint32_t) nnames; i++) {
+        int64_t n = 0;
+        if (!(opts->limit > 0 && total >= opts->limit)) {
+            local.limit = (opts->limit > 0) ? opts->limit - (int) total : 0;
+            n = _roke_count_one((const uint8_t*) config_dir, names[i], m.strmatch, &local);
+            // a fuzzy pattern is counted in full within an index
+            if (local.limit > 0 && n > local.limit) {
+                n = local.limit;
+            }
+        }
+        if (n < 0) {
+            total = -1;
+            break;
+        }
+        total += n;
+
+        if (counts != NULL && ncounts != NULL && i < *ncounts) {
+            // strip the .d.bin suffix
+            size_t len = strlen(names[i]) - 6;
+            if (len >= sizeof(counts[i].name)) {
+                len = sizeof(counts[i].name) - 1;
+            }
+            memcpy(counts[i].name, names[i], len);
+            counts[i].name[len] = '\0';
+            counts[i].count = (uint64_t) n;
+        }
+    }
+    if (ncounts != NULL) {
+        *ncounts = (size_t) nnames;
+    }
+
+    for (i=0; i<(uint32_t) nnames; i++) {
+        free(names[i]);
+    }
+    free(names);
+    _roke_matchers_free(&m);
+    return total;
+}
+
+/**
+ * @brief a query whose results are pulled by the caller
+ *
+ * unranked results are found a chunk of an index at a time, on the
+ * thread which asks for them. only the ids of the matches are kept, and
+ * their paths are built in the buffer of the caller as they are
+ * returned. ranked results are all found by the first call to
+ * roke_search_next, and the indexes which hold them stay open until the
+ * search is closed.
+ */
+struct roke_search {
+    uint8_t config_dir[ROKE_PATH_MAX];
+    roke_matchers_t m;
+    roke_locate_options_t opts;
+    char* under;                // a copy of opts.under
+    char** names;
+    uint32_t nnames;
+    roke_open_index_t* indexes;
+    uint8_t* opened;            // non-zero for every index which is open
+    int ranked;
+
+    uint32_t index;             // the index being searched
+    int state;                  // 0 before the index is opened, 1 while
+                                // searching directories, 2 files
+    uint32_t pos;               // the next entry to search
+    roke_buffer_t ids;          // ids of the matches not yet returned
+    size_t ids_pos;
+    uint32_t found;             // matches found, for the limit
+
+    roke_topk_t top;            // ranked results
+    int collected;              // the ranked results have been found
+    uint32_t next;              // the next ranked result to return
+
+    roke_mutex_t lock;
+    uint32_t first;             // zero once cancelled, see roke_cancel_t
+};
+
+/**
+ * @brief start a query
+ * @param search     set to the new search, which must be closed by
+ *                   roke_search_close
+ * @param config_dir the directory containing the index files
+ * @param patterns   array of patterns, see roke_locate
+ * @param npatterns  length of the patterns array
+ * @param opts       match flags, limit and metadata filters. threads is
+ *                   only used for ranked searches
+ * @return non-zero on failure
+ *
+ * nothing is searched until results are asked for.
+ */
+int
+roke_search_open(
+    roke_search_t** search,
+    const char* config_dir,
+    const char** patterns,
+    size_t npatterns,
+    const roke_locate_options_t* opts)
+{
+    roke_search_t* s;
+    char** names = NULL;
+
+    *search = NULL;
+    s = calloc(1, sizeof(roke_search_t));
+    if (s == NULL) {
+        return 1;
+    }
+    strcpy_safe(s->config_dir, sizeof(s->config_dir), (const uint8_t*) config_dir);
+    s->opts = *opts;
+    roke_topk_init(&s->top, (opts->limit > 0) ? (uint32_t) opts->limit : 0);
+    roke_mutex_init(&s->lock);
+    s->first = 1;
+
+    if (opts->under != NULL) {
+        size_t len = strlen(opts->under);
+        s->under = malloc(len + 1);
+        if (s->under == NULL) {
+            goto error;
+        }
+        memcpy(s->under, opts->under, len + 1);
+        s->opts.under = s->under;
+    }
+
+    if (_roke_matchers_init(&s->m, patterns, npatterns, opts->match_flags)!=0) {
+        goto error;
+    }
+    s->ranked = _roke_ranked(s->m.strmatch, opts);
+
+    int nnames = _roke_list_indexes(s->config_dir, &names);
+    if (nnames < 0) {
+        goto error;
+    }
+    s->names = names;
+    s->nnames = (uint32_t) nnames;
+    if (nnames > 0) {
+        s->indexes = calloc(s->nnames, sizeof(roke_open_index_t));
+        s->opened = calloc(s->nnames, sizeof(uint8_t));
+        if (s->indexes == NULL || s->opened == NULL) {
+            goto error;
+        }
+    }
+
+    *search = s;
+    return 0;
+
+  error:
+    roke_search_close(s);
+    return 1;
+}
+
+/**
+ * @brief stop a search
+ *
+ * may be called from another thread while results are being found, in
+ * which case the call which is finding them returns early. every later
+ * call to roke_search_next returns zero.
+ */
+void
+roke_search_cancel(roke_search_t* search)
+{
+    roke_mutex_lock(&search->lock);
+    search->first = 0;
+    roke_mutex_unlock(&search->lock);
+}
+
+void
+roke_search_close(roke_search_t* search)
+{
+    uint32_t i;
+    if (search == NULL) {
+        return;
+    }
+    for (i=0; i<search->nnames; i++) {
+        if (search->opened != NULL && search->opened[i]) {
+            _roke_open_index_close(&search->indexes[i]);
+        }
+        free(search->names[i]);
+    }
+    _roke_matchers_free(&search->m);
+    roke_topk_free(&search->top);
+    roke_mutex_destroy(&search->lock);
+    free(search->ids.data);
+    free(search->names);
+    free(search->indexes);
+    free(search->opened);
+    free(search->under);
+    free(search);
+}
+
+/**
+ * @brief the name of an index, as used by roke_build_index
+ * @param index the index of a result
+ * @return the length of the name, zero if there is no such index or it
+ *         does not fit in dst
+ */
+size_t
+roke_search_index_name(
+    roke_search_t* search,
+    uint32_t index,
+    char* dst,
+    size_t dstlen)
+{
+    if (index >= search->nnames) {
+        return 0;
+    }
+    // strip the .d.bin suffix
+    size_t len = strlen(search->names[index]) - 6;
+    if (len >= dstlen) {
+        return 0;
+    }
+    memcpy(dst, search->names[index], len);
+    dst[len] = '\0';
+    return len;
+}
+
+/**
+ * @brief describe a match, building its path in dst
+ * @return non-zero if the path does not fit in dst
+ */
+static int
+_roke_search_result(
+    roke_open_index_t* oi,
+    uint32_t index,
+    int is_dir,
+    uint32_t id,
+    roke_result_t* result,
+    char* dst,
+    size_t dstlen)
+{
+    roke_index_t* idx = (is_dir) ? &oi->didx : &oi->fidx;
+    size_t len = (dstlen > 0) ?
+        _roke_index_path(idx, &oi->didx, id, (uint8_t*) dst, dstlen) : 0;
+    if (len == 0) {
+        return 1;
+    }
+    result->path = dst;
+    result->pathlen = (uint32_t) len;
+    result->id = id;
+    result->index = index;
+    result->type = _roke_entry_type(idx, id, is_dir);
+    result->size = (idx->size != NULL) ? idx->size[id] : idx->entries[id].f_size;
+    return 0;
+}
+
+/**
+ * @brief find the matches of the next chunk of the current index
+ * @return 0 if a chunk was searched, 1 once every index is searched, or
+ *         -1 on failure
+ */
+static int
+_roke_search_scan(roke_search_t* s, const roke_cancel_t* cancel)
+{
+    while (s->index < s->nnames) {
+        roke_open_index_t* oi = &s->indexes[s->index];
+
+        if (s->state == 0) {
+            if (_roke_open_index(oi, s->config_dir, s->names[s->index], NULL,
+                    s->m.strmatch, &s->opts)!=0) {
+                s->index++;
+                continue;
+            }
+            s->opened[s->index] = 1;
+            s->state = 1;
+            s->pos = oi->dbegin;
+        }
+
+        int is_dir = (s->state == 1);
+        roke_index_t* fidx = (is_dir) ? &oi->didx : &oi->fidx;
+        uint32_t end = 0;
+        if (is_dir ? oi->dmatch : oi->fmatch) {
+            end = (is_dir) ? oi->dend : oi->fend;
+        }
+        if (end > fidx->nitems) {
+            end = fidx->nitems;
+        }
+
+        if (s->pos >= end) {
+            if (is_dir) {
+                s->state = 2;
+                s->pos = oi->fbegin;
+            } else {
+                _roke_open_index_close(oi);
+                s->opened[s->index] = 0;
+                s->index++;
+                s->state = 0;
+            }
+            continue;
+        }
+
+        uint32_t cend = (end - s->pos > _roke_scan_chunk) ? s->pos + _roke_scan_chunk : end;
+        int limit = (s->opts.limit > 0) ? s->opts.limit - (int) s->found : 0;
+        s->ids.size = 0;
+        s->ids_pos = 0;
+        int n = _roke_scan_range(s->m.strmatch, &s->opts, fidx, &oi->didx,
+            s->pos, cend, NULL, limit, NULL, &s->ids, NULL, NULL, cancel);
+        if (n < 0) {
+            return -1;
+        }
+        s->pos = cend;
+        s->found += (uint32_t) n;
+        return 0;
+    }
+    return 1;
+}
+
+/**
+ * @brief find every ranked result, leaving the indexes which hold them
+ *        open
+ * @return non-zero on failure
+ */
+static int
+_roke_search_rank(roke_search_t* s, const roke_cancel_t* cancel)
+{
+    roke_sink_t sink = {NULL, NULL, &s->top, 0, NULL};
+    uint32_t i;
+    int err = 0;
+
+    for (i=0; i<s->nnames && !err; i++) {
+        roke_open_index_t* oi = &s->indexes[i];
+        roke_rank_t rank;
+        uint8_t* dirstate = NULL;
+        int count = 0;
+
+        if (_roke_open_index(oi, s->config_dir, s->names[i], NULL, s->m.strmatch, &s->opts)!=0) {
+            continue;
+        }
+        s->opened[i] = 1;
+        sink.index = i;
+
+        err = _roke_rank_init(&rank, s->m.strmatch, &oi->didx, i, s->top.k, &dirstate);
+        if (!err && oi->dmatch) {
+            err = roke_locate_index_impl(&sink, s->m.strmatch, &s->opts, &oi->didx,
+                &oi->didx, oi->dbegin, oi->dend, &count, "/", &rank, &s->top, cancel);
+        }
+        if (!err && oi->fmatch) {
+            err = roke_locate_index_impl(&sink, s->m.strmatch, &s->opts, &oi->fidx,
+                &oi->didx, oi->fbegin, oi->fend, &count, "", &rank, &s->top, cancel);
+        }
+        free(dirstate);
+    }
+    roke_topk_sort(&s->top);
+
+    // close the indexes which hold none of the results
+    uint8_t* used = calloc(s->nnames, sizeof(uint8_t));
+    if (used != NULL) {
+        for (i=0; i<s->top.size; i++) {
+            used[s->top.items[i].order >> 33] = 1;
+        }
+        for (i=0; i<s->nnames; i++) {
+            if (s->opened[i] && !used[i]) {
+                _roke_open_index_close(&s->indexes[i]);
+                s->opened[i] = 0;
+            }
+        }
+        free(used);
+    }
+    return err;
+}
+
+/**
+ * @brief get the next results of a search
+ * @param results  filled with up to nresults results
+ * @param buf      receives the null terminated path of every result,
+ *                 which results[i].path points into. should have room
+ *                 for 4096 bytes, the longest path
+ * @return the number of results, zero once every result has been
+ *         returned or the search is cancelled, or -1 on failure
+ *
+ * the paths are not written to any stream, and the search may be
+ * abandoned at any point by closing it.
+ */
+int
+roke_search_next(
+    roke_search_t* search,
+    roke_result_t* results,
+    size_t nresults,
+    char* buf,
+    size_t buflen)
+{
+    roke_search_t* s = search;
+    roke_cancel_t cancel = {&s->lock, &s->first, 0, NULL};
+    size_t n = 0, used = 0;
+
+    if (s->ranked && !s->collected) {
+        s->collected = 1;
+        if (_roke_search_rank(s, &cancel)!=0) {
+            return -1;
+        }
+    }
+
+    if (_roke_cancelled(&cancel)) {
+        return 0;
+    }
+
+    while (n < nresults) {
+        int is_dir;
+        uint32_t index, id;
+
+        if (s->ranked) {
+            if (s->next >= s->top.size) {
+                break;
+            }
+            uint64_t order = s->top.items[s->next].order;
+            index = (uint32_t) (order >> 33);
+            is_dir = !((order >> 32) & 1);
+            id = (uint32_t) order;
+        } else if (s->ids_pos < s->ids.size) {
+            index = s->index;
+            is_dir = (s->state == 1);
+            memcpy(&id, s->ids.data + s->ids_pos, sizeof(id));
+        } else {
+            if ((s->opts.limit > 0 && s->found >= (uint32_t) s->opts.limit) ||
+                _roke_cancelled(&cancel)) {
+                break;
+            }
+            int r = _roke_search_scan(s, &cancel);
+            if (r < 0) {
+                return -1;
+            }
+            if (r > 0) {
+                break;
+            }
+            continue;
+        }
+
+        if (_roke_search_result(&s->indexes[index], index, is_dir, id,
+                &results[n], buf + used, buflen - used)!=0) {
+            if (buflen - used < ROKE_PATH_MAX) {
+                // try again with the next buffer
+                if (n > 0) {
+                    break;
+                }
+                return -1;
+            }
+            // longer than any path, skipped like any other query
+        } else {
+            used += results[n].pathlen + 1;
+            n++;
+        }
+
+        if (s->ranked) {
+            s->next++;
+        } else {
+            s->ids_pos += sizeof(id);
+        }
+    }
+
+    return (int) n;
+}
+
+/**
+ * @brief the matches of the last query of a session in one index
+ */
+typedef struct roke_session_index {
+    char* name;
+    roke_index_sig_t dsig, fsig;    // the generation the ids belong to
+    roke_buffer_t dids;             // uint32_t ids of every match
+    roke_buffer_t fids;
+} roke_session_index_t;
+
+/**
+ * @brief a series of queries, each usually extending the one before it
+ *
+ * the indexes stay mapped between queries, and the ids of every match of
+ * the last query which ran to the end are kept. a query whose patterns
+ * extend those patterns can only match some of those entries, so only
+ * they are tested.
+ */
+struct roke_session {
+    roke_index_cache_t cache;
+    roke_session_index_t* last;     // sorted by name
+    uint32_t nlast;
+    char** patterns;                // the patterns of the last query
+    size_t npatterns;
+    roke_locate_options_t opts;
+    char* under;                    // a copy of opts.under
+
+    roke_mutex_t lock;
+    uint32_t first;                 // zero once cancelled, see roke_cancel_t
+};
+
+static void
+_roke_session_index_free(roke_session_index_t* items, uint32_t count)
+{
+    uint32_t i;
+    for (i=0; items != NULL && i<count; i++) {
+        free(items[i].name);
+        free(items[i].dids.data);
+        free(items[i].fids.data);
+    }
+    free(items);
+}
+
+/**
+ * @brief discard the matches of the last query
+ */
+static void
+_roke_session_forget(roke_session_t* s)
+{
+    size_t i;
+    _roke_session_index_free(s->last, s->nlast);
+    s->last = NULL;
+    s->nlast = 0;
+    for (i=0; s->patterns != NULL && i<s->npatterns; i++) {
+        free(s->patterns[i]);
+    }
+    free(s->patterns);
+    s->patterns = NULL;
+    s->npatterns = 0;
+    free(s->under);
+    s->under = NULL;
+}
+
+/**
+ * @brief remember the query whose matches are kept
+ * @return non-zero on failure
+ */
+static int
+_roke_session_remember(
+    roke_session_t* s,
+    const char** patterns,
+    size_t npatterns,
+    const roke_locate_options_t* opts)
+{
+    size_t i;
+
+    s->patterns = calloc(npatterns, sizeof(char*));
+    if (s->patterns == NULL) {
+        return 1;
+    }
+    s->npatterns = npatterns;
+    for (i=0; i<npatterns; i++) {
+        s->patterns[i] = (char*) strdup_safe((const uint8_t*) patterns[i]);
+        if (s->patterns[i] == NULL) {
+            return 1;
+        }
+    }
+    s->opts = *opts;
+    s->opts.under = NULL;
+    if (opts->under != NULL) {
+        s->under = (char*) strdup_safe((const uint8_t*) opts->under);
+        if (s->under == NULL) {
+            return 1;
+        }
+        s->opts.under = s->under;
+    }
+    return 0;
+}
+
+/**
+ * @brief test if every name matching a pattern also matches the pattern
+ *        it was extended from
+ *
+ * a literal pattern must contain the pattern before it, after both are
+ * folded the way names are. a fuzzy pattern must contain it as a
+ * subsequence.
+ */
+static int
+_roke_pattern_extends(const char* prev, const char* next, int flags)
+{
+    uint8_t a[ROKE_PATH_MAX];
+    uint8_t b[ROKE_PATH_MAX];
+    size_t alen = strlen(prev);
+    size_t blen = strlen(next);
+
+    if (alen >= sizeof(a) || blen >= sizeof(b)) {
+        return 0;
+    }
+    if (flags&ROKE_NORMALIZE) {
+        alen = tonormalized(a, sizeof(a) - 1, (const uint8_t*) prev, alen);
+        blen = tonormalized(b, sizeof(b) - 1, (const uint8_t*) next, blen);
+    } else {
+        memcpy(a, prev, alen);
+        memcpy(b, next, blen);
+    }
+    a[alen] = '\0';
+    b[blen] = '\0';
+
+    if (flags&ROKE_FUZZY) {
+        size_t i, j = 0;
+        for (i=0; i<blen && j<alen; i++) {
+            j += (b[i] == a[j]);
+        }
+        return j == alen;
+    }
+    return alen > 0 && strstr((const char*) b, (const char*) a) != NULL;
+}
+
+/**
+ * @brief test if the matches of a query are among the matches of the
+ *        last query of a session
+ *
+ * each pattern must extend the pattern in the same position, using the
+ * same flags and filters. with ROKE_MATCH_ALL or ROKE_MATCH_ANY every
+ * name matching the new patterns still matches the old ones. globs,
+ * regular expressions and queries are always searched in full.
+ */
+static int
+_roke_session_refines(
+    const roke_session_t* s,
+    const char** patterns,
+    size_t npatterns,
+    const roke_locate_options_t* opts)
+{
+    const roke_locate_options_t* prev = &s->opts;
+    size_t i;
+
+    if (s->patterns == NULL || npatterns != s->npatterns) {
+        return 0;
+    }
+    if (opts->match_flags != prev->match_flags ||
+        (opts->match_flags&(ROKE_GLOB|ROKE_REGEX|ROKE_QUERY))) {
+        return 0;
+    }
+    // results are checked to exist as they are written, not matched
+    if (((opts->filters ^ prev->filters) & ~ROKE_FILTER_EXISTS) ||
+        opts->newer != prev->newer || opts->older != prev->older || opts->size_min != prev->size_min ||
+        opts->size_max != prev->size_max || opts->types != prev->types) {
+        return 0;
+    }
+    if ((opts->under == NULL) != (prev->under == NULL) ||
+        (opts->under != NULL && strcmp(opts->under, prev->under)!=0)) {
+        return 0;
+    }
+    for (i=0; i<npatterns; i++) {
+        if (!_roke_pattern_extends(s->patterns[i], patterns[i], opts->match_flags)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/**
+ * @brief find every match of entries [begin, end) of an index
+ * @param out receives the uint32_t id of every match
+ * @param ids the entries which may match, or NULL to search them all
+ * @return non-zero on failure
+ */
+static int
+_roke_session_scan(
+    roke_buffer_t* out,
+    const roke_buffer_t* ids,
+    string_matcher_t** strmatch,
+    const roke_locate_options_t* opts,
+    roke_index_t* fidx,
+    roke_index_t* didx,
+    uint32_t begin,
+    uint32_t end,
+    const roke_rank_t* rank,
+    roke_topk_t* top,
+    const roke_cancel_t* cancel)
+{
+    if (ids == NULL) {
+        roke_sink_t sink = {NULL, out, NULL, 0, NULL};
+        int count = 0;
+        return roke_locate_index_impl(&sink, strmatch, opts, fidx, didx,
+            begin, end, &count, NULL, rank, top, cancel);
+    }
+    if (end > fidx->nitems) {
+        end = fidx->nitems;
+    }
+    if (begin >= end) {
+        return 0;
+    }
+    return _roke_scan_range(strmatch, opts, fidx, didx, begin, end, ids, 0,
+        NULL, out, rank, top, cancel) < 0;
+}
+
+/**
+ * @brief write a result of a session, or hold it to be checked by verify
+ * @return non-zero once no more results are wanted
+ */
+static int
+_roke_session_result(
+    roke_output_t* output,
+    roke_verify_t* verify,
+    roke_buffer_t* held,
+    int format,
+    const uint8_t* path,
+    size_t len)
+{
+    if (verify == NULL) {
+        return _roke_output_result(output, format, path, len);
+    }
+    if (_roke_buffer_result(held, format, path, len, (const uint8_t*) "", 0)) {
+        return 1;
+    }
+    if (held->size < ROKE_OUTPUT_CAPACITY) {
+        return 0;
+    }
+    int done = _roke_verify_write(verify, held->data, held->size);
+    held->size = 0;
+    return done;
+}
+
+/**
+ * @brief write the results of a query the way roke_locate writes them
+ * @param verify checks the results before they are written and applies
+ *               the limit, or NULL
+ * @return non-zero on failure
+ */
+static int
+_roke_session_write(
+    roke_output_t* output,
+    roke_verify_t* verify,
+    roke_index_cache_t* cache,
+    const roke_session_index_t* found,
+    const roke_topk_t* top,
+    int ranked,
+    const roke_locate_options_t* opts)
+{
+    uint8_t buffer1[4096];
+    uint32_t i, k;
+    int count = 0;
+    int err = 0;
+    roke_buffer_t held = {NULL, 0, 0};
+
+    if (ranked) {
+        for (i=0; i<top->size && !err; i++) {
+            uint64_t order = top->items[i].order;
+            roke_cached_index_t* item = &cache->items[order >> 33];
+            int is_dir = !((order >> 32) & 1);
+            size_t len = _roke_index_path((is_dir) ? &item->didx : &item->fidx,
+                &item->didx, (uint32_t) order, buffer1, sizeof(buffer1) - 1);
+            if (len == 0) {
+                continue;
+            }
+            if (is_dir) {
+                buffer1[len++] = SEP;
+            }
+            err = _roke_session_result(output, verify, &held, opts->format, buffer1, len);
+        }
+        goto end;
+    }
+
+    for (i=0; i<cache->count && !err; i++) {
+        roke_cached_index_t* item = &cache->items[i];
+        int is_dir;
+        for (is_dir=1; is_dir>=0 && !err; is_dir--) {
+            const roke_buffer_t* ids = (is_dir) ? &found[i].dids : &found[i].fids;
+            const uint32_t* id = (const uint32_t*) ids->data;
+            uint32_t n = (uint32_t) (ids->size / sizeof(uint32_t));
+            for (k=0; k<n && !err; k++) {
+                if (verify == NULL && opts->limit > 0 && count >= opts->limit) {
+                    goto end;
+                }
+                size_t len = _roke_index_path((is_dir) ? &item->didx : &item->fidx,
+                    &item->didx, id[k], buffer1, sizeof(buffer1) - 2);
+                if (len == 0) {
+                    continue;
+                }
+                if (is_dir) {
+                    buffer1[len++] = '/';
+                }
+                err = _roke_session_result(output, verify, &held, opts->format, buffer1, len);
+                count++;
+            }
+        }
+    }
+
+  end:
+    if (verify != NULL) {
+        // reaching the limit is not a failure, a failed write is
+        if (!err) {
+            _roke_verify_write(verify, held.data, held.size);
+        }
+        err = (output->err != 0) || (err && !verify->done);
+    }
+    free(held.data);
+    return err;
+}
+
+/**
+ * @brief start a series of queries on the indexes of a config directory
+ * @param session    set to the new session, which must be closed by
+ *                   roke_session_close
+ * @param config_dir the directory containing the index files
+ * @return non-zero on failure
+ */
+int
+roke_session_open(roke_session_t** session, const char* config_dir)
+{
+    roke_session_t* s = calloc(1, sizeof(roke_session_t));
+    *session = NULL;
+    if (s == NULL) {
+        return 1;
+    }
+    _roke_index_cache_init(&s->cache, (const uint8_t*) config_dir);
+    roke_mutex_init(&s->lock);
+    s->first = 1;
+    *session = s;
+    return 0;
+}
+
+/**
+ * @brief stop the query of a session which is running
+ *
+ * may be called from another thread, in which case the query returns
+ * without writing any result. the matches of the last query which ran to
+ * the end are kept for the next query.
+ */
+void
+roke_session_cancel(roke_session_t* session)
+{
+    roke_mutex_lock(&session->lock);
+    session->first = 0;
+    roke_mutex_unlock(&session->lock);
+}
+
+void
+roke_session_close(roke_session_t* session)
+{
+    if (session == NULL) {
+        return;
+    }
+    _roke_session_forget(session);
+    _roke_index_cache_free(&session->cache);
+    roke_mutex_destroy(&session->lock);
+    free(session);
+}
+
+/**
+ * @brief run the next query of a session, writing the results to fd
+ * @param fd         closed once the results are written, as by
+ *                   roke_locate_fd
+ * @param patterns   array of patterns, see roke_locate
+ * @param npatterns  length of the patterns array
+ * @param opts       match flags, limit and metadata filters
+ * @return zero on success, or if the query was cancelled. non-zero on
+ *         failure
+ *
+ * when the patterns extend the patterns of the last query, for example
+ * conf after con, only the entries which matched the last query are
+ * tested. otherwise, or if an index was rebuilt since, the index is
+ * searched in full. every match is found even with a limit, so that the
+ * next query can refine them, and the results are written once the
+ * query has run to the end.
+ */
+int
+roke_session_locate_fd(
+    roke_session_t* session,
+    int fd,
+    const char** patterns,
+    size_t npatterns,
+    const roke_locate_options_t* opts)
+{
+    roke_session_t* s = session;
+    roke_cancel_t cancel = {&s->lock, &s->first, 0, NULL};
+    roke_session_index_t* found = NULL;
+    uint32_t nfound = 0;
+    roke_matchers_t m;
+    roke_topk_t top;
+    uint32_t i, j = 0;
+    int err = 1;
+    roke_output_t output;
+
+    if (roke_output_init(&output, fd)!=0) {
+        roke_close(fd);
+        return -1;
+    }
 
-    // get the arrays of entries out of the mem map
-    idx->entries = (roke_entry_t*) (((uint8_t*)idx->data)+16);
+    memset(&m, 0, sizeof(m));
+    roke_topk_init(&top, (opts->limit > 0) ? (uint32_t) opts->limit : 0);
 
-    // get the initial mem position for which the offset is added
-    // to produce a name
-    idx->strings = idx->data;
+    // a cancel stops the query which is running, not the next one
+    roke_mutex_lock(&s->lock);
+    s->first = 1;
+    roke_mutex_unlock(&s->lock);
 
-    return 0;
+    if (_roke_index_cache_refresh(&s->cache)!=0 ||
+        _roke_matchers_init(&m, patterns, npatterns, opts->match_flags)!=0) {
+        goto end;
+    }
 
-  map_error:
-    fclose(idx->fp);
-    idx->fp = NULL;
+    int refine = _roke_session_refines(s, patterns, npatterns, opts);
+    int ranked = _roke_ranked(m.strmatch, opts);
+    roke_locate_options_t scan = *opts;
+    scan.limit = 0;
+    scan.filters &= ~ROKE_FILTER_EXISTS;
 
-    return 1;
+    nfound = s->cache.count;
+    found = calloc((nfound > 0) ? nfound : 1, sizeof(roke_session_index_t));
+    if (found == NULL) {
+        goto end;
+    }
 
-}
+    for (i=0; i<nfound && !_roke_cancelled(&cancel); i++) {
+        roke_cached_index_t* item = &s->cache.items[i];
+        roke_session_index_t* r = &found[i];
+        roke_session_index_t* prev = NULL;
+        roke_open_index_t oi;
 
+        r->name = (char*) strdup_safe((const uint8_t*) item->name);
+        if (r->name == NULL) {
+            goto end;
+        }
+        r->dsig = item->dsig;
+        r->fsig = item->fsig;
 
-int
-roke_index_close(roke_index_t* idx)
-{
-    int rc;
+        // the ids of the last query must belong to the same generation
+        // of the index. both lists are sorted by name
+        while (j < s->nlast && strcmp(s->last[j].name, item->name) < 0) {
+            j++;
+        }
+        if (refine && j < s->nlast && strcmp(s->last[j].name, item->name)==0 &&
+            memcmp(&s->last[j].dsig, &r->dsig, sizeof(r->dsig))==0 &&
+            memcmp(&s->last[j].fsig, &r->fsig, sizeof(r->fsig))==0) {
+            prev = &s->last[j];
+        }
 
-    if (idx->data != NULL) {
-        rc = munmap(idx->data, idx->fsize);
-        if (rc != 0) {
-            fprintf(stderr, "warning: error unmapping directory index.");
+        if (_roke_open_index(&oi, s->cache.config_dir, item->name, item,
+                m.strmatch, &scan)!=0) {
+            continue;
+        }
+
+        roke_rank_t rank, *prank = NULL;
+        uint8_t* dirstate = NULL;
+        int e = 0;
+        if (ranked) {
+            e = _roke_rank_init(&rank, m.strmatch, &oi.didx, i, top.k, &dirstate);
+            prank = &rank;
+        }
+        if (!e && oi.dmatch) {
+            e = _roke_session_scan(&r->dids, (prev) ? &prev->dids : NULL,
+                m.strmatch, &scan, &oi.didx, &oi.didx, oi.dbegin, oi.dend,
+                prank, &top, &cancel);
+        }
+        if (!e && oi.fmatch) {
+            e = _roke_session_scan(&r->fids, (prev) ? &prev->fids : NULL,
+                m.strmatch, &scan, &oi.fidx, &oi.didx, oi.fbegin, oi.fend,
+                prank, &top, &cancel);
+        }
+        free(dirstate);
+        _roke_open_index_close(&oi);
+        if (e) {
+            goto end;
         }
     }
-    idx->data = NULL;
 
-    if (idx->fp != NULL) {
-        fclose(idx->fp);
+    if (_roke_cancelled(&cancel)) {
+        // the matches are incomplete, keep the last ones
+        err = 0;
+        goto end;
     }
-    idx->fp = NULL;
 
-    return 0;
+    roke_topk_sort(&top);
+    if (opts->filters&ROKE_FILTER_EXISTS) {
+        roke_verify_t* verify = _roke_verify_open(&output, opts);
+        err = (verify == NULL) ||
+            _roke_session_write(&output, verify, &s->cache, found, &top, ranked, opts);
+        _roke_verify_close(verify);
+    } else {
+        err = _roke_session_write(&output, NULL, &s->cache, found, &top, ranked, opts);
+    }
+    err = roke_output_flush(&output) || err;
+
+    _roke_session_forget(s);
+    s->last = found;
+    s->nlast = nfound;
+    found = NULL;
+    if (_roke_session_remember(s, patterns, npatterns, opts)!=0) {
+        // without its patterns the next query can not refine the matches
+        _roke_session_forget(s);
+    }
+
+  end:
+    _roke_session_index_free(found, nfound);
+    _roke_matchers_free(&m);
+    roke_topk_free(&top);
+    roke_output_free(&output);
+    roke_close(fd);
+    return err;
 }
 
+/*
+ * roke-server keeps the indexes of a config directory mapped, and answers
+ * queries on the socket <config_dir>/roke.sock.
+ *
+ * a request is a header followed by the options and patterns of a query,
+ * in the byte order of the host:
+ *
+ *     uint32 magic, uint32 size of the rest of the request
+ *     int32 match_flags, limit, threads
+ *     uint32 filters, types
+ *     int64 newer, older
+ *     uint64 size_min, size_max
+ *     uint32 npatterns
+ *     string under, then npatterns strings
+ *
+ * a string is a uint32 length and its bytes. under is NULL if its length
+ * is UINT32_MAX. the response is a uint32 magic and an int32 status, and
+ * when the status is zero, the text roke would have written as frames of
+ * a uint32 length and its bytes. an empty frame and the int32 status of
+ * the query end the response, a response which ends without them was
+ * cut short.
+ */
+
+#define ROKE_SERVER_SOCKET "roke.sock"
+#define ROKE_SERVER_REQUEST 0x32514b52  // "RKQ2"
+#define ROKE_SERVER_RESPONSE 0x32524b52 // "RKR2"
+#define ROKE_SERVER_MAX_REQUEST (1 << 20)
+#define ROKE_SERVER_TIMEOUT 5           // seconds
+
+/**
+ * @brief a query decoded from a request
+ */
+typedef struct roke_request {
+    roke_locate_options_t opts;
+    const char** patterns;
+    uint32_t npatterns;
+    uint8_t* data;          // the strings of the request, made null terminated
+} roke_request_t;
+
+static int
+_roke_put_u32(roke_buffer_t* buf, uint32_t v)
+{
+    return _roke_buffer_append(buf, (const uint8_t*) &v, sizeof(v));
+}
 
-static int roke_locate_index_impl(FILE* output, string_matcher_t** strmatch, roke_index_t* fidx, roke_index_t* didx, int* count, int limit, char* suffix)
+static int
+_roke_put_u64(roke_buffer_t* buf, uint64_t v)
 {
+    return _roke_buffer_append(buf, (const uint8_t*) &v, sizeof(v));
+}
 
-    uint32_t idx;
-    uint8_t buffer1[4096];
+static int
+_roke_put_string(roke_buffer_t* buf, const char* str)
+{
+    if (str == NULL) {
+        return _roke_put_u32(buf, UINT32_MAX);
+    }
+    uint32_t len = (uint32_t) strlen(str);
+    return _roke_put_u32(buf, len) ||
+        _roke_buffer_append(buf, (const uint8_t*) str, len);
+}
 
-    for (idx=0; idx< fidx->nitems; idx++) {
+/**
+ * @brief encode a query as a request
+ * @return non-zero on failure
+ */
+static int
+_roke_request_encode(
+    roke_buffer_t* buf,
+    const char** patterns,
+    size_t npatterns,
+    const roke_locate_options_t* opts)
+{
+    size_t i;
+    int err = _roke_put_u32(buf, ROKE_SERVER_REQUEST) ||
+        _roke_put_u32(buf, 0) ||
+        _roke_put_u32(buf, (uint32_t) opts->match_flags) ||
+        _roke_put_u32(buf, (uint32_t) opts->limit) ||
+        _roke_put_u32(buf, (uint32_t) opts->threads) ||
+        _roke_put_u32(buf, opts->filters) ||
+        _roke_put_u32(buf, opts->types) ||
+        _roke_put_u32(buf, (uint32_t) opts->format) ||
+        _roke_put_u64(buf, (uint64_t) opts->newer) ||
+        _roke_put_u64(buf, (uint64_t) opts->older) ||
+        _roke_put_u64(buf, opts->size_min) ||
+        _roke_put_u64(buf, opts->size_max) ||
+        _roke_put_u32(buf, (uint32_t) npatterns) ||
+        _roke_put_string(buf, opts->under);
+    for (i=0; i<npatterns && !err; i++) {
+        err = _roke_put_string(buf, patterns[i]);
+    }
+    if (err || buf->size > ROKE_SERVER_MAX_REQUEST) {
+        return 1;
+    }
+    uint32_t size = (uint32_t) (buf->size - 2 * sizeof(uint32_t));
+    memcpy(buf->data + sizeof(uint32_t), &size, sizeof(size));
+    return 0;
+}
 
-        uint8_t* pname = fidx->strings + fidx->entries[idx].offset;
-        uint16_t name_length = fidx->entries[idx].namelen;
-        uint32_t parent_index = fidx->entries[idx].index;
+/**
+ * @brief read the next field of a request
+ * @return non-zero if the request is too short
+ */
+static int
+_roke_get(const uint8_t** p, const uint8_t* end, void* dst, size_t len)
+{
+    if ((size_t) (end - *p) < len) {
+        return 1;
+    }
+    memcpy(dst, *p, len);
+    *p += len;
+    return 0;
+}
 
-        if (string_matcher_match(strmatch[0], pname, name_length)==0) {
+/**
+ * @brief read a string of a request, moving it back by one byte to make
+ *        room for its null terminator
+ * @param str set to the string, or NULL
+ */
+static int
+_roke_get_string(const uint8_t** p, const uint8_t* end, char** str)
+{
+    uint32_t len;
+    if (_roke_get(p, end, &len, sizeof(len))) {
+        return 1;
+    }
+    if (len == UINT32_MAX) {
+        *str = NULL;
+        return 0;
+    }
+    if ((size_t) (end - *p) < len) {
+        return 1;
+    }
+    // the length field is no longer needed, so the string fits before its end
+    uint8_t* s = (uint8_t*) *p - 1;
+    memmove(s, *p, len);
+    s[len] = '\0';
+    *p += len;
+    *str = (char*) s;
+    return 0;
+}
 
-            uint8_t* path[ROKE_RECURSION_DEPTH];
-            uint32_t path_idx = 1023;
-            // copy the path components into the array in reverse order
-            path[path_idx--] = pname;
-            while (parent_index > 0 && parent_index < didx->nitems) {
-                pname = didx->strings + didx->entries[parent_index].offset;
-                parent_index = didx->entries[parent_index].index;
-                path[path_idx--] = pname;
-            }
-            pname = didx->strings + didx->entries[0].offset;
-            path[path_idx] = pname;
+/**
+ * @brief decode the body of a request
+ * @param data the body, which is modified and owned by req afterwards
+ * @return non-zero if the request is malformed
+ */
+static int
+_roke_request_decode(roke_request_t* req, uint8_t* data, size_t size)
+{
+    const uint8_t* p = data;
+    const uint8_t* end = data + size;
+    roke_locate_options_t* opts = &req->opts;
+    uint32_t u32, i;
+    uint64_t u64;
+    char* under;
+
+    memset(req, 0, sizeof(roke_request_t));
+    req->data = data;
+    roke_locate_options_init(opts);
+
+    if (_roke_get(&p, end, &u32, 4)) return 1;
+    opts->match_flags = (int) u32;
+    if (_roke_get(&p, end, &u32, 4)) return 1;
+    opts->limit = (int) u32;
+    if (_roke_get(&p, end, &u32, 4)) return 1;
+    opts->threads = (int) u32;
+    if (_roke_get(&p, end, &opts->filters, 4)) return 1;
+    if (_roke_get(&p, end, &opts->types, 4)) return 1;
+    if (_roke_get(&p, end, &u32, 4)) return 1;
+    opts->format = (int) u32;
+    if (_roke_get(&p, end, &u64, 8)) return 1;
+    opts->newer = (int64_t) u64;
+    if (_roke_get(&p, end, &u64, 8)) return 1;
+    opts->older = (int64_t) u64;
+    if (_roke_get(&p, end, &opts->size_min, 8)) return 1;
+    if (_roke_get(&p, end, &opts->size_max, 8)) return 1;
+    if (_roke_get(&p, end, &req->npatterns, 4)) return 1;
+    if (req->npatterns == 0 || req->npatterns > size) return 1;
+    if (_roke_get_string(&p, end, &under)) return 1;
+    opts->under = under;
+
+    req->patterns = calloc(req->npatterns, sizeof(char*));
+    if (req->patterns == NULL) {
+        return 1;
+    }
+    for (i=0; i<req->npatterns; i++) {
+        char* pattern;
+        if (_roke_get_string(&p, end, &pattern) || pattern == NULL) {
+            return 1;
+        }
+        req->patterns[i] = pattern;
+    }
+    return p != end;
+}
 
-            const uint8_t** parts = (const uint8_t**) (path + path_idx);
-            size_t nparts = (sizeof(path) / sizeof(char*)) - path_idx;
+static void
+_roke_request_free(roke_request_t* req)
+{
+    free(req->patterns);
+    free(req->data);
+    memset(req, 0, sizeof(roke_request_t));
+}
 
-            // todo check for errors
-            _joinpath(parts, nparts, buffer1, sizeof(buffer1));
+#ifndef _WIN32
 
-            int i, m=0;
-            for (i=1; strmatch[i]!=NULL; i++) {
-                if (string_matcher_match(strmatch[i],
-                        buffer1, sizeof(buffer1))!=0) {
-                    m=1;
-                    break;
-                }
-            }
-            if (m!=0) {
-                continue;
-            }
+static volatile sig_atomic_t _roke_server_stopped = 0;
 
-            fprintf(output, "%s%s\n", buffer1, suffix);
-            (*count)++;
+/**
+ * @brief the path of the server socket of a config directory
+ * @return non-zero if the path is too long for a socket address
+ */
+static int
+_roke_server_address(const char* config_dir, struct sockaddr_un* addr)
+{
+    uint8_t path[ROKE_PATH_MAX];
+    const uint8_t* parts[] = { (const uint8_t*) config_dir, (const uint8_t*) ROKE_SERVER_SOCKET };
+    _joinpath(parts, 2, path, sizeof(path));
 
-            if (limit > 0 && (*count) >= limit) {
-                break;
-            }
+    memset(addr, 0, sizeof(struct sockaddr_un));
+    addr->sun_family = AF_UNIX;
+    if (strlen((char*) path) >= sizeof(addr->sun_path)) {
+        return 1;
+    }
+    strcpy_safe((uint8_t*) addr->sun_path, sizeof(addr->sun_path), path);
+    return 0;
+}
 
+static int
+_roke_write_full(int fd, const void* data, size_t len)
+{
+    const uint8_t* p = (const uint8_t*) data;
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n < 0 && errno == EINTR) {
+            continue;
         }
+        if (n <= 0) {
+            return 1;
+        }
+        p += n;
+        len -= (size_t) n;
     }
+    return 0;
+}
 
+static int
+_roke_read_full(int fd, void* data, size_t len)
+{
+    uint8_t* p = (uint8_t*) data;
+    while (len > 0) {
+        ssize_t n = read(fd, p, len);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return 1;
+        }
+        p += n;
+        len -= (size_t) n;
+    }
     return 0;
 }
 
+static void
+_roke_socket_timeout(int fd, int seconds)
+{
+    struct timeval tv;
+    tv.tv_sec = seconds;
+    tv.tv_usec = 0;
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+}
+
 /**
- * @brief find files patching a given set of patterns
- * @param config_dir null terminated string ending in a path separator
- *                   the directory path containing index files
- * @param bmopts     null terminated list of pointers to boyer_moore
- *                   options structs
- * @return
+ * @brief a response held in memory, written to its connection by a
+ *        thread of its own
+ */
+typedef struct roke_server_reply {
+    int conn;
+    char* data;
+    size_t size;
+} roke_server_reply_t;
+
+static void
+_roke_server_reply_worker(void* arg)
+{
+    roke_server_reply_t* reply = (roke_server_reply_t*) arg;
+    _roke_write_full(reply->conn, reply->data, reply->size);
+    close(reply->conn);
+    free(reply->data);
+    free(reply);
+}
+
+/**
+ * @brief answer the query of one connection, and close it
  *
- * This implementation of find memory maps the index files to improve
- * lookup speed by removing the need to parse a text file.
+ * the request and the status header are bounded by the socket timeouts.
+ * the results are collected in memory and written without a deadline by
+ * a thread of their own, so that a client which reads slowly (roke foo |
+ * less) neither loses results nor holds up the clients after it.
  */
-int roke_locate_impl(
-    FILE* output,
-    const uint8_t* config_dir,
-    string_matcher_t** strmatch,
-    int limit)
+static void
+_roke_server_handle(roke_index_cache_t* cache, int conn)
 {
-    int i=0;
-    int count=0;
-    uint8_t didx_path[4096];
-    uint8_t fidx_path[4096];
+    uint32_t header[2];
+    int32_t response[2] = {ROKE_SERVER_RESPONSE, 1};
+    roke_request_t req;
+    roke_matchers_t m;
+    roke_output_t output;
+    roke_server_reply_t* reply = NULL;
+    roke_thread_t thread;
+    uint8_t* data = NULL;
+    FILE* fp = NULL;
+
+    memset(&req, 0, sizeof(req));
+    memset(&m, 0, sizeof(m));
+    memset(&output, 0, sizeof(output));
+
+    if (_roke_read_full(conn, header, sizeof(header)) ||
+        header[0] != ROKE_SERVER_REQUEST || header[1] > ROKE_SERVER_MAX_REQUEST) {
+        goto end;
+    }
+    data = malloc(header[1] + 1);
+    if (data == NULL || _roke_read_full(conn, data, header[1])) {
+        free(data);
+        goto end;
+    }
+    if (_roke_request_decode(&req, data, header[1])!=0) {
+        goto error;
+    }
 
-    DIR *d = NULL;
-    struct dirent *dir;
+    // pick up the indexes built since the last query
+    if (_roke_index_cache_refresh(cache)!=0 ||
+        _roke_matchers_init(&m, req.patterns, req.npatterns, req.opts.match_flags)!=0) {
+        goto error;
+    }
 
-    roke_index_t didx, fidx;
+    response[1] = 0;
+    if (_roke_write_full(conn, response, sizeof(response))) {
+        goto end;
+    }
 
-    d = opendir((char*)config_dir);
-    if (!d) {
-        fprintf(stderr, "failed to open config directory\n");
-        goto error;
+    int32_t trailer[2] = {0, 1};
+    reply = calloc(1, sizeof(roke_server_reply_t));
+    fp = (reply != NULL) ? open_memstream(&reply->data, &reply->size) : NULL;
+    if (fp == NULL) {
+        // the client reports a response without results as a failure
+        _roke_write_full(conn, trailer, sizeof(trailer));
+        free(reply);
+        goto end;
     }
+    if (roke_output_init_file(&output, fp)==0) {
+        output.framed = 1;
+        trailer[1] = _roke_locate_run(&output, cache->config_dir, cache, m.strmatch, &req.opts);
+        trailer[1] = roke_output_flush(&output) || trailer[1];
+    }
+    fwrite(trailer, sizeof(trailer), 1, fp);
+    fclose(fp);
 
-    while ((dir = readdir(d)) != NULL) {
+    reply->conn = conn;
+    _roke_socket_timeout(conn, 0);
+    if (roke_thread_create(&thread, _roke_server_reply_worker, reply)==0) {
+        roke_thread_detach(&thread);
+    } else {
+        _roke_server_reply_worker(reply);
+    }
+    conn = -1;
+    goto end;
 
-        if (limit > 0 && count >= limit) {
-            printf("limit reached a %d/%d\n", count, limit);
-            break;
-        }
+  error:
+    // the client searches without the server
+    _roke_write_full(conn, response, sizeof(response));
 
-        // find all databases,
+  end:
+    if (conn >= 0) {
+        close(conn);
+    }
+    roke_output_free(&output);
+    _roke_matchers_free(&m);
+    _roke_request_free(&req);
+}
 
-        size_t name_len = strlen(dir->d_name);
-        if (!has_suffix((uint8_t*) dir->d_name, name_len, (uint8_t*)".d.bin", 6)) {
-            continue;
+#endif
+
+/**
+ * @brief answer queries for a config directory until roke_server_stop
+ * @return non-zero if the server could not be started
+ *
+ * the indexes are mapped once, and mapped again when roke-build replaces
+ * them, so a query only pays for matching. queries are answered one at a
+ * time, each using every thread. a client which does not send its request
+ * or read the status within ROKE_SERVER_TIMEOUT seconds is dropped, the
+ * results are then written by a thread of their own at the pace of the
+ * client.
+ */
+int
+roke_server_run(const char* config_dir)
+{
+#ifdef _WIN32
+    fprintf(stderr, "error: roke-server is not supported on windows\n");
+    return 1;
+#else
+    struct sockaddr_un addr;
+    roke_index_cache_t cache;
+
+    if (_roke_server_address(config_dir, &addr)!=0) {
+        fprintf(stderr, "error: config directory path too long for a socket\n");
+        return 1;
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        fprintf(stderr, "error: failed to create socket\n");
+        return 1;
+    }
+
+    // a socket which nothing answers was left by a server which exited
+    // without removing it
+    if (connect(fd, (struct sockaddr*) &addr, sizeof(addr))==0) {
+        fprintf(stderr, "error: a server is already running: %s\n", addr.sun_path);
+        close(fd);
+        return 1;
+    }
+    close(fd);
+    unlink(addr.sun_path);
+
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    // only the owner of the config directory may connect
+    mode_t mask = umask(077);
+    int err = (fd < 0) || bind(fd, (struct sockaddr*) &addr, sizeof(addr))!=0;
+    umask(mask);
+    if (err || listen(fd, 16)!=0) {
+        fprintf(stderr, "error: failed to listen on %s\n", addr.sun_path);
+        if (fd >= 0) {
+            close(fd);
         }
+        return 1;
+    }
 
-        const uint8_t* parts[] = { config_dir, (uint8_t*)dir->d_name };
-        // todo check for errors
-        _joinpath(parts, 2, didx_path, sizeof(didx_path));
-        strcpy_safe(fidx_path, sizeof(fidx_path), didx_path);
-        fidx_path[strlen((char*)fidx_path) - 5] = 'f';
+    // a client which goes away must not stop the server
+    signal(SIGPIPE, SIG_IGN);
 
-        if (roke_index_open(&didx, didx_path)!=0)
-            goto error_didx;
+    _roke_server_stopped = 0;
+    _roke_index_cache_init(&cache, (const uint8_t*) config_dir);
+    _roke_index_cache_refresh(&cache);
 
-        if (roke_index_open(&fidx, fidx_path)!=0)
-            goto error_fidx;
+    while (!_roke_server_stopped) {
+        struct pollfd pfd = {fd, POLLIN, 0};
+        // wake up regularly to notice roke_server_stop
+        if (poll(&pfd, 1, 1000) <= 0) {
+            continue;
+        }
+        int conn = accept(fd, NULL, NULL);
+        if (conn < 0) {
+            continue;
+        }
+        _roke_socket_timeout(conn, ROKE_SERVER_TIMEOUT);
+        _roke_server_handle(&cache, conn);
+    }
 
-        // match the pattern against directories
-        roke_locate_index_impl(output, strmatch, &didx, &didx, &count, limit, "/");
+    _roke_index_cache_free(&cache);
+    close(fd);
+    unlink(addr.sun_path);
+    return 0;
+#endif
+}
 
-        // match the pattern against files
-        roke_locate_index_impl(output, strmatch, &fidx, &didx, &count, limit, "");
+/**
+ * @brief stop roke_server_run after the query it is answering
+ *
+ * safe to call from a signal handler.
+ */
+void
+roke_server_stop(void)
+{
+#ifndef _WIN32
+    _roke_server_stopped = 1;
+#endif
+}
 
-    error_fidx:
-        roke_index_close(&fidx);
-    error_didx:
-        roke_index_close(&didx);
+/**
+ * @brief find files using the server of a config directory
+ * @param fd the results are written to this file descriptor
+ * @return -1 if no server answered the query, or the server stopped
+ *         before any result was written, the query should then be run
+ *         with roke_locate_ex. otherwise zero, or non-zero if the
+ *         results could not all be written
+ */
+int
+roke_locate_remote_fd(
+    int fd,
+    const char* config_dir,
+    const char** patterns,
+    size_t npatterns,
+    const roke_locate_options_t* opts)
+{
+#ifdef _WIN32
+    return -1;
+#else
+    struct sockaddr_un addr;
+    roke_buffer_t request = {NULL, 0, 0};
+    int32_t response[2];
+    uint8_t buffer[1 << 16];
+    int v = -1;
 
+    if (npatterns == 0 || _roke_server_address(config_dir, &addr)!=0) {
+        return -1;
+    }
+    int sock = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (sock < 0) {
+        return -1;
+    }
+    if (connect(sock, (struct sockaddr*) &addr, sizeof(addr))!=0 ||
+        _roke_request_encode(&request, patterns, npatterns, opts)!=0) {
+        goto end;
     }
 
-  error:
+    // a server busy with a long query is not waited for
+    _roke_socket_timeout(sock, 2);
+    if (_roke_write_full(sock, request.data, request.size) ||
+        _roke_read_full(sock, response, sizeof(response)) ||
+        response[0] != ROKE_SERVER_RESPONSE || response[1] != 0) {
+        goto end;
+    }
+    _roke_socket_timeout(sock, 0);
+
+    // a server which stops before the empty frame failed to answer
+    size_t written = 0;
+    int ended = 0;
+    v = 1;
+    while (1) {
+        uint32_t frame;
+        if (_roke_read_full(sock, &frame, sizeof(frame))) {
+            break;
+        }
+        if (frame == 0) {
+            int32_t status;
+            if (_roke_read_full(sock, &status, sizeof(status))==0) {
+                v = (status != 0);
+                ended = 1;
+            }
+            break;
+        }
+        while (frame > 0) {
+            size_t n = (frame < sizeof(buffer)) ? frame : sizeof(buffer);
+            if (_roke_read_full(sock, buffer, n)) {
+                goto cut;
+            }
+            if (_roke_write_full(fd, buffer, n)) {
+                goto end;
+            }
+            written += n;
+            frame -= (uint32_t) n;
+        }
+    }
 
-    if (d != NULL) {
-        closedir(d);
+  cut:
+    if (!ended) {
+        if (written == 0) {
+            // nothing was written, the query is run without the server
+            fprintf(stderr, "warning: the server stopped answering, searching without it\n");
+            v = -1;
+        } else {
+            fprintf(stderr, "error: the server stopped before sending every result\n");
+        }
     }
 
-    return 0;
+  end:
+    free(request.data);
+    close(sock);
+    return v;
+#endif
 }
 
 size_t
@@ -969,6 +6967,21 @@ roke_index_dirinfo(
 
     snprintf((char*) didx_path, sizeof(didx_path), "%s%s.d.bin", config_dir, name);
 
+    // a compressed name must be decompressed from its frame
+    roke_section_t section;
+    if (roke_index_find_section(didx_path, ROKE_SECTION_NAMES, &section)==0) {
+        roke_index_t idx;
+        uint16_t namelen;
+        if (roke_index_open_ex(&idx, didx_path, 1)!=0 || idx.nitems == 0) {
+            fprintf(stderr, "failed to read entry root\n");
+            return 0;
+        }
+        const uint8_t* pname = roke_index_name(&idx, 0, &namelen);
+        strcpy_safe((uint8_t*) root, rootlen, pname);
+        roke_index_close(&idx);
+        return strlen(root);
+    }
+
     FILE* didx = fopen_safe(didx_path, "r");
 
     if (didx == NULL) {
@@ -978,12 +6991,16 @@ roke_index_dirinfo(
 
     size_t count;
     roke_entry_t  entry;
-    count=fread(root, sizeof(uint8_t), 16, didx);
-    if (count != 16) { 
+    uint32_t header[4];
+    count=fread(header, sizeof(uint32_t), 4, didx);
+    if (count != 4) { 
         fclose(didx); 
         fprintf(stderr, "failed to read header\n");
         return 0; 
     }
+    if (header[2] != 0) {
+        fseek(didx, header[2], SEEK_SET);
+    }
     count=fread(&entry, sizeof(entry), 1, didx);
     if (count != 1) { 
         fclose(didx); 
@@ -1070,10 +7087,26 @@ roke_rebuild_index(
     char** blacklist)
 {
     char root[ROKE_PATH_MAX];
+    uint8_t didx_path[ROKE_PATH_MAX];
+    roke_section_t section;
+    int build_flags = 0;
 
     roke_index_dirinfo(config_dir, name, root, sizeof(root));
 
+    // preserve the metadata columns, compression and normalized names of
+    // the existing index
+    snprintf((char*) didx_path, sizeof(didx_path), "%s%s.d.bin", config_dir, name);
+    if (roke_index_find_section(didx_path, ROKE_SECTION_MODE, &section)==0) {
+        build_flags |= ROKE_BUILD_METADATA;
+    }
+    if (roke_index_find_section(didx_path, ROKE_SECTION_NAMES, &section)==0) {
+        build_flags |= ROKE_BUILD_COMPRESS;
+    }
+    if (roke_index_find_section(didx_path, ROKE_SECTION_NORM, &section)==0) {
+        build_flags |= ROKE_BUILD_NORMALIZE;
+    }
+
     fprintf(stdout, "Rebuilding  %s: root=%s\n", name, root);
 
-    return roke_build_index(config_dir, name, root, blacklist);
+    return roke_build_index_ex(config_dir, name, root, blacklist, build_flags);
 }
\ No newline at end of file
@@ -34,6 +34,78 @@ extern "C" {
 #define ROKE_CASE_INSENSITIVE  1
 #define ROKE_GLOB  2
 #define ROKE_REGEX  4
+// every pattern matches names. a name must contain any (or all) of them
+#define ROKE_MATCH_ANY  8
+#define ROKE_MATCH_ALL  16
+// the patterns are joined by spaces and parsed as a query, see roke_locate
+#define ROKE_QUERY  32
+// compare names and patterns after NFKC normalization and case folding.
+// fastest with an index built with ROKE_BUILD_NORMALIZE
+#define ROKE_NORMALIZE  64
+// the pattern is a subsequence of the path, e.g. rklbc finds roke/libroke.c.
+// results are written best first, limit is the number of results ranked.
+// smart case: ASCII letters match either case unless the pattern has upper
+// case letters
+#define ROKE_FUZZY  128
+// write the results best first instead of in index order, and keep the
+// best limit results: names which are exactly the pattern, then shallower
+// paths, then recently modified entries if the index stores metadata
+#define ROKE_RANK  256
+
+// build flags
+#define ROKE_BUILD_METADATA 1
+// store names in compressed frames, which are decompressed while searching
+#define ROKE_BUILD_COMPRESS 2
+// store every name normalized for ROKE_NORMALIZE, see tonormalized
+#define ROKE_BUILD_NORMALIZE 4
+
+// entry types, used by the type filter
+#define ROKE_TYPE_FILE 1
+#define ROKE_TYPE_DIR  2
+#define ROKE_TYPE_LINK 4
+
+// set in roke_locate_options_t.filters for each filter that is enabled
+#define ROKE_FILTER_NEWER    1
+#define ROKE_FILTER_OLDER    2
+#define ROKE_FILTER_SIZE_MIN 4
+#define ROKE_FILTER_SIZE_MAX 8
+#define ROKE_FILTER_TYPE     16
+// drop results which no longer exist on disk. every result is checked
+// with lstat as it is written, by the roke_locate functions, the server
+// and sessions. roke_count and roke_search ignore it
+#define ROKE_FILTER_EXISTS   32
+
+// how roke_locate_options_t.format separates the results which are written
+#define ROKE_FORMAT_LINES   0   // each path is followed by a newline
+#define ROKE_FORMAT_NUL     1   // each path is followed by a null byte, for xargs -0
+// each path is preceded by its length as a uint32_t in host byte order,
+// and is not terminated
+#define ROKE_FORMAT_RECORDS 2
+
+/**
+ * @brief options for roke_locate_ex
+ *
+ * metadata filters are evaluated before the name is matched. filters on
+ * size and time require an index built with ROKE_BUILD_METADATA, indexes
+ * without metadata are skipped. ROKE_FILTER_EXISTS is evaluated on the
+ * results instead, ranked results once they have been ranked, so fewer
+ * than limit ranked results are written if some have been deleted.
+ */
+typedef struct roke_locate_options {
+    int match_flags;    // ROKE_CASE_INSENSITIVE, ROKE_GLOB, ROKE_REGEX,
+                        // ROKE_MATCH_ANY, ROKE_MATCH_ALL, ROKE_QUERY,
+                        // ROKE_NORMALIZE, ROKE_FUZZY, ROKE_RANK
+    int limit;          // maximum number of results, zero for no limit
+    uint32_t filters;   // the set of ROKE_FILTER_* which are enabled
+    int64_t newer;      // modified at or after this unix time
+    int64_t older;      // modified before this unix time
+    uint64_t size_min;  // at least this many bytes
+    uint64_t size_max;  // at most this many bytes
+    uint32_t types;     // combination of ROKE_TYPE_*
+    const char* under;  // absolute path, only search below this directory
+    int threads;        // threads used to scan an index, zero to use every cpu
+    int format;         // ROKE_FORMAT_*, how the results are separated
+} roke_locate_options_t;
 
 ROKE_API size_t roke_default_config_dir(char* dst, size_t dstlen);
 
@@ -42,6 +114,9 @@ ROKE_API int roke_build_cancel();
 ROKE_API int roke_build_index(const char* config_dir,
     const char* name, const char* root, char** blacklist);
 
+ROKE_API int roke_build_index_ex(const char* config_dir,
+    const char* name, const char* root, char** blacklist, int build_flags);
+
 ROKE_API int roke_build_index_fd(int fd, const char* config_dir,
     const char* name, const char* root, char** blacklist);
 
@@ -52,6 +127,75 @@ ROKE_API int roke_locate(const char* config_dir, const char** patterns,
 ROKE_API int roke_locate_fd(int fd, const char* config_dir, const char** patterns,
     size_t npatterns, int match_flags, int limit);
 
+ROKE_API void roke_locate_options_init(roke_locate_options_t* opts);
+
+ROKE_API int roke_locate_ex(const char* config_dir, const char** patterns,
+    size_t npatterns, const roke_locate_options_t* opts);
+
+ROKE_API int roke_locate_ex_fd(int fd, const char* config_dir,
+    const char** patterns, size_t npatterns, const roke_locate_options_t* opts);
+
+/**
+ * @brief the number of matches in one index, see roke_count
+ */
+typedef struct roke_index_count {
+    char name[256];     // the index name, as given to roke_build_index
+    uint64_t count;
+} roke_index_count_t;
+
+ROKE_API int64_t roke_count(const char* config_dir, const char** patterns,
+    size_t npatterns, const roke_locate_options_t* opts,
+    roke_index_count_t* counts, size_t* ncounts);
+
+ROKE_API int roke_locate_remote_fd(int fd, const char* config_dir,
+    const char** patterns, size_t npatterns, const roke_locate_options_t* opts);
+
+ROKE_API int roke_server_run(const char* config_dir);
+
+ROKE_API void roke_server_stop(void);
+
+/**
+ * @brief a search whose results are pulled in batches, see roke_search_open
+ */
+typedef struct roke_search roke_search_t;
+
+typedef struct roke_result {
+    const char* path;   // null terminated, in the buffer given to roke_search_next
+    uint32_t pathlen;
+    uint32_t id;        // the entry in its directory or file index
+    uint32_t index;     // the index holding the entry, see roke_search_index_name
+    uint32_t type;      // ROKE_TYPE_*, zero for other kinds of file
+    uint64_t size;      // size in bytes, zero if the index has no sizes
+} roke_result_t;
+
+ROKE_API int roke_search_open(roke_search_t** search, const char* config_dir,
+    const char** patterns, size_t npatterns, const roke_locate_options_t* opts);
+
+ROKE_API int roke_search_next(roke_search_t* search, roke_result_t* results,
+    size_t nresults, char* buf, size_t buflen);
+
+ROKE_API void roke_search_cancel(roke_search_t* search);
+
+ROKE_API void roke_search_close(roke_search_t* search);
+
+ROKE_API size_t roke_search_index_name(roke_search_t* search, uint32_t index,
+    char* dst, size_t dstlen);
+
+/**
+ * @brief a series of queries, such as the patterns typed into a search
+ *        box, see roke_session_locate_fd
+ */
+typedef struct roke_session roke_session_t;
+
+ROKE_API int roke_session_open(roke_session_t** session, const char* config_dir);
+
+ROKE_API int roke_session_locate_fd(roke_session_t* session, int fd,
+    const char** patterns, size_t npatterns, const roke_locate_options_t* opts);
+
+ROKE_API void roke_session_cancel(roke_session_t* session);
+
+ROKE_API void roke_session_close(roke_session_t* session);
+
 // todo merge these two api calls into 1, populate a structure?
 
 typedef struct roke_info {
@@ -0,0 +1,159 @@
+#include "roke/libroke_internal.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <time.h>
+#endif
+
+argparse_spec_t spec[] = {
+    {0, 0, 0, "compare query latency of compressed and uncompressed indexes"},
+
+    {0, 0, 0, "Positional Arguments:"},
+    {0, 0, "config_directory", "scratch directory for the indexes"},
+    {0, 0, "source_directory", "directory to index"},
+
+    {0, 0, 0, "Optional Arguments:"},
+    {"pattern", 'p', 0, "the pattern to search for (default .c)"},
+    {"rounds", 'r', 0, "number of times to repeat each query (default 10)"},
+    {0, 0, 0, 0},
+};
+
+// wall clock time, so that cold queries include the time spent reading
+static double
+now_seconds(void)
+{
+#if defined(CLOCK_MONOTONIC)
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+#else
+    return ((double) clock()) / CLOCKS_PER_SEC;
+#endif
+}
+
+// drop the index files from the page cache, if the platform allows it
+static int
+evict(const char* config_dir, const char* name)
+{
+#if defined(POSIX_FADV_DONTNEED)
+    const char* suffixes[] = {".d.bin", ".f.bin"};
+    char path[ROKE_PATH_MAX];
+    int i;
+    for (i=0; i<2; i++) {
+        snprintf(path, sizeof(path), "%s%s%s", config_dir, name, suffixes[i]);
+        int fd = open(path, O_RDONLY);
+        if (fd < 0) {
+            return 1;
+        }
+        posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        close(fd);
+    }
+    return 0;
+#else
+    return 1;
+#endif
+}
+
+static uint64_t
+index_size(const char* config_dir, const char* name)
+{
+    const char* suffixes[] = {".d.bin", ".f.bin"};
+    char path[ROKE_PATH_MAX];
+    struct stat st;
+    uint64_t total = 0;
+    int i;
+    for (i=0; i<2; i++) {
+        snprintf(path, sizeof(path), "%s%s%s", config_dir, name, suffixes[i]);
+        if (stat(path, &st) == 0) {
+            total += st.st_size;
+        }
+    }
+    return total;
+}
+
+static void
+run(const char* label, const char* config_dir, const char* name,
+    const char* pattern, int rounds, int cold)
+{
+    string_matcher_t sm;
+    string_matcher_t* strmatch[] = {&sm, NULL};
+    roke_locate_options_t opts;
+    double total = 0.0;
+    int r;
+
+    FILE* devnull = fopen("/dev/null", "w");
+    if (devnull == NULL) {
+        return;
+    }
+
+    roke_locate_options_init(&opts);
+    string_matcher_init(&sm, (const uint8_t*) pattern, strlen(pattern), 0);
+
+    if (cold && evict(config_dir, name) != 0) {
+        fprintf(stdout, "%-24s unable to evict the page cache\n", label);
+        goto end;
+    }
+
+    for (r=0; r<rounds; r++) {
+        if (cold) {
+            evict(config_dir, name);
+        }
+        double t_start = now_seconds();
+        roke_locate_impl(devnull, (const uint8_t*) config_dir, strmatch, &opts);
+        total += now_seconds() - t_start;
+    }
+
+    fprintf(stdout, "%-24s %8.3f ms\n", label, total * 1000.0 / rounds);
+
+  end:
+    string_matcher_free(&sm);
+    fclose(devnull);
+}
+
+int main(int argc, char** argv)
+{
+    char plain_dir[ROKE_PATH_MAX];
+    char packed_dir[ROKE_PATH_MAX];
+    char root[ROKE_PATH_MAX];
+    const char* pattern = ".c";
+    int32_t rounds = 10;
+    char* blacklist[] = {".", "..", ".git", NULL};
+
+    argparser_t *argparse = newArgParse(argc, (const char**) argv, spec);
+    argparser_default_kwarg(argparse, "pattern", &pattern);
+    argparser_default_kwarg_i(argparse, "rounds", &rounds);
+    if (rounds < 1) {
+        rounds = 1;
+    }
+
+    // each index is placed in its own directory, locate searches every
+    // index in the configuration directory
+    snprintf(plain_dir, sizeof(plain_dir), "%s%cplain%c", argparse->argv[1], SEP, SEP);
+    snprintf(packed_dir, sizeof(packed_dir), "%s%ccompressed%c", argparse->argv[1], SEP, SEP);
+    makedirs((uint8_t*) plain_dir);
+    makedirs((uint8_t*) packed_dir);
+
+    _abspath((uint8_t*) argparse->argv[2], strlen(argparse->argv[2]),
+             (uint8_t*) root, sizeof(root));
+
+    FILE* devnull = fopen("/dev/null", "w");
+    roke_build_index_impl(devnull, plain_dir, "bench", root, blacklist, 0, 1);
+    roke_build_index_impl(devnull, packed_dir, "bench", root, blacklist, ROKE_BUILD_COMPRESS, 1);
+    if (devnull != NULL) {
+        fclose(devnull);
+    }
+
+    fprintf(stdout, "zstd: %s\n", roke_codec_available(ROKE_CODEC_ZSTD) ? "yes" : "no");
+    fprintf(stdout, "%-24s %8.2f MB\n", "size (mmap)",
+        index_size(plain_dir, "bench") / 1048576.0);
+    fprintf(stdout, "%-24s %8.2f MB\n", "size (compressed)",
+        index_size(packed_dir, "bench") / 1048576.0);
+
+    run("cold (mmap)", plain_dir, "bench", pattern, rounds, 1);
+    run("cold (compressed)", packed_dir, "bench", pattern, rounds, 1);
+    run("warm (mmap)", plain_dir, "bench", pattern, rounds, 0);
+    run("warm (compressed)", packed_dir, "bench", pattern, rounds, 0);
+
+    argparser_delete(&argparse);
+    return 0;
+}
@@ -11,15 +11,25 @@
 
 #include "roke/common/compat.h"
 #include "roke/common/boyer_moore.h"
+#include "roke/common/substr.h"
+#include "roke/common/aho_corasick.h"
+#include "roke/common/glob.h"
+#include "roke/common/fuzzy.h"
+#include "roke/common/topk.h"
 #include "roke/common/regex.h"
 #include "roke/common/strutil.h"
 #include "roke/common/pathutil.h"
 #include "roke/common/stack.h"
 #include "roke/common/argparse.h"
 #include "roke/common/cache.h"
+#include "roke/common/bloom.h"
+#include "roke/common/exists.h"
+#include "roke/common/frame.h"
+#include "roke/common/output.h"
 #include "roke/libroke.h"
 
-#define ROKE_MATCH_MASK (ROKE_GLOB|ROKE_REGEX)
+#define ROKE_MATCH_MASK (ROKE_GLOB|ROKE_REGEX|ROKE_FUZZY)
+#define ROKE_MATCH_MULTI (ROKE_MATCH_ANY|ROKE_MATCH_ALL)
 
 /**
  * @brief A wrapper to support multiple kinds of string matching algorithms.
@@ -27,13 +37,68 @@
 typedef struct string_matcher {
     int flags;
     union {
-        bmopt_t bmopt;
+        roke_substr_t substr;
         rregex_t regex;
-        uint8_t* glob_pattern;
+        roke_glob_t glob;
+        roke_fuzzy_t fuzzy;
+        // ROKE_MATCH_ANY or ROKE_MATCH_ALL. literal patterns are matched
+        // in one pass by an automaton, other kinds one at a time
+        struct {
+            roke_ac_t* ac;
+            struct string_matcher* subs;
+            uint64_t* seen;
+        } multi;
+        // ROKE_QUERY
+        struct roke_query* query;
     } data;
     uint8_t* scratch;
+    // the pattern as given to string_matcher_init, used to clone the
+    // matcher. a multi-pattern matcher stores every pattern, each
+    // followed by a null
+    uint8_t* pattern;
+    size_t patlen;
+    uint32_t npatterns;
+    // a literal pattern which folds to ASCII, see _string_matcher_match_icase
+    int ascii_pattern;
 } string_matcher_t;
 
+// the operators and predicates of a query
+#define ROKE_QOP_AND  1
+#define ROKE_QOP_OR   2
+#define ROKE_QOP_NOT  3
+#define ROKE_QOP_NAME 4     // the name matches a pattern
+#define ROKE_QOP_PATH 5     // the full path matches a pattern
+#define ROKE_QOP_META 6     // a metadata filter
+
+/**
+ * @brief a node of a compiled query
+ */
+typedef struct roke_qnode {
+    int op;
+    uint32_t cost;                  // relative cost of evaluating the node
+    string_matcher_t matcher;       // NAME and PATH
+    roke_locate_options_t filter;   // META, holding a single filter
+    struct roke_qnode** children;   // AND, OR and NOT
+    uint32_t nchildren;
+} roke_qnode_t;
+
+/**
+ * @brief a query compiled into a plan
+ *
+ * the children of every node are ordered by cost, so that AND and OR
+ * stop at the cheapest predicate which decides the result.
+ */
+typedef struct roke_query {
+    roke_qnode_t* root;
+    // a name pattern which every result matches, or NULL. used to match
+    // names a block at a time and to test index sketches
+    string_matcher_t* prefilter;
+    // every metadata filter used by the query
+    uint32_t filters;
+    // every ROKE_TYPE_* named by a type filter of the query
+    uint32_t types;
+} roke_query_t;
+
 
 /**
  * @brief an in-memory file record
@@ -56,13 +121,92 @@ typedef struct string_matcher {
 typedef struct roke_entry {
 
     uint32_t index;     // the parent index of this file or directory
-    uint64_t f_size;    // file: size of the file, directory: sum of contained files
+    uint64_t f_size;    // size in bytes, zero if the entry was not stat'd
     uint16_t namelen;   // the length of the file name
     uint32_t offset;    // the offset (from the start of the memory address
                         // where the name can be found.
 
 } roke_entry_t;
 
+/**
+ * @brief file metadata collected while building an index
+ */
+typedef struct roke_meta {
+    uint64_t size;      // size in bytes
+    uint32_t mtime;     // modification time, seconds since the epoch
+    uint32_t mode;      // st_mode from lstat, includes the file type
+} roke_meta_t;
+
+/**
+ * @brief a binary index file begins with a fixed size header
+ *
+ *   0: "ROKE"
+ *   4: the number of entries
+ *   8: the offset of the entries array. zero for indexes which have no
+ *      section table, in which case the entries begin at ROKE_HEADER_SIZE
+ *  12: the number of slots in the section table
+ *  16: the section table, followed by any sections stored in the header
+ */
+#define ROKE_HEADER_SIZE 16
+#define ROKE_SECTION_MAX 8
+
+// section tags, stored as four characters
+#define ROKE_SECTION_TAG(a,b,c,d) \
+    ((uint32_t)(a) | ((uint32_t)(b) << 8) | ((uint32_t)(c) << 16) | ((uint32_t)(d) << 24))
+#define ROKE_SECTION_SKETCH ROKE_SECTION_TAG('S','K','C','H')
+// metadata columns, one value per entry. uint32 mtime, uint64 size, uint32 mode
+#define ROKE_SECTION_MTIME  ROKE_SECTION_TAG('M','T','I','M')
+#define ROKE_SECTION_SIZE   ROKE_SECTION_TAG('S','I','Z','E')
+#define ROKE_SECTION_MODE   ROKE_SECTION_TAG('M','O','D','E')
+// directory index only, one roke_range_t per directory
+#define ROKE_SECTION_RANGE  ROKE_SECTION_TAG('R','N','G','E')
+// names stored in compressed frames, see roke/common/frame.h. the offset
+// of an entry is relative to the start of the frame containing the entry
+#define ROKE_SECTION_NAMES  ROKE_SECTION_TAG('N','A','M','E')
+// names normalized with tonormalized, stored uncompressed. nitems + 1
+// uint32 offsets relative to the end of the offsets, followed by the
+// null terminated names. name i is [offsets[i], offsets[i + 1] - 1)
+#define ROKE_SECTION_NORM   ROKE_SECTION_TAG('N','O','R','M')
+
+// the number of decompressed frames cached for random access to names
+#define ROKE_FRAME_CACHE 16
+
+// the number of names matched by a single call to string_matcher_match_block
+#define ROKE_MATCH_BLOCK 4096
+
+// the number of entries claimed at a time by a thread scanning an index.
+// indexes smaller than two chunks are scanned by the calling thread
+#define ROKE_SCAN_CHUNK (16 * ROKE_MATCH_BLOCK)
+// the maximum number of patterns in a query
+#define ROKE_SCAN_MAX_PATTERNS 8
+
+/**
+ * @brief the entries contained in the subtree of a directory
+ *
+ * directories are numbered in depth first pre-order, and files are
+ * numbered in the order their parent directory was visited. the subtree
+ * of directory d is the directories [d, dir_end) and the files
+ * [file_begin, file_end).
+ */
+typedef struct roke_range {
+    uint32_t dir_end;
+    uint32_t file_begin;
+    uint32_t file_end;
+} roke_range_t;
+
+/**
+ * @brief an entry in the section table of a binary index
+ *
+ * Sections hold optional data about the index. Unused slots have a tag
+ * of zero. the offset is relative to the start of the file.
+ */
+typedef struct roke_section {
+    uint32_t tag;
+    uint32_t flags;
+    uint64_t offset;
+    uint64_t size;
+} roke_section_t;
+
 /**
  * @brief represents a memory mapped file index
  *
@@ -80,34 +224,141 @@ typedef struct roke_index {
     uint32_t nitems;
     roke_entry_t* entries;
     uint8_t* strings;
+    uint32_t nsections;
+    roke_section_t* sections;
+
+    // metadata columns, NULL if the index was built without metadata
+    uint32_t* mtime;
+    uint64_t* size;
+    uint32_t* mode;
+
+    // subtree ranges, directory indexes only. NULL for older indexes
+    roke_range_t* ranges;
+
+    // compressed names, NULL if the names are stored in strings
+    roke_frame_reader_t* names;
+
+    // normalized names, NULL if the index was built without them
+    uint32_t* norm;
+    uint8_t* norm_names;
+    uint64_t norm_size;
 
 } roke_index_t;
 
+/**
+ * @brief get the name of an entry
+ * @param len set to the length of the name
+ *
+ * a compressed name remains valid until a frame which uses the same
+ * cache slot is accessed. the name is empty if the frame is corrupt.
+ */
+static inline const uint8_t*
+roke_index_name(roke_index_t* idx, uint32_t i, uint16_t* len)
+{
+    roke_entry_t* ent = &idx->entries[i];
+    if (idx->names == NULL) {
+        *len = ent->namelen;
+        return idx->strings + ent->offset;
+    }
+
+    uint32_t usize;
+    const uint8_t* frame = roke_frame_reader_get(idx->names,
+        i / idx->names->frame_entries, &usize);
+    if (frame == NULL || (uint64_t) ent->offset + ent->namelen >= usize) {
+        *len = 0;
+        return (const uint8_t*) "";
+    }
+    *len = ent->namelen;
+    return frame + ent->offset;
+}
+
+/**
+ * @brief get the normalized name of an entry
+ * @param len set to the length of the name
+ *
+ * the index must contain normalized names. the name is empty if the
+ * section is corrupt.
+ */
+static inline const uint8_t*
+roke_index_norm_name(const roke_index_t* idx, uint32_t i, size_t* len)
+{
+    uint32_t begin = idx->norm[i];
+    uint32_t end = idx->norm[i + 1];
+    if (end <= begin || end > idx->norm_size) {
+        *len = 0;
+        return (const uint8_t*) "";
+    }
+    *len = end - begin - 1;
+    return idx->norm_names + begin;
+}
+
 ROKE_INTERNAL_API int roke_index_open(roke_index_t* idx, uint8_t* path);
+ROKE_INTERNAL_API int roke_index_open_ex(roke_index_t* idx, uint8_t* path,
+    uint32_t ncache);
 ROKE_INTERNAL_API int roke_index_close(roke_index_t* idx);
+ROKE_INTERNAL_API uint8_t* roke_index_section(roke_index_t* idx,
+    uint32_t tag, uint64_t* size);
+ROKE_INTERNAL_API int roke_index_find_section(const uint8_t* path,
+    uint32_t tag, roke_section_t* section);
+ROKE_INTERNAL_API int roke_index_read_sketch(const uint8_t* path,
+    roke_bloom_t* bloom);
 
 ROKE_INTERNAL_API int roke_get_config_dir(char* s, size_t slen, char* default_path);
 ROKE_INTERNAL_API int roke_set_build_cancel_for_test(int value);
-ROKE_INTERNAL_API int roke_parse_entry(uint8_t* str, uint32_t* index, uint64_t* f_size, uint8_t** name);
-ROKE_INTERNAL_API int roke_binarize_index(uint8_t* index_path, uint32_t nitems);
+ROKE_INTERNAL_API int roke_parse_entry(uint8_t* str, uint32_t* index, roke_meta_t* meta, uint8_t** name);
+ROKE_INTERNAL_API int roke_binarize_index(uint8_t* index_path, uint32_t nitems, int build_flags, const roke_range_t* ranges);
+ROKE_INTERNAL_API void roke_compute_ranges(const uint32_t* parents,
+    const uint32_t* file_begin, uint32_t ndirs, uint32_t nfiles, roke_range_t* ranges);
+ROKE_INTERNAL_API int roke_index_resolve_dir(roke_index_t* didx,
+    const uint8_t* path, uint32_t* dir);
+ROKE_INTERNAL_API int roke_parse_size_filter(const char* str, roke_locate_options_t* opts);
+ROKE_INTERNAL_API int roke_parse_time_filter(const char* str, int64_t now, int64_t* t);
+ROKE_INTERNAL_API int roke_parse_type_filter(const char* str, roke_locate_options_t* opts);
 
 ROKE_INTERNAL_API int string_matcher_init(string_matcher_t* matcher,
     const uint8_t* pattern, size_t patlen, int flags);
 ROKE_INTERNAL_API int string_matcher_match(string_matcher_t* matcher,
     const uint8_t* pattern, size_t patlen);
+ROKE_INTERNAL_API uint32_t string_matcher_match_block(string_matcher_t* matcher,
+    const uint8_t* strings, size_t size, const roke_entry_t* entries,
+    uint32_t n, uint64_t* bitmap);
+ROKE_INTERNAL_API int string_matcher_match_folded(string_matcher_t* matcher,
+    const uint8_t* str, size_t len);
+ROKE_INTERNAL_API uint32_t string_matcher_match_norm_block(string_matcher_t* matcher,
+    const roke_index_t* idx, uint32_t begin, uint32_t n, uint64_t* bitmap);
+ROKE_INTERNAL_API uint32_t roke_scan_set_chunk_for_test(uint32_t chunk);
+ROKE_INTERNAL_API int string_matcher_init_multi(string_matcher_t* matcher,
+    const uint8_t** patterns, const size_t* lens, uint32_t npatterns, int flags);
+ROKE_INTERNAL_API int roke_query_compile(roke_query_t** query,
+    const uint8_t* text, size_t len, int flags);
+ROKE_INTERNAL_API void roke_query_free(roke_query_t* query);
+ROKE_INTERNAL_API int roke_query_match(const roke_query_t* query,
+    roke_index_t* fidx, roke_index_t* didx, uint32_t i,
+    uint8_t* path, size_t pathlen, size_t* len);
+ROKE_INTERNAL_API int string_matcher_clone(string_matcher_t* dst,
+    const string_matcher_t* src);
 ROKE_INTERNAL_API int string_matcher_free(string_matcher_t* matcher);
+ROKE_INTERNAL_API int string_matcher_sketch_test(string_matcher_t* matcher,
+    const roke_bloom_t* bloom);
 
 ROKE_INTERNAL_API int roke_build_index_impl(FILE* output,
     const char* config_dir, const char* name, const char* root,
-    char** blacklist, int verbose);
+    char** blacklist, int build_flags, int verbose);
 
 ROKE_INTERNAL_API int roke_rebuild_index(char* config_dir, char* name,
     char** blacklist);
 
 ROKE_INTERNAL_API int roke_locate_impl(FILE* output,
-    const uint8_t* config_dir, string_matcher_t** bmopts, int limit);
+    const uint8_t* config_dir, string_matcher_t** bmopts,
+    const roke_locate_options_t* opts);
+
+ROKE_INTERNAL_API int roke_locate_output_impl(roke_output_t* output,
+    const uint8_t* config_dir, string_matcher_t** strmatch,
+    const roke_locate_options_t* opts);
 
 ROKE_INTERNAL_API int roke_dirent_info(
     struct dirent *dir, uint8_t* path, int* is_dir, off_t* size);
+ROKE_INTERNAL_API int roke_dirent_stat(
+    uint8_t* path, int* is_dir, roke_meta_t* meta);
 
 #endif
\ No newline at end of file
@@ -3,6 +3,13 @@
 #include "roke/common/unittest.h"
 #include "roke/common/pathutil.h"
 
+#ifndef _WIN32
+#include <utime.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#endif
+
 argparse_spec_t spec[] = {
     {0, 0, 0, "libroke test"},
     {0, 0, "config_directory", "config directory"},
@@ -33,6 +40,1294 @@ int test_build_index(const char* config_directory, const char* source_directory)
     return err;
 }
 
+int
+test_index_sketch(const char* config_directory)
+{
+    int err=0;
+    uint8_t path[ROKE_PATH_MAX];
+    roke_bloom_t bloom;
+    string_matcher_t sm_hit, sm_miss, sm_glob;
+
+    snprintf((char*)path, sizeof(path), "%stest.f.bin", config_directory);
+
+    tassert_zero(roke_index_read_sketch(path, &bloom));
+
+    string_matcher_init(&sm_hit, (uint8_t*)"libroke", 7, 0);
+    string_matcher_init(&sm_miss, (uint8_t*)"qqqzzzqqq", 9, 0);
+    string_matcher_init(&sm_glob, (uint8_t*)"*ROKE*.c", 8, ROKE_GLOB|ROKE_CASE_INSENSITIVE);
+
+    tassert_true(string_matcher_sketch_test(&sm_hit, &bloom));
+    tassert_false(string_matcher_sketch_test(&sm_miss, &bloom));
+    tassert_true(string_matcher_sketch_test(&sm_glob, &bloom));
+
+    string_matcher_free(&sm_hit);
+    string_matcher_free(&sm_miss);
+    string_matcher_free(&sm_glob);
+    roke_bloom_free(&bloom);
+
+  end:
+    return err;
+}
+
+int
+test_build_index_metadata(const char* config_directory, const char* source_directory)
+{
+    int err=0;
+    uint8_t path[ROKE_PATH_MAX];
+    roke_index_t fidx;
+    uint32_t i;
+    int found = 0;
+
+    char* blacklist[] = {".", "..", NULL};
+
+    roke_build_index_ex(config_directory, "test_meta", source_directory,
+        blacklist, ROKE_BUILD_METADATA);
+
+    snprintf((char*)path, sizeof(path), "%stest_meta.f.bin", config_directory);
+    tassert_zero(roke_index_open(&fidx, path));
+    tassert_nonnull(fidx.mtime);
+    tassert_nonnull(fidx.size);
+    tassert_nonnull(fidx.mode);
+
+    for (i=0; i<fidx.nitems; i++) {
+        uint8_t* name = fidx.strings + fidx.entries[i].offset;
+        if (strcmp((char*)name, "libroke_test.c")==0) {
+            tassert_true(fidx.size[i] > 1024);
+            tassert_equal(fidx.size[i], fidx.entries[i].f_size);
+            tassert_true(fidx.mtime[i] > 0);
+            tassert_true(S_ISREG(fidx.mode[i]));
+            found = 1;
+        }
+    }
+    tassert_true(found);
+
+  end:
+    roke_index_close(&fidx);
+    return err;
+}
+
+int
+test_compute_ranges(void)
+{
+    int err=0;
+
+    // 0 -> {1 -> {2, 3}, 4 -> {5}}
+    uint32_t parents[] = {0, 0, 1, 1, 0, 4};
+    uint32_t file_begin[] = {0, 2, 3, 3, 5, 6};
+    roke_range_t ranges[6];
+
+    roke_compute_ranges(parents, file_begin, 6, 8, ranges);
+
+    tassert_equal(ranges[0].dir_end, 6);
+    tassert_equal(ranges[0].file_begin, 0);
+    tassert_equal(ranges[0].file_end, 8);
+    tassert_equal(ranges[1].dir_end, 4);
+    tassert_equal(ranges[1].file_begin, 2);
+    tassert_equal(ranges[1].file_end, 5);
+    tassert_equal(ranges[3].dir_end, 4);
+    tassert_equal(ranges[3].file_end, 5);
+    tassert_equal(ranges[4].dir_end, 6);
+    tassert_equal(ranges[4].file_begin, 5);
+    tassert_equal(ranges[5].file_begin, 6);
+    tassert_equal(ranges[5].file_end, 8);
+
+  end:
+    return err;
+}
+
+int
+test_index_ranges(const char* config_directory, const char* source_directory)
+{
+    int err=0;
+    uint8_t path[ROKE_PATH_MAX];
+    roke_index_t didx, fidx;
+    uint32_t i, d;
+
+    memset(&didx, 0, sizeof(didx));
+    memset(&fidx, 0, sizeof(fidx));
+
+    snprintf((char*)path, sizeof(path), "%stest.d.bin", config_directory);
+    tassert_zero(roke_index_open(&didx, path));
+    snprintf((char*)path, sizeof(path), "%stest.f.bin", config_directory);
+    tassert_zero(roke_index_open(&fidx, path));
+    tassert_nonnull(didx.ranges);
+
+    // every directory and file in a subtree has its parent in the subtree
+    for (d=0; d<didx.nitems; d++) {
+        roke_range_t* r = &didx.ranges[d];
+        for (i=d+1; i<r->dir_end; i++) {
+            uint32_t p = didx.entries[i].index;
+            tassert_true(p >= d && p < i);
+        }
+        for (i=r->file_begin; i<r->file_end; i++) {
+            uint32_t p = fidx.entries[i].index;
+            tassert_true(p >= d && p < r->dir_end);
+        }
+    }
+
+    // resolve a directory inside the source tree
+    snprintf((char*)path, sizeof(path), "%s/roke/common", source_directory);
+    tassert_zero(roke_index_resolve_dir(&didx, path, &d));
+    tassert_str_equal((char*)(didx.strings + didx.entries[d].offset), "common");
+    d = didx.entries[d].index;
+    tassert_str_equal((char*)(didx.strings + didx.entries[d].offset), "roke");
+
+    // the root and its ancestors resolve to the whole index
+    tassert_zero(roke_index_resolve_dir(&didx, (uint8_t*) source_directory, &d));
+    tassert_equal(d, 0);
+    tassert_zero(roke_index_resolve_dir(&didx, (uint8_t*) "/", &d));
+    tassert_equal(d, 0);
+
+    snprintf((char*)path, sizeof(path), "%s/roke/missing", source_directory);
+    tassert_nonzero(roke_index_resolve_dir(&didx, path, &d));
+    snprintf((char*)path, sizeof(path), "%s_other", source_directory);
+    tassert_nonzero(roke_index_resolve_dir(&didx, path, &d));
+
+  end:
+    roke_index_close(&fidx);
+    roke_index_close(&didx);
+    return err;
+}
+
+int
+test_build_index_compressed(const char* config_directory, const char* source_directory)
+{
+    int err=0;
+    uint8_t path[ROKE_PATH_MAX];
+    char root1[ROKE_PATH_MAX];
+    char root2[ROKE_PATH_MAX];
+    roke_index_t fidx1, fidx2, didx;
+    uint32_t i, d;
+
+    char* blacklist[] = {".", "..", NULL};
+
+    memset(&fidx1, 0, sizeof(fidx1));
+    memset(&fidx2, 0, sizeof(fidx2));
+    memset(&didx, 0, sizeof(didx));
+
+    roke_build_index_ex(config_directory, "test_z", source_directory,
+        blacklist, ROKE_BUILD_COMPRESS);
+
+    snprintf((char*)path, sizeof(path), "%stest.f.bin", config_directory);
+    tassert_zero(roke_index_open(&fidx1, path));
+    snprintf((char*)path, sizeof(path), "%stest_z.f.bin", config_directory);
+    tassert_zero(roke_index_open_ex(&fidx2, path, 1));
+    tassert_null(fidx1.names);
+    tassert_nonnull(fidx2.names);
+
+    // the same names are found in the same order
+    tassert_equal(fidx1.nitems, fidx2.nitems);
+    for (i=0; i<fidx1.nitems; i++) {
+        uint16_t len1, len2;
+        const uint8_t* name1 = roke_index_name(&fidx1, i, &len1);
+        const uint8_t* name2 = roke_index_name(&fidx2, i, &len2);
+        tassert_equal(len1, len2);
+        tassert_zero(memcmp(name1, name2, len1));
+        tassert_equal(fidx1.entries[i].index, fidx2.entries[i].index);
+    }
+
+    tassert_nonzero(roke_index_dirinfo((char*) config_directory, "test", root1, sizeof(root1)));
+    tassert_nonzero(roke_index_dirinfo((char*) config_directory, "test_z", root2, sizeof(root2)));
+    tassert_str_equal(root1, root2);
+
+    snprintf((char*)path, sizeof(path), "%stest_z.d.bin", config_directory);
+    tassert_zero(roke_index_open(&didx, path));
+    snprintf((char*)path, sizeof(path), "%s/roke/common", source_directory);
+    tassert_zero(roke_index_resolve_dir(&didx, path, &d));
+    tassert_notequal(d, 0);
+
+  end:
+    roke_index_close(&fidx1);
+    roke_index_close(&fidx2);
+    roke_index_close(&didx);
+    return err;
+}
+
+int
+test_match_block(const char* config_directory)
+{
+    int err=0;
+    uint8_t path[ROKE_PATH_MAX];
+    roke_index_t fidx;
+    string_matcher_t sm[3];
+    uint64_t bitmap[(ROKE_MATCH_BLOCK + 63) / 64];
+    uint32_t i, k;
+
+    memset(&fidx, 0, sizeof(fidx));
+    string_matcher_init(&sm[0], (uint8_t*)"test", 4, 0);
+    string_matcher_init(&sm[1], (uint8_t*)"TEST", 4, ROKE_CASE_INSENSITIVE);
+    string_matcher_init(&sm[2], (uint8_t*)"*_test.c", 8, ROKE_GLOB);
+
+    snprintf((char*)path, sizeof(path), "%stest.f.bin", config_directory);
+    tassert_zero(roke_index_open(&fidx, path));
+
+    uint32_t n = (fidx.nitems < ROKE_MATCH_BLOCK) ? fidx.nitems : ROKE_MATCH_BLOCK;
+
+    // the bitmap agrees with matching one name at a time
+    for (k=0; k<3; k++) {
+        uint32_t nmatch = string_matcher_match_block(&sm[k], fidx.strings,
+            fidx.fsize, fidx.entries, n, bitmap);
+        uint32_t expected = 0;
+        for (i=0; i<n; i++) {
+            uint16_t len;
+            const uint8_t* name = roke_index_name(&fidx, i, &len);
+            int m = string_matcher_match(&sm[k], name, len)==0;
+            tassert_equal((bitmap[i >> 6] >> (i & 63)) & 1, m);
+            expected += m;
+        }
+        tassert_equal(nmatch, expected);
+        tassert_true(nmatch > 0);
+    }
+
+  end:
+    roke_index_close(&fidx);
+    for (k=0; k<3; k++) {
+        string_matcher_free(&sm[k]);
+    }
+    return err;
+}
+
+int
+test_match_multi(void)
+{
+    int err=0;
+    string_matcher_t sm, clone;
+    const uint8_t* literals[] = {(uint8_t*)"foo", (uint8_t*)"bar", (uint8_t*)"BAZ"};
+    const uint8_t* globs[] = {(uint8_t*)"*.c", (uint8_t*)"test*"};
+    size_t literal_lens[] = {3, 3, 3};
+    size_t glob_lens[] = {3, 5};
+
+#define multi_match(m, s) (string_matcher_match(m, (uint8_t*) s, strlen(s))==0)
+
+    memset(&sm, 0, sizeof(sm));
+    memset(&clone, 0, sizeof(clone));
+
+    tassert_zero(string_matcher_init_multi(&sm, literals, literal_lens, 3, ROKE_MATCH_ANY));
+    tassert_true(multi_match(&sm, "xfoo"));
+    tassert_true(multi_match(&sm, "xBAZ"));
+    tassert_false(multi_match(&sm, "xbaz"));
+    tassert_false(multi_match(&sm, "fo ba"));
+
+    // clones match the same names
+    tassert_zero(string_matcher_clone(&clone, &sm));
+    tassert_true(multi_match(&clone, "barn"));
+    tassert_false(multi_match(&clone, "ba"));
+    string_matcher_free(&clone);
+    string_matcher_free(&sm);
+
+    tassert_zero(string_matcher_init_multi(&sm, literals, literal_lens, 3,
+        ROKE_MATCH_ALL|ROKE_CASE_INSENSITIVE));
+    tassert_true(multi_match(&sm, "Foo.Bar.baz"));
+    tassert_false(multi_match(&sm, "foo.bar"));
+    string_matcher_free(&sm);
+
+    // globs are matched one at a time
+    tassert_zero(string_matcher_init_multi(&sm, globs, glob_lens, 2, ROKE_MATCH_ALL|ROKE_GLOB));
+    tassert_true(multi_match(&sm, "test_main.c"));
+    tassert_false(multi_match(&sm, "main.c"));
+    string_matcher_free(&sm);
+
+    tassert_zero(string_matcher_init_multi(&sm, globs, glob_lens, 2, ROKE_MATCH_ANY|ROKE_GLOB));
+    tassert_true(multi_match(&sm, "main.c"));
+    tassert_true(multi_match(&sm, "test.h"));
+    tassert_false(multi_match(&sm, "main.h"));
+
+#undef multi_match
+
+  end:
+    string_matcher_free(&sm);
+    return err;
+}
+
+int
+test_match_icase(void)
+{
+    int err=0;
+    string_matcher_t sm;
+
+#define icase_match(m, s) (string_matcher_match(m, (uint8_t*) s, strlen(s))==0)
+
+    memset(&sm, 0, sizeof(sm));
+
+    tassert_zero(string_matcher_init(&sm, (uint8_t*) "Main", 4, ROKE_CASE_INSENSITIVE));
+    tassert_true(sm.ascii_pattern);
+    tassert_true(icase_match(&sm, "libMAIN.c"));
+    tassert_true(icase_match(&sm, "\xc3\x84main"));
+    tassert_false(icase_match(&sm, "ma_in"));
+    tassert_false(icase_match(&sm, "m\xc3\xa4in"));
+    string_matcher_free(&sm);
+
+    // the kelvin sign folds to an ASCII k, which only Unicode folding finds
+    tassert_zero(string_matcher_init(&sm, (uint8_t*) "k", 1, ROKE_CASE_INSENSITIVE));
+    tassert_true(icase_match(&sm, "\xe2\x84\xaa"));
+    string_matcher_free(&sm);
+
+    tassert_zero(string_matcher_init(&sm, (uint8_t*) "\xc3\x84", 2, ROKE_CASE_INSENSITIVE));
+    tassert_false(sm.ascii_pattern);
+    tassert_true(icase_match(&sm, "x\xc3\xa4.txt"));
+    tassert_true(icase_match(&sm, "X\xc3\x84.TXT"));
+    tassert_false(icase_match(&sm, "xa.txt"));
+
+#undef icase_match
+
+  end:
+    string_matcher_free(&sm);
+    return err;
+}
+
+int
+test_match_glob(void)
+{
+    int err=0;
+    string_matcher_t sm;
+
+#define glob_match(m, s) (string_matcher_match(m, (uint8_t*) s, strlen(s))==0)
+
+    memset(&sm, 0, sizeof(sm));
+
+    tassert_zero(string_matcher_init(&sm, (uint8_t*) "*.C", 3, ROKE_GLOB|ROKE_CASE_INSENSITIVE));
+    tassert_true(glob_match(&sm, "Main.c"));
+    tassert_true(glob_match(&sm, "MAIN.C"));
+    // names which are not valid UTF-8 are folded up to the end
+    tassert_true(glob_match(&sm, "ab\xff.C"));
+    tassert_false(glob_match(&sm, "main.h"));
+    string_matcher_free(&sm);
+
+    tassert_zero(string_matcher_init(&sm, (uint8_t*) "caf?", 4, ROKE_GLOB|ROKE_CASE_INSENSITIVE));
+    tassert_true(glob_match(&sm, "CAF\xc3\x89"));
+    string_matcher_free(&sm);
+
+    tassert_zero(string_matcher_init(&sm, (uint8_t*) "test*", 5, ROKE_GLOB));
+    tassert_true(glob_match(&sm, "test"));
+    tassert_true(glob_match(&sm, "test_main.c"));
+    tassert_false(glob_match(&sm, "Test.c"));
+
+#undef glob_match
+
+  end:
+    string_matcher_free(&sm);
+    return err;
+}
+
+// run a query and read back everything it wrote
+static char*
+locate_to_string(const char* config_directory, string_matcher_t** strmatch,
+    const roke_locate_options_t* opts, long* size)
+{
+    FILE* fp = tmpfile();
+    char* text = NULL;
+    if (fp == NULL) {
+        return NULL;
+    }
+    roke_locate_impl(fp, (const uint8_t*) config_directory, strmatch, opts);
+    *size = ftell(fp);
+    text = malloc(*size + 1);
+    if (text != NULL) {
+        rewind(fp);
+        *size = (long) fread(text, 1, *size, fp);
+        text[*size] = '\0';
+    }
+    fclose(fp);
+    return text;
+}
+
+int
+test_locate_threads(const char* config_directory)
+{
+    int err=0;
+    string_matcher_t sm[2];
+    string_matcher_t* strmatch[] = {&sm[0], &sm[1], NULL};
+    roke_locate_options_t opts;
+    char* expected = NULL;
+    char* actual = NULL;
+    long nexpected = 0, nactual = 0;
+    int limits[] = {0, 5, 40};
+    int k;
+
+    string_matcher_init(&sm[0], (uint8_t*)"*.c", 3, ROKE_GLOB);
+    string_matcher_init(&sm[1], (uint8_t*)"*roke*", 6, ROKE_GLOB);
+
+    // small chunks so that the test index is split between the threads
+    uint32_t chunk = roke_scan_set_chunk_for_test(7);
+
+    // the merged results are in the same order as a single threaded scan,
+    // including when the limit is reached part way through an index
+    for (k=0; k<3; k++) {
+        roke_locate_options_init(&opts);
+        opts.limit = limits[k];
+        opts.threads = 1;
+        expected = locate_to_string(config_directory, strmatch, &opts, &nexpected);
+        opts.threads = 4;
+        actual = locate_to_string(config_directory, strmatch, &opts, &nactual);
+        tassert_nonnull(expected);
+        tassert_nonnull(actual);
+        tassert_true(nexpected > 0);
+        tassert_equal(nactual, nexpected);
+        tassert_str_equal(actual, expected);
+        free(expected);
+        free(actual);
+        expected = actual = NULL;
+    }
+
+  end:
+    roke_scan_set_chunk_for_test(chunk);
+    free(expected);
+    free(actual);
+    string_matcher_free(&sm[0]);
+    string_matcher_free(&sm[1]);
+    return err;
+}
+
+int
+test_locate_path_patterns(const char* config_directory)
+{
+    int err=0;
+    string_matcher_t sm[2];
+    string_matcher_t* strmatch[] = {&sm[0], &sm[1], NULL};
+    roke_locate_options_t opts;
+    char* all = NULL;
+    char* actual = NULL;
+    char* expected = NULL;
+    long nall = 0, nactual = 0;
+    uint32_t k;
+    struct {
+        const char* pattern;
+        int flags;
+    } cases[] = {
+        {"common/", 0},
+        {"COMMON/S", ROKE_CASE_INSENSITIVE},
+        {"on/str", 0},
+        {"roke", 0},
+        {"zzz", 0},
+        {"rkcmn", ROKE_FUZZY},
+    };
+
+    memset(sm, 0, sizeof(sm));
+    roke_locate_options_init(&opts);
+    tassert_zero(string_matcher_init(&sm[0], (uint8_t*)"t", 1, 0));
+
+    strmatch[1] = NULL;
+    all = locate_to_string(config_directory, strmatch, &opts, &nall);
+    tassert_nonnull(all);
+    strmatch[1] = &sm[1];
+
+    // the path of each parent is matched once, with the same results as
+    // matching every path
+    for (k=0; k<sizeof(cases)/sizeof(cases[0]); k++) {
+        const char* pattern = cases[k].pattern;
+        roke_fuzzy_t fz;
+        size_t n = 0;
+        tassert_zero(string_matcher_init(&sm[1], (const uint8_t*) pattern,
+            strlen(pattern), cases[k].flags));
+        tassert_zero(roke_fuzzy_init(&fz, (const uint8_t*) pattern, strlen(pattern)));
+
+        expected = calloc((size_t) nall + 1, 1);
+        tassert_nonnull(expected);
+        char* line = all;
+        while (*line != '\0') {
+            char lower[4096];
+            char* nl = strchr(line, '\n');
+            size_t len = (size_t) (nl - line);
+            // the separator after a directory is not part of its path
+            size_t pathlen = (line[len - 1] == '/') ? len - 1 : len;
+            size_t i;
+            for (i=0; i<pathlen; i++) {
+                lower[i] = (cases[k].flags&ROKE_CASE_INSENSITIVE) ?
+                    (char) tolower((unsigned char) line[i]) : line[i];
+            }
+            lower[pathlen] = '\0';
+            int m = (cases[k].flags&ROKE_FUZZY) ?
+                roke_fuzzy_match(&fz, (uint8_t*) lower, pathlen)==0 :
+                strstr(lower, (cases[k].flags&ROKE_CASE_INSENSITIVE) ?
+                    "common/s" : pattern) != NULL;
+            if (m) {
+                memcpy(expected + n, line, len + 1);
+                n += len + 1;
+            }
+            line = nl + 1;
+        }
+
+        actual = locate_to_string(config_directory, strmatch, &opts, &nactual);
+        tassert_nonnull(actual);
+        tassert_str_equal(actual, expected);
+        tassert_true(n > 0 || k == 4);
+        free(actual);
+        free(expected);
+        actual = expected = NULL;
+        string_matcher_free(&sm[1]);
+    }
+
+  end:
+    free(all);
+    free(actual);
+    free(expected);
+    string_matcher_free(&sm[0]);
+    string_matcher_free(&sm[1]);
+    return err;
+}
+
+int
+test_locate_fuzzy(const char* config_directory)
+{
+    int err=0;
+    string_matcher_t sm;
+    string_matcher_t* strmatch[] = {&sm, NULL};
+    roke_locate_options_t opts;
+    roke_fuzzy_t fz;
+    char* all = NULL;
+    char* expected = NULL;
+    char* actual = NULL;
+    long nall = 0, nexpected = 0, nactual = 0;
+    int limits[] = {0, 1, 3};
+    int k;
+
+    uint32_t chunk = roke_scan_set_chunk_for_test(7);
+    tassert_zero(string_matcher_init(&sm, (uint8_t*)"rklbc", 5, ROKE_FUZZY));
+    tassert_zero(roke_fuzzy_init(&fz, (uint8_t*)"rklbc", 5));
+
+    roke_locate_options_init(&opts);
+    opts.threads = 1;
+    all = locate_to_string(config_directory, strmatch, &opts, &nall);
+    tassert_nonnull(all);
+    tassert_nonnull(strstr(all, "roke/libroke.c\n"));
+
+    // every result is a match of the whole path
+    char* line = all;
+    while (*line != '\0') {
+        char* nl = strchr(line, '\n');
+        tassert_nonnull(nl);
+        tassert_zero(roke_fuzzy_match(&fz, (uint8_t*) line, (size_t) (nl - line)));
+        line = nl + 1;
+    }
+
+    // the best k results are the first k of every result, however the
+    // work is divided between threads
+    for (k=0; k<3; k++) {
+        opts.limit = limits[k];
+        opts.threads = 1;
+        expected = locate_to_string(config_directory, strmatch, &opts, &nexpected);
+        opts.threads = 4;
+        actual = locate_to_string(config_directory, strmatch, &opts, &nactual);
+        tassert_nonnull(expected);
+        tassert_nonnull(actual);
+        tassert_true(nexpected > 0);
+        tassert_equal(nactual, nexpected);
+        tassert_str_equal(actual, expected);
+        tassert_zero(strncmp(all, expected, (size_t) nexpected));
+        free(expected);
+        free(actual);
+        expected = actual = NULL;
+    }
+
+  end:
+    roke_scan_set_chunk_for_test(chunk);
+    free(all);
+    free(expected);
+    free(actual);
+    string_matcher_free(&sm);
+    return err;
+}
+
+static void
+touch(const char* dir, const char* name)
+{
+    char path[ROKE_PATH_MAX];
+    snprintf(path, sizeof(path), "%s%s", dir, name);
+    FILE* fp = fopen(path, "w");
+    if (fp != NULL) {
+        fclose(fp);
+    }
+}
+
+int
+test_locate_normalized(const char* config_directory)
+{
+    int err=0;
+    char source[1024];
+    char config1[1024];
+    char config2[1024];
+    uint8_t path[ROKE_PATH_MAX];
+    uint8_t folded[ROKE_PATH_MAX];
+    roke_index_t fidx1, fidx2;
+    string_matcher_t sm;
+    string_matcher_t* strmatch[] = {&sm, NULL};
+    roke_locate_options_t opts;
+    char* expected = NULL;
+    char* actual = NULL;
+    long nexpected = 0, nactual = 0;
+    uint32_t i, k;
+
+    char* blacklist[] = {".", "..", NULL};
+    // a decomposed e acute, a ligature and a sharp s
+    const char* names[] = {"cafe\xcc\x81.txt", "\xef\xac\x81le.TXT",
+        "Stra\xc3\x9f" "e.md", "plain.txt"};
+    struct {
+        const char* pattern;
+        int flags;
+        const char* found;
+    } cases[] = {
+        {"CAF\xc3\x89", 0, names[0]},
+        {"caf?.txt", ROKE_GLOB, names[0]},
+        {"file", 0, names[1]},
+        {"strasse.MD", 0, names[2]},
+        {"^caf\xc3\xa9\\.", ROKE_REGEX, names[0]},
+    };
+
+    memset(&fidx1, 0, sizeof(fidx1));
+    memset(&fidx2, 0, sizeof(fidx2));
+    memset(&sm, 0, sizeof(sm));
+
+    snprintf(source, sizeof(source), "%snorm_src/", config_directory);
+    snprintf(config1, sizeof(config1), "%snorm1/", config_directory);
+    snprintf(config2, sizeof(config2), "%snorm2/", config_directory);
+    makedirs((uint8_t*) source);
+    makedirs((uint8_t*) config1);
+    makedirs((uint8_t*) config2);
+    for (k=0; k<4; k++) {
+        touch(source, names[k]);
+    }
+
+    roke_build_index_ex(config1, "n", source, blacklist,
+        ROKE_BUILD_NORMALIZE|ROKE_BUILD_COMPRESS);
+    roke_build_index_ex(config2, "n", source, blacklist, 0);
+
+    snprintf((char*)path, sizeof(path), "%sn.f.bin", config1);
+    tassert_zero(roke_index_open(&fidx1, path));
+    snprintf((char*)path, sizeof(path), "%sn.f.bin", config2);
+    tassert_zero(roke_index_open(&fidx2, path));
+    tassert_nonnull(fidx1.norm);
+    tassert_null(fidx2.norm);
+    tassert_equal(fidx1.nitems, 4);
+
+    // every stored name is the normalized form of the name
+    for (i=0; i<fidx1.nitems; i++) {
+        uint16_t len;
+        size_t normlen;
+        const uint8_t* name = roke_index_name(&fidx1, i, &len);
+        size_t n = tonormalized(folded, sizeof(folded), name, len);
+        const uint8_t* norm = roke_index_norm_name(&fidx1, i, &normlen);
+        tassert_equal(normlen, n);
+        tassert_zero(memcmp(norm, folded, n));
+    }
+
+    // the normalized names give the same results as normalizing every
+    // name while searching
+    roke_locate_options_init(&opts);
+    for (k=0; k<sizeof(cases)/sizeof(cases[0]); k++) {
+        const char* pattern = cases[k].pattern;
+        tassert_zero(string_matcher_init(&sm, (const uint8_t*) pattern,
+            strlen(pattern), cases[k].flags|ROKE_NORMALIZE));
+        expected = locate_to_string(config2, strmatch, &opts, &nexpected);
+        actual = locate_to_string(config1, strmatch, &opts, &nactual);
+        tassert_nonnull(expected);
+        tassert_nonnull(actual);
+        tassert_str_equal(actual, expected);
+        // only the expected name is found
+        tassert_nonnull(strstr(actual, cases[k].found));
+        tassert_equal(strchr(actual, '\n') - actual + 1, nactual);
+        free(expected);
+        free(actual);
+        expected = actual = NULL;
+        string_matcher_free(&sm);
+    }
+
+    // without normalization the composed pattern does not match
+    tassert_zero(string_matcher_init(&sm, (const uint8_t*) "caf\xc3\xa9", 5, 0));
+    actual = locate_to_string(config1, strmatch, &opts, &nactual);
+    tassert_nonnull(actual);
+    tassert_equal(nactual, 0);
+
+  end:
+    free(expected);
+    free(actual);
+    string_matcher_free(&sm);
+    roke_index_close(&fidx1);
+    roke_index_close(&fidx2);
+    return err;
+}
+
+int
+test_binarize_short(const char* config_directory)
+{
+    int err=0;
+    uint8_t path[ROKE_PATH_MAX];
+    char tmp[ROKE_PATH_MAX];
+    FILE* fp;
+
+    // the second name holds a newline, the rest of it is not an entry
+    snprintf((char*)path, sizeof(path), "%sshort.f.idx", config_directory);
+    snprintf(tmp, sizeof(tmp), "%sshort.f.bin.tmp", config_directory);
+    fp = fopen((char*) path, "w");
+    tassert_nonnull(fp);
+    fputs("0 0 0 0 first\n0 0 0 0 sec\nond\n", fp);
+    fclose(fp);
+
+    tassert_zero(roke_binarize_index(path, 2, 0, NULL));
+    remove(tmp);
+
+    // an index file with fewer entries than expected fails the build
+    tassert_nonzero(roke_binarize_index(path, 3, 0, NULL));
+    tassert_false(access(tmp, F_OK)==0);
+
+  end:
+    return err;
+}
+
+int
+test_sketch_folded(const char* config_directory)
+{
+    int err=0;
+    char source[1024];
+    char config[1024];
+    uint8_t path[ROKE_PATH_MAX];
+    roke_bloom_t bloom;
+    string_matcher_t sm;
+    string_matcher_t* strmatch[] = {&sm, NULL};
+    roke_locate_options_t opts;
+    char* actual = NULL;
+    long nactual = 0;
+
+    char* blacklist[] = {".", "..", NULL};
+    // KELVIN SIGN and a capital I with a dot fold to ASCII
+    const char* name = "\xe2\x84\xaa" "elv\xc4\xb0n.txt";
+
+    memset(&sm, 0, sizeof(sm));
+    memset(&bloom, 0, sizeof(bloom));
+    snprintf(source, sizeof(source), "%sfolded_src/", config_directory);
+    snprintf(config, sizeof(config), "%sfolded/", config_directory);
+    makedirs((uint8_t*) source);
+    makedirs((uint8_t*) config);
+    touch(source, name);
+    roke_build_index(config, "k", source, blacklist);
+
+    // the sketch holds the trigrams of the folded name
+    snprintf((char*)path, sizeof(path), "%sk.f.bin", config);
+    tassert_zero(roke_index_read_sketch(path, &bloom));
+    tassert_zero(string_matcher_init(&sm, (const uint8_t*) "kelvin", 6,
+        ROKE_CASE_INSENSITIVE));
+    tassert_true(string_matcher_sketch_test(&sm, &bloom));
+
+    roke_locate_options_init(&opts);
+    actual = locate_to_string(config, strmatch, &opts, &nactual);
+    tassert_nonnull(actual);
+    tassert_nonnull(strstr(actual, name));
+
+  end:
+    free(actual);
+    string_matcher_free(&sm);
+    roke_bloom_free(&bloom);
+    return err;
+}
+
+int
+test_locate_rank(const char* config_directory)
+{
+    int err=0;
+    char source[1024];
+    char config[1024];
+    char path[2048];
+    string_matcher_t sm;
+    string_matcher_t* strmatch[] = {&sm, NULL};
+    roke_locate_options_t opts;
+    char* expected = NULL;
+    char* actual = NULL;
+    long nexpected = 0, nactual = 0;
+    uint32_t k;
+
+    char* blacklist[] = {".", "..", NULL};
+    const char* dirs[] = {"a/b/c/d/", "x/"};
+    // in the order they rank for "target"
+    const char* names[] = {"a/target", "x/target", "a/b/c/target",
+        "a/b/c/d/target", "target.log", "a/b/target.txt"};
+
+    memset(&sm, 0, sizeof(sm));
+    snprintf(source, sizeof(source), "%srank_src/", config_directory);
+    snprintf(config, sizeof(config), "%srank/", config_directory);
+    makedirs((uint8_t*) config);
+    for (k=0; k<2; k++) {
+        snprintf(path, sizeof(path), "%s%s", source, dirs[k]);
+        makedirs((uint8_t*) path);
+    }
+    for (k=0; k<6; k++) {
+        touch(source, names[k]);
+    }
+#ifndef _WIN32
+    // the more recent of two exact matches at the same depth is first
+    struct utimbuf times = {1000000000, 1000000000};
+    snprintf(path, sizeof(path), "%s%s", source, names[1]);
+    utime(path, &times);
+    times.actime = times.modtime = 1100000000;
+    snprintf(path, sizeof(path), "%s%s", source, names[0]);
+    utime(path, &times);
+#endif
+
+    roke_build_index_ex(config, "r", source, blacklist, ROKE_BUILD_METADATA);
+    tassert_zero(string_matcher_init(&sm, (const uint8_t*) "TARGET", 6,
+        ROKE_CASE_INSENSITIVE|ROKE_RANK));
+
+    roke_locate_options_init(&opts);
+    opts.match_flags = ROKE_CASE_INSENSITIVE|ROKE_RANK;
+    opts.threads = 1;
+    expected = locate_to_string(config, strmatch, &opts, &nexpected);
+    tassert_nonnull(expected);
+    char* line = expected;
+    for (k=0; k<6; k++) {
+        char* nl = strchr(line, '\n');
+        tassert_nonnull(nl);
+        *nl = '\0';
+        tassert_true(has_suffix((uint8_t*) line, strlen(line),
+            (uint8_t*) names[k], strlen(names[k])));
+        *nl = '\n';
+        line = nl + 1;
+    }
+    tassert_str_equal(line, "");
+    free(expected);
+    expected = NULL;
+
+    // the best results are the same with a limit and with more threads
+    uint32_t chunk = roke_scan_set_chunk_for_test(2);
+    opts.limit = 3;
+    expected = locate_to_string(config, strmatch, &opts, &nexpected);
+    opts.threads = 4;
+    actual = locate_to_string(config, strmatch, &opts, &nactual);
+    roke_scan_set_chunk_for_test(chunk);
+    tassert_nonnull(expected);
+    tassert_nonnull(actual);
+    tassert_str_equal(actual, expected);
+    tassert_nonnull(strstr(expected, names[2]));
+    tassert_null(strstr(expected, names[3]));
+
+  end:
+    free(expected);
+    free(actual);
+    string_matcher_free(&sm);
+    return err;
+}
+
+int
+test_search(const char* config_directory)
+{
+    int err=0;
+    string_matcher_t sm;
+    string_matcher_t* strmatch[] = {&sm, NULL};
+    const char* patterns[] = {"libroke"};
+    roke_locate_options_t opts;
+    roke_search_t* search = NULL;
+    roke_result_t results[3];
+    char buf[ROKE_PATH_MAX * 2];
+    char name[64];
+    char* expected = NULL;
+    long nexpected = 0;
+    size_t pos = 0;
+    int n, i, found = 0;
+
+    tassert_zero(string_matcher_init(&sm, (const uint8_t*) patterns[0], 7, 0));
+    roke_locate_options_init(&opts);
+    opts.threads = 1;
+    expected = locate_to_string(config_directory, strmatch, &opts, &nexpected);
+    tassert_nonnull(expected);
+    tassert_true(nexpected > 0);
+
+    // the results pulled a few at a time are the results written by locate
+    tassert_zero(roke_search_open(&search, config_directory, patterns, 1, &opts));
+    while ((n = roke_search_next(search, results, 3, buf, sizeof(buf))) > 0) {
+        for (i=0; i<n; i++) {
+            roke_result_t* r = &results[i];
+            tassert_equal(r->pathlen, strlen(r->path));
+            tassert_zero(strncmp(expected + pos, r->path, r->pathlen));
+            pos += r->pathlen;
+            if (r->type == ROKE_TYPE_DIR) {
+                tassert_equal(expected[pos++], '/');
+            }
+            tassert_equal(expected[pos++], '\n');
+
+            tassert_true(roke_search_index_name(search, r->index, name, sizeof(name)) > 0);
+            if (strcmp(name, "test_meta")==0 &&
+                has_suffix((const uint8_t*) r->path, r->pathlen, (const uint8_t*) "/libroke_test.c", 15)) {
+                tassert_equal(r->type, ROKE_TYPE_FILE);
+                tassert_true(r->size > 1024);
+                found = 1;
+            }
+        }
+    }
+    tassert_zero(n);
+    tassert_equal(pos, (size_t) nexpected);
+    tassert_true(found);
+    roke_search_close(search);
+    search = NULL;
+
+    // ranked results are pulled best first
+    string_matcher_free(&sm);
+    free(expected);
+    tassert_zero(string_matcher_init(&sm, (const uint8_t*) "rklbc", 5, ROKE_FUZZY));
+    opts.match_flags = ROKE_FUZZY;
+    opts.limit = 5;
+    expected = locate_to_string(config_directory, strmatch, &opts, &nexpected);
+    tassert_nonnull(expected);
+    patterns[0] = "rklbc";
+    tassert_zero(roke_search_open(&search, config_directory, patterns, 1, &opts));
+    for (pos=0; (n = roke_search_next(search, results, 2, buf, sizeof(buf))) > 0; ) {
+        for (i=0; i<n; i++) {
+            tassert_zero(strncmp(expected + pos, results[i].path, results[i].pathlen));
+            pos += results[i].pathlen + (results[i].type == ROKE_TYPE_DIR) + 1;
+        }
+    }
+    tassert_equal(pos, (size_t) nexpected);
+    roke_search_close(search);
+    search = NULL;
+    opts.match_flags = 0;
+    patterns[0] = "libroke";
+
+    // a limit and a cancel stop the search early
+    opts.limit = 4;
+    tassert_zero(roke_search_open(&search, config_directory, patterns, 1, &opts));
+    tassert_equal(roke_search_next(search, results, 3, buf, sizeof(buf)), 3);
+    tassert_equal(roke_search_next(search, results, 3, buf, sizeof(buf)), 1);
+    tassert_zero(roke_search_next(search, results, 3, buf, sizeof(buf)));
+    roke_search_close(search);
+    search = NULL;
+
+    opts.limit = 0;
+    tassert_zero(roke_search_open(&search, config_directory, patterns, 1, &opts));
+    tassert_equal(roke_search_next(search, results, 1, buf, sizeof(buf)), 1);
+    roke_search_cancel(search);
+    tassert_zero(roke_search_next(search, results, 3, buf, sizeof(buf)));
+
+    // a buffer too small for any path is an error
+    roke_search_close(search);
+    tassert_zero(roke_search_open(&search, config_directory, patterns, 1, &opts));
+    tassert_equal(roke_search_next(search, results, 3, buf, 4), -1);
+
+  end:
+    roke_search_close(search);
+    free(expected);
+    string_matcher_free(&sm);
+    return err;
+}
+
+static long
+count_lines(const char* text)
+{
+    long n = 0;
+    for (; *text; text++) {
+        n += (*text == '\n');
+    }
+    return n;
+}
+
+// convert results written with ROKE_FORMAT_NUL or ROKE_FORMAT_RECORDS
+// back to lines, in place. returns non-zero if a record is truncated
+static int
+results_to_lines(char* text, long* size, int format)
+{
+    long i, n = 0;
+    if (format == ROKE_FORMAT_NUL) {
+        for (i=0; i<*size; i++) {
+            text[i] = (text[i] == '\0') ? '\n' : text[i];
+        }
+        return 0;
+    }
+    for (i=0; i<*size; ) {
+        uint32_t len;
+        if (*size - i < (long) sizeof(len)) {
+            return 1;
+        }
+        memcpy(&len, text + i, sizeof(len));
+        i += sizeof(len);
+        if (*size - i < (long) len) {
+            return 1;
+        }
+        memmove(text + n, text + i, len);
+        n += len;
+        text[n++] = '\n';
+        i += len;
+    }
+    *size = n;
+    text[n] = '\0';
+    return 0;
+}
+
+int
+test_format(const char* config_directory)
+{
+    int err=0;
+    string_matcher_t sm;
+    string_matcher_t* strmatch[] = {&sm, NULL};
+    roke_locate_options_t opts;
+    char* expected = NULL;
+    char* actual = NULL;
+    long nexpected = 0, nactual = 0;
+    size_t k, l;
+    int f;
+    struct {
+        const char* pattern;
+        int flags;
+    } cases[] = {
+        {"libroke", 0},
+        {"*.h", ROKE_GLOB},
+        {"rklbc", ROKE_FUZZY},
+        {"test", ROKE_RANK},
+    };
+    int formats[] = {ROKE_FORMAT_NUL, ROKE_FORMAT_RECORDS};
+    int limits[] = {0, 5, 40};
+
+    memset(&sm, 0, sizeof(sm));
+    // the limit is reached part way through the chunks of the threads
+    uint32_t chunk = roke_scan_set_chunk_for_test(7);
+    for (k=0; k<sizeof(cases)/sizeof(cases[0]); k++) {
+        tassert_zero(string_matcher_init(&sm, (const uint8_t*) cases[k].pattern,
+            strlen(cases[k].pattern), cases[k].flags));
+        for (l=0; l<sizeof(limits)/sizeof(limits[0]); l++) {
+            roke_locate_options_init(&opts);
+            opts.match_flags = cases[k].flags;
+            opts.limit = limits[l];
+            opts.threads = 4;
+            expected = locate_to_string(config_directory, strmatch, &opts, &nexpected);
+            tassert_nonnull(expected);
+            tassert_true(nexpected > 0);
+
+            // the same results, only separated differently
+            for (f=0; f<2; f++) {
+                opts.format = formats[f];
+                actual = locate_to_string(config_directory, strmatch, &opts, &nactual);
+                tassert_nonnull(actual);
+                tassert_zero(results_to_lines(actual, &nactual, formats[f]));
+                tassert_equal(nactual, nexpected);
+                tassert_zero(memcmp(actual, expected, (size_t) nexpected));
+                free(actual);
+                actual = NULL;
+            }
+            free(expected);
+            expected = NULL;
+        }
+        string_matcher_free(&sm);
+    }
+
+  end:
+    roke_scan_set_chunk_for_test(chunk);
+    free(expected);
+    free(actual);
+    return err;
+}
+
+int
+test_count(const char* config_directory)
+{
+    int err=0;
+    string_matcher_t sm;
+    string_matcher_t* strmatch[] = {&sm, NULL};
+    roke_locate_options_t opts;
+    roke_index_count_t counts[8];
+    char* expected = NULL;
+    long nexpected = 0;
+    size_t k, i, ncounts;
+    struct {
+        const char* pattern;
+        int flags;
+    } cases[] = {
+        {"libroke", 0},
+        {"ROKE", ROKE_CASE_INSENSITIVE},
+        {"*.h", ROKE_GLOB},
+        {"rklbc", ROKE_FUZZY},
+        {"test", ROKE_RANK},
+    };
+
+    memset(&sm, 0, sizeof(sm));
+    for (k=0; k<sizeof(cases)/sizeof(cases[0]); k++) {
+        const char* patterns[] = {cases[k].pattern};
+        roke_locate_options_init(&opts);
+        opts.match_flags = cases[k].flags;
+        tassert_zero(string_matcher_init(&sm, (const uint8_t*) cases[k].pattern,
+            strlen(cases[k].pattern), opts.match_flags));
+        expected = locate_to_string(config_directory, strmatch, &opts, &nexpected);
+        tassert_nonnull(expected);
+        nexpected = count_lines(expected);
+        tassert_true(nexpected > 0);
+
+        // the counts of the indexes add up to the total
+        ncounts = sizeof(counts) / sizeof(counts[0]);
+        tassert_equal(roke_count(config_directory, patterns, 1, &opts, counts, &ncounts), nexpected);
+        tassert_true(ncounts > 0 && ncounts <= sizeof(counts) / sizeof(counts[0]));
+        int64_t total = 0;
+        for (i=0; i<ncounts; i++) {
+            total += (int64_t) counts[i].count;
+        }
+        tassert_equal(total, nexpected);
+
+        // with more threads than chunks
+        uint32_t chunk = roke_scan_set_chunk_for_test(2);
+        opts.threads = 4;
+        tassert_equal(roke_count(config_directory, patterns, 1, &opts, NULL, NULL), nexpected);
+
+        // a limit stops the count
+        opts.limit = 1;
+        tassert_equal(roke_count(config_directory, patterns, 1, &opts, NULL, NULL), 1);
+        roke_scan_set_chunk_for_test(chunk);
+
+        string_matcher_free(&sm);
+        free(expected);
+        expected = NULL;
+    }
+
+    const char* missing[] = {"no_such_name_anywhere"};
+    roke_locate_options_init(&opts);
+    opts.limit = 1;
+    tassert_zero(roke_count(config_directory, missing, 1, &opts, NULL, NULL));
+
+  end:
+    free(expected);
+    string_matcher_free(&sm);
+    return err;
+}
+
+int
+test_query_compile(void)
+{
+    int err=0;
+    roke_query_t* q = NULL;
+    const char* invalid[] = {"", "a AND", "(a", "a)", "NOT", "OR a",
+        "size>abc", "name:\"abc", "name~(", NULL};
+    int i;
+
+#define compile(text) roke_query_compile(&q, (uint8_t*) text, strlen(text), 0)
+
+    // metadata is tested before names, and names before paths
+    tassert_zero(compile("path:/var/ AND name:*.log size>10M"));
+    tassert_equal(q->root->op, ROKE_QOP_AND);
+    tassert_equal(q->root->nchildren, 3);
+    tassert_equal(q->root->children[0]->op, ROKE_QOP_META);
+    tassert_equal(q->root->children[1]->op, ROKE_QOP_NAME);
+    tassert_equal(q->root->children[2]->op, ROKE_QOP_PATH);
+    tassert_equal(q->prefilter, &q->root->children[1]->matcher);
+    tassert_equal(q->filters, ROKE_FILTER_SIZE_MIN);
+    roke_query_free(q);
+
+    // the types of every type filter are collected, a link needs an index
+    // with a mode column
+    tassert_zero(compile("type:f OR type:l"));
+    tassert_equal(q->filters, ROKE_FILTER_TYPE);
+    tassert_equal(q->types, ROKE_TYPE_FILE|ROKE_TYPE_LINK);
+    roke_query_free(q);
+
+    // regular expressions are tested last, and literals before globs
+    tassert_zero(compile("name~^a name:*.c name:b"));
+    tassert_equal(q->root->children[0]->matcher.flags&ROKE_MATCH_MASK, 0);
+    tassert_equal(q->root->children[1]->matcher.flags&ROKE_MATCH_MASK, ROKE_GLOB);
+    tassert_equal(q->root->children[2]->matcher.flags&ROKE_MATCH_MASK, ROKE_REGEX);
+    roke_query_free(q);
+
+    // AND binds more tightly than OR, and a query which does not require
+    // a name pattern has no prefilter
+    tassert_zero(compile("a OR b c"));
+    tassert_equal(q->root->op, ROKE_QOP_OR);
+    tassert_equal(q->root->children[0]->op, ROKE_QOP_NAME);
+    tassert_equal(q->root->children[1]->op, ROKE_QOP_AND);
+    tassert_null(q->prefilter);
+    roke_query_free(q);
+
+    tassert_zero(compile("NOT (a OR \"b c\")"));
+    tassert_equal(q->root->op, ROKE_QOP_NOT);
+    tassert_str_equal((char*) q->root->children[0]->children[1]->matcher.pattern, "b c");
+    roke_query_free(q);
+    q = NULL;
+
+    for (i=0; invalid[i]!=NULL; i++) {
+        tassert_nonzero(compile(invalid[i]));
+        tassert_null(q);
+    }
+
+#undef compile
+
+  end:
+    roke_query_free(q);
+    return err;
+}
+
+int
+test_locate_query(const char* config_directory)
+{
+    int err=0;
+    string_matcher_t sm[3];
+    string_matcher_t* legacy[] = {&sm[0], &sm[1], NULL};
+    string_matcher_t* query[] = {&sm[2], NULL};
+    roke_locate_options_t opts;
+    char* expected = NULL;
+    char* actual = NULL;
+    long nexpected = 0, nactual = 0;
+    const char* text = "path:roke AND name:test";
+
+    roke_locate_options_init(&opts);
+    string_matcher_init(&sm[0], (uint8_t*)"test", 4, 0);
+    string_matcher_init(&sm[1], (uint8_t*)"roke", 4, 0);
+    tassert_zero(string_matcher_init(&sm[2], (uint8_t*)text, strlen(text), ROKE_QUERY));
+
+    // a query gives the same results as the equivalent pair of patterns
+    expected = locate_to_string(config_directory, legacy, &opts, &nexpected);
+    actual = locate_to_string(config_directory, query, &opts, &nactual);
+    tassert_nonnull(expected);
+    tassert_nonnull(actual);
+    tassert_true(nexpected > 0);
+    tassert_str_equal(actual, expected);
+
+  end:
+    free(expected);
+    free(actual);
+    string_matcher_free(&sm[0]);
+    string_matcher_free(&sm[1]);
+    string_matcher_free(&sm[2]);
+    return err;
+}
+
+int
+test_parse_filters(void)
+{
+    int err=0;
+    int64_t t;
+    roke_locate_options_t opts;
+
+    roke_locate_options_init(&opts);
+    tassert_zero(roke_parse_size_filter("+1G", &opts));
+    tassert_equal(opts.filters, ROKE_FILTER_SIZE_MIN);
+    tassert_equal(opts.size_min, (1ll << 30) + 1);
+
+    roke_locate_options_init(&opts);
+    tassert_zero(roke_parse_size_filter("-10k", &opts));
+    tassert_equal(opts.filters, ROKE_FILTER_SIZE_MAX);
+    tassert_equal(opts.size_max, 10 * 1024 - 1);
+
+    roke_locate_options_init(&opts);
+    tassert_zero(roke_parse_size_filter("2M", &opts));
+    tassert_equal(opts.size_min, (1 << 20) + 1);
+    tassert_equal(opts.size_max, 2 << 20);
+
+    tassert_nonzero(roke_parse_size_filter("G", &opts));
+    tassert_nonzero(roke_parse_size_filter("1X", &opts));
+    tassert_nonzero(roke_parse_size_filter("-0", &opts));
+    tassert_nonzero(roke_parse_size_filter("+20000000T", &opts));
+    tassert_nonzero(roke_parse_size_filter("16777216T", &opts));
+    tassert_nonzero(roke_parse_size_filter("99999999999999999999", &opts));
+    tassert_nonzero(roke_parse_size_filter("+18446744073709551615", &opts));
+    tassert_zero(roke_parse_size_filter("16777215T", &opts));
+
+    tassert_zero(roke_parse_time_filter("1d", 100000, &t));
+    tassert_equal(t, 100000 - 86400);
+    tassert_zero(roke_parse_time_filter("30m", 100000, &t));
+    tassert_equal(t, 100000 - 1800);
+    tassert_zero(roke_parse_time_filter("2", 200000, &t));
+    tassert_equal(t, 200000 - 2 * 86400);
+    tassert_zero(roke_parse_time_filter("2020-01-02", 0, &t));
+    tassert_true(t > 1577000000 && t < 1578100000);
+    tassert_nonzero(roke_parse_time_filter("yesterday", 0, &t));
+
+    roke_locate_options_init(&opts);
+    tassert_zero(roke_parse_type_filter("f,l", &opts));
+    tassert_equal(opts.types, ROKE_TYPE_FILE|ROKE_TYPE_LINK);
+    tassert_nonzero(roke_parse_type_filter("x", &opts));
+
+  end:
+    return err;
+}
+
 int
 test_get_config_1(void) {
     int err = 0;
@@ -207,6 +1502,476 @@ fork_locate_test_2(char* config_base) {
 
 }
 
+// run the next query of a session, returning the text it wrote
+static char*
+session_to_string(roke_session_t* session, const char** patterns,
+    size_t npatterns, const roke_locate_options_t* opts)
+{
+    FILE* fp = tmpfile();
+    char* text = NULL;
+    if (fp == NULL) {
+        return NULL;
+    }
+    // the session closes the descriptor it is given
+    if (roke_session_locate_fd(session, dup(fileno(fp)), patterns, npatterns, opts) == 0) {
+        long size = (long) lseek(fileno(fp), 0, SEEK_END);
+        text = malloc(size + 1);
+        if (text != NULL) {
+            lseek(fileno(fp), 0, SEEK_SET);
+            size = (long) read(fileno(fp), text, size);
+            text[size < 0 ? 0 : size] = '\0';
+        }
+    }
+    fclose(fp);
+    return text;
+}
+
+int
+test_session(const char* config_directory)
+{
+    int err=0;
+    string_matcher_t sm[2];
+    string_matcher_t* strmatch[] = {&sm[0], &sm[1], NULL};
+    size_t lens[2];
+    roke_locate_options_t opts;
+    roke_session_t* session = NULL;
+    char* expected = NULL;
+    char* actual = NULL;
+    long nexpected = 0;
+    size_t k;
+
+    // each query extends the one before it, until it does not
+    struct {
+        const char* patterns[2];
+        size_t npatterns;
+        int flags;
+        int limit;
+    } cases[] = {
+        {{"l"}, 1, 0, 0},
+        {{"li"}, 1, 0, 0},
+        {{"libro"}, 1, 0, 5},
+        {{"libroke"}, 1, 0, 0},
+        {{"libroke_"}, 1, 0, 0},
+        {{"roke"}, 1, 0, 0},
+        {{"ROKE"}, 1, ROKE_CASE_INSENSITIVE, 0},
+        {{"ROKE.C"}, 1, ROKE_CASE_INSENSITIVE, 0},
+        {{"rk"}, 1, ROKE_FUZZY, 10},
+        {{"rklb"}, 1, ROKE_FUZZY, 10},
+        {{"rklbc"}, 1, ROKE_FUZZY, 0},
+        {{"li", "roke"}, 2, ROKE_MATCH_ALL, 0},
+        {{"lib", "roke_"}, 2, ROKE_MATCH_ALL, 0},
+        {{"test", "/common/"}, 2, 0, 0},
+        {{"test.c", "/common/"}, 2, 0, 0},
+        {{"_test.c", "roke/common/"}, 2, 0, 0},
+        {{"tes"}, 1, ROKE_RANK, 3},
+        {{"test"}, 1, ROKE_RANK, 3},
+        {{"*.h"}, 1, ROKE_GLOB, 0},
+        {{"*_test.h"}, 1, ROKE_GLOB, 0},
+    };
+
+    memset(sm, 0, sizeof(sm));
+    tassert_zero(roke_session_open(&session, config_directory));
+
+    for (k=0; k<sizeof(cases)/sizeof(cases[0]); k++) {
+        roke_locate_options_init(&opts);
+        opts.match_flags = cases[k].flags;
+        opts.limit = cases[k].limit;
+        lens[0] = strlen(cases[k].patterns[0]);
+        lens[1] = (cases[k].npatterns > 1) ? strlen(cases[k].patterns[1]) : 0;
+        if (opts.match_flags&ROKE_MATCH_ALL) {
+            tassert_zero(string_matcher_init_multi(&sm[0],
+                (const uint8_t**) cases[k].patterns, lens, 2, opts.match_flags));
+            strmatch[1] = NULL;
+        } else {
+            tassert_zero(string_matcher_init(&sm[0],
+                (const uint8_t*) cases[k].patterns[0], lens[0], opts.match_flags));
+            strmatch[1] = NULL;
+            if (cases[k].npatterns > 1) {
+                tassert_zero(string_matcher_init(&sm[1],
+                    (const uint8_t*) cases[k].patterns[1], lens[1], opts.match_flags));
+                strmatch[1] = &sm[1];
+            }
+        }
+        expected = locate_to_string(config_directory, strmatch, &opts, &nexpected);
+        string_matcher_free(&sm[0]);
+        if (strmatch[1] != NULL) {
+            string_matcher_free(&sm[1]);
+        }
+        actual = session_to_string(session, cases[k].patterns, cases[k].npatterns, &opts);
+        tassert_nonnull(expected);
+        tassert_nonnull(actual);
+        tassert_str_equal(actual, expected);
+        free(expected);
+        free(actual);
+        expected = actual = NULL;
+    }
+
+    // a cancel only stops the query which is running
+    roke_session_cancel(session);
+    roke_locate_options_init(&opts);
+    actual = session_to_string(session, cases[3].patterns, 1, &opts);
+    tassert_nonnull(actual);
+    tassert_nonnull(strstr(actual, "libroke.c"));
+
+  end:
+    free(expected);
+    free(actual);
+    roke_session_close(session);
+    return err;
+}
+
+// query a running server, returning the text it wrote or NULL if no server
+// answered
+static char*
+remote_to_string(const char* config_directory, const char* pattern)
+{
+    FILE* fp = tmpfile();
+    char* text = NULL;
+    const char* patterns[] = {pattern, NULL};
+    roke_locate_options_t opts;
+    if (fp == NULL) {
+        return NULL;
+    }
+    roke_locate_options_init(&opts);
+    if (roke_locate_remote_fd(fileno(fp), config_directory, patterns, 1, &opts) == 0) {
+        // the server wrote to the descriptor, not through fp
+        long size = (long) lseek(fileno(fp), 0, SEEK_END);
+        text = malloc(size + 1);
+        if (text != NULL) {
+            lseek(fileno(fp), 0, SEEK_SET);
+            size = (long) read(fileno(fp), text, size);
+            text[size < 0 ? 0 : size] = '\0';
+        }
+    }
+    fclose(fp);
+    return text;
+}
+
+int
+test_server(const char* config_directory)
+{
+    int err=0;
+    char source[1024];
+    char config[1024];
+    string_matcher_t sm;
+    string_matcher_t* strmatch[] = {&sm, NULL};
+    roke_locate_options_t opts;
+    char* expected = NULL;
+    char* actual = NULL;
+    long nexpected = 0;
+    pid_t pid = -1;
+    int status = 0;
+    uint32_t k;
+
+    char* blacklist[] = {".", "..", NULL};
+
+    memset(&sm, 0, sizeof(sm));
+    snprintf(source, sizeof(source), "%sserver_src/", config_directory);
+    snprintf(config, sizeof(config), "%sserver/", config_directory);
+    makedirs((uint8_t*) source);
+    makedirs((uint8_t*) config);
+    touch(source, "served_one.txt");
+    touch(source, "other.txt");
+    roke_build_index(config, "s", source, blacklist);
+
+    // without a server the caller is told to search by itself
+    tassert_null(remote_to_string(config, "served"));
+
+    pid = fork();
+    tassert_true(pid >= 0);
+    if (pid == 0) {
+        exit(roke_server_run(config));
+    }
+
+    for (k=0; k<100 && actual == NULL; k++) {
+        usleep(20000);
+        actual = remote_to_string(config, "served");
+    }
+    tassert_nonnull(actual);
+
+    tassert_zero(string_matcher_init(&sm, (const uint8_t*) "served", 6, 0));
+    roke_locate_options_init(&opts);
+    expected = locate_to_string(config, strmatch, &opts, &nexpected);
+    tassert_nonnull(expected);
+    tassert_str_equal(actual, expected);
+    tassert_nonnull(strstr(actual, "served_one.txt"));
+    free(actual);
+    free(expected);
+    actual = expected = NULL;
+
+    // a rebuilt index is used by the next query
+    touch(source, "served_two.txt");
+    roke_build_index(config, "s", source, blacklist);
+    actual = remote_to_string(config, "served");
+    tassert_nonnull(actual);
+    tassert_nonnull(strstr(actual, "served_one.txt"));
+    tassert_nonnull(strstr(actual, "served_two.txt"));
+
+  end:
+    if (pid > 0) {
+        kill(pid, SIGTERM);
+        waitpid(pid, &status, 0);
+    }
+    free(expected);
+    free(actual);
+    string_matcher_free(&sm);
+    return err;
+}
+
+int
+test_server_cut_short(const char* config_directory)
+{
+    int err=0;
+    char config[1024];
+    struct sockaddr_un addr;
+    const char* patterns[] = {"served", NULL};
+    roke_locate_options_t opts;
+    FILE* fp = NULL;
+    pid_t pid = -1;
+    int status = 0;
+    int sock = -1;
+    char text[16] = {0};
+
+    snprintf(config, sizeof(config), "%scut_short/", config_directory);
+    makedirs((uint8_t*) config);
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    tassert_true(strlen(config) + 10 <= sizeof(addr.sun_path));
+    memcpy(addr.sun_path, config, strlen(config));
+    strcat(addr.sun_path, "roke.sock");
+    unlink(addr.sun_path);
+    sock = socket(AF_UNIX, SOCK_STREAM, 0);
+    tassert_true(sock >= 0);
+    tassert_zero(bind(sock, (struct sockaddr*) &addr, sizeof(addr)));
+    tassert_zero(listen(sock, 1));
+
+    // a server which answers, then goes away part way through the results
+    pid = fork();
+    tassert_true(pid >= 0);
+    if (pid == 0) {
+        int conn = accept(sock, NULL, NULL);
+        uint32_t header[2];
+        char request[4096];
+        int32_t response[2] = {0x32524b52, 0};
+        uint32_t frame = 6;
+        if (conn < 0 || read(conn, header, sizeof(header)) != sizeof(header) ||
+            header[1] > sizeof(request) || read(conn, request, header[1]) < 0) {
+            exit(1);
+        }
+        if (write(conn, response, sizeof(response)) < 0 ||
+            write(conn, &frame, sizeof(frame)) < 0 ||
+            write(conn, "abc\nde", frame) < 0) {
+            exit(1);
+        }
+        exit(0);
+    }
+
+    fp = tmpfile();
+    tassert_nonnull(fp);
+    roke_locate_options_init(&opts);
+    tassert_nonzero(roke_locate_remote_fd(fileno(fp), config, patterns, 1, &opts));
+    lseek(fileno(fp), 0, SEEK_SET);
+    tassert_equal(read(fileno(fp), text, sizeof(text) - 1), 6);
+    tassert_str_equal(text, "abc\nde");
+
+  end:
+    if (pid > 0) {
+        waitpid(pid, &status, 0);
+    }
+    if (fp != NULL) {
+        fclose(fp);
+    }
+    if (sock >= 0) {
+        close(sock);
+    }
+    unlink(addr.sun_path);
+    return err;
+}
+
+int
+test_locate_memstream(const char* config_directory)
+{
+    int err=0;
+    string_matcher_t sm;
+    string_matcher_t* strmatch[] = {&sm, NULL};
+    roke_locate_options_t opts;
+    char* expected = NULL;
+    char* actual = NULL;
+    size_t nactual = 0;
+    long nexpected = 0;
+
+    memset(&sm, 0, sizeof(sm));
+    tassert_zero(string_matcher_init(&sm, (const uint8_t*) "libroke", 7, 0));
+    roke_locate_options_init(&opts);
+    expected = locate_to_string(config_directory, strmatch, &opts, &nexpected);
+    tassert_nonnull(expected);
+    tassert_true(nexpected > 0);
+
+    // a stream without a file descriptor
+    FILE* fp = open_memstream(&actual, &nactual);
+    tassert_nonnull(fp);
+    tassert_zero(roke_locate_impl(fp, (const uint8_t*) config_directory, strmatch, &opts));
+    fclose(fp);
+    tassert_equal((long) nactual, nexpected);
+    tassert_str_equal(actual, expected);
+
+    // a write which fails fails the query
+    fp = fopen("/dev/full", "w");
+    if (fp != NULL) {
+        int v = roke_locate_impl(fp, (const uint8_t*) config_directory, strmatch, &opts);
+        fclose(fp);
+        tassert_nonzero(v);
+    }
+
+  end:
+    free(expected);
+    free(actual);
+    string_matcher_free(&sm);
+    return err;
+}
+
+// remove the lines of text containing word, in place
+static void
+drop_lines(char* text, const char* word)
+{
+    char* out = text;
+    while (*text) {
+        char* nl = strchr(text, '\n');
+        size_t len = (nl != NULL) ? (size_t) (nl - text) + 1 : strlen(text);
+        char c = text[len - 1];
+        text[len - 1] = '\0';
+        int keep = (strstr(text, word) == NULL);
+        text[len - 1] = c;
+        if (keep) {
+            memmove(out, text, len);
+            out += len;
+        }
+        text += len;
+    }
+    *out = '\0';
+}
+
+// keep the first n lines of text
+static void
+head_lines(char* text, int n)
+{
+    for (; *text && n > 0; text++) {
+        n -= (*text == '\n');
+    }
+    *text = '\0';
+}
+
+int
+test_existing(const char* config_directory)
+{
+    int err=0;
+    char source[1024];
+    char many[1024];
+    char config[1024];
+    char path[ROKE_PATH_MAX];
+    char name[64];
+    string_matcher_t sm;
+    string_matcher_t* strmatch[] = {&sm, NULL};
+    const char* patterns[] = {"_", NULL};
+    roke_locate_options_t opts;
+    roke_session_t* session = NULL;
+    char* expected = NULL;
+    char* actual = NULL;
+    long nexpected = 0, nactual = 0;
+    size_t k;
+    int i;
+    struct {
+        int flags;
+        int limit;
+        int threads;
+    } cases[] = {
+        {0, 0, 1},
+        {0, 0, 4},
+        {0, 3, 1},
+        {0, 3, 4},
+        {0, 1, 4},
+        {ROKE_RANK, 0, 4},
+    };
+
+    char* blacklist[] = {".", "..", NULL};
+
+    memset(&sm, 0, sizeof(sm));
+    snprintf(source, sizeof(source), "%sexisting_src/", config_directory);
+    snprintf(config, sizeof(config), "%sexisting/", config_directory);
+    snprintf(path, sizeof(path), "%sgone_dir/", source);
+    makedirs((uint8_t*) path);
+    snprintf(path, sizeof(path), "%skeep_dir/", source);
+    makedirs((uint8_t*) path);
+    makedirs((uint8_t*) config);
+    touch(source, "keep_a.txt");
+    touch(source, "gone_b.txt");
+    touch(source, "keep_c.txt");
+    touch(source, "gone_dir/inner_d.txt");
+    touch(source, "keep_dir/keep_e.txt");
+    roke_build_index(config, "e", source, blacklist);
+
+    // an index searched first whose results, past more than the limit
+    // and a window of them, are deleted
+    snprintf(many, sizeof(many), "%sexistingmany/", config_directory);
+    snprintf(path, sizeof(path), "%smany/sub/", many);
+    makedirs((uint8_t*) path);
+    for (i=0; i<1100; i++) {
+        snprintf(name, sizeof(name), "many/gone_%d.txt", i);
+        touch(many, name);
+    }
+    touch(many, "many/sub/keep_f.txt");
+    roke_build_index(config, "d", many, blacklist);
+    for (i=0; i<1100; i++) {
+        snprintf(path, sizeof(path), "%smany/gone_%d.txt", many, i);
+        tassert_zero(unlink(path));
+    }
+
+    // a deleted directory takes its children with it
+    snprintf(path, sizeof(path), "%sgone_b.txt", source);
+    tassert_zero(unlink(path));
+    snprintf(path, sizeof(path), "%sgone_dir/inner_d.txt", source);
+    tassert_zero(unlink(path));
+    snprintf(path, sizeof(path), "%sgone_dir", source);
+    tassert_zero(rmdir(path));
+
+    tassert_zero(string_matcher_init(&sm, (const uint8_t*) "_", 1, 0));
+    tassert_zero(roke_session_open(&session, config));
+    for (k=0; k<sizeof(cases)/sizeof(cases[0]); k++) {
+        roke_locate_options_init(&opts);
+        opts.match_flags = cases[k].flags;
+        opts.threads = cases[k].threads;
+        expected = locate_to_string(config, strmatch, &opts, &nexpected);
+        tassert_nonnull(expected);
+        tassert_nonnull(strstr(expected, "gone_dir/inner_d.txt"));
+        drop_lines(expected, "gone");
+        if (cases[k].limit > 0) {
+            head_lines(expected, cases[k].limit);
+        }
+
+        // the results which exist, in the same order
+        opts.limit = cases[k].limit;
+        opts.filters |= ROKE_FILTER_EXISTS;
+        actual = locate_to_string(config, strmatch, &opts, &nactual);
+        tassert_nonnull(actual);
+        tassert_str_equal(actual, expected);
+        free(actual);
+
+        actual = session_to_string(session, patterns, 1, &opts);
+        tassert_nonnull(actual);
+        tassert_str_equal(actual, expected);
+        free(actual);
+        free(expected);
+        actual = expected = NULL;
+    }
+
+  end:
+    free(expected);
+    free(actual);
+    roke_session_close(session);
+    string_matcher_free(&sm);
+    return err;
+}
+
 #endif
 
 
@@ -248,8 +2013,39 @@ main(int argc, const char **argv) {
 
 
 
-    run_test(fork_locate_test_1, config_dir);
-    run_test(fork_locate_test_2, config_dir);
+    run_test_continue(fork_locate_test_1, config_dir);
+    run_test_continue(fork_locate_test_2, config_dir);
+#endif
+
+    run_test(test_index_sketch, config_dir);
+    run_test(test_build_index_metadata, config_dir, source_dir);
+    run_test(test_parse_filters);
+    run_test(test_compute_ranges);
+    run_test(test_index_ranges, config_dir, source_dir);
+    run_test(test_build_index_compressed, config_dir, source_dir);
+    run_test(test_match_block, config_dir);
+    run_test(test_match_multi);
+    run_test(test_match_icase);
+    run_test(test_match_glob);
+    run_test(test_locate_threads, config_dir);
+    run_test(test_locate_path_patterns, config_dir);
+    run_test(test_locate_fuzzy, config_dir);
+    run_test(test_query_compile);
+    run_test(test_locate_query, config_dir);
+    run_test(test_locate_normalized, config_dir);
+    run_test(test_sketch_folded, config_dir);
+    run_test(test_binarize_short, config_dir);
+    run_test(test_locate_rank, config_dir);
+    run_test(test_search, config_dir);
+    run_test(test_count, config_dir);
+    run_test(test_format, config_dir);
+
+#ifndef _WIN32
+    run_test(test_session, config_dir);
+    run_test(test_server, config_dir);
+    run_test(test_locate_memstream, config_dir);
+    run_test(test_server_cut_short, config_dir);
+    run_test(test_existing, config_dir);
 #endif
   exit:
     end_test();
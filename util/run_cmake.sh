@@ -3,6 +3,7 @@ mode="${1:-release}"
 
 USE_COVERAGE=
 USE_PROFILE=
+USE_BENCHMARK=
 
 case "$mode" in
     release)
@@ -19,10 +20,14 @@ case "$mode" in
         BUILD_TYPE=Debug
         USE_COVERAGE="-DROKE_COVERAGE=1"
     ;;
+    benchmark)
+        BUILD_TYPE=Release
+        USE_BENCHMARK="-DROKE_BENCHMARK=1"
+    ;;
     *)
         echo "unknown profile: $mode"
         echo
-        echo "usage: $0 {release|debug|profile|coverage}"
+        echo "usage: $0 {release|debug|profile|coverage|benchmark}"
         exit 1
     ;;
 esac
@@ -78,6 +83,7 @@ $cmake -G "Unix Makefiles" \
     ${HAVE_DIRENT} \
     ${USE_COVERAGE} \
     ${USE_PROFILE} \
+    ${USE_BENCHMARK} \
     -DCMAKE_BUILD_TYPE=${BUILD_TYPE} \
     -DCMAKE_MACOSX_RPATH=NEW \
     -DCMAKE_C_COMPILER="$CC" \